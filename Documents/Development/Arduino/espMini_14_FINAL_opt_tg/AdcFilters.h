@@ -0,0 +1,102 @@
+#ifndef ADC_FILTERS_H
+#define ADC_FILTERS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <algorithm>
+
+// Окно последних отсчётов канала АЦП (в мВ) и фильтры по нему.
+// Среднее, RMS и EMA ведутся на лету при добавлении отсчёта, медиана
+// считается по запросу. Без Arduino: проверяется на хосте.
+
+enum AdcFilter : uint8_t {
+    ADC_FILTER_MEAN,
+    ADC_FILTER_MEDIAN,
+    ADC_FILTER_EMA,
+    ADC_FILTER_RMS      // действующее значение переменной составляющей
+};
+
+#define ADC_EMA_SHIFT 4   // коэффициент EMA = 1/16
+
+template<size_t N>
+class AdcWindow {
+public:
+    void clear() {
+        head = 0;
+        filled = 0;
+        sum = 0;
+        sumSquares = 0;
+        emaValue = 0;
+    }
+
+    void push(uint16_t mv) {
+        if (filled == N) {
+            uint16_t oldest = samples[head];
+            sum -= oldest;
+            sumSquares -= (uint32_t)oldest * oldest;
+        } else {
+            filled++;
+        }
+
+        samples[head] = mv;
+        head = (head + 1) % N;
+        sum += mv;
+        sumSquares += (uint32_t)mv * mv;
+
+        // EMA в формате Q8, первый отсчёт - начальное значение
+        int32_t scaled = (int32_t)mv << 8;
+        if (filled == 1) emaValue = scaled;
+        else emaValue += (scaled - emaValue) >> ADC_EMA_SHIFT;
+    }
+
+    size_t count() const { return filled; }
+
+    float mean() const {
+        return filled ? (float)sum / filled : 0.0f;
+    }
+
+    float ema() const {
+        return emaValue / 256.0f;
+    }
+
+    // Среднеквадратичное отклонение от среднего: для датчиков тока с опорой в середине шкалы.
+    float rms() const {
+        if (!filled) return 0.0f;
+        double avg = (double)sum / filled;
+        double variance = (double)sumSquares / filled - avg * avg;
+        return variance > 0 ? (float)sqrt(variance) : 0.0f;
+    }
+
+    float median() const {
+        if (!filled) return 0.0f;
+        uint16_t scratch[N];
+        std::copy(samples, samples + filled, scratch);
+        size_t middle = filled / 2;
+        std::nth_element(scratch, scratch + middle, scratch + filled);
+        if (filled & 1) return scratch[middle];
+
+        uint16_t upper = scratch[middle];
+        uint16_t lower = *std::max_element(scratch, scratch + middle);
+        return (lower + upper) / 2.0f;
+    }
+
+    float value(AdcFilter filter) const {
+        switch (filter) {
+            case ADC_FILTER_MEDIAN: return median();
+            case ADC_FILTER_EMA: return ema();
+            case ADC_FILTER_RMS: return rms();
+            default: return mean();
+        }
+    }
+
+private:
+    uint16_t samples[N];
+    size_t head = 0;
+    size_t filled = 0;
+    uint32_t sum = 0;
+    uint64_t sumSquares = 0;
+    int32_t emaValue = 0;
+};
+
+#endif
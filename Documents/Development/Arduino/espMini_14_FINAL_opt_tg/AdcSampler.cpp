@@ -0,0 +1,231 @@
+#include "AdcSampler.h"
+
+#if defined(ADC_SAMPLER_DMA)
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+
+#define ADC_DMA_FRAME_SIZE 256
+#define ADC_DMA_BUFFER_SIZE 2048
+#define ADC_MAX_OVERSAMPLE 64
+// Затухание 11/12 дБ: диапазон ~0-3.1 В
+#define ADC_SAMPLER_ATTEN ((adc_atten_t)3)
+#define ADC_MAX_RAW ((1 << SOC_ADC_DIGI_MAX_BITWIDTH) - 1)
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define ADC_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define ADC_RESULT_CHANNEL(p) ((p)->type1.channel)
+#define ADC_RESULT_DATA(p) ((p)->type1.data)
+#else
+#define ADC_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define ADC_RESULT_CHANNEL(p) ((p)->type2.channel)
+#define ADC_RESULT_DATA(p) ((p)->type2.data)
+#endif
+#endif
+
+AdcSampler::~AdcSampler() {
+    stop();
+}
+
+const AdcChannelWindow* AdcSampler::window(uint8_t pin) const {
+    for (uint8_t i = 0; i < channelCount; i++) {
+        if (channels[i].pin == pin) return &channels[i].window;
+    }
+    return nullptr;
+}
+
+#if defined(ADC_SAMPLER_DMA)
+
+bool AdcSampler::configure(const uint8_t* pins, size_t count, uint16_t rate) {
+    stop();
+    rateHz = constrain(rate, ADC_MIN_RATE_HZ, ADC_MAX_RATE_HZ);
+
+    bool allBound = true;
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX] = {};
+
+    for (size_t i = 0; i < count; i++) {
+        adc_unit_t unit;
+        adc_channel_t adcChannel;
+        // В DMA-режиме работает только АЦП1 (АЦП2 занят Wi-Fi)
+        if (channelCount >= ADC_MAX_CHANNELS || channelCount >= SOC_ADC_PATT_LEN_MAX ||
+            adc_continuous_io_to_channel(pins[i], &unit, &adcChannel) != ESP_OK || unit != ADC_UNIT_1) {
+            allBound = false;
+            continue;
+        }
+
+        Channel& channel = channels[channelCount];
+        channel.pin = pins[i];
+        channel.adcChannel = adcChannel;
+        channel.accumulator = 0;
+        channel.accumulated = 0;
+        channel.window.clear();
+
+        pattern[channelCount].atten = ADC_SAMPLER_ATTEN;
+        pattern[channelCount].channel = adcChannel & 0x7;
+        pattern[channelCount].unit = ADC_UNIT_1;
+        pattern[channelCount].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        channelCount++;
+    }
+    if (channelCount == 0) return allBound;
+
+    // Контроллер не умеет медленнее нижнего порога: лишние отсчёты усредняются
+    uint32_t totalRate = (uint32_t)rateHz * channelCount;
+    uint32_t ratio = (SOC_ADC_SAMPLE_FREQ_THRES_LOW + totalRate - 1) / totalRate;
+    oversample = constrain(ratio, 1, ADC_MAX_OVERSAMPLE);
+    uint32_t sampleFreq = min((uint32_t)SOC_ADC_SAMPLE_FREQ_THRES_HIGH, totalRate * oversample);
+
+    adc_continuous_handle_cfg_t handleConfig = {};
+    handleConfig.max_store_buf_size = ADC_DMA_BUFFER_SIZE;
+    handleConfig.conv_frame_size = ADC_DMA_FRAME_SIZE;
+
+    adc_continuous_config_t config = {};
+    config.pattern_num = channelCount;
+    config.adc_pattern = pattern;
+    config.sample_freq_hz = sampleFreq;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_OUTPUT_FORMAT;
+
+    if (adc_continuous_new_handle(&handleConfig, &handle) != ESP_OK) {
+        handle = nullptr;
+        channelCount = 0;
+        return false;
+    }
+    if (adc_continuous_config(handle, &config) != ESP_OK || adc_continuous_start(handle) != ESP_OK) {
+        stop();
+        return false;
+    }
+
+    buildCalibration();
+    return allBound;
+}
+
+// Таблица код -> мВ по калибровке из eFuse; без неё - линейная шкала
+void AdcSampler::buildCalibration() {
+    adc_cali_handle_t cali = nullptr;
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t caliConfig = {};
+    caliConfig.unit_id = ADC_UNIT_1;
+    caliConfig.atten = ADC_SAMPLER_ATTEN;
+    caliConfig.bitwidth = ADC_BITWIDTH_DEFAULT;
+    if (adc_cali_create_scheme_curve_fitting(&caliConfig, &cali) != ESP_OK) cali = nullptr;
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t caliConfig = {};
+    caliConfig.unit_id = ADC_UNIT_1;
+    caliConfig.atten = ADC_SAMPLER_ATTEN;
+    caliConfig.bitwidth = ADC_BITWIDTH_DEFAULT;
+    if (adc_cali_create_scheme_line_fitting(&caliConfig, &cali) != ESP_OK) cali = nullptr;
+#endif
+
+    calibration.build(0, ADC_MAX_RAW, 7, [cali](int32_t raw) -> int32_t {
+        if (raw > ADC_MAX_RAW) raw = ADC_MAX_RAW;
+        int mv = 0;
+        if (cali && adc_cali_raw_to_voltage(cali, raw, &mv) == ESP_OK) return mv;
+        return raw * ADC_FULL_SCALE_MV / ADC_MAX_RAW;
+    });
+
+    if (cali) {
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+        adc_cali_delete_scheme_curve_fitting(cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+        adc_cali_delete_scheme_line_fitting(cali);
+#endif
+    }
+}
+
+AdcSampler::Channel* AdcSampler::findByAdcChannel(uint8_t adcChannel) {
+    for (uint8_t i = 0; i < channelCount; i++) {
+        if (channels[i].adcChannel == adcChannel) return &channels[i];
+    }
+    return nullptr;
+}
+
+void AdcSampler::stop() {
+    if (handle) {
+        adc_continuous_stop(handle);
+        adc_continuous_deinit(handle);
+        handle = nullptr;
+    }
+    channelCount = 0;
+}
+
+void AdcSampler::update() {
+    if (!handle) return;
+
+    uint8_t frame[ADC_DMA_FRAME_SIZE];
+    uint32_t length = 0;
+
+    while (adc_continuous_read(handle, frame, sizeof(frame), &length, 0) == ESP_OK) {
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            adc_digi_output_data_t* result = (adc_digi_output_data_t*)&frame[i];
+            Channel* channel = findByAdcChannel(ADC_RESULT_CHANNEL(result));
+            if (!channel) continue;
+
+            channel->accumulator += ADC_RESULT_DATA(result);
+            if (++channel->accumulated >= oversample) {
+                channel->window.push(calibration.lookup(channel->accumulator / channel->accumulated));
+                channel->accumulator = 0;
+                channel->accumulated = 0;
+            }
+        }
+    }
+}
+
+#else
+
+bool AdcSampler::configure(const uint8_t* pins, size_t count, uint16_t rate) {
+    stop();
+    rateHz = constrain(rate, ADC_MIN_RATE_HZ, ADC_MAX_RATE_HZ);
+
+    bool allBound = true;
+    for (size_t i = 0; i < count; i++) {
+        if (channelCount >= ADC_MAX_CHANNELS) {
+            allBound = false;
+            continue;
+        }
+        channels[channelCount].pin = pins[i];
+        channels[channelCount].window.clear();
+        channelCount++;
+    }
+
+    if (channelCount > 0) {
+        uint32_t periodMs = max(1UL, 1000UL / rateHz);
+        sampleTimer.attach_ms(periodMs, onSample, this);
+    }
+    return allBound;
+}
+
+void AdcSampler::stop() {
+    sampleTimer.detach();
+    Sample sample;
+    while (samples.pop(sample)) {}
+    channelCount = 0;
+}
+
+uint16_t AdcSampler::readMilliVolts(uint8_t pin) {
+#if defined(ESP32)
+    return analogReadMilliVolts(pin);
+#else
+    return (uint32_t)analogRead(pin) * ADC_FULL_SCALE_MV / 1023;
+#endif
+}
+
+// Контекст таймера: только замер и запись в очередь
+void AdcSampler::onSample(AdcSampler* sampler) {
+    for (uint8_t i = 0; i < sampler->channelCount; i++) {
+        Sample sample = { i, readMilliVolts(sampler->channels[i].pin) };
+        if (!sampler->samples.push(sample)) {
+            sampler->droppedSamples.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void AdcSampler::update() {
+    Sample sample;
+    while (samples.pop(sample)) {
+        if (sample.channel < channelCount) {
+            channels[sample.channel].window.push(sample.mv);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <atomic>
+#include "AdcFilters.h"
+#include "LinearTable.h"
+#include "LockFreeQueue.h"
+
+// Непрерывный опрос аналоговых входов. На ESP32 (ESP-IDF 5) - DMA-режим АЦП
+// с передискретизацией и калибровкой по eFuse, на остальных - опрос по таймеру.
+// Сенсоры читают отфильтрованные значения из окон, АЦП напрямую не трогают.
+
+#if defined(ESP32) && ESP_IDF_VERSION_MAJOR >= 5
+#define ADC_SAMPLER_DMA
+#include "esp_adc/adc_continuous.h"
+#endif
+
+#if defined(ESP8266)
+#define ADC_MAX_CHANNELS 1
+#define ADC_WINDOW_SIZE 64
+#define ADC_MAX_RATE_HZ 100
+#else
+#define ADC_MAX_CHANNELS 8
+#define ADC_WINDOW_SIZE 200     // 200 мс при 1 кГц: целое число периодов 50 и 60 Гц
+#define ADC_MAX_RATE_HZ 1000
+#endif
+
+#define ADC_DEFAULT_RATE_HZ 1000
+#define ADC_MIN_RATE_HZ 10
+#define ADC_FULL_SCALE_MV 3300
+
+typedef AdcWindow<ADC_WINDOW_SIZE> AdcChannelWindow;
+
+class AdcSampler {
+public:
+    AdcSampler() = default;
+    ~AdcSampler();
+
+    AdcSampler(const AdcSampler&) = delete;
+    AdcSampler& operator=(const AdcSampler&) = delete;
+
+    // Перезапускает опрос для набора пинов; rateHz - отсчётов в секунду на канал.
+    // false - часть пинов не подключена (не АЦП1 или превышено число каналов).
+    bool configure(const uint8_t* pins, size_t count, uint16_t rateHz);
+    void stop();
+
+    // Переносит накопленные отсчёты в окна. Вызывается из задачи управления.
+    void update();
+
+    const AdcChannelWindow* window(uint8_t pin) const;
+
+    uint16_t rate() const { return rateHz; }
+    uint32_t dropped() const { return droppedSamples.load(std::memory_order_relaxed); }
+
+private:
+    struct Channel {
+        uint8_t pin;
+        AdcChannelWindow window;
+#if defined(ADC_SAMPLER_DMA)
+        uint8_t adcChannel;
+        uint32_t accumulator;
+        uint8_t accumulated;
+#endif
+    };
+
+    Channel channels[ADC_MAX_CHANNELS];
+    uint8_t channelCount = 0;
+    uint16_t rateHz = 0;
+    std::atomic<uint32_t> droppedSamples{0};
+
+#if defined(ADC_SAMPLER_DMA)
+    adc_continuous_handle_t handle = nullptr;
+    LinearTable calibration;   // код АЦП -> мВ
+    uint8_t oversample = 1;
+
+    void buildCalibration();
+    Channel* findByAdcChannel(uint8_t adcChannel);
+#else
+    struct Sample {
+        uint8_t channel;
+        uint16_t mv;
+    };
+
+    Ticker sampleTimer;
+    SpscQueue<Sample, 256> samples;
+
+    static void onSample(AdcSampler* sampler);
+    static uint16_t readMilliVolts(uint8_t pin);
+#endif
+};
+
+#endif
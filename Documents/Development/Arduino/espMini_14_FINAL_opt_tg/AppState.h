@@ -1,19 +1,23 @@
 #pragma once
 #include <Arduino.h>
+#include <atomic>
 
+// Флаги читаются и пишутся из разных задач (управление, сеть, AsyncTCP),
+// поэтому атомарные.
     struct AppState {
 
-    bool wifiConnected = false;
-    bool isAP = false;
-    bool isTemporaryAP = false;
-    bool isScanning = false;
-    bool isInternetAvailable = false;
-    bool isStartWifi = false;
+    std::atomic<bool> wifiConnected{false};
+    std::atomic<bool> isAP{false};
+    std::atomic<bool> isTemporaryAP{false};
+    std::atomic<bool> isScanning{false};
+    std::atomic<bool> isInternetAvailable{false};
+    std::atomic<bool> isStartWifi{false};
 
-    bool isUpdating = false;
-    bool isFormat = false;
-    bool isReboot = false;
-    bool isSaveControlRequest = false;
-    bool isSaveWifiRequest = false;
-    bool isProcessWorkingJson = false;
+    std::atomic<bool> isUpdating{false};
+    std::atomic<bool> isFormat{false};
+    std::atomic<bool> isReboot{false};
+    std::atomic<bool> isWifiToggleRequest{false};
+    std::atomic<bool> isSaveControlRequest{false};
+    std::atomic<bool> isSaveWifiRequest{false};
+    std::atomic<bool> isProcessWorkingJson{false};
 };
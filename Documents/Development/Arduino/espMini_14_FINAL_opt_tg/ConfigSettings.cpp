@@ -112,6 +112,8 @@ bool Settings::loadDefaults(bool saveToFile) {
   ws.autoReconnect = true;
   ws.timeZone = 3;
   ws.saveLogs = false;
+  ws.historyKb = HISTORY_ARCHIVE_BUDGET_KB;
+  ws.isMultiDevice = false;
 
   ws.networkSettings.clear();
   NetworkSetting defaultNetwork;
@@ -160,6 +162,8 @@ String Settings::serializeSettings(const WiFiSettings& settings) {
   doc["autoReconnect"] = settings.autoReconnect;
   doc["timeZone"] = settings.timeZone;
   doc["saveLogs"] = settings.saveLogs;
+  doc["historyKb"] = settings.historyKb;
+  doc["multiDev"] = settings.isMultiDevice;
 
   JsonObject telegram = doc.createNestedObject("telegramSettings");
   telegram["isTelegramOn"] = settings.telegramSettings.isTelegramOn;
@@ -212,6 +216,8 @@ bool Settings::deserializeSettings(JsonObject doc, WiFiSettings& settings) {
   settings.autoReconnect = doc["autoReconnect"] | true;
   settings.timeZone = doc["timeZone"] | 3;
   settings.saveLogs = doc["saveLogs"] | true;
+  settings.historyKb = max((int)HISTORY_ARCHIVE_MIN_KB, doc["historyKb"] | HISTORY_ARCHIVE_BUDGET_KB);
+  settings.isMultiDevice = doc["multiDev"] | false;
 
   if (doc.containsKey("staticIpAP")) {
     settings.staticIpAP.fromString(doc["staticIpAP"] | "192.168.1.1");
@@ -6,6 +6,7 @@
 #include "AppState.h"
 
 #include "CommonTypes.h"
+#include "HistoryArchive.h"
 
 struct TelegramUser {
   String id;
@@ -51,6 +52,8 @@ struct WiFiSettings {
 
   int8_t timeZone = 3;
   bool saveLogs;
+  uint16_t historyKb = HISTORY_ARCHIVE_BUDGET_KB;   // бюджет архива истории на флеше
+  bool isMultiDevice = false;   // все устройства с непересекающимися пинами работают одновременно
   TelegramSettings telegramSettings;
   int8_t systemLoading;
 };
@@ -1,5 +1,32 @@
 #include "Control.h"
 
+// Значения для выражений берутся прямо из устройства; минута суток -
+// по первому запросу, чтобы правила без "now" не трогали localtime
+class DeviceExpressionEnv : public ExpressionEnv {
+public:
+    DeviceExpressionEnv(const Device& target, time_t now) : device(target), now(now) {}
+
+    float sensorValue(uint16_t index) const override { return device.sensors[index].currentValue; }
+    float humidityValue(uint16_t index) const override { return device.sensors[index].humidityValue; }
+    bool relayState(uint16_t index) const override { return device.relays[index].statePin; }
+
+    int minuteOfDay() const override {
+        if (minute < 0) minute = minuteOfDay(now);
+        return minute;
+    }
+
+    static int minuteOfDay(time_t now) {
+        struct tm timeInfo;
+        localtime_r(&now, &timeInfo);
+        return timeInfo.tm_hour * 60 + timeInfo.tm_min;
+    }
+
+private:
+    const Device& device;
+    time_t now;
+    mutable int minute = -1;
+};
+
  Control::Control(DeviceManager& dm, Logger& logger, AppState& appState)
     : deviceManager(dm),
       logger(logger),
@@ -8,41 +35,14 @@
       currentDeviceIndex(dm.currentDeviceIndex)
 {
 
-    myPID = nullptr;
     lastPidTime = 0;
-    pidWindowStartTime = 0;
     lastUpdate = 0;
-
-    touchStates.clear();
   }
 
   void Control::setup() {
     setupControl();
   }
 
-  void Control::loop() {
-    //delay(300);
-  unsigned long now = millis();
-
-  readSensors();
-
-  static unsigned long lastFastUpdate = 0;
-  if (now - lastFastUpdate >= 250) {
-    updatePins();
-    setSensorActions();
-    lastFastUpdate = now;
-  }
-
-  static unsigned long lastSlowUpdate = 0;
-  if (now - lastSlowUpdate >= 1000) {
-
-    setSchedules();
-    setTimersExecute();
-    setTemperature();
-    lastSlowUpdate = now;
-  }
-}
-
   bool Control::isNumeric(const String& str) {
     for (size_t i = 0; i < str.length(); i++) {
       if (!isdigit(str.charAt(i))) {
@@ -97,31 +97,22 @@
     return true;
   }
 
-  int Control::shiftWeekDay(int currentDay) {
-    if (currentDay == 0) {
-      return 6;
-    } else {
-      return currentDay - 1;
-    }
+  void Control::setClock(MillisFn millisFn, TimeFn timeFn) {
+    clockMillis = millisFn ? millisFn : defaultMillis;
+    clockTime = timeFn ? timeFn : defaultTime;
   }
 
-  time_t Control::convertToTimeT(const String& date) {
-    tm t = {};
-    sscanf(date.c_str(), "%4d-%2d-%2d", &t.tm_year, &t.tm_mon, &t.tm_mday);
-
-    t.tm_year -= 1900;
-    t.tm_mon -= 1;
-
-    t.tm_hour = 0;
-    t.tm_min = 0;
-    t.tm_sec = 0;
+  uint32_t Control::defaultMillis() {
+    return millis();
+  }
 
-    return mktime(&t);
+  time_t Control::defaultTime() {
+    return time(nullptr);
   }
 
   time_t Control::getCurrentTime() {
 
-    return time(nullptr);
+    return clockTime();
   }
 
   String Control::formatDateTime(time_t rawTime) {
@@ -140,25 +131,6 @@
     return String(buffer);
   }
 
-  time_t Control::convertOnlyDate(time_t rawTime) {
-    struct tm timeInfo;
-    localtime_r(&rawTime, &timeInfo);
-
-    timeInfo.tm_hour = 0;
-    timeInfo.tm_min = 0;
-    timeInfo.tm_sec = 0;
-
-    return mktime(&timeInfo);
-  }
-
-  uint32_t Control::timeStringToSeconds(const String& timeStr) {
-    int hours, minutes, seconds;
-    if (sscanf(timeStr.c_str(), "%d:%d:%d", &hours, &minutes, &seconds) == 3) {
-      return hours * 3600 + minutes * 60 + seconds;
-    }
-    return 0;
-  }
-
   String Control::secondsToTimeString(uint32_t totalSeconds) {
     int hours = totalSeconds / 3600;
     int minutes = (totalSeconds % 3600) / 60;
@@ -171,54 +143,144 @@
  void Control::updatePins() {
     if (myDevices.empty()) return;
 
-    Device& currentDevice = myDevices[currentDeviceIndex];
-    static std::unordered_map<int, bool> lastPinStates;
-    static std::unordered_map<int, uint8_t> lastPwmValues;
+    forEachLiveDevice([this](Device& device, DeviceRuntime& runtime) { updatePins(device, runtime); });
+
+    // Все цифровые выходы всех устройств - одной записью в регистры set/clear
+    OutputMasks masks = outputStage.commit();
+    if (masks.empty()) return;
+
+    char logBuffer[80];
+    for (uint8_t pin = 0; pin < OUTPUT_MAX_PINS; pin++) {
+        uint32_t bit = 1UL << (pin % 32);
+        bool isSet = masks.set[pin / 32] & bit;
+        if (!isSet && !(masks.clear[pin / 32] & bit)) continue;
+
+        snprintf(logBuffer, sizeof(logBuffer),
+                 "Реле обновлено | PIN: %d -> %s",
+                 pin, isSet ? "HIGH" : "LOW");
+        logger.addLog(logBuffer, LOG_INFO);
+    }
+}
 
+void Control::updatePins(Device& currentDevice, DeviceRuntime& runtime) {
     bool isForceControlRelay = currentDevice.isForceControlRelay;
-    
-    for (auto& relay : currentDevice.relays) {
-        if (relay.isOutput) {
-            if (relay.isPwm) {
-                uint8_t newPwmValue = relay.pwm;
-                
-                if ((lastPwmValues[relay.pin] != newPwmValue) || isForceControlRelay) {
-                    analogWrite(relay.pin, newPwmValue);
-                    lastPwmValues[relay.pin] = newPwmValue;
-                    
-                    char logBuffer[64];
+    char logBuffer[80];
+
+    for (size_t i = 0; i < currentDevice.relays.size(); i++) {
+        Relay& relay = currentDevice.relays[i];
+        if (!relay.isOutput || !currentDevice.plan.pinUsable[i]) continue;
+
+        if (relay.isPwm) {
+            PwmOutputConfig config = { relay.pwmFrequency, relay.pwmResolution, relay.pwmRampMs };
+            const TemperatureLoopState* pidLoop = pidPwmLoop(currentDevice, runtime, relay);
+            bool isPidOutput = pidLoop != nullptr;
+            uint32_t duty = isPidOutput ? pidLoop->duty : relay.pwm;
+            uint8_t bits = isPidOutput ? 16 : PWM_INPUT_RESOLUTION;
+
+            switch (outputStage.setPwm(relay.pin, duty, bits, config, clockMillis(), isForceControlRelay)) {
+                case PWM_ATTACHED: {
+                    const PwmSlot* slot = outputStage.pwmEngine().slotFor(relay.pin);
                     snprintf(logBuffer, sizeof(logBuffer),
-                             "PWM обновлено | PIN: %d -> %d",
-                             relay.pin, newPwmValue);
-                    logger.addLog(logBuffer, LOG_INFO);
+                             "ШИМ | PIN: %d канал %d, %lu Гц, %d бит%s",
+                             relay.pin, slot->channel, (unsigned long)slot->frequency, slot->resolution,
+                             slot->shared ? " (общий таймер)" : "");
+                    logger.addLog(logBuffer, slot->shared ? LOG_ERROR : LOG_INFO);
+                    break;
                 }
-            } else { // обычное цифровое управление
-                bool newState = relay.statePin;
-                
-                if ((lastPinStates[relay.pin] != newState) || isForceControlRelay) {
-                    digitalWrite(relay.pin, newState ? HIGH : LOW);
-                    lastPinStates[relay.pin] = newState;
-                    
-                    char logBuffer[64];
+                case PWM_WRITTEN:
+                    if (isPidOutput) break;
                     snprintf(logBuffer, sizeof(logBuffer),
-                             "Реле обновлено | PIN: %d -> %s",
-                             relay.pin, newState ? "HIGH" : "LOW");
+                             "PWM обновлено | PIN: %d -> %d",
+                             relay.pin, relay.pwm);
                     logger.addLog(logBuffer, LOG_INFO);
+                    break;
+                case PWM_NO_CHANNEL:
+                    snprintf(logBuffer, sizeof(logBuffer),
+                             "ШИМ | PIN: %d нет свободного канала", relay.pin);
+                    logger.addLog(logBuffer, LOG_ERROR);
+                    break;
+                default:
+                    break;
+            }
+        } else {
+            outputStage.setDigital(relay.pin, relay.statePin, isForceControlRelay);
+        }
+    }
+    currentDevice.isForceControlRelay = false;
+}
+
+void Control::updatePwm() {
+    outputStage.tick(clockMillis());
+}
+
+// Выход ПИД в плавном режиме пишется с полной разрядностью, relay.pwm - только для отображения
+const TemperatureLoopState* Control::pidPwmLoop(const Device& device, const DeviceRuntime& runtime, const Relay& relay) const {
+    for (size_t i = 0; i < device.temperatures.size() && i < runtime.loops.size(); i++) {
+        const Temperature& temp = device.temperatures[i];
+        bool isPidDriven = temp.autotune.state() == AUTOTUNE_RUNNING ||
+                           (runtime.loops[i].pid && temp.selectedPidIndex != -2);
+        if (temp.isUseSetting && temp.isSmoothly && temp.relayPtr == &relay && !relay.manualMode && isPidDriven) {
+            return &runtime.loops[i];
+        }
+    }
+    return nullptr;
+}
+
+bool Control::processCommands(bool isAllowed) {
+    ControlCommand command;
+    bool relaysChanged = false;
+
+    if (isAllowed) {
+        for (size_t i = 0; i < runtimes.size(); i++) {
+            if (!runtimes[i].isTimerStepDeferred) continue;
+            runtimes[i].isTimerStepDeferred = false;
+            if (onTimerStep(i, runtimes[i].deferredStepGeneration)) relaysChanged = true;
+        }
+    }
+
+    while (deviceManager.bridge.commands.pop(command)) {
+        if (command.type == CMD_REINIT_SENSORS) {
+            setupControl(true);
+            continue;
+        }
+        if (command.type == CMD_AUTOTUNE) {
+            if (command.value && !isAllowed) {
+                logger.addLog("Автонастройка ПИД: управление приостановлено, запуск отклонён", LOG_ERROR);
+                continue;
+            }
+            startAutotune(command.id, command.value, command.number);
+            continue;
+        }
+        if (command.type == CMD_TIMER_STEP) {
+            if (!isAllowed) {
+                // Таймер взводится заново только шагом: потерянное событие остановило бы последовательность
+                if ((size_t)command.id < myDevices.size()) {
+                    DeviceRuntime& runtime = runtimeFor(command.id);
+                    runtime.isTimerStepDeferred = true;
+                    runtime.deferredStepGeneration = (uint32_t)command.number;
                 }
+                continue;
             }
-            
-            currentDevice.isForceControlRelay = false;
+            if (onTimerStep(command.id, (uint32_t)command.number)) relaysChanged = true;
+            continue;
+        }
+        if (deviceManager.applyCommand(command)) {
+            relaysChanged = true;
+        }
+        if (command.type == CMD_SET_ITEM && command.field == ITEM_ACTION_USE && !myDevices.empty()) {
+            markActionPending(myDevices[currentDeviceIndex], runtimeFor(currentDeviceIndex), command.id);
+        }
+        if (command.type == CMD_PATCH_ITEM && !myDevices.empty()) {
+            applyItemPatch(myDevices[currentDeviceIndex], runtimeFor(currentDeviceIndex), command.field, command.id);
         }
     }
+    return relaysChanged;
 }
 
-  void Control::controlOutputs(OutPower& outPower) {
+  void Control::controlOutputs(Device& device, OutPower& outPower) {
     if (!outPower.isUseSetting) return;
 
-    if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
-
-    Relay* relay = findRelayById(device, outPower.relayId);
+    Relay* relay = boundRelay(device, outPower.relayIndex);
 
     if (relay) {
 
@@ -229,7 +291,7 @@
   }
 
 double Control::scalePidCoefficient(double userCoefficient) {
-  const double scaleFactor = 1000.0;
+  const double scaleFactor = PID_COEFFICIENT_SCALE;
   const double maxUserCoefficient = 100.0;
 
   if (userCoefficient < 0) {
@@ -247,52 +309,57 @@ double Control::scalePidCoefficient(double userCoefficient) {
 
 void Control::setTemperature() {
     if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
-    Temperature& temp = device.temperature;
-
-    static bool wasActive = false;
-    static uint8_t lastDeviceIndex = 255;
-    static int lastSensorId = -1;
-    static int lastRelayId = -1;
-    static int lastPidIndex = -1;
-    static float lastSetTemperature = -999.0f; 
-
-    // Смена устройства → сброс состояния
-    if (lastDeviceIndex != currentDeviceIndex) {
-        lastDeviceIndex = currentDeviceIndex;
-        wasActive = false;
-        lastSensorId = -1;
-        lastRelayId = -1;
-        lastPidIndex = -1;
-        temp.sensorPtr = nullptr;
-        temp.relayPtr = nullptr;
-        lastSetTemperature = -999.0f;
+    forEachLiveDevice([this](Device& device, DeviceRuntime& runtime) { setTemperature(device, runtime); });
+}
+
+// Контуры независимы: у каждого свои ПИД, окно и состояние в runtime.loops
+void Control::setTemperature(Device& device, DeviceRuntime& runtime) {
+    // Число контуров изменилось → сброс их состояния
+    if (runtime.loops.size() != device.temperatures.size()) {
+        runtime.loops.clear();
+        runtime.loops.resize(device.temperatures.size());
+        for (Temperature& temp : device.temperatures) {
+            temp.sensorPtr = nullptr;
+            temp.relayPtr = nullptr;
+        }
     }
 
+    for (size_t i = 0; i < device.temperatures.size(); i++) {
+        runTemperatureLoop(device, device.temperatures[i], runtime.loops[i]);
+    }
+}
+
+void Control::runTemperatureLoop(Device& device, Temperature& temp, TemperatureLoopState& state) {
     if (!temp.isUseSetting) {
-        if (wasActive) {
+        temp.autotune.cancel();
+        if (state.isActive) {
             if (temp.relayPtr && temp.collectionSettings.get(0)) {
                 temp.relayPtr->statePin = false;
                 temp.relayPtr->isPwm = false;
                 temp.relayPtr->pwm = 0;
             }
             if (temp.collectionSettings.get(1)) device.isTimersEnabled = false;
-            if (myPID) {
-                myPID.reset();
-                myPID = nullptr;
+            if (state.pid) {
+                state.pid.reset();
+                state.pid = nullptr;
             }
-            wasActive = false;
+            state.isActive = false;
         }
         return;
     }
 
     // Инициализация при первом запуске или смене параметров
-    if (!wasActive || 
-        temp.sensorId != lastSensorId ||
-        temp.relayId != lastRelayId ||
-        temp.selectedPidIndex != lastPidIndex ||
-        fabs(temp.setTemperature - lastSetTemperature) > 0.1f)  // <-- Если уставка изменилась
+    if (!state.isActive || 
+        temp.sensorId != state.sensorId ||
+        temp.relayId != state.relayId ||
+        temp.selectedPidIndex != state.pidIndex ||
+        fabs(temp.setTemperature - state.setTemperature) > 0.1f)  // <-- Если уставка изменилась
     {
+        if (state.isActive && temp.autotune.state() == AUTOTUNE_RUNNING) {
+          temp.autotune.cancel();
+          logger.addLog("Автонастройка ПИД прервана: изменены параметры регулятора", LOG_INFO);
+        }
+
         temp.sensorPtr = findSensorById(device, temp.sensorId);
         temp.relayPtr = findRelayById(device, temp.relayId);
 
@@ -302,14 +369,14 @@ void Control::setTemperature() {
         }
 
         temp.relayPtr->lastState = temp.relayPtr->statePin;
-        lastSensorId = temp.sensorId;
-        lastRelayId = temp.relayId;
-        lastPidIndex = temp.selectedPidIndex;
-        lastSetTemperature = temp.setTemperature;  // Сохраняем новую уставку
+        state.sensorId = temp.sensorId;
+        state.relayId = temp.relayId;
+        state.pidIndex = temp.selectedPidIndex;
+        state.setTemperature = temp.setTemperature;  // Сохраняем новую уставку
 
-        inputPid = static_cast<double>(temp.sensorPtr->currentValue);
-        setpointPid = static_cast<double>(temp.setTemperature);
-        outputPid = 0.0;
+        state.input = static_cast<double>(temp.sensorPtr->currentValue);
+        state.setpoint = static_cast<double>(temp.setTemperature);
+        state.output = 0.0;
 
     if (temp.selectedPidIndex == -2) {
       Serial.println("Control Mode: Hysteresis");
@@ -332,26 +399,26 @@ void Control::setTemperature() {
         Serial.printf("Control Mode: Standard PID (Index: %d)\n", temp.selectedPidIndex);
       }
 
-      myPID = std::make_unique<PID>(
-        &inputPid, &outputPid, &setpointPid,
+      state.pid = std::make_unique<PID>(
+        &state.input, &state.output, &state.setpoint,
         initialKp, initialKi, initialKd,
         temp.isIncrease ? DIRECT : REVERSE
       );
 
-      if (myPID) {
-        myPID->SetMode(AUTOMATIC);
-        myPID->SetOutputLimits(0, pidWindowSize);
-        myPID->SetSampleTime(1000);
+      if (state.pid) {
+        state.pid->SetMode(AUTOMATIC);
+        state.pid->SetOutputLimits(0, pidWindowSize);
+        state.pid->SetSampleTime(1000);
       }
     }
 
-    pidWindowStartTime = millis();
-    wasActive = true;
+    state.windowStart = clockMillis();
+    state.isActive = true;
   }
 
   if (!temp.sensorPtr || !temp.relayPtr) {
     temp.isUseSetting = false;
-    wasActive = false;
+    state.isActive = false;
     return;
   }
 
@@ -362,26 +429,32 @@ void Control::setTemperature() {
   }
 
   if (temp.currentTemp <= -998.0f) {
-    if (wasActive) {
+    if (state.isActive) {
       char logBuffer[128];
       snprintf(logBuffer, sizeof(logBuffer), "АВАРИЯ: Сенсор ID %d отключен! Регулирование остановлено.", temp.sensorId);
       logger.addLog(logBuffer, LOG_ERROR);
       Serial.println(logBuffer);
+      temp.autotune.cancel();
       temp.relayPtr->statePin = false;
       temp.relayPtr->isPwm = false;
       temp.relayPtr->pwm = 0;
       if (temp.collectionSettings.get(1)) device.isTimersEnabled = false;
-      if (myPID) {
-        myPID.reset();
-        myPID = nullptr;
+      if (state.pid) {
+        state.pid.reset();
+        state.pid = nullptr;
       }
-      wasActive = false;
+      state.isActive = false;
     }
     return;
   }
 
-  if (temp.sensorId != lastSensorId || temp.relayId != lastRelayId || temp.selectedPidIndex != lastPidIndex) {
-    wasActive = false;
+  if (temp.sensorId != state.sensorId || temp.relayId != state.relayId || temp.selectedPidIndex != state.pidIndex) {
+    state.isActive = false;
+    return;
+  }
+
+  if (temp.autotune.state() == AUTOTUNE_RUNNING) {
+    runAutotune(device, temp, state);
     return;
   }
 
@@ -403,42 +476,42 @@ void Control::setTemperature() {
         }
     }
   } else {
-    if (!myPID) return;
+    if (!state.pid) return;
 
-    inputPid = static_cast<double>(temp.currentTemp);
-    setpointPid = static_cast<double>(temp.setTemperature);
+    state.input = static_cast<double>(temp.currentTemp);
+    state.setpoint = static_cast<double>(temp.setTemperature);
 
     if (temp.selectedPidIndex == -1 && device.pids.size() >= 2) {
       auto agg_it = std::max_element(device.pids.begin(), device.pids.end(), [](const Pid& a, const Pid& b) { return a.Kp < b.Kp; });
       auto cons_it = std::min_element(device.pids.begin(), device.pids.end(), [](const Pid& a, const Pid& b) { return a.Kp < b.Kp; });
 
       const double switchingThreshold = 1.5;
-      double gap = abs(setpointPid - inputPid);
+      double gap = abs(state.setpoint - state.input);
 
       if (gap < switchingThreshold) {
 
-        myPID->SetTunings(scalePidCoefficient(cons_it->Kp), scalePidCoefficient(cons_it->Ki), scalePidCoefficient(cons_it->Kd));
+        state.pid->SetTunings(scalePidCoefficient(cons_it->Kp), scalePidCoefficient(cons_it->Ki), scalePidCoefficient(cons_it->Kd));
       } else {
 
-        myPID->SetTunings(scalePidCoefficient(agg_it->Kp), scalePidCoefficient(agg_it->Ki), scalePidCoefficient(agg_it->Kd));
+        state.pid->SetTunings(scalePidCoefficient(agg_it->Kp), scalePidCoefficient(agg_it->Ki), scalePidCoefficient(agg_it->Kd));
       }
     }
 
-    myPID->Compute();
-    temp.pidOutputMs = static_cast<unsigned long>(outputPid);
+    state.pid->Compute();
+    temp.pidOutputMs = static_cast<unsigned long>(state.output);
 
     if (temp.isSmoothly) {
       temp.relayPtr->isPwm = true;
-      uint8_t pwmValue = map(static_cast<long>(outputPid), 0, pidWindowSize, 0, 255);
-      if (!temp.relayPtr->manualMode) temp.relayPtr->pwm = pwmValue;
+      state.duty = static_cast<uint16_t>(constrain(state.output, 0.0, (double)pidWindowSize) * 65535.0 / pidWindowSize);
+      if (!temp.relayPtr->manualMode) temp.relayPtr->pwm = state.duty >> 8;
     } else if (temp.collectionSettings.get(0)) {
       temp.relayPtr->isPwm = false;
-      unsigned long now = millis();
-      if (now - pidWindowStartTime > pidWindowSize) {
-        pidWindowStartTime += pidWindowSize;
+      unsigned long now = clockMillis();
+      if (now - state.windowStart > pidWindowSize) {
+        state.windowStart += pidWindowSize;
       }
       if (!temp.relayPtr->manualMode) {
-        temp.relayPtr->statePin = (temp.pidOutputMs > (now - pidWindowStartTime));
+        temp.relayPtr->statePin = (temp.pidOutputMs > (now - state.windowStart));
       }
     } else if (temp.collectionSettings.get(1)) {
       temp.relayPtr->isPwm = false;
@@ -451,23 +524,88 @@ void Control::setTemperature() {
   }
 }
 
-Relay* Control::findRelayById(Device& device, int id) {
+// Старт эксперимента на реле и датчике регулятора; во время него ПИД не считается
+void Control::startAutotune(size_t loopIndex, bool start, float hysteresis) {
+  if (myDevices.empty() || loopIndex >= myDevices[currentDeviceIndex].temperatures.size()) return;
+  Temperature& temp = myDevices[currentDeviceIndex].temperatures[loopIndex];
 
-  for (auto& relay : device.relays) {
-    if (relay.id == id) {
-      return &relay;
+  if (!start) {
+    if (temp.autotune.state() == AUTOTUNE_RUNNING) {
+      temp.autotune.cancel();
+      logger.addLog("Автонастройка ПИД остановлена", LOG_USER);
     }
+    return;
   }
-  return nullptr;
+
+  if (!temp.isUseSetting || !temp.sensorPtr || !temp.relayPtr ||
+      !(temp.isSmoothly || temp.collectionSettings.get(0)) || temp.sensorPtr->currentValue <= -998.0f) {
+    logger.addLog("Автонастройка ПИД: регулятор температуры не активен или выход не на реле", LOG_ERROR);
+    return;
+  }
+
+  temp.autotune.start(temp.setTemperature, hysteresis, pidWindowSize, temp.isIncrease, clockMillis());
+
+  char logBuffer[128];
+  snprintf(logBuffer, sizeof(logBuffer), "Автонастройка ПИД запущена: уставка %.1f, гистерезис %.2f",
+           temp.setTemperature, hysteresis);
+  logger.addLog(logBuffer, LOG_USER);
 }
 
-Sensor* Control::findSensorById(Device& device, int id) {
-  for (auto& sensor : device.sensors) {
-    if (sensor.sensorId == id) {
-      return &sensor;
-    }
+void Control::runAutotune(Device& device, Temperature& temp, TemperatureLoopState& state) {
+  bool isOn = temp.autotune.update(clockMillis(), temp.currentTemp);
+  temp.pidOutputMs = isOn ? pidWindowSize : 0;
+
+  if (temp.isSmoothly) {
+    temp.relayPtr->isPwm = true;
+    state.duty = isOn ? 65535 : 0;
+    if (!temp.relayPtr->manualMode) temp.relayPtr->pwm = state.duty >> 8;
+  } else {
+    temp.relayPtr->isPwm = false;
+    if (!temp.relayPtr->manualMode) temp.relayPtr->statePin = isOn;
   }
-  return nullptr;
+
+  if (temp.autotune.state() == AUTOTUNE_DONE) {
+    finishAutotune(device, temp);
+  } else if (temp.autotune.state() == AUTOTUNE_FAILED) {
+    logger.addLog("Автонастройка ПИД не удалась: нет устойчивых колебаний", LOG_ERROR);
+  }
+}
+
+// Результат - новая запись ПИД в пользовательском масштабе, она же становится текущей
+void Control::finishAutotune(Device& device, Temperature& temp) {
+  const AutotuneResult& result = temp.autotune.getResult();
+
+  Pid pid;
+  snprintf(pid.description, MAX_DESCRIPTION_LENGTH, "Автонастройка Ku=%.2f Tu=%.0fс",
+           result.ku / PID_COEFFICIENT_SCALE, result.tuSeconds);
+  pid.Kp = result.kp / PID_COEFFICIENT_SCALE;
+  pid.Ki = result.ki / PID_COEFFICIENT_SCALE;
+  pid.Kd = result.kd / PID_COEFFICIENT_SCALE;
+
+  // Сеть читает снимок конфигурации, не device: новый ПИД попадёт в него при публикации
+  device.pids.push_back(pid);
+  temp.selectedPidIndex = device.pids.size() - 1;
+  deviceManager.markConfigChanged();
+
+  char logBuffer[128];
+  snprintf(logBuffer, sizeof(logBuffer), "Автонастройка ПИД: Kp=%.3f Ki=%.4f Kd=%.2f (Tu %.0f с, амплитуда %.2f)",
+           pid.Kp, pid.Ki, pid.Kd, result.tuSeconds, result.amplitude);
+  logger.addLog(logBuffer, LOG_USER);
+
+  appState.isSaveControlRequest = true;
+}
+
+Relay* Control::findRelayById(Device& device, int id) {
+  return boundRelay(device, device.plan.relayIndex(id));
+}
+
+Sensor* Control::findSensorById(Device& device, int id) {
+  int16_t index = device.plan.sensorIndex(id);
+  return index != PLAN_NO_INDEX ? &device.sensors[index] : nullptr;
+}
+
+Relay* Control::boundRelay(Device& device, int16_t index) {
+  return (index != PLAN_NO_INDEX && (size_t)index < device.relays.size()) ? &device.relays[index] : nullptr;
 }
 
   void Control::setFlagsSettingsTimers(uint8_t selectedIndex, Timer& currentTimer) {
@@ -478,127 +616,143 @@ Sensor* Control::findSensorById(Device& device, int id) {
     }
   }
 
-  void Control::collectionSettingsTimer(uint8_t currentTimerIndex) {
-    static bool prevHadTempControl = false;
-
-    if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
+  void Control::collectionSettingsTimer(Device& device, DeviceRuntime& runtime, uint8_t currentTimerIndex) {
     Timer& currentTimer = device.timers[currentTimerIndex];
 
-    if (prevHadTempControl && !currentTimer.collectionSettings.get(0)) {
+    if (runtime.prevHadTempControl && !currentTimer.collectionSettings.get(0)) {
 
-      device.temperature.isUseSetting = false;
+      device.temperature().isUseSetting = false;
     }
     else if (currentTimer.collectionSettings.get(0)) {
 
-      device.temperature.isUseSetting = true;
+      device.temperature().isUseSetting = true;
     }
 
-    prevHadTempControl = currentTimer.collectionSettings.get(0);
+    runtime.prevHadTempControl = currentTimer.collectionSettings.get(0);
 
     if (currentTimer.collectionSettings.get(1)) {
-      controlOutputs(currentTimer.endStateRelay);
+      controlOutputs(device, currentTimer.endStateRelay);
       setFlagsSettingsTimers(1, currentTimer);
     }
   }
 
-  void Control::executeTimers(bool state) {
-
-    static size_t currentTimerIndex = 0;
-    static unsigned long timerStartTime = 0;
-    static bool timersCompleted = false;
-
-    if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
-
+  // Шаг завершает событие аппаратного таймера (deadline); опрос раз в секунду -
+  // запуск последовательности и запасной путь, если событие потерялось
+  void Control::executeTimers(Device& device, DeviceRuntime& runtime, bool deadline) {
     if (!device.isTimersEnabled || device.timers.empty()) {
 
       for (auto& timer : device.timers) {
-        timer.progress = {0, 0, false, false};
+        timer.progress.clear();
       }
 
-      currentTimerIndex = 0;
-      timersCompleted = false;
+      runtime.timerIndex = 0;
+      runtime.timersCompleted = false;
+      disarmTimerStep(runtime);
       return;
     }
 
-    if (timersCompleted && !device.isEncyclateTimers) {
+    if (runtime.timersCompleted && !device.isEncyclateTimers) {
       return;
     }
 
-    if (!device.timers[currentTimerIndex].progress.isRunning) {
+    if (runtime.timerIndex >= device.timers.size()) {
+      runtime.timerIndex = 0;
+    }
 
-      while (currentTimerIndex < device.timers.size() && !device.timers[currentTimerIndex].isUseSetting) {
-        currentTimerIndex++;
-      }
+    Timer& current = device.timers[runtime.timerIndex];
 
-      if (currentTimerIndex >= device.timers.size()) {
+    if (!current.progress.isRunning) {
+      size_t index = nextUsedTimer(device, runtime.timerIndex);
+      if (index >= device.timers.size()) {
         return;
       }
+      runtime.timersCompleted = false;
+      startTimerStep(device, runtime, index);
+      return;
+    }
 
-      device.timers[currentTimerIndex].progress.isStopped = false;
-      timerStartTime = millis();
-      device.timers[currentTimerIndex].progress.isRunning = true;
-      controlOutputs(device.timers[currentTimerIndex].initialStateRelay);
-      timersCompleted = false;
-    }
-
-    if (device.timers[currentTimerIndex].progress.isRunning) {
-
-        uint32_t timerDuration = timeStringToSeconds(device.timers[currentTimerIndex].time);
-        unsigned long currentTime = millis();
-        unsigned long elapsedTime = (currentTime - timerStartTime) / 1000;
-        unsigned long remainingTime = (timerDuration > elapsedTime) ? (timerDuration - elapsedTime) : 0;
-
-        device.timers[currentTimerIndex].progress = {
-          elapsedTime,
-          remainingTime,
-          true,
-          false,
-        };
-
-        if (elapsedTime >= timerDuration) {
-          collectionSettingsTimer(currentTimerIndex);
-          device.timers[currentTimerIndex].progress.isRunning = false;
-          device.timers[currentTimerIndex].progress.isStopped = true;
-
-          size_t nextTimerIndex = currentTimerIndex + 1;
-          while (nextTimerIndex < device.timers.size() && !device.timers[nextTimerIndex].isUseSetting) {
-            nextTimerIndex++;
-          }
-
-          if (nextTimerIndex >= device.timers.size()) {
-            if (!device.isEncyclateTimers) {
-              timersCompleted = true;
-              return;
-            }
+    if (deadline || clockMillis() - current.progress.startedAt >= current.durationMs) {
+      finishTimerStep(device, runtime);
+    }
+  }
 
-            nextTimerIndex = 0;
-            while (nextTimerIndex < device.timers.size() && !device.timers[nextTimerIndex].isUseSetting) {
-              nextTimerIndex++;
-            }
-            if (nextTimerIndex >= device.timers.size()) return;
-          }
+  size_t Control::nextUsedTimer(const Device& device, size_t from) const {
+    while (from < device.timers.size() && !device.timers[from].isUseSetting) {
+      from++;
+    }
+    return from;
+  }
 
-          currentTimerIndex = nextTimerIndex;
-          timerStartTime = millis();
-          controlOutputs(device.timers[currentTimerIndex].initialStateRelay);
+  void Control::startTimerStep(Device& device, DeviceRuntime& runtime, size_t timerIndex) {
+    Timer& timer = device.timers[timerIndex];
+    runtime.timerIndex = timerIndex;
 
-        }
+    timer.progress.isStopped = false;
+    timer.progress.isRunning = true;
+    timer.progress.startedAt = clockMillis();
+    controlOutputs(device, timer.initialStateRelay);
+    armTimerStep(device, runtime, timer.durationMs);
+  }
+
+  void Control::finishTimerStep(Device& device, DeviceRuntime& runtime) {
+    disarmTimerStep(runtime);
+
+    collectionSettingsTimer(device, runtime, runtime.timerIndex);
+    device.timers[runtime.timerIndex].progress.isRunning = false;
+    device.timers[runtime.timerIndex].progress.isStopped = true;
+
+    size_t nextTimerIndex = nextUsedTimer(device, runtime.timerIndex + 1);
+
+    if (nextTimerIndex >= device.timers.size()) {
+      if (!device.isEncyclateTimers) {
+        runtime.timersCompleted = true;
+        return;
       }
+
+      nextTimerIndex = nextUsedTimer(device, 0);
+      if (nextTimerIndex >= device.timers.size()) return;
     }
 
-  void Control::setTimersExecute() {
-    static bool isInitialStateSaved = false;
-    static bool isEndStateApplied = false;
+    startTimerStep(device, runtime, nextTimerIndex);
+  }
+
+  void Control::armTimerStep(Device& device, DeviceRuntime& runtime, uint32_t durationMs) {
+    if (!runtime.timerClock) {
+      runtime.timerClock.reset(new TimerStepClock());
+      runtime.timerClock->bridge = &deviceManager.bridge;
+    }
+
+    TimerStepClock& clock = *runtime.timerClock;
+    clock.ticker.detach();
+    clock.deviceIndex = &device - &myDevices[0];
+    clock.generation = ++runtime.timerGeneration;
+    clock.ticker.once_ms(durationMs, TimerStepClock::onDeadline, &clock);
+  }
+
+  void Control::disarmTimerStep(DeviceRuntime& runtime) {
+    // Событие, уже стоящее в очереди, отсеется по поколению
+    runtime.timerGeneration++;
+    if (runtime.timerClock) runtime.timerClock->ticker.detach();
+  }
 
-    static bool prevTimersEnabled = false;
+  bool Control::onTimerStep(uint8_t deviceIndex, uint32_t generation) {
+    if (deviceIndex >= myDevices.size() || !deviceManager.isLiveDevice(deviceIndex)) return false;
 
+    DeviceRuntime& runtime = runtimeFor(deviceIndex);
+    if (generation != runtime.timerGeneration) return false;
+
+    executeTimers(myDevices[deviceIndex], runtime, true);
+    return true;
+  }
+
+  void Control::setTimersExecute() {
     if (myDevices.empty()) return;
+    forEachLiveDevice([this](Device& device, DeviceRuntime& runtime) { setTimersExecute(device, runtime); });
+  }
 
-    Device& device = myDevices[currentDeviceIndex];
-    bool stateChanged = (device.isTimersEnabled != prevTimersEnabled);
-    prevTimersEnabled = device.isTimersEnabled;
+  void Control::setTimersExecute(Device& device, DeviceRuntime& runtime) {
+    bool stateChanged = (device.isTimersEnabled != runtime.prevTimersEnabled);
+    runtime.prevTimersEnabled = device.isTimersEnabled;
 
     if (stateChanged && device.isTimersEnabled) {
 
@@ -618,11 +772,10 @@ Sensor* Control::findSensorById(Device& device, int id) {
         }
       }
 
-      isInitialStateSaved = true;
-      isEndStateApplied = false;
+      runtime.isInitialStateSaved = true;
     }
 
-    if (stateChanged && !device.isTimersEnabled && isInitialStateSaved) {
+    if (stateChanged && !device.isTimersEnabled && runtime.isInitialStateSaved) {
 
       std::unordered_set<uint8_t> relayIds;
       for (auto& timer : device.timers) {
@@ -639,41 +792,31 @@ Sensor* Control::findSensorById(Device& device, int id) {
         }
       }
 
-      isEndStateApplied = true;
-      isInitialStateSaved = false;
+      runtime.isInitialStateSaved = false;
     }
 
-    executeTimers(device.isTimersEnabled);
+    executeTimers(device, runtime);
   }
 
-  void Control::saveRelayStates(uint8_t relayId) {
-    if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
-
+  void Control::saveRelayStates(Device& device, uint8_t relayId) {
     Relay* relay = findRelayById(device, relayId);
     if (relay && relay->isOutput) {
       relay->lastState = relay->statePin;
     }
   }
 
-  void Control::restoreRelayStates(uint8_t relayId) {
-    if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
-
+  void Control::restoreRelayStates(Device& device, uint8_t relayId) {
     Relay* relay = findRelayById(device, relayId);
     if (relay && relay->isOutput) {
       relay->statePin = relay->lastState;
     }
   }
 
-    void Control::collectionSettingsSchedule(bool start, ScheduleScenario& scenario) {
-    if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
-
+    void Control::collectionSettingsSchedule(Device& device, bool start, ScheduleScenario& scenario) {
     if (start) {
 
         if (scenario.collectionSettings.get(0)) {
-            device.temperature.isUseSetting = true;
+            device.temperature().isUseSetting = true;
         } 
 
         if (scenario.collectionSettings.get(1)) {
@@ -682,24 +825,24 @@ Sensor* Control::findSensorById(Device& device, int id) {
 
         if (scenario.collectionSettings.get(2) && !scenario.initialStateApplied) {
             Serial.printf("[CollectionSettings] -> Applying INITIAL RELAY state for relay ID %d.\n", scenario.initialStateRelay.relayId);
-            controlOutputs(scenario.initialStateRelay);
+            controlOutputs(device, scenario.initialStateRelay);
             scenario.initialStateApplied = true;
         }
 
     } else {
         Serial.println("[CollectionSettings] Deactivating schedule. Restoring states.");
         if (scenario.collectionSettings.get(0)) {
-            device.temperature.isUseSetting = false;
-            restoreRelayStates(device.temperature.relayId);
+            device.temperature().isUseSetting = false;
+            restoreRelayStates(device, device.temperature().relayId);
         }
         if (scenario.collectionSettings.get(1)) {
             device.isTimersEnabled = false;
         }
         if (scenario.initialStateApplied) {
-            restoreRelayStates(scenario.initialStateRelay.relayId);
+            restoreRelayStates(device, scenario.initialStateRelay.relayId);
         }
         if (scenario.endStateRelay.isUseSetting) {
-            controlOutputs(scenario.endStateRelay);
+            controlOutputs(device, scenario.endStateRelay);
         }
 
         scenario.initialStateApplied = false;
@@ -709,141 +852,78 @@ Sensor* Control::findSensorById(Device& device, int id) {
 
   void Control::setSchedules() {
     if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
-
-    static bool lastScheduleState = device.isScheduleEnabled;
-    if (lastScheduleState != device.isScheduleEnabled) {
-      if (!device.isScheduleEnabled) {
+    forEachLiveDevice([this](Device& device, DeviceRuntime& runtime) { setSchedules(device, runtime); });
+  }
 
-        for (auto& scenario : device.scheduleScenarios) {
-          if (scenario.isActive) {
+  void Control::setSchedules(Device& device, DeviceRuntime& runtime) {
+    if (runtime.lastScheduleState != device.isScheduleEnabled) {
+      for (auto& scenario : device.scheduleScenarios) {
+        if (!device.isScheduleEnabled && scenario.isActive) {
 
-            collectionSettingsSchedule(false, scenario);
-            scenario.isActive = false;
-          }
+          collectionSettingsSchedule(device, false, scenario);
+          scenario.isActive = false;
         }
+        scenario.compiled.invalidate();
       }
-      lastScheduleState = device.isScheduleEnabled;
+      device.scheduleHorizon.invalidate();
+      runtime.lastScheduleState = device.isScheduleEnabled;
     }
 
     if (!device.isScheduleEnabled) {
       return;
     }
 
+    // Сценарий пересчитывается только на своей ближайшей границе
+    // (начало/конец интервала, смена суток); до ближайшей из них по всем
+    // сценариям тик - одно сравнение.
     time_t currentDateTime = getCurrentTime();
+    if (!device.scheduleHorizon.isDue(currentDateTime)) {
+      return;
+    }
+
     struct tm currentTime;
-    localtime_r(&currentDateTime, &currentTime);
-    int currentMinutes = currentTime.tm_hour * 60 + currentTime.tm_min;
+    bool isLocalTimeReady = false;
+    time_t horizon = currentDateTime + SECONDS_PER_DAY;
 
     for (auto& scenario : device.scheduleScenarios) {
 
       if (!scenario.isUseSetting) {
         if (scenario.isActive) {
-          String message = "Deactivating scenario '";
-          message += scenario.description;
-          message += "' (isUseSetting is now false)";
-
-          collectionSettingsSchedule(false, scenario);
+          collectionSettingsSchedule(device, false, scenario);
           scenario.isActive = false;
         }
+        scenario.compiled.invalidate();
         continue;
       }
 
-      time_t startDate = convertToTimeT(scenario.startDate);
-      time_t endDate = convertToTimeT(scenario.endDate);
-      time_t currentDate = convertOnlyDate(currentDateTime);
-
-      if (currentDate < startDate || (endDate != 0 && currentDate > endDate)) {
-        if (scenario.isActive) {
-          String message = "Scenario '";
-          message += scenario.description;
-          message += "' expired";
-
-          collectionSettingsSchedule(false, scenario);
-          scenario.isActive = false;
-        }
+      if (!scenario.compiled.isDue(currentDateTime)) {
+        if (scenario.compiled.nextTransition < horizon) horizon = scenario.compiled.nextTransition;
         continue;
       }
 
-      if (!scenario.months.get(currentTime.tm_mon)) {
-        if (scenario.isActive) {
-          String message = "Scenario '";
-          message += scenario.description;
-          message += "' inactive this month";
-
-          collectionSettingsSchedule(false, scenario);
-          scenario.isActive = false;
-        }
-        continue;
+      if (!isLocalTimeReady) {
+        localtime_r(&currentDateTime, &currentTime);
+        isLocalTimeReady = true;
       }
 
-      if (!scenario.week.get(shiftWeekDay(currentTime.tm_wday))) {
-        if (scenario.isActive) {
-          String message = "Scenario '";
-          message += scenario.description;
-          message += "' inactive today";
+      bool shouldBeActive = scenario.compiled.evaluate(currentDateTime, currentTime);
+      if (scenario.compiled.nextTransition < horizon) horizon = scenario.compiled.nextTransition;
 
-          collectionSettingsSchedule(false, scenario);
+      if (shouldBeActive) {
+        if (!scenario.isActive) {
+          collectionSettingsSchedule(device, true, scenario);
+          scenario.isActive = true;
+        }
+      } else {
+        if (scenario.isActive) {
+          collectionSettingsSchedule(device, false, scenario);
           scenario.isActive = false;
         }
-        continue;
       }
-
-        bool shouldBeActive = false;
-        String activePeriod = "";
-
-        for (auto& timePeriod : scenario.startEndTimes) {
-            String startTimeStr = String(timePeriod.startTime);
-            String endTimeStr = String(timePeriod.endTime);
-
-            if (startTimeStr.length() < 5 || endTimeStr.length() < 5) {
-                //Serial.printf("[Schedule Error] Invalid time format in scenario '%s'. Skipping.\n", scenario.description);
-                continue;
-            }
-
-            int startMinutes = startTimeStr.substring(0, 2).toInt() * 60 + startTimeStr.substring(3, 5).toInt();
-            int endMinutes = endTimeStr.substring(0, 2).toInt() * 60 + endTimeStr.substring(3, 5).toInt();
-            
-//            Serial.printf("[Schedule Debug] Checking period %02d:%02d (%d) to %02d:%02d (%d) for scenario '%s'\n",
-//                          startMinutes / 60, startMinutes % 60, startMinutes,
-//                          endMinutes / 60, endMinutes % 60, endMinutes,
-//                          scenario.description);
-
-            bool periodIsActive = false;
-
-            if (startMinutes <= endMinutes) {
-                if (currentMinutes >= startMinutes && currentMinutes < endMinutes) {
-                    periodIsActive = true;
-                }
-            } 
-            else {
-                if (currentMinutes >= startMinutes || currentMinutes < endMinutes) {
-                    periodIsActive = true;
-                }
-            }
-
-            if (periodIsActive) {
-                shouldBeActive = true;
-                activePeriod = startTimeStr + "-" + endTimeStr;
-               // Serial.printf("[Schedule Debug] -> Period is ACTIVE for scenario '%s'.\n", scenario.description);
-                break; 
-            }
-        }
-
-        if (shouldBeActive) {
-            if (!scenario.isActive) {
-              //  Serial.printf("[Schedule] Activating scenario '%s' for period %s.\n", scenario.description, activePeriod.c_str());
-                collectionSettingsSchedule(true, scenario);
-                scenario.isActive = true;
-            }
-        } else {
-            if (scenario.isActive) {
-               // Serial.printf("[Schedule] Deactivating scenario '%s' (time is outside all active periods).\n", scenario.description);
-                collectionSettingsSchedule(false, scenario);
-                scenario.isActive = false;
-            }
-        }
     }
+
+    device.scheduleHorizon.evaluatedAt = currentDateTime;
+    device.scheduleHorizon.nextTransition = horizon;
 }
 
 void Control::setupControl(bool onlyDHT) {
@@ -861,75 +941,67 @@ void Control::setupControl(bool onlyDHT) {
         currentDeviceIndex = 0;
     }
 
-    Device& device = myDevices[currentDeviceIndex];
+    selectLiveDevices();
 
-    for (auto& sensor : device.sensors) {
+    if (!onlyDHT) {
+        // Пины перенастраиваются - тени выходов больше не отражают их состояние
+        outputStage.reset();
+        releaseDeviceInputs();
 
-         if (sensor.dht != nullptr) {
-                delete sensor.dht;      // удаляем объект
-                sensor.dht = nullptr;    // обнуляем указатель
-            }
-      
-        if ((sensor.typeSensor.get(0) || sensor.typeSensor.get(1)) && sensor.dht == nullptr) {
-            Relay* inputRelay = findRelayById(device, sensor.relayId);
-            if (inputRelay && !inputRelay->isOutput) {
-                sensor.dht = new DHT(inputRelay->pin, sensor.typeSensor.get(0) ? DHT11 : DHT22);
-                if (sensor.dht) {
-                    sensor.dht->begin();
-                    delay(100);
-
-                    float testTemp = sensor.dht->readTemperature();
-                    float testHum = sensor.dht->readHumidity();
-
-                    if (isnan(testTemp) || isnan(testHum)) {
-                        snprintf(logBuffer, sizeof(logBuffer), "Ошибка DHT: Не удалось прочитать данные с пина %d после инициализации. Проверьте подключение.", inputRelay->pin);
-                        logger.addLog(logBuffer, LOG_ERROR);
-
-                        delete sensor.dht;
-                        sensor.dht = nullptr;
-                    }
-                } else {
-                    snprintf(logBuffer, sizeof(logBuffer), "Ошибка DHT: Не удалось выделить память для сенсора на пине %d.", inputRelay->pin);
-                    logger.addLog(logBuffer, LOG_ERROR);
-                }
-            } else {
-                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации DHT: Реле ID %d для сенсора ID %d не найдено или является выходом.", sensor.relayId, sensor.sensorId);
-                logger.addLog(logBuffer, LOG_ERROR);
-            }
+        analogReadResolution(12);
+        analogSetAttenuation(ADC_11db);
+    }
+
+    // Каналы захвата DHT держат только живые устройства
+    for (size_t i = 0; i < myDevices.size(); i++) {
+        if (!deviceManager.isLiveDevice(i)) {
+            releaseDhtSensors(myDevices[i]);
+            disarmTimerStep(runtimeFor(i));
         }
     }
 
-    if (onlyDHT) return ;
+    forEachLiveDevice([this, onlyDHT](Device& device, DeviceRuntime& runtime) { setupDevice(device, runtime, onlyDHT); });
 
-    analogReadResolution(12);
-    analogSetAttenuation(ADC_11db);
+    // Без полной настройки пинов кнопки-сенсоры всё равно приводятся к новой конфигурации
+    if (onlyDHT) syncDeviceInputs();
 
-    std::unordered_set<uint8_t> usedPins;
-    for (auto& relay : device.relays) {
-        if (usedPins.count(relay.pin)) {
-            snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации Реле: Пин %d используется более чем одним реле (ID: %d).", relay.pin, relay.id);
-            logger.addLog(logBuffer, LOG_ERROR);
+    // Сохранение и переинициализация тоже могут добавить или убрать аналоговые входы
+    configureAdc();
+
+    // Входы уточняют isDigital реле, индекс устройства мог смениться
+    deviceManager.markConfigChanged();
+}
+
+void Control::setupDevice(Device& device, DeviceRuntime& runtime, bool onlyDHT) {
+    char logBuffer[128];
+
+    reportPlanIssues(device);
+
+    // Новая конфигурация: все действия вычисляются заново
+    runtime.pendingActions.clear();
+    for (auto& action : device.actions) {
+        action.isPending = false;
+    }
+    markAllActionsPending(device, runtime);
+
+    releaseDhtSensors(device);
+    attachDhtSensors(device);
+
+    if (onlyDHT) return;
+
+    // Конфликты пинов и неразрешённые входы уже отмечены в плане
+    for (size_t i = 0; i < device.relays.size(); i++) {
+        Relay& relay = device.relays[i];
+        if (!device.plan.pinUsable[i]) {
             continue;
         }
-        usedPins.insert(relay.pin);
 
         if (relay.isOutput) {
             pinMode(relay.pin, OUTPUT);
             digitalWrite(relay.pin, relay.statePin ? HIGH : LOW);
         } else {
-            if (std::find(device.pins.begin(), device.pins.end(), relay.pin) == device.pins.end()) {
-                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации Реле: Входной пин %d (ID: %d) не входит в список разрешенных.", relay.pin, relay.id);
-                logger.addLog(logBuffer, LOG_ERROR);
-                continue;
-            }
-
-            Sensor* linkedSensor = nullptr;
-            for (auto& s : device.sensors) {
-                if (s.relayId == relay.id) {
-                    linkedSensor = &s;
-                    break;
-                }
-            }
+            int16_t sensorIndex = device.plan.inputSensorIndex[i];
+            Sensor* linkedSensor = sensorIndex != PLAN_NO_INDEX ? &device.sensors[sensorIndex] : nullptr;
 
           if (linkedSensor) {
 
@@ -939,7 +1011,10 @@ void Control::setupControl(bool onlyDHT) {
             relay.isDigital = true;
         }
         pinMode(relay.pin, INPUT_PULLUP);
-        touchStates[relay.pin] = TouchSensorState();
+        if (!attachGestureInput(relay.pin, GestureRecognizer::defaultTiming(), true)) {
+            snprintf(logBuffer, sizeof(logBuffer), "Кнопка на пине %d не подключена: нет свободных прерываний.", relay.pin);
+            logger.addLog(logBuffer, LOG_ERROR);
+        }
         
     } else if (linkedSensor->typeSensor.get(0) || linkedSensor->typeSensor.get(1)) {
         // Тип 0 или 1 цифровой вход без подтяжки
@@ -972,250 +1047,699 @@ void Control::setupControl(bool onlyDHT) {
         }
         pinMode(relay.pin, INPUT);
     }
-} else {
-                snprintf(logBuffer, sizeof(logBuffer), "Предупреждение: Входное реле ID %d (пин %d) не привязано к сенсору. Установлен режим INPUT.", relay.id, relay.pin);
-                logger.addLog(logBuffer, LOG_ERROR);
-            }
+}
         }
         yield();
         delay(5);
     }
+
+}
+
+// Создаёт недостающие DHT; уже работающие датчики не трогаются
+void Control::attachDhtSensors(Device& device) {
+    char logBuffer[128];
+
+    for (auto& sensor : device.sensors) {
+        if ((sensor.typeSensor.get(0) || sensor.typeSensor.get(1)) && sensor.dht == nullptr) {
+            if (sensor.inputRelayIndex != PLAN_NO_INDEX) {
+                // Наличие датчика проверит первое чтение в readDhtSensors, без ожидания здесь
+                sensor.dht = new DhtReader(sensor.inputPin, sensor.typeSensor.get(0));
+                if (!sensor.dht) {
+                    snprintf(logBuffer, sizeof(logBuffer), "Ошибка DHT: Не удалось выделить память для сенсора на пине %d.", sensor.inputPin);
+                    logger.addLog(logBuffer, LOG_ERROR);
+                } else if (!sensor.dht->begin()) {
+                    snprintf(logBuffer, sizeof(logBuffer), "Ошибка DHT: Нет свободного канала захвата для сенсора на пине %d.", sensor.inputPin);
+                    logger.addLog(logBuffer, LOG_ERROR);
+
+                    delete sensor.dht;
+                    sensor.dht = nullptr;
+                } else {
+                    sensor.dht->start(millis());
+                }
+            }
+        }
+    }
+}
+
+void Control::releaseDhtSensors(Device& device) {
+    for (auto& sensor : device.sensors) {
+        if (sensor.dht != nullptr) {
+            delete sensor.dht;
+            sensor.dht = nullptr;
+        }
+    }
+}
+
+// После CMD_PATCH_ITEM: пересчёт только зависящих от записи действий, недостающие DHT и опрос АЦП,
+// новые коэффициенты в контурах с этим ПИД - без сброса их состояния
+void Control::applyItemPatch(Device& device, DeviceRuntime& runtime, uint8_t section, size_t index) {
+    switch (section) {
+        case PATCH_RELAY:
+            // Действия ссылаются на реле по id: цели и условия могли смениться
+            markAllActionsPending(device, runtime);
+            attachDhtSensors(device);
+            syncDeviceInputs();
+            configureAdc();
+            break;
+        case PATCH_SENSOR:
+            markSensorChanged(device, runtime, index);
+            attachDhtSensors(device);
+            syncDeviceInputs();
+            configureAdc();
+            break;
+        case PATCH_ACTION:
+            markActionPending(device, runtime, index);
+            break;
+        case PATCH_PID:
+            for (size_t i = 0; i < device.temperatures.size() && i < runtime.loops.size(); i++) {
+                const Temperature& temp = device.temperatures[i];
+                TemperatureLoopState& state = runtime.loops[i];
+                bool usesPid = temp.selectedPidIndex == (int)index || (temp.selectedPidIndex == -1 && index == 0);
+                if (!usesPid || !state.pid || index >= device.pids.size()) continue;
+
+                const Pid& pid = device.pids[index];
+                state.pid->SetTunings(scalePidCoefficient(pid.Kp), scalePidCoefficient(pid.Ki), scalePidCoefficient(pid.Kd));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Текущее устройство живо всегда; в режиме нескольких устройств к нему
+// добавляются остальные, если их пины не заняты уже выбранными
+void Control::selectLiveDevices() {
+    std::vector<uint8_t>& live = deviceManager.liveDevices;
+    live.clear();
+    live.push_back(currentDeviceIndex);
+    if (!deviceManager.isMultiDevice) return;
+
+    auto pinMask = [](const Device& device) {
+        uint64_t mask = 0;
+        for (const auto& relay : device.relays) {
+            if (relay.pin < OUTPUT_MAX_PINS) mask |= 1ULL << relay.pin;
+        }
+        return mask;
+    };
+
+    uint64_t usedPins = pinMask(myDevices[currentDeviceIndex]);
+    char logBuffer[160];
+
+    for (size_t i = 0; i < myDevices.size(); i++) {
+        if (i == currentDeviceIndex) continue;
+
+        uint64_t pins = pinMask(myDevices[i]);
+        if (pins & usedPins) {
+            snprintf(logBuffer, sizeof(logBuffer), "Устройство '%s' не запущено: его пины заняты другим устройством.", myDevices[i].nameDevice);
+            logger.addLog(logBuffer, LOG_ERROR);
+            continue;
+        }
+        usedPins |= pins;
+        live.push_back(i);
+    }
+
+    snprintf(logBuffer, sizeof(logBuffer), "Одновременно работают устройств: %u", (unsigned)live.size());
+    logger.addLog(logBuffer, LOG_INFO);
+}
+
+DeviceRuntime& Control::runtimeFor(uint8_t deviceIndex) {
+    // Список устройств изменился: у прежних устройств состояние (ход таймеров,
+    // расписания, ПИД) остаётся, новые получают чистое, у убранных таймер
+    // останавливается вместе с состоянием
+    if (runtimes.size() != myDevices.size()) {
+        for (size_t i = myDevices.size(); i < runtimes.size(); i++) disarmTimerStep(runtimes[i]);
+        runtimes.resize(myDevices.size());
+    }
+    return runtimes[deviceIndex];
+}
+
+// Аналоговые сенсоры (NTC и аналоговый вход) опрашиваются непрерывно, в фоне
+void Control::configureAdc() {
+    uint8_t pins[ADC_MAX_CHANNELS];
+    size_t count = 0;
+    bool overflow = false;
+
+    forEachLiveDevice([&](Device& device, DeviceRuntime&) {
+        for (const auto& sensor : device.sensors) {
+            if (!sensor.isUseSetting || sensor.inputRelayIndex == PLAN_NO_INDEX) continue;
+            if (!(sensor.typeSensor.get(2) || sensor.typeSensor.get(4))) continue;
+
+            if (count >= ADC_MAX_CHANNELS) {
+                overflow = true;
+                continue;
+            }
+            pins[count++] = sensor.inputPin;
+        }
+    });
+
+    // Частота опроса - по текущему устройству
+    uint16_t rateHz = myDevices[currentDeviceIndex].adcRateHz;
+    if (isAdcConfigured && count == adcPinCount && rateHz == adcRateHz &&
+        memcmp(pins, adcPins, count) == 0) {
+        return;
+    }
+    memcpy(adcPins, pins, count);
+    adcPinCount = count;
+    adcRateHz = rateHz;
+    isAdcConfigured = true;
+
+    if (!adcSampler.configure(pins, count, rateHz) || overflow) {
+        logger.addLog("Ошибка АЦП: часть аналоговых входов не подключена к опросу (только АЦП1, не больше " + String(ADC_MAX_CHANNELS) + " каналов).", LOG_ERROR);
+    }
+}
+
+void Control::reportPlanIssues(const Device& device) {
+    char logBuffer[128];
+
+    for (const auto& issue : device.plan.issues) {
+        switch (issue.type) {
+            case PLAN_DUPLICATE_RELAY_ID:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: ID реле %d используется повторно.", issue.id);
+                break;
+            case PLAN_DUPLICATE_SENSOR_ID:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: ID сенсора %d используется повторно.", issue.id);
+                break;
+            case PLAN_ID_OUT_OF_RANGE:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: ID %d вне допустимого диапазона 0..%d.", issue.id, PLAN_MAX_ID);
+                break;
+            case PLAN_PIN_CONFLICT:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации Реле: Пин %d используется более чем одним реле (ID: %d).", issue.pin, issue.id);
+                break;
+            case PLAN_PIN_NOT_ALLOWED:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации Реле: Входной пин %d (ID: %d) не входит в список разрешенных.", issue.pin, issue.id);
+                break;
+            case PLAN_SENSOR_RELAY_MISSING:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: Реле ID %d для сенсора ID %d не найдено или является выходом.", issue.refId, issue.id);
+                break;
+            case PLAN_ACTION_SENSOR_MISSING:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: Действие #%d ссылается на несуществующий сенсор ID %d.", issue.id + 1, issue.refId);
+                break;
+            case PLAN_ACTION_RELAY_MISSING:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: Действие #%d ссылается на несуществующее реле ID %d.", issue.id + 1, issue.refId);
+                break;
+            case PLAN_OUTPUT_RELAY_MISSING:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: Выход ссылается на несуществующее реле ID %d.", issue.refId);
+                break;
+            case PLAN_SENSOR_EXPRESSION_INVALID:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: Выражение сенсора ID %d, позиция %d.", issue.id, issue.refId);
+                break;
+            case PLAN_ACTION_EXPRESSION_INVALID:
+                snprintf(logBuffer, sizeof(logBuffer), "Ошибка конфигурации: Условие действия #%d, позиция %d.", issue.id + 1, issue.refId);
+                break;
+            case PLAN_INPUT_UNBOUND:
+                snprintf(logBuffer, sizeof(logBuffer), "Предупреждение: Входное реле ID %d (пин %d) не привязано к сенсору. Установлен режим INPUT.", issue.id, issue.pin);
+                break;
+        }
+        logger.addLog(logBuffer, LOG_ERROR);
+    }
 }
 
   float Control::readNTCTemperature(const Sensor& sensor) {
     if (!sensor.typeSensor.get(2)) return -999.0;
 
-    Relay* inputRelay = findRelayById(myDevices[currentDeviceIndex], sensor.relayId);
-
-    if (!inputRelay || inputRelay->isOutput) {
+    if (sensor.inputRelayIndex == PLAN_NO_INDEX) {
       return -999.0;
     }
 
-    int pin = inputRelay->pin;
-    const int adc = analogRead(pin);
-    const int mapped = map(adc, 0, 4095, 0, 1023);
-    if (mapped == 0) return -999.0;
+    const AdcChannelWindow* window = adcSampler.window(sensor.inputPin);
+    if (!window || window->count() == 0) return -999.0;
+
+    if (sensor.ntcTable.empty()) return -999.0;
 
-    const float resistance = sensor.serial_r / (1023.0 / mapped - 1);
-    float temp = log(resistance / sensor.thermistor_r);
-    temp /= 3950.0;
-    temp += 1.0 / (25.0 + 273.15);
-    temp = 1.0 / temp - 273.15 - 1;
+    // Таблица строится при загрузке конфигурации (DeviceManager::compileSensor)
+    const float mv = window->value((AdcFilter)sensor.filter);
+    if (mv <= 0.0f || mv >= ADC_FULL_SCALE_MV) return -999.0;
 
-    return temp;
+    return NtcModel::lookupCentiCelsius(sensor.ntcTable, mv) / 100.0f;
   }
 
-  int Control::readAnalog(const Sensor& sensor) {
+  // Отфильтрованное значение входа в шкале 0-255
+  float Control::readAnalog(const Sensor& sensor) {
 
     if (!sensor.typeSensor.get(4)) {
       return -1;
     }
 
-    Relay* inputRelay = findRelayById(myDevices[currentDeviceIndex], sensor.relayId);
-
-    if (!inputRelay || inputRelay->isOutput) {
+    if (sensor.inputRelayIndex == PLAN_NO_INDEX) {
       return -1;
     }
 
-    int adcValue = analogRead(inputRelay->pin);
-    Serial.printf("[ADC Debug] Raw value: %d\n", adcValue);
-    
-    int mappedValue = map(adcValue, 0, 4095, 0, 255);
-  
-    mappedValue = constrain(mappedValue, 0, 255); 
+    const AdcChannelWindow* window = adcSampler.window(sensor.inputPin);
+    if (!window || window->count() == 0) return -1;
+
+    float value = window->value((AdcFilter)sensor.filter) * 255.0f / ADC_FULL_SCALE_MV;
+    value = constrain(value, 0.0f, 255.0f);
 
-    return mappedValue;
+    return roundf(value * 10.0f) / 10.0f;
 }
 
-  bool Control::checkTouchSensor(uint8_t pin) {
-    static const int DEBOUNCE_MS = 20;
-    bool currentState = digitalRead(pin);
+  void Control::updateAdc() {
+    adcSampler.update();
+  }
+
+  void Control::recordHistory() {
+    if (myDevices.empty()) return;
+    deviceManager.history.record(myDevices[currentDeviceIndex]);
+  }
+
+  bool Control::readSensors() {
+    if (myDevices.empty()) return false;
+    bool changed = false;
+    forEachLiveDevice([this, &changed](Device& device, DeviceRuntime& runtime) {
+      if (readSensors(device, runtime)) changed = true;
+    });
+    return changed;
+  }
 
-    auto& ts = touchStates[pin];
-    unsigned long now = millis();
+  bool Control::readSensors(Device& device, DeviceRuntime& runtime) {
 
-    if (currentState != ts.lastState) {
-      ts.lastDebounceTime = now;
-      ts.lastState = currentState;
+    for (size_t i = 0; i < device.sensors.size(); i++) {
+      Sensor& sensor = device.sensors[i];
+      if (!sensor.isUseSetting) continue;
+
+      float previousValue = sensor.currentValue;
+
+      if (sensor.typeSensor.get(2)) {
+        sensor.currentValue = readNTCTemperature(sensor);
+      }
+      else if (sensor.typeSensor.get(3)) {
+        // Кнопки обновляет updateInputs по фронтам из прерываний
+        continue;
+      }
+      else if (sensor.typeSensor.get(4)) {
+        sensor.currentValue = readAnalog(sensor);
+      }
+      else if (sensor.typeSensor.get(5)) {
+        // Виртуальный: выражение над сенсорами, уже прочитанными выше по списку
+        if (sensor.program.empty()) continue;
+        float value = sensor.program.evaluate(DeviceExpressionEnv(device, getCurrentTime()));
+        sensor.currentValue = isnan(value) ? -999.0f : value;
+      }
+
+      if (sensor.currentValue != previousValue) {
+        markSensorChanged(device, runtime, i);
+      }
     }
 
-    if ((now - ts.lastDebounceTime) > DEBOUNCE_MS) {
+    // Действия, зависящие от изменившихся сенсоров, - сразу после замера
+    return setSensorActions(device, runtime);
+  }
+
+  bool Control::readDhtSensors() {
+    if (myDevices.empty()) return false;
+    bool changed = false;
+    forEachLiveDevice([this, &changed](Device& device, DeviceRuntime& runtime) {
+      if (readDhtSensors(device, runtime)) changed = true;
+    });
+    return changed;
+  }
 
-      if (currentState == LOW) {
-        ts.pressed = true;
-        ts.pressStartTime = now;
-        return true;
-      } else {
-        ts.pressed = false;
-        return false;
+  bool Control::readDhtSensors(Device& device, DeviceRuntime& runtime) {
+
+    for (size_t i = 0; i < device.sensors.size(); i++) {
+      Sensor& sensor = device.sensors[i];
+      if (!sensor.isUseSetting) continue;
+      if (!(sensor.typeSensor.get(0) || sensor.typeSensor.get(1))) continue;
+      if (!sensor.dht) continue;
+
+      // Чтение идёт в фоне: забираем готовый кадр и запускаем следующий
+      uint32_t now = millis();
+      DhtStatus previousStatus = sensor.dht->status();
+      if (sensor.dht->poll(now)) {
+        DhtStatus status = sensor.dht->status();
+        if (status != DHT_OK && status != previousStatus) {
+          char logBuffer[96];
+          snprintf(logBuffer, sizeof(logBuffer), "Ошибка DHT: Не удалось прочитать данные с пина %d (код %d). Проверьте подключение.", sensor.inputPin, status);
+          logger.addLog(logBuffer, LOG_ERROR);
+        }
+
+        float previousTemp = sensor.currentValue;
+        float previousHum = sensor.humidityValue;
+
+        sensor.currentValue = sensor.dht->reading().temperature;
+        sensor.humidityValue = sensor.dht->reading().humidity;
+
+        if (sensor.currentValue != previousTemp || sensor.humidityValue != previousHum) {
+          markSensorChanged(device, runtime, i);
+        }
       }
+      sensor.dht->start(now);
     }
 
-    return ts.pressed;
+    return setSensorActions(device, runtime);
   }
 
-  void Control::readSensors() {
+void Control::markSensorChanged(Device& device, DeviceRuntime& runtime, size_t sensorIndex) {
+    const RuntimePlan& plan = device.plan;
+    if (sensorIndex + 1 >= plan.sensorActionStart.size()) return;
+
+    for (uint16_t i = plan.sensorActionStart[sensorIndex]; i < plan.sensorActionStart[sensorIndex + 1]; i++) {
+        markActionPending(device, runtime, plan.sensorActions[i]);
+    }
+}
 
-    static unsigned long lastDHTRead = 0;
-    static unsigned long lastFastRead = 0;
+void Control::markActionPending(Device& device, DeviceRuntime& runtime, size_t actionIndex) {
+    if (actionIndex >= device.actions.size()) return;
+
+    Action& action = device.actions[actionIndex];
+    if (!action.isPending) {
+        action.isPending = true;
+        runtime.pendingActions.push_back(actionIndex);
+    }
+}
+
+void Control::markAllActionsPending(Device& device, DeviceRuntime& runtime) {
+    for (size_t i = 0; i < device.actions.size(); i++) {
+        markActionPending(device, runtime, i);
+    }
+}
 
+// Вычисляет только действия, помеченные событиями: изменился сенсор,
+// переключилось реле-условие, включили действие или загрузили конфигурацию.
+ void Control::setSensorActions() {
     if (myDevices.empty()) return;
-    if (currentDeviceIndex >= myDevices.size()) return;
+    forEachLiveDevice([this](Device& device, DeviceRuntime& runtime) { setSensorActions(device, runtime); });
+}
 
-    Device& device = myDevices[currentDeviceIndex];
-    unsigned long now = millis();
+bool Control::setSensorActions(Device& device, DeviceRuntime& runtime) {
+    if (!device.isActionEnabled) {
+        runtime.wasActionEnabled = false;
+        return false;
+    }
 
-    bool timeToReadFast = (now - lastFastRead >= 200);
-    bool timeToReadDHT = (now - lastDHTRead >= 1000);
+    if (!runtime.wasActionEnabled) {
+        markAllActionsPending(device, runtime);
+        runtime.wasActionEnabled = true;
+    }
 
-    for (auto& sensor : device.sensors) {
-      if (!sensor.isUseSetting) continue;
+    RuntimePlan& plan = device.plan;
+    if (!plan.timeActions.empty()) {
+        int minute = DeviceExpressionEnv::minuteOfDay(getCurrentTime());
+        if (minute != runtime.lastConditionMinute) {
+            runtime.lastConditionMinute = minute;
+            for (uint16_t actionIndex : plan.timeActions) {
+                markActionPending(device, runtime, actionIndex);
+            }
+        }
+    }
 
-      if (sensor.typeSensor.get(0) || sensor.typeSensor.get(1)) {
+    for (size_t i = 0; i < plan.conditionRelays.size(); i++) {
+        bool state = device.relays[plan.conditionRelays[i]].statePin;
+        if (state != plan.conditionState[i]) {
+            plan.conditionState[i] = state;
+            for (uint16_t j = plan.conditionActionStart[i]; j < plan.conditionActionStart[i + 1]; j++) {
+                markActionPending(device, runtime, plan.conditionActions[j]);
+            }
+        }
+    }
 
-        if (timeToReadDHT) {
-          if (sensor.dht) {
-            float temp = sensor.dht->readTemperature();
-            float hum  = sensor.dht->readHumidity();
+    if (runtime.pendingActions.empty()) return false;
 
-    if (isnan(temp)) {
-        sensor.currentValue = -999;
-    } else {
-        sensor.currentValue = temp;
+    bool isFired = false;
+    for (uint16_t actionIndex : runtime.pendingActions) {
+        if (actionIndex >= device.actions.size()) continue;
+
+        Action& action = device.actions[actionIndex];
+        action.isPending = false;
+
+        if (!action.isUseSetting) {
+            continue;
+        }
+        bool wasTriggered = action.wasTriggered;
+        evaluateAction(device, action);
+        if (action.wasTriggered != wasTriggered) isFired = true;
     }
+    runtime.pendingActions.clear();
+    return isFired;
+}
 
-    if (isnan(hum)) {
-        sensor.humidityValue = -999;
-    } else {
-        sensor.humidityValue = hum;
+void Control::evaluateAction(Device& device, Action& action) {
+    // Действия по жестам вызывает dispatchGesture, уровень сенсора им не важен
+    if (action.gesture != GESTURE_NONE) return;
+
+    if (action.targetRelayId != -1) {
+        Relay* conditionRelay = boundRelay(device, action.conditionRelayIndex);
+        if (!conditionRelay || conditionRelay->statePin != action.relayMustBeOn) {
+
+            return;
+        }
     }
-          }
+
+    // Условие-выражение вместо порога: истинно - сработать, ложно - сбросить
+    if (action.condition.length() > 0) {
+        if (action.conditionProgram.empty()) return;   // не скомпилировалось
+        bool isTrue = ExpressionProgram::isTrue(action.conditionProgram.evaluate(DeviceExpressionEnv(device, getCurrentTime())));
+        if (isTrue && !action.wasTriggered) {
+            triggerAction(device, action);
+        } else if (!isTrue && action.wasTriggered) {
+            resetAction(device, action);
         }
-      }
+        return;
+    }
 
-      else {
+    // 2. Сенсор привязан заранее в плане
+    if (action.sensorIndex == PLAN_NO_INDEX) {
+        // Если сенсор не найден, пропускаем
+        return;
+    }
+    Sensor* targetSensor = &device.sensors[action.sensorIndex];
 
-        if (timeToReadFast) {
-          if (sensor.typeSensor.get(2)) {
-            sensor.currentValue = readNTCTemperature(sensor);
-          }
-          else if (sensor.typeSensor.get(3)) {
-            Relay* inputRelay = findRelayById(device, sensor.relayId);
-            if (inputRelay && !inputRelay->isOutput) {
-              sensor.currentValue = checkTouchSensor(inputRelay->pin) ? 1.0f : 0.0f;
-            }
-          }
-          else if (sensor.typeSensor.get(4)) {
-            int analogVal = readAnalog(sensor);
-            if (analogVal != -1) {
-              sensor.currentValue = static_cast<float>(analogVal);
-            } else {
-              sensor.currentValue = -1.0f;
+    // 3. Проверяем, нет ли ошибки сенсора
+    float sensorValue = action.isHumidity ? targetSensor->humidityValue : targetSensor->currentValue;
+    if (sensorValue <= -998.0f) {
+        //Serial.printf("[ACTION_DEBUG] Сенсор '%s' (%d) вернул ошибку: %.2f. Пропуск.\n", action.description, action.targetSensorId, sensorValue);
+        return;
+    }
+
+    // 4. Вычисляем, нужно ли сработать и нужно ли сбросить
+    bool shouldTrigger = false;
+    bool shouldReset = false;
+
+    if (action.actionMoreOrEqual) { // "Больше или равно"
+        shouldTrigger = (sensorValue >= action.triggerValueMax);
+        shouldReset = (sensorValue < action.triggerValueMin);
+    } else { // "Меньше или равно"
+        shouldTrigger = (sensorValue <= action.triggerValueMax);
+        shouldReset = (sensorValue > action.triggerValueMin);
+    }
+
+    if (shouldTrigger && !action.wasTriggered) {
+        triggerAction(device, action);
+    }
+
+    else if (shouldReset && action.wasTriggered) {
+        resetAction(device, action);
+    }
+}
+
+void Control::triggerAction(Device& device, Action& action) {
+    if (action.collectionSettings.get(0)) {
+        device.isTimersEnabled = true;
+    }
+    if (action.collectionSettings.get(1)) {
+        for (auto& output : action.outputs) {
+            Relay* relay = boundRelay(device, output.relayIndex);
+            if (relay && relay->isOutput) {
+                output.lastState = relay->statePin;
             }
-          }
+            controlOutputs(device, output);
         }
-      }
     }
+    if (action.collectionSettings.get(2)) {
+        device.temperature().isUseSetting = true;
+    }
+
+    if (action.collectionSettings.get(3) && action.sendMsg.length() > 0) {
+        logger.addLog(action.sendMsg, LOG_USER);
+    }
+
+    action.wasTriggered = true;
+}
 
-    if (timeToReadFast) {
-      lastFastRead = now;
+void Control::resetAction(Device& device, Action& action) {
+    if (action.isReturnSetting) {
+        if (action.collectionSettings.get(0)) { device.isTimersEnabled = false; }
+        if (action.collectionSettings.get(2)) { device.temperature().isUseSetting = false; }
     }
-    if (timeToReadDHT) {
-      lastDHTRead = now;
+    if (action.collectionSettings.get(1)) {
+        for (auto& output : action.outputs) {
+            if (output.isReturn) {
+                Relay* relay = boundRelay(device, output.relayIndex);
+                if (relay && relay->isOutput) {
+                    relay->statePin = output.lastState;
+                }
+            }
+        }
     }
-  }
 
- void Control::setSensorActions() {
-    if (myDevices.empty()) return;
-    Device& device = myDevices[currentDeviceIndex];
+    action.wasTriggered = false;
+}
 
-    if (!device.isActionEnabled) return;
+// --- Входы по прерываниям и жесты ---
 
-    for (auto& action : device.actions) {
-        if (!action.isUseSetting) {
-            continue;
+bool Control::attachGestureInput(uint8_t pin, const GestureTiming& timing, bool isDevicePin) {
+    if (gestureInputs.count(pin)) return true;
+    if (!inputEdges.attach(pin)) return false;
+
+    GestureInput& input = gestureInputs[pin];
+    input.recognizer = GestureRecognizer(timing);
+    input.recognizer.reset(digitalRead(pin) == LOW, millis());
+    input.isDevicePin = isDevicePin;
+    return true;
+}
+
+// Пины устройств перенастраиваются заново; системные кнопки остаются
+void Control::releaseDeviceInputs() {
+    for (auto it = gestureInputs.begin(); it != gestureInputs.end();) {
+        if (it->second.isDevicePin) {
+            inputEdges.detach(it->first);
+            it = gestureInputs.erase(it);
+        } else {
+            ++it;
         }
+    }
+}
+
+// Сохранение и PATCH: кнопки-сенсоры живых устройств без полной перенастройки
+// пинов. Новые подключаются к прерываниям, пропавшие отключаются, остальные
+// сохраняют состояние распознавателя.
+void Control::syncDeviceInputs() {
+    char logBuffer[128];
+    uint64_t buttonPins = 0;
 
-        if (action.targetRelayId != -1) {
-            Relay* conditionRelay = findRelayById(device, action.targetRelayId);
-            if (!conditionRelay || conditionRelay->statePin != action.relayMustBeOn) {
+    forEachLiveDevice([&](Device& device, DeviceRuntime&) {
+        const RuntimePlan& plan = device.plan;
+        for (size_t i = 0; i < device.relays.size(); i++) {
+            Relay& relay = device.relays[i];
+            if (relay.isOutput || !plan.pinUsable[i] || relay.pin >= OUTPUT_MAX_PINS) continue;
 
-                continue;
+            int16_t sensorIndex = plan.inputSensorIndex[i];
+            if (sensorIndex == PLAN_NO_INDEX || !device.sensors[sensorIndex].typeSensor.get(3)) continue;
+
+            buttonPins |= 1ULL << relay.pin;
+            relay.isDigital = true;
+            if (gestureInputs.count(relay.pin)) continue;
+
+            pinMode(relay.pin, INPUT_PULLUP);
+            if (!attachGestureInput(relay.pin, GestureRecognizer::defaultTiming(), true)) {
+                snprintf(logBuffer, sizeof(logBuffer), "Кнопка на пине %d не подключена: нет свободных прерываний.", relay.pin);
+                logger.addLog(logBuffer, LOG_ERROR);
             }
         }
+    });
 
-        // 2. Находим сенсор
-        Sensor* targetSensor = findSensorById(device, action.targetSensorId);
-        if (!targetSensor) {
-            // Если сенсор не найден, пропускаем
-            continue;
+    for (auto it = gestureInputs.begin(); it != gestureInputs.end();) {
+        if (it->second.isDevicePin && !(it->first < OUTPUT_MAX_PINS && (buttonPins & (1ULL << it->first)))) {
+            inputEdges.detach(it->first);
+            it = gestureInputs.erase(it);
+        } else {
+            ++it;
         }
+    }
+}
 
-        // 3. Проверяем, нет ли ошибки сенсора
-        float sensorValue = action.isHumidity ? targetSensor->humidityValue : targetSensor->currentValue;
-        if (sensorValue <= -998.0f) {
-            //Serial.printf("[ACTION_DEBUG] Сенсор '%s' (%d) вернул ошибку: %.2f. Пропуск.\n", action.description, action.targetSensorId, sensorValue);
-            continue;
+bool Control::isInputPressed(uint8_t pin) const {
+    auto input = gestureInputs.find(pin);
+    return input != gestureInputs.end() && input->second.recognizer.isPressed();
+}
+
+bool Control::bindGesture(uint8_t pin, GestureType gesture, GestureHandler handler, uint16_t longMs) {
+    GestureTiming timing = GestureRecognizer::defaultTiming();
+    timing.longMs = longMs;
+    timing.repeatMs = 0;
+    if (!attachGestureInput(pin, timing, false)) return false;
+
+    gestureBindings.push_back({ pin, gesture, handler });
+    return true;
+}
+
+bool Control::updateInputs(bool applyActions) {
+    InputEdge edge;
+    while (inputEdges.pop(edge)) {
+        auto input = gestureInputs.find(edge.pin);
+        if (input != gestureInputs.end()) {
+            input->second.recognizer.edge(edge.time, edge.level == LOW);
         }
+    }
 
-        // 4. Вычисляем, нужно ли сработать и нужно ли сбросить
-        bool shouldTrigger = false;
-        bool shouldReset = false;
+    bool changed = false;
+    uint32_t now = millis();
+    for (auto& input : gestureInputs) {
+        GestureRecognizer& recognizer = input.second.recognizer;
+        recognizer.update(now);
 
-        if (action.actionMoreOrEqual) { // "Больше или равно"
-            shouldTrigger = (sensorValue >= action.triggerValueMax);
-            shouldReset = (sensorValue < action.triggerValueMin);
-        } else { // "Меньше или равно"
-            shouldTrigger = (sensorValue <= action.triggerValueMax);
-            shouldReset = (sensorValue > action.triggerValueMin);
+        GestureType gesture;
+        while (recognizer.nextGesture(gesture)) {
+            if (dispatchGesture(input.first, gesture, applyActions)) changed = true;
         }
+    }
 
-        if (shouldTrigger && !action.wasTriggered) {
-          
-           // Serial.printf("[ACTION_DEBUG] >>> СРАБАТЫВАНИЕ!\n");
- 
-            if (action.collectionSettings.get(0)) {
-                device.isTimersEnabled = true;
-            }
-            if (action.collectionSettings.get(1)) {
-                for (auto& output : action.outputs) {
-                    Relay* relay = findRelayById(device, output.relayId);
-                    if (relay && relay->isOutput) {
-                        output.lastState = relay->statePin;
-                    }
-                    controlOutputs(output);
-                }
-            }
-            if (action.collectionSettings.get(2)) {
-                device.temperature.isUseSetting = true;
-            }
+    if (!applyActions || myDevices.empty()) return changed;
 
-            if (action.collectionSettings.get(3) && action.sendMsg.length() > 0) {
-                logger.addLog(action.sendMsg, LOG_USER);
-            }
+    // Кнопки-сенсоры: значение - принятый после антидребезга уровень
+    forEachLiveDevice([this, &changed](Device& device, DeviceRuntime& runtime) {
+        bool sensorChanged = false;
+        for (size_t i = 0; i < device.sensors.size(); i++) {
+            Sensor& sensor = device.sensors[i];
+            if (!sensor.isUseSetting || !sensor.typeSensor.get(3) || sensor.inputRelayIndex == PLAN_NO_INDEX) continue;
 
-            action.wasTriggered = true;
+            float value = isInputPressed(sensor.inputPin) ? 1.0f : 0.0f;
+            if (value != sensor.currentValue) {
+                sensor.currentValue = value;
+                markSensorChanged(device, runtime, i);
+                sensorChanged = true;
+            }
         }
+        if (sensorChanged && setSensorActions(device, runtime)) {
+            changed = true;
+        }
+    });
+    return changed;
+}
 
-        else if (shouldReset && action.wasTriggered) {
-        
-    if (action.isReturnSetting) {
-        if (action.collectionSettings.get(0)) { device.isTimersEnabled = false; }
-        if (action.collectionSettings.get(2)) { device.temperature.isUseSetting = false; }
-    }
-                if (action.collectionSettings.get(1)) {
-                    for (auto& output : action.outputs) {
-                        if (output.isReturn) {
-                            Relay* relay = findRelayById(device, output.relayId);
-                            if (relay && relay->isOutput) {
-                                relay->statePin = output.lastState;
-                            }
-                        }
-                    }
+bool Control::dispatchGesture(uint8_t pin, GestureType gesture, bool applyActions) {
+    bool changed = false;
+    for (const GestureBinding& binding : gestureBindings) {
+        if (binding.pin == pin && binding.gesture == gesture) binding.handler(pin, gesture);
+    }
+    if (!applyActions || myDevices.empty()) return false;
+
+    forEachLiveDevice([this, pin, gesture, &changed](Device& device, DeviceRuntime&) {
+        if (!device.isActionEnabled) return;
+
+        const RuntimePlan& plan = device.plan;
+        for (size_t i = 0; i < device.sensors.size() && i + 1 < plan.sensorActionStart.size(); i++) {
+            const Sensor& sensor = device.sensors[i];
+            if (!sensor.typeSensor.get(3) || sensor.inputRelayIndex == PLAN_NO_INDEX || sensor.inputPin != pin) continue;
+
+            for (uint16_t j = plan.sensorActionStart[i]; j < plan.sensorActionStart[i + 1]; j++) {
+                Action& action = device.actions[plan.sensorActions[j]];
+                if (action.isUseSetting && action.gesture == gesture && fireGestureAction(device, action)) {
+                    changed = true;
                 }
+            }
+        }
+    });
+    return changed;
+}
 
-            action.wasTriggered = false;
+// Жест - событие, а не уровень: повторный жест возвращает то, что включил первый
+bool Control::fireGestureAction(Device& device, Action& action) {
+    if (action.targetRelayId != -1) {
+        Relay* conditionRelay = boundRelay(device, action.conditionRelayIndex);
+        if (!conditionRelay || conditionRelay->statePin != action.relayMustBeOn) {
+            return false;
         }
     }
+    if (action.condition.length() > 0) {
+        if (action.conditionProgram.empty()) return false;
+        if (!ExpressionProgram::isTrue(action.conditionProgram.evaluate(DeviceExpressionEnv(device, getCurrentTime())))) return false;
+    }
 
+    if (action.wasTriggered && action.isReturnSetting) {
+        resetAction(device, action);
+    } else {
+        triggerAction(device, action);
+    }
+    return true;
 }
@@ -7,11 +7,82 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <PID_v1.h>
-#include <DHT.h>
 #include <time.h>
+#include <Ticker.h>
 #include "DeviceManager.h"
 #include "Logger.h"
 #include "AppState.h"
+#include "OutputStage.h"
+#include "AdcSampler.h"
+#include "InputEdges.h"
+
+// Пользовательские Kp/Ki/Kd хранятся в тысячных долях коэффициентов регулятора
+#define PID_COEFFICIENT_SCALE 1000.0
+
+// Состояние одного контура температуры; ПИД держит указатели на input/output/setpoint
+struct TemperatureLoopState {
+    std::unique_ptr<PID> pid;
+    double input = 0;
+    double output = 0;
+    double setpoint = 0;
+    unsigned long windowStart = 0;
+    uint16_t duty = 0;          // выход ПИД в плавном режиме, 16 бит
+
+    bool isActive = false;
+    int sensorId = -1;
+    int relayId = -1;
+    int pidIndex = -1;
+    float setTemperature = -999.0f;
+};
+
+// Системная привязка жеста (кнопка на плате), не зависит от конфигурации устройств
+typedef void (*GestureHandler)(uint8_t pin, GestureType gesture);
+
+struct GestureBinding {
+    uint8_t pin;
+    GestureType gesture;
+    GestureHandler handler;
+};
+
+// Дедлайн шага последовательности таймеров. Ticker - это esp_timer на ESP32 и
+// os_timer на ESP8266; колбэк только ставит CMD_TIMER_STEP в очередь моста,
+// переход выполняет задача управления. Адрес стабилен: runtime держит его по указателю.
+struct TimerStepClock {
+    Ticker ticker;
+    ControlBridge* bridge = nullptr;
+    uint8_t deviceIndex = 0;
+    uint32_t generation = 0;
+
+    static void onDeadline(TimerStepClock* clock) {
+        ControlCommand command;
+        command.type = CMD_TIMER_STEP;
+        command.id = clock->deviceIndex;
+        command.number = clock->generation;
+        clock->bridge->post(command);
+    }
+};
+
+// Состояние исполнения одного устройства: у каждого живого устройства своё
+struct DeviceRuntime {
+    std::vector<TemperatureLoopState> loops;   // по индексу device.temperatures
+
+    size_t timerIndex = 0;
+    std::unique_ptr<TimerStepClock> timerClock;
+    uint32_t timerGeneration = 0;   // события с другим поколением устарели
+    bool isTimerStepDeferred = false;   // шаг пришёл, пока управление приостановлено
+    uint32_t deferredStepGeneration = 0;
+    bool timersCompleted = false;
+    bool prevTimersEnabled = false;
+    bool isInitialStateSaved = false;
+    bool prevHadTempControl = false;
+
+    bool lastScheduleState = false;
+
+    // Действия, ожидающие вычисления по событиям сенсоров и реле-условий
+    std::vector<uint16_t> pendingActions;
+    bool wasActionEnabled = false;
+    int lastConditionMinute = -1;   // правила с "now" пересчитываются раз в минуту
+};
 
 class Control {
 private:
@@ -22,44 +93,68 @@ private:
     std::vector<Device>& myDevices;
     uint8_t& currentDeviceIndex;
 
-    std::unordered_map<uint8_t, TouchSensorState> touchStates;
-    std::unique_ptr<PID> myPID;
+    // Цифровые входы с жестами: кнопки-сенсоры (бит 3) живых устройств и
+    // системные кнопки из bindGesture. Фронты приходят из прерываний.
+    struct GestureInput {
+        GestureRecognizer recognizer;
+        bool isDevicePin;
+    };
+    InputEdges inputEdges;
+    std::unordered_map<uint8_t, GestureInput> gestureInputs;
+    std::vector<GestureBinding> gestureBindings;
+
+    bool attachGestureInput(uint8_t pin, const GestureTiming& timing, bool isDevicePin);
+    void releaseDeviceInputs();
+    void syncDeviceInputs();
+    bool isInputPressed(uint8_t pin) const;
+    bool dispatchGesture(uint8_t pin, GestureType gesture, bool applyActions);
+    bool fireGestureAction(Device& device, Action& action);
 
     unsigned long lastPidTime;
-    double outputPid;
-    double inputPid;
-    double setpointPid;
 
     const unsigned long pidWindowSize = 5000;
-    unsigned long pidWindowStartTime;
 
     unsigned long lastUpdate = 0;
 
+    static uint32_t defaultMillis();
+    static time_t defaultTime();
+    uint32_t (*clockMillis)() = defaultMillis;
+    time_t (*clockTime)() = defaultTime;
+
      double scalePidCoefficient(double userCoefficient);
 
+    // Релейная автонастройка ПИД текущего устройства
+    void startAutotune(size_t loopIndex, bool start, float hysteresis);
+    void runAutotune(Device& device, Temperature& temp, TemperatureLoopState& state);
+    void finishAutotune(Device& device, Temperature& temp);
+
     bool isNumeric(const String& str);
     bool isValidDateTime(const String& dateTime);
-    int shiftWeekDay(int currentDay);
-    time_t convertToTimeT(const String& date);
     time_t getCurrentTime();
     String formatDateTime(time_t rawTime);
-    time_t convertOnlyDate(time_t rawTime);
-    uint32_t timeStringToSeconds(const String& timeStr);
     String secondsToTimeString(uint32_t totalSeconds);
 
-    void controlOutputs(OutPower& outPower);
+    void controlOutputs(Device& device, OutPower& outPower);
 
     void setFlagsSettingsTimers(uint8_t selectedIndex, Timer& currentTimer);
-    void collectionSettingsTimer(uint8_t currentTimerIndex);
-    void executeTimers(bool state);
+    void collectionSettingsTimer(Device& device, DeviceRuntime& runtime, uint8_t currentTimerIndex);
+    void executeTimers(Device& device, DeviceRuntime& runtime, bool deadline = false);
+    size_t nextUsedTimer(const Device& device, size_t from) const;
+    void startTimerStep(Device& device, DeviceRuntime& runtime, size_t timerIndex);
+    void finishTimerStep(Device& device, DeviceRuntime& runtime);
+    void armTimerStep(Device& device, DeviceRuntime& runtime, uint32_t durationMs);
+    void disarmTimerStep(DeviceRuntime& runtime);
+    bool onTimerStep(uint8_t deviceIndex, uint32_t generation);
+    void setTimersExecute(Device& device, DeviceRuntime& runtime);
 
-    void saveRelayStates(uint8_t relayIndex);
-    void restoreRelayStates(uint8_t relayIndex);
+    void saveRelayStates(Device& device, uint8_t relayIndex);
+    void restoreRelayStates(Device& device, uint8_t relayIndex);
 
-    void collectionSettingsSchedule(bool start, ScheduleScenario& scenario);
+    void collectionSettingsSchedule(Device& device, bool start, ScheduleScenario& scenario);
+    void setSchedules(Device& device, DeviceRuntime& runtime);
 
     float readNTCTemperature(const Sensor& sensor);
-    int readAnalog(const Sensor& sensor);
+    float readAnalog(const Sensor& sensor);
 
  struct {
     bool isActive = false;
@@ -68,26 +163,101 @@ private:
 
     Relay* findRelayById(Device& device, int id);
     Sensor* findSensorById(Device& device, int id);
+    Relay* boundRelay(Device& device, int16_t index);
+    void reportPlanIssues(const Device& device);
+
+    // Исполнение устройств: текущее и, в режиме нескольких устройств, остальные
+    // с непересекающимися пинами. runtimes - по индексу myDevices.
+    std::vector<DeviceRuntime> runtimes;
+    void selectLiveDevices();
+    DeviceRuntime& runtimeFor(uint8_t deviceIndex);
+
+    template <typename Fn>
+    void forEachLiveDevice(Fn fn) {
+        for (uint8_t index : deviceManager.liveDevices) {
+            if (index < myDevices.size()) fn(myDevices[index], runtimeFor(index));
+        }
+    }
+
+    // Теневое состояние выходов и пакетная запись в GPIO
+    OutputStage outputStage;
+
+    void setTemperature(Device& device, DeviceRuntime& runtime);
+    void runTemperatureLoop(Device& device, Temperature& temp, TemperatureLoopState& state);
+
+    const TemperatureLoopState* pidPwmLoop(const Device& device, const DeviceRuntime& runtime, const Relay& relay) const;
+    void updatePins(Device& device, DeviceRuntime& runtime);
+
+    // Непрерывный опрос аналоговых входов всех живых устройств
+    AdcSampler adcSampler;
+    uint8_t adcPins[ADC_MAX_CHANNELS];   // набор, с которым запущен опрос
+    size_t adcPinCount = 0;
+    uint16_t adcRateHz = 0;
+    bool isAdcConfigured = false;
+    void configureAdc();   // перезапускает опрос, только если набор входов или частота изменились
+
+    void setupDevice(Device& device, DeviceRuntime& runtime, bool onlyDHT);
+    void attachDhtSensors(Device& device);
+    void releaseDhtSensors(Device& device);
+    void applyItemPatch(Device& device, DeviceRuntime& runtime, uint8_t section, size_t index);
+
+    // true - сработало или сбросилось действие: выходы реле могли измениться
+    bool readSensors(Device& device, DeviceRuntime& runtime);
+    bool readDhtSensors(Device& device, DeviceRuntime& runtime);
+    bool setSensorActions(Device& device, DeviceRuntime& runtime);
+
+    void markSensorChanged(Device& device, DeviceRuntime& runtime, size_t sensorIndex);
+    void markActionPending(Device& device, DeviceRuntime& runtime, size_t actionIndex);
+    void markAllActionsPending(Device& device, DeviceRuntime& runtime);
+    void evaluateAction(Device& device, Action& action);
+    void triggerAction(Device& device, Action& action);
+    void resetAction(Device& device, Action& action);
 
 public:
 
      Control(DeviceManager& dm, Logger& lg, AppState& appState);
 
+    typedef uint32_t (*MillisFn)();
+    typedef time_t (*TimeFn)();
+
+    // Часы логики управления: расписания, таймеры, ПИД, автонастройка, ШИМ
+    // и правила с "now". По умолчанию millis() и time(); виртуальные часы
+    // прогоняют неделю расписаний без ожидания. Опрос DHT и метки фронтов
+    // кнопок остаются на millis(): их задаёт железо.
+    void setClock(MillisFn millisFn, TimeFn timeFn);
+
     void setup();
     void update();
-    void loop();
 
     void setupControl(bool onlyDHT = false);
-    void readSensors();
+    // true - действия по новым значениям изменили состояние: нужен updatePins
+    bool readSensors();
+    bool readDhtSensors();
     void setTemperature();
     void setTimersExecute();
     void updatePins();
+    void updatePwm();
+    void updateAdc();
+    void recordHistory();
     void setSchedules();
     void setSensorActions();
 
     void processCommand(const String& command);
 
-    bool checkTouchSensor(uint8_t pin);
+    // Применяет команды из очереди моста. Возвращает true, если изменились выходы реле.
+    // isAllowed = false (OTA, сохранение, смена Wi-Fi): шаги таймеров откладываются
+    // до возобновления, запуск автонастройки отклоняется.
+    bool processCommands(bool isAllowed);
+
+    // false - не хватило слотов прерываний
+    bool bindGesture(uint8_t pin, GestureType gesture, GestureHandler handler, uint16_t longMs = GESTURE_LONG_MS);
+
+    // Фронты из очереди -> жесты, кнопки-сенсоры и действия по жестам.
+    // applyActions = false - только системные привязки (управление приостановлено).
+    // Возвращает true, если могли измениться выходы.
+    bool updateInputs(bool applyActions);
+
+    const OutputStage& outputs() const { return outputStage; }
 
     void reInitDhtSensors();
 
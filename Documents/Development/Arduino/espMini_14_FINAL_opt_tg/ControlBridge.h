@@ -0,0 +1,196 @@
+#ifndef CONTROL_BRIDGE_H
+#define CONTROL_BRIDGE_H
+
+#include <stdint.h>
+#include "LockFreeQueue.h"
+
+// Мост между задачей управления и сетевыми задачами (веб-сервер, Telegram).
+// Сеть не трогает конфигурацию устройства напрямую: изменения уходят командами
+// в очередь, а состояние для отображения читается из снимков, которые
+// публикует задача управления.
+
+#if defined(ESP8266)
+#define SNAPSHOT_MAX_RELAYS 16
+#define SNAPSHOT_MAX_SENSORS 8
+#define SNAPSHOT_MAX_TIMERS 8
+#define SNAPSHOT_MAX_DEVICES 4
+#else
+#define SNAPSHOT_MAX_RELAYS 32
+#define SNAPSHOT_MAX_SENSORS 16
+#define SNAPSHOT_MAX_TIMERS 16
+#define SNAPSHOT_MAX_DEVICES 8
+#endif
+
+#define CONTROL_QUEUE_SIZE 32
+
+enum ControlCommandType : uint8_t {
+    CMD_RELAY_ON,
+    CMD_RELAY_OFF,
+    CMD_RELAY_RESET,
+    CMD_RELAY_RESET_ALL,
+    CMD_SET_FLAG,
+    CMD_SET_ITEM,
+    CMD_SET_PID_KP,
+    CMD_APPLY_DEVICE,
+    CMD_REINIT_SENSORS,
+    CMD_AUTOTUNE,           // id: индекс контура, value: старт/стоп, number: гистерезис, °C
+    CMD_TIMER_STEP,         // id: индекс устройства, number: поколение шага; шлёт аппаратный таймер
+    CMD_PATCH_ITEM          // field: DevicePatchSection, id: индекс записи, number: прежний id реле/сенсора
+};
+
+// Флаги устройства для CMD_SET_FLAG
+enum ControlFlag : uint8_t {
+    FLAG_TIMERS,
+    FLAG_ENCYCLATE,
+    FLAG_SCHEDULE,
+    FLAG_ACTIONS,
+    FLAG_TEMPERATURE
+};
+
+// Поля элементов массивов для CMD_SET_ITEM
+enum ControlItemField : uint8_t {
+    ITEM_ACTION_USE,
+    ITEM_ACTION_DESCRIPTION, // payload: строка из strdup, освобождает получатель
+    ITEM_TIMER_USE,
+    ITEM_SCHEDULE_USE,
+    ITEM_SENSOR_USE,
+    ITEM_RELAY_MANUAL,
+    ITEM_RELAY_STATE,
+    ITEM_TEMPERATURE_USE     // id: индекс контура температуры
+};
+
+// Записи устройства для CMD_PATCH_ITEM; реле и сенсоры ищутся по id, остальные по индексу
+enum DevicePatchSection : uint8_t {
+    PATCH_RELAY,
+    PATCH_SENSOR,
+    PATCH_SCHEDULE,
+    PATCH_TIMER,
+    PATCH_ACTION,
+    PATCH_PID
+};
+
+// Применённая правка, которую осталось дописать в журнал конфигурации
+struct PatchedItem {
+    uint8_t device;
+    uint8_t section;        // DevicePatchSection
+    uint16_t index;
+};
+
+#define PATCHED_QUEUE_SIZE 16
+
+struct ControlCommand {
+    ControlCommandType type;
+    uint8_t field = 0;      // ControlFlag / ControlItemField
+    bool value = false;
+    int32_t id = 0;         // id реле или индекс элемента
+    double number = 0;
+    void* payload = nullptr; // CMD_APPLY_DEVICE: Device*, CMD_PATCH_ITEM: запись раздела; владение переходит получателю
+};
+
+struct RelaySnapshot {
+    int id;
+    uint8_t index;
+    uint8_t pin;
+    bool isOutput;
+    bool statePin;
+    bool manualMode;
+    bool isPwm;
+    uint8_t pwm;
+};
+
+struct SensorSnapshot {
+    int sensorId;
+    uint8_t index;
+    bool isUseSetting;
+    uint8_t typeBits;
+    float currentValue;
+    float humidityValue;
+};
+
+// Ход таймера считается при чтении: снимок хранит только момент старта шага
+struct TimerSnapshot {
+    bool isUseSetting;
+    bool isRunning;
+    bool isStopped;
+    unsigned long startedAt;
+    uint32_t durationMs;
+
+    uint32_t elapsedMs(unsigned long now) const {
+        if (isStopped) return durationMs;
+        if (!isRunning) return 0;
+        unsigned long elapsed = now - startedAt;
+        return elapsed < durationMs ? elapsed : durationMs;
+    }
+
+    unsigned long elapsedSeconds(unsigned long now) const { return elapsedMs(now) / 1000; }
+    unsigned long remainingSeconds(unsigned long now) const {
+        return isRunning ? (durationMs - elapsedMs(now) + 999) / 1000 : 0;
+    }
+};
+
+// Сводка по живому устройству (режим нескольких устройств)
+struct DeviceSnapshot {
+    uint8_t index;              // индекс в myDevices
+    uint8_t outputCount;
+    uint8_t outputsOn;
+    bool isTimersEnabled;
+    bool isScheduleEnabled;
+    bool isActionEnabled;
+    bool isTemperatureUseSetting;
+    float currentTemp;          // основной контур температуры
+    float setTemperature;
+};
+
+struct ControlSnapshot {
+    uint32_t seq = 0;
+    bool valid = false;
+
+    uint8_t relayCount = 0;
+    uint8_t sensorCount = 0;
+    uint8_t timerCount = 0;
+    RelaySnapshot relays[SNAPSHOT_MAX_RELAYS];
+    SensorSnapshot sensors[SNAPSHOT_MAX_SENSORS];
+    TimerSnapshot timers[SNAPSHOT_MAX_TIMERS];
+
+    bool isTimersEnabled = false;
+    bool isEncyclateTimers = false;
+    bool isScheduleEnabled = false;
+    bool isActionEnabled = false;
+    bool isTemperatureUseSetting = false;
+    uint8_t autotuneState = 0;      // AutotuneState
+    uint8_t autotuneCycles = 0;
+
+    uint8_t deviceCount = 0;
+    DeviceSnapshot devices[SNAPSHOT_MAX_DEVICES];   // все живые устройства, первым - текущее
+};
+
+class ControlBridge {
+public:
+    typedef void (*WakeFn)();
+
+    // Писатели: обработчики веб-сервера и Telegram. Читатель: задача управления.
+    MpscQueue<ControlCommand, CONTROL_QUEUE_SIZE> commands;
+
+    // Отдельный снимок на каждого читателя: веб-сервер и Telegram живут в разных задачах.
+    SnapshotBuffer<ControlSnapshot> webSnapshot;
+    SnapshotBuffer<ControlSnapshot> botSnapshot;
+
+    // Пишет задача управления после CMD_PATCH_ITEM, читает она же в задаче saveControl
+    // и дописывает журнал. Переполнение - сохранить конфигурацию целиком.
+    SpscQueue<PatchedItem, PATCHED_QUEUE_SIZE> patched;
+    std::atomic<bool> isPatchedLost{false};
+
+    void setWakeCallback(WakeFn fn) { wake = fn; }
+
+    // false - очередь переполнена, команда не принята.
+    bool post(const ControlCommand& command) {
+        if (!commands.push(command)) return false;
+        if (wake) wake();
+        return true;
+    }
+
+private:
+    WakeFn wake = nullptr;
+};
+
+#endif
@@ -0,0 +1,811 @@
+#include "DeviceConfigFile.h"
+#include <initializer_list>
+
+namespace {
+
+const uint8_t CONFIG_MAGIC[4] = { 'E', 'S', 'P', 'D' };
+const uint8_t JOURNAL_MAGIC[4] = { 'E', 'S', 'P', 'J' };
+const size_t CONFIG_BUFFER = 256;
+
+enum ConfigSection : uint8_t {
+    SECTION_END = 0,
+    SECTION_DEVICE,
+    SECTION_PINS,
+    SECTION_RELAYS,
+    SECTION_SENSORS,
+    SECTION_ACTIONS,
+    SECTION_SCHEDULES,
+    SECTION_TEMPERATURES,
+    SECTION_PIDS,
+    SECTION_TIMERS
+};
+
+// CRC32 (как в zip) по полубайтам: таблица на 16 слов
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    while (length--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+uint8_t packFlags(std::initializer_list<bool> values) {
+    uint8_t flags = 0;
+    uint8_t bit = 0;
+    for (bool value : values) flags |= (uint8_t)value << bit++;
+    return flags;
+}
+
+bool flagAt(uint8_t flags, uint8_t bit) { return (flags >> bit) & 1; }
+
+// Без файла только считает байты: так узнаётся длина записи перед ней самой
+class ConfigWriter {
+public:
+    ConfigWriter() : file(nullptr), buffer(nullptr) {}
+    ConfigWriter(File& file, uint8_t* buffer) : file(&file), buffer(buffer) {}
+
+    void bytes(const void* data, size_t length) {
+        written += length;
+        if (!file) return;
+
+        const uint8_t* source = static_cast<const uint8_t*>(data);
+        crc = crc32Update(crc, source, length);
+        while (length > 0) {
+            size_t chunk = min(length, CONFIG_BUFFER - fill);
+            memcpy(buffer + fill, source, chunk);
+            fill += chunk;
+            source += chunk;
+            length -= chunk;
+            if (fill == CONFIG_BUFFER) flush();
+        }
+    }
+
+    void u8(uint8_t value) { bytes(&value, 1); }
+    void u16(uint16_t value) {
+        uint8_t raw[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+        bytes(raw, sizeof(raw));
+    }
+    void u32(uint32_t value) {
+        uint8_t raw[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+        bytes(raw, sizeof(raw));
+    }
+    void i32(int32_t value) { u32((uint32_t)value); }
+    void f32(float value) {
+        uint32_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        u32(raw);
+    }
+    void f64(double value) {
+        uint64_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        u32((uint32_t)raw);
+        u32((uint32_t)(raw >> 32));
+    }
+
+    void text(const char* value, size_t length) {
+        if (length > UINT16_MAX) length = UINT16_MAX;
+        u16(length);
+        bytes(value, length);
+    }
+    void text(const char* value) { text(value, strlen(value)); }
+    void text(const String& value) { text(value.c_str(), value.length()); }
+
+    bool flush() {
+        if (file && fill > 0) {
+            if (file->write(buffer, fill) != fill) failed = true;
+            fill = 0;
+        }
+        return !failed;
+    }
+
+    uint32_t size() const { return written; }
+    uint32_t checksum() const { return crc; }
+
+private:
+    File* file;
+    uint8_t* buffer;
+    size_t fill = 0;
+    uint32_t written = 0;
+    uint32_t crc = 0;
+    bool failed = false;
+};
+
+// Чтение за границей текущей записи даёт нули и ничего не потребляет:
+// так поля, которых не было у прежней прошивки, остаются по умолчанию.
+// Конец файла раньше границы - ошибка.
+class ConfigReader {
+public:
+    ConfigReader(File& file, uint8_t* buffer) : file(file), buffer(buffer) {}
+
+    bool failed() const { return error; }
+    void fail() { error = true; }
+    bool atEnd() { return head == fill && file.available() == 0; }
+    uint32_t checksum() const { return crc; }
+    void restartChecksum() { crc = 0; }
+    uint32_t remaining() const { return limit - position; }
+
+    void bytes(void* data, size_t length) {
+        uint8_t* target = static_cast<uint8_t*>(data);
+        if (error || length > remaining()) {
+            memset(target, 0, length);
+            return;
+        }
+
+        while (length > 0) {
+            if (head == fill) {
+                fill = file.read(buffer, CONFIG_BUFFER);
+                head = 0;
+                if (fill == 0) {
+                    error = true;
+                    memset(target, 0, length);
+                    return;
+                }
+            }
+            size_t chunk = min(length, fill - head);
+            memcpy(target, buffer + head, chunk);
+            crc = crc32Update(crc, target, chunk);
+            head += chunk;
+            position += chunk;
+            target += chunk;
+            length -= chunk;
+        }
+    }
+
+    void skip(uint32_t count) {
+        uint8_t scratch[16];
+        while (count > 0 && !error) {
+            size_t chunk = min((size_t)count, sizeof(scratch));
+            bytes(scratch, chunk);
+            count -= chunk;
+        }
+    }
+
+    uint8_t u8() {
+        uint8_t value;
+        bytes(&value, 1);
+        return value;
+    }
+    uint16_t u16() {
+        uint8_t raw[2];
+        bytes(raw, sizeof(raw));
+        return raw[0] | (uint16_t)raw[1] << 8;
+    }
+    uint32_t u32() {
+        uint8_t raw[4];
+        bytes(raw, sizeof(raw));
+        return raw[0] | (uint32_t)raw[1] << 8 | (uint32_t)raw[2] << 16 | (uint32_t)raw[3] << 24;
+    }
+    int32_t i32() { return (int32_t)u32(); }
+    float f32() {
+        uint32_t raw = u32();
+        float value;
+        memcpy(&value, &raw, sizeof(value));
+        return value;
+    }
+    double f64() {
+        uint64_t raw = u32();
+        raw |= (uint64_t)u32() << 32;
+        double value;
+        memcpy(&value, &raw, sizeof(value));
+        return value;
+    }
+
+    // size - с нулём; длиннее обрезается, как strncpy_safe
+    void text(char* dest, size_t size) {
+        uint16_t length = u16();
+        size_t kept = min((size_t)length, size - 1);
+        bytes(dest, kept);
+        dest[kept] = '\0';
+        skip(length - kept);
+    }
+
+    void text(String& dest, size_t maxLength) {
+        uint16_t length = u16();
+        size_t kept = min((size_t)length, maxLength);
+        dest = "";
+        dest.reserve(kept);
+
+        char chunk[33];
+        size_t done = 0;
+        while (done < kept && !error) {
+            size_t part = min(kept - done, sizeof(chunk) - 1);
+            bytes(chunk, part);
+            chunk[part] = '\0';
+            dest += chunk;
+            done += part;
+        }
+        skip(length - kept);
+    }
+
+    // Граница записи длиной length; возвращает внешнюю для leave()
+    uint32_t enter(uint32_t length) {
+        uint32_t outer = limit;
+        if (length > remaining()) {
+            error = true;
+            length = remaining();
+        }
+        limit = position + length;
+        return outer;
+    }
+
+    // Остаток записи (поля новой прошивки) пропускается
+    void leave(uint32_t outer) {
+        skip(limit - position);
+        limit = outer;
+    }
+
+private:
+    File& file;
+    uint8_t* buffer;
+    size_t head = 0;
+    size_t fill = 0;
+    uint32_t position = 0;
+    uint32_t limit = UINT32_MAX;
+    uint32_t crc = 0;
+    bool error = false;
+};
+
+template <typename Body>
+void writeSection(ConfigWriter& out, uint8_t tag, Body body) {
+    ConfigWriter counter;
+    body(counter);
+    out.u8(tag);
+    out.u32(counter.size());
+    body(out);
+}
+
+template <typename T>
+void writeList(ConfigWriter& out, const std::vector<T>& items, void (*writeItem)(ConfigWriter&, const T&)) {
+    size_t count = min(items.size(), (size_t)UINT16_MAX);
+    out.u16(count);
+    for (size_t i = 0; i < count; i++) {
+        ConfigWriter counter;
+        writeItem(counter, items[i]);
+        out.u16(min(counter.size(), (uint32_t)UINT16_MAX));
+        writeItem(out, items[i]);
+    }
+}
+
+// Запись не короче своего u16 - по этому отсекается испорченное число записей
+template <typename T>
+void readList(ConfigReader& in, std::vector<T>& items, void (*readItem)(ConfigReader&, T&)) {
+    uint16_t count = in.u16();
+    items.clear();
+    if (count > in.remaining() / 2) {
+        in.fail();
+        return;
+    }
+
+    items.reserve(count);
+    for (uint16_t i = 0; i < count && !in.failed(); i++) {
+        uint32_t outer = in.enter(in.u16());
+        items.emplace_back();
+        readItem(in, items.back());
+        in.leave(outer);
+    }
+}
+
+void writeOutPower(ConfigWriter& out, const OutPower& power) {
+    out.u8(packFlags({ power.isUseSetting, power.statePin, power.lastState, power.isReturn }));
+    out.u8(power.relayId);
+}
+
+void readOutPower(ConfigReader& in, OutPower& power) {
+    uint8_t flags = in.u8();
+    power.isUseSetting = flagAt(flags, 0);
+    power.statePin = flagAt(flags, 1);
+    power.lastState = flagAt(flags, 2);
+    power.isReturn = flagAt(flags, 3);
+    power.relayId = in.u8();
+}
+
+void writeRelay(ConfigWriter& out, const Relay& relay) {
+    out.i32(relay.id);
+    out.u8(relay.pin);
+    out.u8(packFlags({ relay.manualMode, relay.statePin, relay.isOutput, relay.isDigital, relay.lastState }));
+    out.text(relay.description);
+    out.u32(relay.pwmFrequency);
+    out.u8(relay.pwmResolution);
+    out.u16(relay.pwmRampMs);
+}
+
+void readRelay(ConfigReader& in, Relay& relay) {
+    relay.id = in.i32();
+    relay.pin = in.u8();
+    uint8_t flags = in.u8();
+    relay.manualMode = flagAt(flags, 0);
+    relay.statePin = flagAt(flags, 1);
+    relay.isOutput = flagAt(flags, 2);
+    relay.isDigital = flagAt(flags, 3);
+    relay.lastState = flagAt(flags, 4);
+    in.text(relay.description, MAX_DESCRIPTION_LENGTH);
+    relay.pwmFrequency = in.u32();
+    uint8_t resolution = in.u8();
+    relay.pwmResolution = constrain(resolution, 1, PWM_MAX_RESOLUTION);
+    relay.pwmRampMs = in.u16();
+}
+
+void writeSensor(ConfigWriter& out, const Sensor& sensor) {
+    out.text(sensor.description);
+    out.u8(sensor.isUseSetting);
+    out.i32(sensor.sensorId);
+    out.i32(sensor.relayId);
+    out.u8(sensor.typeSensor.bits);
+    out.u16(sensor.serial_r);
+    out.u16(sensor.thermistor_r);
+    out.u8(sensor.filter);
+    out.f32(sensor.ntcBeta);
+    out.f32(sensor.ntcShA);
+    out.f32(sensor.ntcShB);
+    out.f32(sensor.ntcShC);
+    out.f32(sensor.ntcOffset);
+    out.text(sensor.expression);
+}
+
+void readSensor(ConfigReader& in, Sensor& sensor) {
+    in.text(sensor.description, MAX_DESCRIPTION_LENGTH);
+    sensor.isUseSetting = in.u8();
+    sensor.sensorId = in.i32();
+    sensor.relayId = in.i32();
+    sensor.typeSensor.bits = in.u8() & 0x7F;
+    sensor.serial_r = in.u16();
+    sensor.thermistor_r = in.u16();
+    uint8_t filter = in.u8();
+    sensor.filter = constrain(filter, ADC_FILTER_MEAN, ADC_FILTER_RMS);
+    sensor.ntcBeta = in.f32();
+    sensor.ntcShA = in.f32();
+    sensor.ntcShB = in.f32();
+    sensor.ntcShC = in.f32();
+    sensor.ntcOffset = in.f32();
+    in.text(sensor.expression, UINT16_MAX);
+}
+
+void writeAction(ConfigWriter& out, const Action& action) {
+    out.text(action.description);
+    out.u8(packFlags({ action.isUseSetting, action.relayMustBeOn, action.isHumidity,
+                       action.actionMoreOrEqual, action.isReturnSetting }));
+    out.i32(action.targetRelayId);
+    out.i32(action.targetSensorId);
+    out.f32(action.triggerValueMax);
+    out.f32(action.triggerValueMin);
+    out.u8(action.gesture);
+    out.u8(action.collectionSettings.bits);
+    out.text(action.sendMsg);
+    out.text(action.condition);
+    writeList(out, action.outputs, writeOutPower);
+}
+
+void readAction(ConfigReader& in, Action& action) {
+    in.text(action.description, MAX_DESCRIPTION_LENGTH);
+    uint8_t flags = in.u8();
+    action.isUseSetting = flagAt(flags, 0);
+    action.relayMustBeOn = flagAt(flags, 1);
+    action.isHumidity = flagAt(flags, 2);
+    action.actionMoreOrEqual = flagAt(flags, 3);
+    action.isReturnSetting = flagAt(flags, 4);
+    action.targetRelayId = in.i32();
+    action.targetSensorId = in.i32();
+    action.triggerValueMax = in.f32();
+    action.triggerValueMin = in.f32();
+    uint8_t gesture = in.u8();
+    action.gesture = min(gesture, (uint8_t)GESTURE_HOLD_REPEAT);
+    action.collectionSettings.bits = in.u8() & 0x0F;
+    in.text(action.sendMsg, UINT16_MAX);
+    in.text(action.condition, UINT16_MAX);
+    readList(in, action.outputs, readOutPower);
+}
+
+void writeInterval(ConfigWriter& out, const startEndTime& interval) {
+    out.text(interval.startTime);
+    out.text(interval.endTime);
+}
+
+void readInterval(ConfigReader& in, startEndTime& interval) {
+    in.text(interval.startTime, MAX_TIME_LENGTH);
+    in.text(interval.endTime, MAX_TIME_LENGTH);
+}
+
+void writeSchedule(ConfigWriter& out, const ScheduleScenario& scenario) {
+    out.text(scenario.description);
+    out.u8(packFlags({ scenario.isUseSetting, scenario.isActive }));
+    out.u8(scenario.collectionSettings.bits);
+    out.text(scenario.startDate);
+    out.text(scenario.endDate);
+    writeList(out, scenario.startEndTimes, writeInterval);
+    out.u8(scenario.week.bits);
+    out.u16(scenario.months.bits);
+    writeOutPower(out, scenario.initialStateRelay);
+    writeOutPower(out, scenario.endStateRelay);
+}
+
+void readSchedule(ConfigReader& in, ScheduleScenario& scenario) {
+    in.text(scenario.description, MAX_DESCRIPTION_LENGTH);
+    uint8_t flags = in.u8();
+    scenario.isUseSetting = flagAt(flags, 0);
+    scenario.isActive = flagAt(flags, 1);
+    scenario.collectionSettings.bits = in.u8() & 0x0F;
+    in.text(scenario.startDate, MAX_DATE_LENGTH);
+    in.text(scenario.endDate, MAX_DATE_LENGTH);
+    readList(in, scenario.startEndTimes, readInterval);
+    scenario.week.bits = in.u8() & 0x7F;
+    scenario.months.bits = in.u16() & 0xFFF;
+    readOutPower(in, scenario.initialStateRelay);
+    readOutPower(in, scenario.endStateRelay);
+}
+
+void writeTemperature(ConfigWriter& out, const Temperature& temperature) {
+    out.u8(packFlags({ temperature.isUseSetting, temperature.lastState, temperature.isSmoothly, temperature.isIncrease }));
+    out.u8(temperature.relayId);
+    out.u8(temperature.sensorId);
+    out.f32(temperature.setTemperature);
+    out.f32(temperature.currentTemp);
+    out.u8(temperature.collectionSettings.bits);
+    out.i32(temperature.selectedPidIndex);
+}
+
+void readTemperature(ConfigReader& in, Temperature& temperature) {
+    uint8_t flags = in.u8();
+    temperature.isUseSetting = flagAt(flags, 0);
+    temperature.lastState = flagAt(flags, 1);
+    temperature.isSmoothly = flagAt(flags, 2);
+    temperature.isIncrease = flagAt(flags, 3);
+    temperature.relayId = in.u8();
+    temperature.sensorId = in.u8();
+    temperature.setTemperature = in.f32();
+    temperature.currentTemp = in.f32();
+    temperature.collectionSettings.bits = in.u8() & 0x0F;
+    temperature.selectedPidIndex = in.i32();
+}
+
+void writePid(ConfigWriter& out, const Pid& pid) {
+    out.text(pid.description);
+    out.f64(pid.Kp);
+    out.f64(pid.Ki);
+    out.f64(pid.Kd);
+}
+
+void readPid(ConfigReader& in, Pid& pid) {
+    in.text(pid.description, MAX_DESCRIPTION_LENGTH);
+    pid.Kp = in.f64();
+    pid.Ki = in.f64();
+    pid.Kd = in.f64();
+}
+
+void writeTimer(ConfigWriter& out, const Timer& timer) {
+    out.u8(timer.isUseSetting);
+    out.text(timer.time);
+    out.u8(timer.collectionSettings.bits);
+    writeOutPower(out, timer.initialStateRelay);
+    writeOutPower(out, timer.endStateRelay);
+}
+
+void readTimer(ConfigReader& in, Timer& timer) {
+    timer.isUseSetting = in.u8();
+    in.text(timer.time, MAX_TIME_LENGTH);
+    timer.collectionSettings.bits = in.u8() & 0x0F;
+    readOutPower(in, timer.initialStateRelay);
+    readOutPower(in, timer.endStateRelay);
+}
+
+void writeDevice(ConfigWriter& out, const Device& device) {
+    writeSection(out, SECTION_DEVICE, [&](ConfigWriter& w) {
+        w.text(device.nameDevice);
+        w.u8(device.isSelected);
+        w.u16(device.adcRateHz);
+        w.u8(packFlags({ device.isTimersEnabled, device.isEncyclateTimers, device.isScheduleEnabled, device.isActionEnabled }));
+    });
+    writeSection(out, SECTION_PINS, [&](ConfigWriter& w) {
+        w.u16(device.pins.size());
+        for (uint8_t pin : device.pins) w.u8(pin);
+    });
+    writeSection(out, SECTION_RELAYS, [&](ConfigWriter& w) { writeList(w, device.relays, writeRelay); });
+    writeSection(out, SECTION_SENSORS, [&](ConfigWriter& w) { writeList(w, device.sensors, writeSensor); });
+    writeSection(out, SECTION_ACTIONS, [&](ConfigWriter& w) { writeList(w, device.actions, writeAction); });
+    writeSection(out, SECTION_SCHEDULES, [&](ConfigWriter& w) { writeList(w, device.scheduleScenarios, writeSchedule); });
+    writeSection(out, SECTION_TEMPERATURES, [&](ConfigWriter& w) { writeList(w, device.temperatures, writeTemperature); });
+    writeSection(out, SECTION_PIDS, [&](ConfigWriter& w) { writeList(w, device.pids, writePid); });
+    writeSection(out, SECTION_TIMERS, [&](ConfigWriter& w) { writeList(w, device.timers, writeTimer); });
+    out.u8(SECTION_END);
+}
+
+void readDevice(ConfigReader& in, Device& device) {
+    while (!in.failed()) {
+        uint8_t tag = in.u8();
+        if (tag == SECTION_END) break;
+
+        uint32_t outer = in.enter(in.u32());
+        switch (tag) {
+            case SECTION_DEVICE: {
+                in.text(device.nameDevice, MAX_DESCRIPTION_LENGTH);
+                device.isSelected = in.u8();
+                uint16_t rate = in.u16();
+                device.adcRateHz = constrain(rate, ADC_MIN_RATE_HZ, ADC_MAX_RATE_HZ);
+                uint8_t flags = in.u8();
+                device.isTimersEnabled = flagAt(flags, 0);
+                device.isEncyclateTimers = flagAt(flags, 1);
+                device.isScheduleEnabled = flagAt(flags, 2);
+                device.isActionEnabled = flagAt(flags, 3);
+                break;
+            }
+            case SECTION_PINS: {
+                uint16_t count = in.u16();
+                device.pins.clear();
+                if (count > in.remaining()) {
+                    in.fail();
+                    break;
+                }
+                device.pins.reserve(count);
+                for (uint16_t i = 0; i < count; i++) device.pins.push_back(in.u8());
+                break;
+            }
+            case SECTION_RELAYS: readList(in, device.relays, readRelay); break;
+            case SECTION_SENSORS: readList(in, device.sensors, readSensor); break;
+            case SECTION_ACTIONS: readList(in, device.actions, readAction); break;
+            case SECTION_SCHEDULES: readList(in, device.scheduleScenarios, readSchedule); break;
+            case SECTION_TEMPERATURES:
+                readList(in, device.temperatures, readTemperature);
+                if (device.temperatures.empty()) device.temperatures.resize(1);
+                if (device.temperatures.size() > MAX_TEMPERATURE_LOOPS) device.temperatures.resize(MAX_TEMPERATURE_LOOPS);
+                break;
+            case SECTION_PIDS: readList(in, device.pids, readPid); break;
+            case SECTION_TIMERS: readList(in, device.timers, readTimer); break;
+            default: break;   // секция новой прошивки
+        }
+        in.leave(outer);
+    }
+}
+
+// Запись журнала: заголовок, запись списка, CRC32 всего этого
+template <typename T>
+void writeJournalItem(ConfigWriter& out, uint8_t deviceIndex, uint8_t tag, size_t index,
+                      const std::vector<T>& items, void (*writeItem)(ConfigWriter&, const T&)) {
+    if (index >= items.size()) return;   // конфигурацию успели заменить
+
+    out.u8(deviceIndex);
+    out.u8(tag);
+    out.u16(index);
+    ConfigWriter counter;
+    writeItem(counter, items[index]);
+    out.u16(min(counter.size(), (uint32_t)UINT16_MAX));
+    writeItem(out, items[index]);
+    out.u32(out.checksum());
+}
+
+// Запись применяется только с верной CRC: оборванная при сбое питания пропадает целиком
+template <typename T>
+bool replayItem(ConfigReader& in, uint32_t outer, std::vector<T>* items, uint16_t index,
+                void (*readItem)(ConfigReader&, T&)) {
+    T item = T();
+    readItem(in, item);
+    in.leave(outer);
+
+    uint32_t expected = in.checksum();
+    if (in.u32() != expected || in.failed()) return false;
+
+    if (items && index < items->size()) (*items)[index] = std::move(item);
+    return true;
+}
+
+bool readJournalHeader(ConfigReader& in, uint32_t baseChecksum) {
+    uint8_t magic[sizeof(JOURNAL_MAGIC)];
+    in.bytes(magic, sizeof(magic));
+    uint16_t version = in.u16();
+    uint32_t checksum = in.u32();
+    return !in.failed() && memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) == 0 &&
+           version == DEVICE_CONFIG_VERSION && checksum == baseChecksum;
+}
+
+// CRC32 в конце файла конфигурации - по нему журнал привязан к своему файлу
+bool readBaseChecksum(const char* path, uint32_t& checksum) {
+    File file = SPIFFS.open(path, "r");
+    if (!file) return false;
+
+    uint8_t raw[4] = { 0 };
+    bool isRead = file.size() >= sizeof(raw) + sizeof(CONFIG_MAGIC) && file.seek(file.size() - sizeof(raw)) &&
+                  file.read(raw, sizeof(raw)) == sizeof(raw);
+    file.close();
+
+    checksum = raw[0] | (uint32_t)raw[1] << 8 | (uint32_t)raw[2] << 16 | (uint32_t)raw[3] << 24;
+    return isRead;
+}
+
+// isTorn - хвост не прочитан: новые записи за ним не были бы видны
+size_t replayJournal(std::vector<Device>& devices, const String& journalPath, uint32_t baseChecksum, bool& isTorn) {
+    isTorn = false;
+    File file = SPIFFS.open(journalPath, "r");
+    if (!file) return 0;
+
+    uint8_t buffer[CONFIG_BUFFER];
+    ConfigReader in(file, buffer);
+    if (!readJournalHeader(in, baseChecksum)) {
+        file.close();
+        Serial.printf("[Config] %s от другой конфигурации, пропущен\n", journalPath.c_str());
+        return 0;
+    }
+
+    size_t applied = 0;
+    while (!in.atEnd()) {
+        in.restartChecksum();
+        uint8_t deviceIndex = in.u8();
+        uint8_t tag = in.u8();
+        uint16_t index = in.u16();
+        uint32_t outer = in.enter(in.u16());
+
+        Device* device = deviceIndex < devices.size() ? &devices[deviceIndex] : nullptr;
+        bool isValid;
+        switch (tag) {
+            case SECTION_RELAYS:    isValid = replayItem(in, outer, device ? &device->relays : nullptr, index, readRelay); break;
+            case SECTION_SENSORS:   isValid = replayItem(in, outer, device ? &device->sensors : nullptr, index, readSensor); break;
+            case SECTION_ACTIONS:   isValid = replayItem(in, outer, device ? &device->actions : nullptr, index, readAction); break;
+            case SECTION_SCHEDULES: isValid = replayItem(in, outer, device ? &device->scheduleScenarios : nullptr, index, readSchedule); break;
+            case SECTION_PIDS:      isValid = replayItem(in, outer, device ? &device->pids : nullptr, index, readPid); break;
+            case SECTION_TIMERS:    isValid = replayItem(in, outer, device ? &device->timers : nullptr, index, readTimer); break;
+            default: {
+                // Секция новой прошивки: пропускается по длине
+                in.leave(outer);
+                uint32_t expected = in.checksum();
+                isValid = in.u32() == expected && !in.failed();
+                break;
+            }
+        }
+        if (!isValid) {
+            Serial.printf("[Config] %s: оборванная запись, остаток пропущен\n", journalPath.c_str());
+            isTorn = true;
+            break;
+        }
+        applied++;
+        yield();
+    }
+
+    file.close();
+    return applied;
+}
+
+}
+
+bool DeviceConfigFile::write(const std::vector<Device>& devices, const char* path) {
+    String tempPath = String(path) + ".tmp";
+    File file = SPIFFS.open(tempPath, "w");
+    if (!file) return false;
+
+    uint8_t buffer[CONFIG_BUFFER];
+    ConfigWriter out(file, buffer);
+    size_t count = min(devices.size(), (size_t)UINT8_MAX);
+
+    out.bytes(CONFIG_MAGIC, sizeof(CONFIG_MAGIC));
+    out.u16(DEVICE_CONFIG_VERSION);
+    out.u8(count);
+    for (size_t i = 0; i < count; i++) {
+        writeDevice(out, devices[i]);
+        yield();
+    }
+    out.u32(out.checksum());
+
+    bool isWritten = out.flush();
+    file.close();
+    if (!isWritten) {
+        SPIFFS.remove(tempPath);
+        Serial.printf("[Config] Ошибка записи %s\n", tempPath.c_str());
+        return false;
+    }
+
+    // Журнал - правки прежнего файла: до подмены, иначе сбой между ними оставит
+    // его при новом файле (его всё равно отсечёт CRC в заголовке)
+    String journalPath = String(path) + DEVICE_CONFIG_JOURNAL_SUFFIX;
+    if (SPIFFS.exists(journalPath)) SPIFFS.remove(journalPath);
+
+    if (SPIFFS.exists(path)) SPIFFS.remove(path);
+    if (!SPIFFS.rename(tempPath, path)) {
+        Serial.printf("[Config] Не удалось переименовать %s\n", tempPath.c_str());
+        return false;
+    }
+
+    Serial.printf("[Config] Сохранено устройств: %u, %lu байт\n", (unsigned)count, (unsigned long)out.size());
+    return true;
+}
+
+bool DeviceConfigFile::read(std::vector<Device>& devices, const char* path) {
+    // Сбой между удалением старого файла и переименованием нового
+    String filePath = path;
+    if (!SPIFFS.exists(filePath)) filePath += ".tmp";
+
+    File file = SPIFFS.open(filePath, "r");
+    if (!file) return false;
+
+    uint8_t buffer[CONFIG_BUFFER];
+    ConfigReader in(file, buffer);
+
+    uint8_t magic[sizeof(CONFIG_MAGIC)];
+    in.bytes(magic, sizeof(magic));
+    uint16_t version = in.u16();
+    if (memcmp(magic, CONFIG_MAGIC, sizeof(magic)) != 0 || version != DEVICE_CONFIG_VERSION) {
+        file.close();
+        Serial.printf("[Config] %s: неизвестный формат или версия %u\n", filePath.c_str(), version);
+        return false;
+    }
+
+    uint8_t count = in.u8();
+    std::vector<Device> loaded;
+    loaded.reserve(count);
+    for (uint8_t i = 0; i < count && !in.failed(); i++) {
+        loaded.emplace_back();
+        readDevice(in, loaded.back());
+        yield();
+    }
+
+    uint32_t expected = in.checksum();
+    uint32_t stored = in.u32();
+    file.close();
+
+    if (in.failed() || stored != expected) {
+        Serial.printf("[Config] %s повреждён, настройки не загружены\n", filePath.c_str());
+        return false;
+    }
+
+    bool isTorn;
+    size_t patched = replayJournal(loaded, String(path) + DEVICE_CONFIG_JOURNAL_SUFFIX, stored, isTorn);
+    if (patched > 0) Serial.printf("[Config] Из журнала применено правок: %u\n", (unsigned)patched);
+
+    devices = std::move(loaded);
+    if (isTorn) write(devices, path);   // журнал сворачивается, повреждённый хвост уходит
+    return true;
+}
+
+bool DeviceConfigFile::writeItem(const Device& device, size_t deviceIndex,
+                                 DevicePatchSection section, size_t itemIndex, const char* path) {
+    uint32_t baseChecksum;
+    if (deviceIndex > UINT8_MAX || itemIndex > UINT16_MAX || !readBaseChecksum(path, baseChecksum)) {
+        return false;
+    }
+
+    String journalPath = String(path) + DEVICE_CONFIG_JOURNAL_SUFFIX;
+    uint8_t buffer[CONFIG_BUFFER];
+
+    // Журнал другого файла (загружен через /uploadFile, сбой при подмене) начинается заново
+    bool isFresh = true;
+    File file = SPIFFS.open(journalPath, "r");
+    if (file) {
+        if (file.size() >= DEVICE_CONFIG_JOURNAL_MAX) {
+            file.close();
+            return false;
+        }
+        ConfigReader in(file, buffer);
+        isFresh = !readJournalHeader(in, baseChecksum);
+        file.close();
+    }
+
+    file = SPIFFS.open(journalPath, isFresh ? "w" : "a");
+    if (!file) return false;
+
+    if (isFresh) {
+        ConfigWriter header(file, buffer);
+        header.bytes(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        header.u16(DEVICE_CONFIG_VERSION);
+        header.u32(baseChecksum);
+        header.flush();
+    }
+
+    ConfigWriter out(file, buffer);
+    switch (section) {
+        case PATCH_RELAY:    writeJournalItem(out, deviceIndex, SECTION_RELAYS, itemIndex, device.relays, writeRelay); break;
+        case PATCH_SENSOR:   writeJournalItem(out, deviceIndex, SECTION_SENSORS, itemIndex, device.sensors, writeSensor); break;
+        case PATCH_SCHEDULE: writeJournalItem(out, deviceIndex, SECTION_SCHEDULES, itemIndex, device.scheduleScenarios, writeSchedule); break;
+        case PATCH_TIMER:    writeJournalItem(out, deviceIndex, SECTION_TIMERS, itemIndex, device.timers, writeTimer); break;
+        case PATCH_ACTION:   writeJournalItem(out, deviceIndex, SECTION_ACTIONS, itemIndex, device.actions, writeAction); break;
+        case PATCH_PID:      writeJournalItem(out, deviceIndex, SECTION_PIDS, itemIndex, device.pids, writePid); break;
+    }
+
+    bool isWritten = out.flush();
+    file.close();
+    if (!isWritten) {
+        Serial.printf("[Config] Ошибка записи %s\n", journalPath.c_str());
+        return false;
+    }
+    return true;
+}
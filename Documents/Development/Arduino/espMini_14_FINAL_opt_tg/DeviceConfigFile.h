@@ -0,0 +1,53 @@
+#ifndef DEVICE_CONFIG_FILE_H
+#define DEVICE_CONFIG_FILE_H
+
+#include <Arduino.h>
+#include <vector>
+#include "DeviceManager.h"
+
+// Конфигурация устройств на флеше в двоичном виде, без JSON-документа:
+// запись и чтение идут потоком через буфер прямо из структур и в них.
+//
+// Файл: "ESPD", версия (u16), число устройств (u8), устройства, CRC32 всего
+// предшествующего (u32). Устройство - u32 длина и секции: тег (u8), u32 длина,
+// содержимое. Списки - u16 число и записи с u16 длиной впереди. Числа - little
+// endian, строки - u16 длина и байты без нуля.
+//
+// Новые поля дописываются в конец записи, новые секции - с новым тегом: старая
+// прошивка пропускает незнакомое по длине, новая берёт для недостающих полей
+// значения по умолчанию. Версия меняется только при несовместимой раскладке.
+//
+// Правка одной записи (PATCH /device) не переписывает файл, а дописывается в
+// журнал path.jnl: "ESPJ", версия (u16), CRC32 файла конфигурации (u32), затем
+// записи - устройство (u8), тег секции (u8), индекс (u16), запись списка как в
+// файле, CRC32 записи (u32). read() накладывает журнал на загруженное; журнал от
+// другого файла и оборванный хвост пропускаются. Полная запись журнал удаляет.
+//
+// Расписания, сенсоры, таймеры и план после чтения не компилируются - это
+// делает DeviceManager::readDevicesFromFile.
+
+// Не .bin: загрузка *.bin через /uploadFile считается прошивкой
+#define DEVICE_CONFIG_PATH "/devices.cfg"
+// JSON - резервная копия из интерфейса: /download отдаёт его из памяти,
+// загруженный через /uploadFile импортируется при следующем старте
+#define DEVICE_CONFIG_LEGACY_PATH "/devices.json"
+#define DEVICE_CONFIG_VERSION 1
+#define DEVICE_CONFIG_JOURNAL_SUFFIX ".jnl"
+#define DEVICE_CONFIG_JOURNAL_MAX 4096   // больше - журнал сворачивается полной записью
+
+class DeviceConfigFile {
+public:
+    // Сначала в path.tmp, затем подмена: сбой питания не оставляет полузаписанный файл
+    static bool write(const std::vector<Device>& devices, const char* path);
+
+    // devices не меняется, если файл повреждён или не той версии
+    static bool read(std::vector<Device>& devices, const char* path);
+
+    // Запись itemIndex раздела section устройства deviceIndex - в журнал.
+    // false - нет файла конфигурации, журнал переполнен или ошибка записи:
+    // нужна полная запись
+    static bool writeItem(const Device& device, size_t deviceIndex,
+                          DevicePatchSection section, size_t itemIndex, const char* path);
+};
+
+#endif
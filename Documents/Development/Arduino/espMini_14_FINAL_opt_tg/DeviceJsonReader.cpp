@@ -0,0 +1,383 @@
+#include "DeviceJsonReader.h"
+
+namespace {
+
+bool is(const char* key, const char* name) { return key && strcmp(key, name) == 0; }
+
+void copyText(char* dest, const JsonStreamValue& value, size_t size) {
+    strncpy(dest, value.asText(), size - 1);
+    dest[size - 1] = '\0';
+}
+
+// Новая запись списка; false - список уже полон
+template <typename T>
+T* addItem(std::vector<T>& items) {
+    if (items.size() >= DEVICE_JSON_MAX_ITEMS) return nullptr;
+    items.emplace_back();
+    return &items.back();
+}
+
+void setOutPower(OutPower& power, const char* key, const JsonStreamValue& value) {
+    if (is(key, "use")) power.isUseSetting = value.asBool();
+    else if (is(key, "rid")) power.relayId = value.asInt();
+    else if (is(key, "stp")) power.statePin = value.asBool();
+    else if (is(key, "lst")) power.lastState = value.asBool();
+    else if (is(key, "rtn")) power.isReturn = value.asBool();
+}
+
+void setTemperature(Temperature& temperature, const char* key, const JsonStreamValue& value) {
+    if (is(key, "use")) temperature.isUseSetting = value.asBool();
+    else if (is(key, "rid")) temperature.relayId = value.asInt();
+    else if (is(key, "lst")) temperature.lastState = value.asBool();
+    else if (is(key, "sid")) temperature.sensorId = value.asInt();
+    else if (is(key, "stT")) temperature.setTemperature = value.asNumber();
+    else if (is(key, "ctp")) temperature.currentTemp = value.asNumber();
+    else if (is(key, "smt")) temperature.isSmoothly = value.asBool();
+    else if (is(key, "inc")) temperature.isIncrease = value.asBool();
+    else if (is(key, "spi")) temperature.selectedPidIndex = value.asInt();
+}
+
+}
+
+DeviceJsonReader::DeviceJsonReader(DevicePatchSection section, void* record) : device(nullptr), parser(*this) {
+    root = { CONTEXT_SKIP, 0, 0, record };
+    switch (section) {
+        case PATCH_RELAY:    root.context = CONTEXT_RELAY; break;
+        case PATCH_SENSOR:   root.context = CONTEXT_SENSOR; break;
+        case PATCH_SCHEDULE: root.context = CONTEXT_SCHEDULE; break;
+        case PATCH_TIMER:    root.context = CONTEXT_TIMER; break;
+        case PATCH_ACTION:   root.context = CONTEXT_ACTION; break;
+        case PATCH_PID:      root.context = CONTEXT_PID; break;
+    }
+}
+
+DeviceJsonReader::Frame DeviceJsonReader::bits(void* target, uint8_t count) {
+    Frame frame = { CONTEXT_BITS, count, 0, target };
+    return frame;
+}
+
+// false - список переполнен
+bool DeviceJsonReader::child(const Frame& parent, const char* key, bool isArray, Frame& frame) {
+    frame = { CONTEXT_SKIP, 0, 0, nullptr };
+
+    switch (parent.context) {
+        case CONTEXT_ROOT:
+            if (isArray && is(key, "rel")) {
+                device->relays.clear();
+                frame.context = CONTEXT_RELAYS;
+            } else if (isArray && is(key, "pinL")) {
+                device->pins.clear();
+                frame.context = CONTEXT_PINS;
+            } else if (isArray && is(key, "sen")) {
+                device->sensors.clear();
+                frame.context = CONTEXT_SENSORS;
+            } else if (isArray && is(key, "act")) {
+                device->actions.clear();
+                frame.context = CONTEXT_ACTIONS;
+            } else if (isArray && is(key, "sch")) {
+                device->scheduleScenarios.clear();
+                frame.context = CONTEXT_SCHEDULES;
+            } else if (!isArray && is(key, "tmp")) {
+                frame.context = CONTEXT_TEMPERATURE;
+                frame.target = &device->temperature();
+            } else if (isArray && is(key, "tzn")) {
+                // Зоны - целым списком, основной контур остаётся на месте
+                device->temperatures.resize(1);
+                frame.context = CONTEXT_ZONES;
+            } else if (isArray && is(key, "pid")) {
+                device->pids.clear();
+                frame.context = CONTEXT_PIDS;
+            } else if (isArray && is(key, "tmr")) {
+                device->timers.clear();
+                frame.context = CONTEXT_TIMERS;
+            }
+            break;
+
+        case CONTEXT_RELAYS:
+            if (!isArray) {
+                frame.target = addItem(device->relays);
+                if (!frame.target) return false;
+                frame.context = CONTEXT_RELAY;
+            }
+            break;
+
+        case CONTEXT_SENSORS:
+            if (!isArray) {
+                frame.target = addItem(device->sensors);
+                if (!frame.target) return false;
+                frame.context = CONTEXT_SENSOR;
+            }
+            break;
+
+        case CONTEXT_SENSOR:
+            if (isArray && is(key, "typ")) frame = bits(&static_cast<Sensor*>(parent.target)->typeSensor.bits, 7);
+            break;
+
+        case CONTEXT_ACTIONS:
+            if (!isArray) {
+                Action* action = addItem(device->actions);
+                if (!action) return false;
+                // Умолчания прежнего разбора для отсутствующих "trd" и "rmb"
+                action->targetRelayId = -1;
+                action->relayMustBeOn = true;
+                frame.target = action;
+                frame.context = CONTEXT_ACTION;
+            }
+            break;
+
+        case CONTEXT_ACTION: {
+            Action* action = static_cast<Action*>(parent.target);
+            if (isArray && is(key, "cls")) {
+                frame = bits(&action->collectionSettings.bits, 4);
+            } else if (isArray && is(key, "outL")) {
+                action->outputs.clear();
+                frame.context = CONTEXT_OUTPUTS;
+                frame.target = &action->outputs;
+            }
+            break;
+        }
+
+        case CONTEXT_OUTPUTS:
+            if (!isArray) {
+                frame.target = addItem(*static_cast<std::vector<OutPower>*>(parent.target));
+                if (!frame.target) return false;
+                frame.context = CONTEXT_OUTPUT;
+            }
+            break;
+
+        case CONTEXT_SCHEDULES:
+            if (!isArray) {
+                frame.target = addItem(device->scheduleScenarios);
+                if (!frame.target) return false;
+                frame.context = CONTEXT_SCHEDULE;
+            }
+            break;
+
+        case CONTEXT_SCHEDULE: {
+            ScheduleScenario* scenario = static_cast<ScheduleScenario*>(parent.target);
+            if (isArray && is(key, "cls")) {
+                frame = bits(&scenario->collectionSettings.bits, 4);
+            } else if (isArray && is(key, "wek")) {
+                frame = bits(&scenario->week.bits, 7);
+            } else if (isArray && is(key, "mon")) {
+                frame = bits(&scenario->months.bits, 12);
+            } else if (isArray && is(key, "set")) {
+                scenario->startEndTimes.clear();
+                frame.context = CONTEXT_INTERVALS;
+                frame.target = &scenario->startEndTimes;
+            } else if (!isArray && (is(key, "isr") || is(key, "esr"))) {
+                frame.context = CONTEXT_OUTPUT;
+                frame.target = is(key, "isr") ? &scenario->initialStateRelay : &scenario->endStateRelay;
+            }
+            break;
+        }
+
+        case CONTEXT_INTERVALS:
+            if (!isArray) {
+                frame.target = addItem(*static_cast<std::vector<startEndTime>*>(parent.target));
+                if (!frame.target) return false;
+                frame.context = CONTEXT_INTERVAL;
+            }
+            break;
+
+        case CONTEXT_TEMPERATURE:
+            if (isArray && is(key, "cls")) frame = bits(&static_cast<Temperature*>(parent.target)->collectionSettings.bits, 4);
+            break;
+
+        case CONTEXT_ZONES:
+            // Зоны сверх MAX_TEMPERATURE_LOOPS пропускаются, как и раньше
+            if (!isArray && device->temperatures.size() < MAX_TEMPERATURE_LOOPS) {
+                device->temperatures.emplace_back();
+                frame.target = &device->temperatures.back();
+                frame.context = CONTEXT_TEMPERATURE;
+            }
+            break;
+
+        case CONTEXT_PIDS:
+            if (!isArray) {
+                frame.target = addItem(device->pids);
+                if (!frame.target) return false;
+                frame.context = CONTEXT_PID;
+            }
+            break;
+
+        case CONTEXT_TIMERS:
+            if (!isArray) {
+                frame.target = addItem(device->timers);
+                if (!frame.target) return false;
+                frame.context = CONTEXT_TIMER;
+            }
+            break;
+
+        case CONTEXT_TIMER: {
+            Timer* timer = static_cast<Timer*>(parent.target);
+            if (isArray && is(key, "cls")) {
+                frame = bits(&timer->collectionSettings.bits, 4);
+            } else if (!isArray && (is(key, "isr") || is(key, "esr"))) {
+                frame.context = CONTEXT_OUTPUT;
+                frame.target = is(key, "isr") ? &timer->initialStateRelay : &timer->endStateRelay;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+bool DeviceJsonReader::beginContainer(const char* key, bool isArray) {
+    if (depth == 0) {
+        if (isArray) return false;   // документ - объект устройства или записи
+        if (device) root = { CONTEXT_ROOT, 0, 0, nullptr };
+        frames[depth++] = root;
+        return true;
+    }
+
+    Frame frame = { CONTEXT_SKIP, 0, 0, nullptr };
+    if (frames[depth - 1].context != CONTEXT_SKIP && !child(frames[depth - 1], key, isArray, frame)) return false;
+    frames[depth++] = frame;
+    return true;
+}
+
+bool DeviceJsonReader::endContainer(bool) {
+    if (depth > 0) depth--;
+    return true;
+}
+
+bool DeviceJsonReader::value(const char* key, const JsonStreamValue& value) {
+    if (depth == 0) return false;
+    Frame& frame = frames[depth - 1];
+
+    switch (frame.context) {
+        case CONTEXT_ROOT:
+            if (is(key, "nmd")) copyText(device->nameDevice, value, MAX_DESCRIPTION_LENGTH);
+            else if (is(key, "isl")) device->isSelected = value.asBool();
+            else if (is(key, "adr")) device->adcRateHz = constrain(value.asInt(), ADC_MIN_RATE_HZ, ADC_MAX_RATE_HZ);
+            else if (is(key, "ite")) device->isTimersEnabled = value.asBool();
+            else if (is(key, "iet")) device->isEncyclateTimers = value.asBool();
+            else if (is(key, "ise")) device->isScheduleEnabled = value.asBool();
+            else if (is(key, "iae")) device->isActionEnabled = value.asBool();
+            break;
+
+        case CONTEXT_PINS:
+            if (device->pins.size() >= DEVICE_JSON_MAX_ITEMS) return false;
+            device->pins.push_back(value.asInt());
+            break;
+
+        case CONTEXT_RELAY: {
+            Relay& relay = *static_cast<Relay*>(frame.target);
+            if (is(key, "id")) relay.id = value.asInt();
+            else if (is(key, "pin")) relay.pin = value.asInt();
+            else if (is(key, "man")) relay.manualMode = value.asBool();
+            else if (is(key, "stp")) relay.statePin = value.asBool();
+            else if (is(key, "lst")) relay.lastState = value.asBool();
+            else if (is(key, "out")) relay.isOutput = value.asBool();
+            else if (is(key, "isPwm")) relay.isPwm = value.asBool();
+            else if (is(key, "pwm")) relay.pwm = value.asInt();
+            else if (is(key, "dig")) relay.isDigital = value.asBool();
+            else if (is(key, "dsc")) copyText(relay.description, value, MAX_DESCRIPTION_LENGTH);
+            else if (is(key, "frq")) relay.pwmFrequency = value.asNumber();
+            else if (is(key, "res")) relay.pwmResolution = constrain(value.asInt(), 1, PWM_MAX_RESOLUTION);
+            else if (is(key, "rmp")) relay.pwmRampMs = value.asInt();
+            break;
+        }
+
+        case CONTEXT_SENSOR: {
+            Sensor& sensor = *static_cast<Sensor*>(frame.target);
+            if (is(key, "dsc")) copyText(sensor.description, value, MAX_DESCRIPTION_LENGTH);
+            else if (is(key, "use")) sensor.isUseSetting = value.asBool();
+            else if (is(key, "sid")) sensor.sensorId = value.asInt();
+            else if (is(key, "rid")) sensor.relayId = value.asInt();
+            else if (is(key, "ser")) sensor.serial_r = value.asInt();
+            else if (is(key, "thm")) sensor.thermistor_r = value.asInt();
+            else if (is(key, "flt")) sensor.filter = constrain(value.asInt(), ADC_FILTER_MEAN, ADC_FILTER_RMS);
+            else if (is(key, "bta")) sensor.ntcBeta = value.asNumber();
+            else if (is(key, "sha")) sensor.ntcShA = value.asNumber();
+            else if (is(key, "shb")) sensor.ntcShB = value.asNumber();
+            else if (is(key, "shc")) sensor.ntcShC = value.asNumber();
+            else if (is(key, "nof")) sensor.ntcOffset = value.asNumber();
+            else if (is(key, "exp")) sensor.expression = value.asText();
+            break;
+        }
+
+        case CONTEXT_ACTION: {
+            Action& action = *static_cast<Action*>(frame.target);
+            if (is(key, "dsc")) copyText(action.description, value, MAX_DESCRIPTION_LENGTH);
+            else if (is(key, "use")) action.isUseSetting = value.asBool();
+            else if (is(key, "trd")) action.targetRelayId = value.asInt();
+            else if (is(key, "rmb")) action.relayMustBeOn = value.asBool();
+            else if (is(key, "tsd")) action.targetSensorId = value.asInt();
+            else if (is(key, "tvm")) action.triggerValueMax = value.asNumber();
+            else if (is(key, "tvi")) action.triggerValueMin = value.asNumber();
+            else if (is(key, "hum")) action.isHumidity = value.asBool();
+            else if (is(key, "ame")) action.actionMoreOrEqual = value.asBool();
+            else if (is(key, "irs")) action.isReturnSetting = value.asBool();
+            else if (is(key, "gst")) action.gesture = constrain(value.asInt(), GESTURE_NONE, GESTURE_HOLD_REPEAT);
+            else if (is(key, "msg")) action.sendMsg = value.asText();
+            else if (is(key, "cnd")) action.condition = value.asText();
+            break;
+        }
+
+        case CONTEXT_OUTPUT:
+            setOutPower(*static_cast<OutPower*>(frame.target), key, value);
+            break;
+
+        case CONTEXT_SCHEDULE: {
+            ScheduleScenario& scenario = *static_cast<ScheduleScenario*>(frame.target);
+            if (is(key, "use")) scenario.isUseSetting = value.asBool();
+            else if (is(key, "dsc")) copyText(scenario.description, value, MAX_DESCRIPTION_LENGTH);
+            else if (is(key, "iac")) scenario.isActive = value.asBool();
+            else if (is(key, "sdt")) copyText(scenario.startDate, value, MAX_DATE_LENGTH);
+            else if (is(key, "edt")) copyText(scenario.endDate, value, MAX_DATE_LENGTH);
+            break;
+        }
+
+        case CONTEXT_INTERVAL: {
+            startEndTime& interval = *static_cast<startEndTime*>(frame.target);
+            if (is(key, "stm")) copyText(interval.startTime, value, MAX_TIME_LENGTH);
+            else if (is(key, "etm")) copyText(interval.endTime, value, MAX_TIME_LENGTH);
+            break;
+        }
+
+        case CONTEXT_TEMPERATURE:
+            setTemperature(*static_cast<Temperature*>(frame.target), key, value);
+            break;
+
+        case CONTEXT_PID: {
+            Pid& pid = *static_cast<Pid*>(frame.target);
+            if (is(key, "dsc")) copyText(pid.description, value, MAX_DESCRIPTION_LENGTH);
+            else if (is(key, "Kp")) pid.Kp = value.asNumber();
+            else if (is(key, "Ki")) pid.Ki = value.asNumber();
+            else if (is(key, "Kd")) pid.Kd = value.asNumber();
+            break;
+        }
+
+        case CONTEXT_TIMER: {
+            Timer& timer = *static_cast<Timer*>(frame.target);
+            if (is(key, "use")) timer.isUseSetting = value.asBool();
+            else if (is(key, "tim")) copyText(timer.time, value, MAX_TIME_LENGTH);
+            break;
+        }
+
+        case CONTEXT_BITS:
+            if (frame.count < frame.bitCount) {
+                if (frame.bitCount > 8) {
+                    uint16_t& bits = *static_cast<uint16_t*>(frame.target);
+                    if (value.asBool()) bits |= 1 << frame.count;
+                    else bits &= ~(1 << frame.count);
+                } else {
+                    uint8_t& bits = *static_cast<uint8_t*>(frame.target);
+                    if (value.asBool()) bits |= 1 << frame.count;
+                    else bits &= ~(1 << frame.count);
+                }
+            }
+            frame.count++;
+            break;
+
+        default:
+            break;
+    }
+    return true;
+}
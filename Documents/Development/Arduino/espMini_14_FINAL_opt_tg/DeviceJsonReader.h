@@ -0,0 +1,88 @@
+#ifndef DEVICE_JSON_READER_H
+#define DEVICE_JSON_READER_H
+
+#include <Arduino.h>
+#include "DeviceManager.h"
+#include "JsonStream.h"
+
+// JSON устройства (формат DeviceJsonWriter) кусками прямо в Device, без
+// документа и без копии тела запроса. Ключи и ограничения - как были у
+// разбора через ArduinoJson: присланный список заменяет прежний целиком,
+// отсутствующие поля не трогаются. После finish() устройство нужно
+// скомпилировать (DeviceManager::compileDevice), запись - compileItem.
+
+#define DEVICE_JSON_MAX_ITEMS 128   // записей в одном списке
+
+#if defined(ESP8266)
+#define DEVICE_JSON_MAX_BYTES 32768
+#else
+#define DEVICE_JSON_MAX_BYTES 65536
+#endif
+
+#define DEVICE_PATCH_MAX_BYTES 4096   // тело PATCH /device - одна запись
+
+class DeviceJsonReader : public JsonStreamHandler {
+public:
+    explicit DeviceJsonReader(Device& device) : device(&device), parser(*this) {}
+
+    // Одна запись раздела (PATCH /device): объект с теми же ключами, что
+    // в списке устройства; record - Relay, Sensor, ... по section
+    DeviceJsonReader(DevicePatchSection section, void* record);
+
+    DeviceJsonReader(const DeviceJsonReader&) = delete;
+    DeviceJsonReader& operator=(const DeviceJsonReader&) = delete;
+
+    bool feed(const char* data, size_t length) { return parser.feed(data, length); }
+    bool finish() { return parser.finish(); }
+    JsonStreamError error() const { return parser.error(); }
+    size_t errorOffset() const { return parser.errorOffset(); }
+
+    bool beginContainer(const char* key, bool isArray) override;
+    bool endContainer(bool isArray) override;
+    bool value(const char* key, const JsonStreamValue& value) override;
+
+private:
+    enum Context : uint8_t {
+        CONTEXT_SKIP,
+        CONTEXT_ROOT,
+        CONTEXT_PINS,
+        CONTEXT_RELAYS,
+        CONTEXT_RELAY,
+        CONTEXT_SENSORS,
+        CONTEXT_SENSOR,
+        CONTEXT_ACTIONS,
+        CONTEXT_ACTION,
+        CONTEXT_OUTPUTS,
+        CONTEXT_OUTPUT,
+        CONTEXT_SCHEDULES,
+        CONTEXT_SCHEDULE,
+        CONTEXT_INTERVALS,
+        CONTEXT_INTERVAL,
+        CONTEXT_TEMPERATURE,
+        CONTEXT_ZONES,
+        CONTEXT_PIDS,
+        CONTEXT_PID,
+        CONTEXT_TIMERS,
+        CONTEXT_TIMER,
+        CONTEXT_BITS            // массив флагов "cls", "typ", "wek", "mon"
+    };
+
+    // target - открытая запись; указатель живёт, пока открыт её объект
+    struct Frame {
+        Context context;
+        uint8_t bitCount;
+        uint16_t count;
+        void* target;
+    };
+
+    Device* device;             // nullptr - разбор одной записи
+    JsonStreamParser parser;
+    Frame root;
+    Frame frames[JSON_STREAM_MAX_DEPTH];
+    uint8_t depth = 0;
+
+    bool child(const Frame& parent, const char* key, bool isArray, Frame& frame);
+    static Frame bits(void* target, uint8_t count);   // count > 8 - uint16_t
+};
+
+#endif
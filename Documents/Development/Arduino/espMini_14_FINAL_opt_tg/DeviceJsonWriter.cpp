@@ -0,0 +1,367 @@
+#include "DeviceJsonWriter.h"
+#include <cstring>
+#include <cmath>
+#include <cstdlib>
+
+bool DeviceJsonWriter::writeNext(Print& target) {
+    if (part == PART_DONE) return false;
+    if (!source) {
+        part = PART_DONE;
+        return false;
+    }
+
+    const Device& device = *source;
+    out = &target;
+
+    switch (part) {
+        case PART_HEAD:
+            writeHead(device);
+            part = PART_RELAYS;
+            break;
+        case PART_RELAYS:
+            if (!list("rel", device.relays.size(), device, &DeviceJsonWriter::writeRelay)) part = PART_PIN_LIST;
+            break;
+        case PART_PIN_LIST:
+            writePins("pinL", device);
+            part = PART_SENSORS;
+            break;
+        case PART_SENSORS:
+            if (!list("sen", device.sensors.size(), device, &DeviceJsonWriter::writeSensor)) part = PART_ACTIONS;
+            break;
+        case PART_ACTIONS:
+            if (!list("act", device.actions.size(), device, &DeviceJsonWriter::writeAction)) part = PART_SCHEDULES;
+            break;
+        case PART_SCHEDULES:
+            if (!list("sch", device.scheduleScenarios.size(), device, &DeviceJsonWriter::writeSchedule)) part = PART_TEMPERATURE;
+            break;
+        case PART_TEMPERATURE:
+            key("tmp");
+            writeTemperature(device.temperature());
+            part = PART_ZONES;
+            break;
+        case PART_ZONES:
+            // Зоны - temperatures[1..]
+            if (!list("tzn", device.temperatures.empty() ? 0 : device.temperatures.size() - 1, device, &DeviceJsonWriter::writeZone)) part = PART_PIDS;
+            break;
+        case PART_PIDS:
+            if (!list("pid", device.pids.size(), device, &DeviceJsonWriter::writePid)) part = PART_TIMERS;
+            break;
+        case PART_TIMERS:
+            if (!list("tmr", device.timers.size(), device, &DeviceJsonWriter::writeTimer)) part = PART_TAIL;
+            break;
+        case PART_TAIL:
+            writeTail(device);
+            part = PART_DONE;
+            break;
+        case PART_DONE:
+            break;
+    }
+
+    out = nullptr;
+    return true;
+}
+
+size_t DeviceJsonWriter::read(uint8_t* buffer, size_t maxLen) {
+    size_t used = 0;
+
+    while (used < maxLen) {
+        if (pending.offset == pending.data.size()) {
+            // Ёмкость остаётся от самого длинного шага и больше не растёт
+            pending.data.clear();
+            pending.offset = 0;
+            if (!writeNext(pending)) break;
+            continue;
+        }
+        size_t chunk = min(maxLen - used, pending.data.size() - pending.offset);
+        memcpy(buffer + used, pending.data.data() + pending.offset, chunk);
+        pending.offset += chunk;
+        used += chunk;
+    }
+
+    return used;
+}
+
+// Ключ и за ним одна запись за шаг; false - список закрыт
+bool DeviceJsonWriter::list(const char* name, size_t count, const Device& device,
+                            void (DeviceJsonWriter::*writeItem)(const Device&, size_t)) {
+    if (item == 0) open(name, '[');
+    if (item < count) {
+        (this->*writeItem)(device, item);
+        item++;
+        if (item < count) return true;
+    }
+    close(']');
+    item = 0;
+    return false;
+}
+
+void DeviceJsonWriter::writeHead(const Device& device) {
+    open(nullptr, '{');
+    text("nmd", device.nameDevice);
+    flag("isl", device.isSelected);
+    unsignedNumber("adr", device.adcRateHz);
+    writePins("pins", device);
+}
+
+void DeviceJsonWriter::writeRelay(const Device& device, size_t i) {
+    const Relay& relay = device.relays[i];
+    open(nullptr, '{');
+    number("id", relay.id);
+    unsignedNumber("pin", relay.pin);
+    flag("man", relay.manualMode);
+    flag("stp", relay.statePin);
+    flag("out", relay.isOutput);
+    flag("dig", relay.isDigital);
+    flag("lst", relay.lastState);
+    text("dsc", relay.description);
+    unsignedNumber("frq", relay.pwmFrequency);
+    unsignedNumber("res", relay.pwmResolution);
+    unsignedNumber("rmp", relay.pwmRampMs);
+    close('}');
+}
+
+void DeviceJsonWriter::writeSensor(const Device& device, size_t i) {
+    const Sensor& sensor = device.sensors[i];
+    open(nullptr, '{');
+    text("dsc", sensor.description);
+    flag("use", sensor.isUseSetting);
+    number("sid", sensor.sensorId);
+    number("rid", sensor.relayId);
+    bits("typ", sensor.typeSensor.bits, 7);
+    unsignedNumber("ser", sensor.serial_r);
+    unsignedNumber("thm", sensor.thermistor_r);
+    unsignedNumber("flt", sensor.filter);
+    if (sensor.typeSensor.get(2)) {
+        real("bta", sensor.ntcBeta);
+        real("sha", sensor.ntcShA);
+        real("shb", sensor.ntcShB);
+        real("shc", sensor.ntcShC);
+        real("nof", sensor.ntcOffset);
+    }
+    if (sensor.typeSensor.get(5)) {
+        text("exp", sensor.expression.c_str());
+    }
+    close('}');
+}
+
+void DeviceJsonWriter::writeAction(const Device& device, size_t i) {
+    const Action& action = device.actions[i];
+    open(nullptr, '{');
+    text("dsc", action.description);
+    flag("use", action.isUseSetting);
+    number("trd", action.targetRelayId);
+    flag("rmb", action.relayMustBeOn);
+    number("tsd", action.targetSensorId);
+    real("tvm", action.triggerValueMax);
+    real("tvi", action.triggerValueMin);
+    flag("hum", action.isHumidity);
+    flag("ame", action.actionMoreOrEqual);
+    flag("irs", action.isReturnSetting);
+    unsignedNumber("gst", action.gesture);
+    text("msg", action.sendMsg.c_str());
+    text("cnd", action.condition.c_str());
+    bits("cls", action.collectionSettings.bits, 4);
+
+    open("outL", '[');
+    for (const auto& output : action.outputs) {
+        writeOutPower(nullptr, output, true);
+    }
+    close(']');
+    close('}');
+}
+
+void DeviceJsonWriter::writeSchedule(const Device& device, size_t i) {
+    const ScheduleScenario& scenario = device.scheduleScenarios[i];
+    open(nullptr, '{');
+    flag("use", scenario.isUseSetting);
+    text("dsc", scenario.description);
+    flag("iac", scenario.isActive);
+    bits("cls", scenario.collectionSettings.bits, 4);
+    text("sdt", scenario.startDate);
+    text("edt", scenario.endDate);
+
+    open("set", '[');
+    for (const auto& interval : scenario.startEndTimes) {
+        open(nullptr, '{');
+        text("stm", interval.startTime);
+        text("etm", interval.endTime);
+        close('}');
+    }
+    close(']');
+
+    bits("wek", scenario.week.bits, 7);
+    bits("mon", scenario.months.bits, 12);
+    writeOutPower("isr", scenario.initialStateRelay, false);
+    writeOutPower("esr", scenario.endStateRelay, false);
+    close('}');
+}
+
+void DeviceJsonWriter::writeZone(const Device& device, size_t i) {
+    key(nullptr);
+    writeTemperature(device.temperatures[i + 1]);
+}
+
+void DeviceJsonWriter::writePid(const Device& device, size_t i) {
+    const Pid& pid = device.pids[i];
+    open(nullptr, '{');
+    text("dsc", pid.description);
+    real("Kp", pid.Kp);
+    real("Ki", pid.Ki);
+    real("Kd", pid.Kd);
+    close('}');
+}
+
+void DeviceJsonWriter::writeTimer(const Device& device, size_t i) {
+    const Timer& timer = device.timers[i];
+    open(nullptr, '{');
+    flag("use", timer.isUseSetting);
+    text("tim", timer.time);
+    bits("cls", timer.collectionSettings.bits, 4);
+    writeOutPower("isr", timer.initialStateRelay, false);
+    writeOutPower("esr", timer.endStateRelay, false);
+    close('}');
+}
+
+void DeviceJsonWriter::writeTail(const Device& device) {
+    flag("ite", device.isTimersEnabled);
+    flag("iet", device.isEncyclateTimers);
+    flag("ise", device.isScheduleEnabled);
+    flag("iae", device.isActionEnabled);
+    close('}');
+}
+
+// Ключ (или разделитель элемента массива) уже записан
+void DeviceJsonWriter::writeTemperature(const Temperature& temperature) {
+    out->write('{');
+    first = true;
+    flag("use", temperature.isUseSetting);
+    unsignedNumber("rid", temperature.relayId);
+    flag("lst", temperature.lastState);
+    unsignedNumber("sid", temperature.sensorId);
+    real("stT", temperature.setTemperature);
+    real("ctp", temperature.currentTemp);
+    flag("smt", temperature.isSmoothly);
+    flag("inc", temperature.isIncrease);
+    bits("cls", temperature.collectionSettings.bits, 4);
+    number("spi", temperature.selectedPidIndex);
+    close('}');
+}
+
+void DeviceJsonWriter::writeOutPower(const char* name, const OutPower& power, bool withReturn) {
+    open(name, '{');
+    flag("use", power.isUseSetting);
+    unsignedNumber("rid", power.relayId);
+    flag("stp", power.statePin);
+    flag("lst", power.lastState);
+    if (withReturn) flag("rtn", power.isReturn);
+    close('}');
+}
+
+void DeviceJsonWriter::writePins(const char* name, const Device& device) {
+    open(name, '[');
+    for (uint8_t pin : device.pins) {
+        unsignedNumber(nullptr, pin);
+    }
+    close(']');
+}
+
+// name == nullptr - элемент массива, только разделитель
+void DeviceJsonWriter::key(const char* name) {
+    if (!first) out->write(',');
+    first = false;
+    if (name == nullptr) return;
+    out->write('"');
+    out->write((const uint8_t*)name, strlen(name));
+    out->write((const uint8_t*)"\":", 2);
+}
+
+void DeviceJsonWriter::open(const char* name, char bracket) {
+    key(name);
+    out->write(bracket);
+    first = true;
+}
+
+void DeviceJsonWriter::close(char bracket) {
+    out->write(bracket);
+    first = false;
+}
+
+void DeviceJsonWriter::flag(const char* name, bool value) {
+    key(name);
+    out->write(value ? '1' : '0');
+}
+
+void DeviceJsonWriter::number(const char* name, long value) {
+    char buffer[12];
+    key(name);
+    out->write((const uint8_t*)buffer, snprintf(buffer, sizeof(buffer), "%ld", value));
+}
+
+void DeviceJsonWriter::unsignedNumber(const char* name, unsigned long value) {
+    char buffer[12];
+    key(name);
+    out->write((const uint8_t*)buffer, snprintf(buffer, sizeof(buffer), "%lu", value));
+}
+
+// Кратчайшая запись, которая читается обратно без потерь: 22.1, а не 22.1000004.
+// NaN и бесконечность в JSON не записать - null, как у ArduinoJson.
+void DeviceJsonWriter::real(const char* name, float value) {
+    char buffer[24];
+    key(name);
+    if (std::isnan(value) || std::isinf(value)) {
+        out->write((const uint8_t*)"null", 4);
+        return;
+    }
+    int length = snprintf(buffer, sizeof(buffer), "%.7g", value);
+    if (strtof(buffer, nullptr) != value) length = snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out->write((const uint8_t*)buffer, length);
+}
+
+void DeviceJsonWriter::real(const char* name, double value) {
+    char buffer[32];
+    key(name);
+    if (std::isnan(value) || std::isinf(value)) {
+        out->write((const uint8_t*)"null", 4);
+        return;
+    }
+    int length = snprintf(buffer, sizeof(buffer), "%.15g", value);
+    if (strtod(buffer, nullptr) != value) length = snprintf(buffer, sizeof(buffer), "%.17g", value);
+    out->write((const uint8_t*)buffer, length);
+}
+
+void DeviceJsonWriter::text(const char* name, const char* value) {
+    key(name);
+    out->write('"');
+
+    const char* run = value;
+    for (const char* p = value; *p; p++) {
+        uint8_t c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        out->write((const uint8_t*)run, p - run);
+        run = p + 1;
+
+        char escape[7];
+        switch (c) {
+            case '"':  strcpy(escape, "\\\""); break;
+            case '\\': strcpy(escape, "\\\\"); break;
+            case '\b': strcpy(escape, "\\b"); break;
+            case '\f': strcpy(escape, "\\f"); break;
+            case '\n': strcpy(escape, "\\n"); break;
+            case '\r': strcpy(escape, "\\r"); break;
+            case '\t': strcpy(escape, "\\t"); break;
+            default:   snprintf(escape, sizeof(escape), "\\u%04x", c); break;
+        }
+        out->write((const uint8_t*)escape, strlen(escape));
+    }
+    out->write((const uint8_t*)run, strlen(run));
+    out->write('"');
+}
+
+void DeviceJsonWriter::bits(const char* name, uint16_t value, uint8_t count) {
+    open(name, '[');
+    for (uint8_t i = 0; i < count; i++) {
+        flag(nullptr, (value >> i) & 1);
+    }
+    close(']');
+}
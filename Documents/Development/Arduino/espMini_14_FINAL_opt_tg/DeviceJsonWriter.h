@@ -0,0 +1,94 @@
+#ifndef DEVICE_JSON_WRITER_H
+#define DEVICE_JSON_WRITER_H
+
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+#include "DeviceManager.h"
+
+// JSON устройства с короткими ключами ("nmd", "rel", "sen", ...) прямо из
+// структур, без документа: за один шаг пишется заголовок, одна запись списка
+// или хвост. Память - одна запись, размер конфигурации не ограничен.
+// Логические значения сразу 0/1, как ждёт интерфейс.
+//
+// Устройство - из снимка конфигурации (DeviceManager::configSnapshot): писатель
+// держит его до конца ответа, весь документ - из одной версии.
+
+class DeviceJsonWriter {
+public:
+    explicit DeviceJsonWriter(std::shared_ptr<const Device> device) : source(std::move(device)) {}
+
+    DeviceJsonWriter(const DeviceJsonWriter&) = delete;
+    DeviceJsonWriter& operator=(const DeviceJsonWriter&) = delete;
+
+    // Следующий шаг в out; false - документ закончен
+    bool writeNext(Print& out);
+    // Весь документ: File, AsyncResponseStream
+    void writeTo(Print& out) { while (writeNext(out)) {} }
+    // Для beginChunkedResponse: до maxLen байт, 0 - конец
+    size_t read(uint8_t* buffer, size_t maxLen);
+
+private:
+    enum Part : uint8_t {
+        PART_HEAD,
+        PART_RELAYS,
+        PART_PIN_LIST,
+        PART_SENSORS,
+        PART_ACTIONS,
+        PART_SCHEDULES,
+        PART_TEMPERATURE,
+        PART_ZONES,
+        PART_PIDS,
+        PART_TIMERS,
+        PART_TAIL,
+        PART_DONE
+    };
+
+    // Остаток шага, не влезший в кусок ответа
+    class Pending : public Print {
+    public:
+        std::vector<uint8_t> data;
+        size_t offset = 0;
+        size_t write(uint8_t c) override { data.push_back(c); return 1; }
+        size_t write(const uint8_t* buffer, size_t size) override {
+            data.insert(data.end(), buffer, buffer + size);
+            return size;
+        }
+    };
+
+    std::shared_ptr<const Device> source;
+    Part part = PART_HEAD;
+    size_t item = 0;
+    Pending pending;
+
+    Print* out = nullptr;
+    bool first = true;   // в текущем объекте или массиве ещё нет элементов
+
+    bool list(const char* key, size_t count, const Device& device, void (DeviceJsonWriter::*writeItem)(const Device&, size_t));
+    void writeHead(const Device& device);
+    void writeRelay(const Device& device, size_t i);
+    void writeSensor(const Device& device, size_t i);
+    void writeAction(const Device& device, size_t i);
+    void writeSchedule(const Device& device, size_t i);
+    void writeZone(const Device& device, size_t i);
+    void writePid(const Device& device, size_t i);
+    void writeTimer(const Device& device, size_t i);
+    void writeTail(const Device& device);
+
+    void writeTemperature(const Temperature& temperature);
+    void writeOutPower(const char* key, const OutPower& power, bool withReturn);
+    void writePins(const char* key, const Device& device);
+
+    void key(const char* name);
+    void open(const char* name, char bracket);
+    void close(char bracket);
+    void flag(const char* name, bool value);
+    void number(const char* name, long value);
+    void unsignedNumber(const char* name, unsigned long value);
+    void real(const char* name, float value);
+    void real(const char* name, double value);
+    void text(const char* name, const char* value);
+    void bits(const char* name, uint16_t value, uint8_t count);
+};
+
+#endif
@@ -1,5 +1,9 @@
 #include "DeviceManager.h"
+#include "DeviceConfigFile.h"
+#include "DeviceJsonReader.h"
 #include <cstring>
+#include <new>
+#include <algorithm>
 
 DeviceManager::DeviceManager(AppState& appState)
     : appState(appState)
@@ -105,6 +109,7 @@ void DeviceManager::initializeDevice(const char* name, bool activ, bool isNewDev
   currentSensor.relayId = 5;
   currentSensor.typeSensor.clear();
   currentSensor.typeSensor.set(4, true);
+  currentSensor.filter = ADC_FILTER_RMS;
   currentSensor.serial_r = 20000;
   currentSensor.thermistor_r = 10000;
   currentSensor.currentValue = 0.0;
@@ -171,22 +176,23 @@ void DeviceManager::initializeDevice(const char* name, bool activ, bool isNewDev
   scenario.endStateRelay.pwm = 0;
   scenario.endStateRelay.isReturn = false;
 
+  compileSchedule(scenario);
   newDevice.scheduleScenarios.push_back(scenario);
 
-  newDevice.temperature.isUseSetting = false;
-  newDevice.temperature.relayId = newDevice.relays[0].id;
-  newDevice.temperature.lastState = false;
-  newDevice.temperature.sensorId = dhtSensor.sensorId;
-  newDevice.temperature.setTemperature = 22;
-  newDevice.temperature.currentTemp = 0.0;
-  newDevice.temperature.isSmoothly = false;
-  newDevice.temperature.isIncrease = true;
-  newDevice.temperature.collectionSettings.clear();
-  newDevice.temperature.collectionSettings.set(0, true);
-  newDevice.temperature.selectedPidIndex = 0;
-  newDevice.temperature.pidOutputMs = 0;
-  newDevice.temperature.sensorPtr = nullptr;
-  newDevice.temperature.relayPtr = nullptr;
+  newDevice.temperature().isUseSetting = false;
+  newDevice.temperature().relayId = newDevice.relays[0].id;
+  newDevice.temperature().lastState = false;
+  newDevice.temperature().sensorId = dhtSensor.sensorId;
+  newDevice.temperature().setTemperature = 22;
+  newDevice.temperature().currentTemp = 0.0;
+  newDevice.temperature().isSmoothly = false;
+  newDevice.temperature().isIncrease = true;
+  newDevice.temperature().collectionSettings.clear();
+  newDevice.temperature().collectionSettings.set(0, true);
+  newDevice.temperature().selectedPidIndex = 0;
+  newDevice.temperature().pidOutputMs = 0;
+  newDevice.temperature().sensorPtr = nullptr;
+  newDevice.temperature().relayPtr = nullptr;
 
   Pid pid1, pid2, pid3;
 
@@ -231,680 +237,526 @@ void DeviceManager::initializeDevice(const char* name, bool activ, bool isNewDev
   timer.endStateRelay.pwm = 0;
   timer.endStateRelay.isReturn = false;
 
-  newDevice.timers.push_back(timer);}
+  newDevice.timers.push_back(timer);
 
-String DeviceManager::serializeDevice(const Device& device, const char* fileName, AsyncWebServerRequest *request) {
+  buildRuntimePlan(newDevice);}
 
-  appState.isProcessWorkingJson = true;
+void DeviceManager::compileSchedule(ScheduleScenario& scenario) {
+  CompiledSchedule& compiled = scenario.compiled;
 
-  DynamicJsonDocument doc(SIZE_JSON_S);
+  compiled.setDates(scenario.startDate, scenario.endDate);
+  compiled.weekMask = scenario.week.bits & 0x7F;
+  compiled.monthMask = scenario.months.bits & 0xFFF;
 
-    if (strlen(device.nameDevice) > 0) {
-        doc["nmd"] = device.nameDevice;
-    } else {
-        doc["nmd"] = "";
-    }
-    doc["isl"] = device.isSelected;
-
-     JsonArray pins = doc.createNestedArray("pins");
-  for (const auto& pin : device.pins) {
-    pins.add(pin);
-  }
-
-    JsonArray rel = doc.createNestedArray("rel");
-    for (const auto& relay : device.relays) {
-        JsonObject relayObj = rel.createNestedObject();
-        relayObj["id"] = relay.id;
-        relayObj["pin"] = relay.pin;
-        relayObj["man"] = relay.manualMode;
-        relayObj["stp"] = relay.statePin;
-        relayObj["out"] = relay.isOutput;
-        relayObj["dig"] = relay.isDigital;
-        relayObj["lst"] = relay.lastState;
-        relayObj["dsc"] = relay.description;
+  compiled.intervals.clear();
+  compiled.intervals.reserve(scenario.startEndTimes.size());
+  for (const auto& timePeriod : scenario.startEndTimes) {
+    if (!compiled.addInterval(timePeriod.startTime, timePeriod.endTime)) {
+      Serial.printf("[Schedule] Invalid time interval '%s-%s' in scenario '%s'. Skipping.\n",
+                    timePeriod.startTime, timePeriod.endTime, scenario.description);
     }
+  }
 
-    JsonArray pinL = doc.createNestedArray("pinL");
-    for (const auto& pin : device.pins) {
-        pinL.add(pin);
-    }
+  compiled.invalidate();
+}
 
-    JsonArray sen = doc.createNestedArray("sen");
-    for (const auto& sensor : device.sensors) {
-        JsonObject sensorObj = sen.createNestedObject();
+void DeviceManager::compileSensor(Sensor& sensor) {
+  if (!sensor.typeSensor.get(2)) {
+    sensor.ntcTable.y.clear();
+    return;
+  }
 
-        sensorObj["dsc"] =  sensor.description;
-        sensorObj["use"] = sensor.isUseSetting;
-        sensorObj["sid"] = sensor.sensorId;
-        sensorObj["rid"] = sensor.relayId;
+  NtcParams params = { sensor.serial_r, sensor.thermistor_r, sensor.ntcBeta,
+                       sensor.ntcShA, sensor.ntcShB, sensor.ntcShC, sensor.ntcOffset };
+  NtcModel::buildTable(params, ADC_FULL_SCALE_MV, sensor.ntcTable);
 
-        JsonArray typ = sensorObj.createNestedArray("typ");
-        for (int i = 0; i < 7; i++) {
-            typ.add(sensor.typeSensor.get(i));
-        }
+  if (sensor.ntcTable.empty()) {
+    Serial.printf("[Sensor] Invalid NTC parameters in sensor '%s'. Sensor disabled.\n", sensor.description);
+  }
+}
 
-        sensorObj["ser"] = sensor.serial_r;
-        sensorObj["thm"] = sensor.thermistor_r;
+// "Ч:М:С" с необязательными долями секунды ("00:00:01.250")
+void DeviceManager::compileTimer(Timer& timer) {
+  unsigned hours, minutes, seconds;
+  int consumed = 0;
+  uint32_t durationMs = 0;
+
+  if (sscanf(timer.time, "%u:%u:%u%n", &hours, &minutes, &seconds, &consumed) == 3 && minutes < 60 && seconds < 60) {
+    durationMs = (hours * 3600UL + minutes * 60UL + seconds) * 1000UL;
+    const char* fraction = timer.time + consumed;
+    if (*fraction == '.') {
+      uint32_t scale = 100;
+      for (fraction++; *fraction >= '0' && *fraction <= '9' && scale > 0; fraction++, scale /= 10) {
+        durationMs += (*fraction - '0') * scale;
+      }
     }
+  } else {
+    Serial.printf("[Timer] Invalid duration '%s'.\n", timer.time);
+  }
 
-    JsonArray act = doc.createNestedArray("act");
-    for (const auto& action : device.actions) {
-        JsonObject actionObj = act.createNestedObject();
-
-        actionObj["dsc"] = action.description;
-        actionObj["use"] = action.isUseSetting;
-        actionObj["trd"] = action.targetRelayId;
-        actionObj["rmb"] = action.relayMustBeOn;
-        actionObj["tsd"] = action.targetSensorId;
-        actionObj["tvm"] = action.triggerValueMax;
-        actionObj["tvi"] = action.triggerValueMin;
-        actionObj["hum"] = action.isHumidity;
-        actionObj["ame"] = action.actionMoreOrEqual;
-        actionObj["irs"] = action.isReturnSetting;
-        actionObj["msg"] = action.sendMsg;
-
-        JsonArray cls = actionObj.createNestedArray("cls");
-        for (int i = 0; i < 4; i++) {
-            cls.add(action.collectionSettings.get(i));
-        }
+  // Нулевой шаг в цикличной последовательности крутил бы задачу управления вхолостую
+  timer.durationMs = max(durationMs, (uint32_t)TIMER_MIN_STEP_MS);
+}
 
-        JsonArray outL = actionObj.createNestedArray("outL");
-        for (const auto& output : action.outputs) {
-            JsonObject outputObj = outL.createNestedObject();
-            outputObj["use"] = output.isUseSetting;
-            outputObj["rid"] = output.relayId;
-            outputObj["stp"] = output.statePin;
-            outputObj["lst"] = output.lastState;
-            outputObj["rtn"] = output.isReturn;
+void DeviceManager::saveRelayStates(uint8_t targetRelayId) {
+  for (auto& device : myDevices) {
 
-        }
+    Relay* relay = findRelayById(device, targetRelayId);
+    if (relay) {
+      relay->lastState = relay->statePin;
     }
 
-    JsonArray sch = doc.createNestedArray("sch");
-    for (const auto& scenario : device.scheduleScenarios) {
-        JsonObject scenarioObj = sch.createNestedObject();
-        scenarioObj["use"] = scenario.isUseSetting;
-        scenarioObj["dsc"] = scenario.description;
-        scenarioObj["iac"] = scenario.isActive;
-
-        JsonArray cls = scenarioObj.createNestedArray("cls");
-        for (int i = 0; i < 4; i++) {
-            cls.add(scenario.collectionSettings.get(i));
-        }
-
-        scenarioObj["sdt"] = scenario.startDate;
-        scenarioObj["edt"] = scenario.endDate;
-
-        JsonArray set = scenarioObj.createNestedArray("set");
-        for (const auto& timeInterval : scenario.startEndTimes) {
-            JsonObject intervalObj = set.createNestedObject();
-            intervalObj["stm"] = timeInterval.startTime;
-            intervalObj["etm"] = timeInterval.endTime;
-        }
-
-        JsonArray wek = scenarioObj.createNestedArray("wek");
-        for (int i = 0; i < 7; i++) {
-            wek.add(scenario.week.get(i));
-        }
-
-        JsonArray mon = scenarioObj.createNestedArray("mon");
-        for (int i = 0; i < 12; i++) {
-            mon.add(scenario.months.get(i));
-        }
-
-        JsonObject isr = scenarioObj.createNestedObject("isr");
-        isr["use"] = scenario.initialStateRelay.isUseSetting;
-        isr["rid"] = scenario.initialStateRelay.relayId;
-        isr["stp"] = scenario.initialStateRelay.statePin;
-        isr["lst"] = scenario.initialStateRelay.lastState;
-
-        JsonObject esr = scenarioObj.createNestedObject("esr");
-        esr["use"] = scenario.endStateRelay.isUseSetting;
-        esr["rid"] = scenario.endStateRelay.relayId;
-        esr["stp"] = scenario.endStateRelay.statePin;
-        esr["lst"] = scenario.endStateRelay.lastState;
-
+    for (auto& temperature : device.temperatures) {
+      if (temperature.relayId == targetRelayId && relay) {
+        temperature.lastState = relay->statePin;
+      }
     }
 
-    JsonObject tmp = doc.createNestedObject("tmp");
-    tmp["use"] = device.temperature.isUseSetting;
-    tmp["rid"] = device.temperature.relayId;
-    tmp["lst"] = device.temperature.lastState;
-    tmp["sid"] = device.temperature.sensorId;
-    tmp["stT"] = device.temperature.setTemperature;
-    tmp["ctp"] = device.temperature.currentTemp;
-    tmp["smt"] = device.temperature.isSmoothly;
-    tmp["inc"] = device.temperature.isIncrease;
-
-    JsonArray tempCls = tmp.createNestedArray("cls");
-    for (int i = 0; i < 4; i++) {
-        tempCls.add(device.temperature.collectionSettings.get(i));
+    for (auto& timer : device.timers) {
+      if (timer.initialStateRelay.relayId == targetRelayId) {
+        timer.initialStateRelay.lastState = relay ? relay->statePin : false;
+      }
+      if (timer.endStateRelay.relayId == targetRelayId) {
+        timer.endStateRelay.lastState = relay ? relay->statePin : false;
+      }
     }
 
-    tmp["spi"] = device.temperature.selectedPidIndex;
-
-    JsonArray pid = doc.createNestedArray("pid");
-    for (const auto& pid_item : device.pids) {
-        JsonObject pidObject = pid.createNestedObject();
-        pidObject["dsc"] = pid_item.description;
-        pidObject["Kp"] = pid_item.Kp;
-        pidObject["Ki"] = pid_item.Ki;
-        pidObject["Kd"] = pid_item.Kd;
+    for (auto& scenario : device.scheduleScenarios) {
+      if (scenario.initialStateRelay.relayId == targetRelayId) {
+        scenario.initialStateRelay.lastState = relay ? relay->statePin : false;
+      }
+      if (scenario.endStateRelay.relayId == targetRelayId) {
+        scenario.endStateRelay.lastState = relay ? relay->statePin : false;
+      }
     }
+  }
+}
 
-    JsonArray tmr = doc.createNestedArray("tmr");
-    for (const auto& timer : device.timers) {
-        JsonObject timerObj = tmr.createNestedObject();
-        timerObj["use"] = timer.isUseSetting;
-        timerObj["tim"] = timer.time;
-
-        JsonArray cls = timerObj.createNestedArray("cls");
-        for (int i = 0; i < 4; i++) {
-            cls.add(timer.collectionSettings.get(i));
-        }
-
-        JsonObject isr = timerObj.createNestedObject("isr");
-        isr["use"] = timer.initialStateRelay.isUseSetting;
-        isr["rid"] = timer.initialStateRelay.relayId;
-        isr["stp"] = timer.initialStateRelay.statePin;
-        isr["lst"] = timer.initialStateRelay.lastState;
-
-        JsonObject esr = timerObj.createNestedObject("esr");
-        esr["use"] = timer.endStateRelay.isUseSetting;
-        esr["rid"] = timer.endStateRelay.relayId;
-        esr["stp"] = timer.endStateRelay.statePin;
-        esr["lst"] = timer.endStateRelay.lastState;
+void DeviceManager::restoreRelayStates(uint8_t targetRelayId) {
+  for (auto& device : myDevices) {
 
+    Relay* relay = findRelayById(device, targetRelayId);
+    if (relay) {
+      relay->statePin = relay->lastState;
     }
 
-    doc["ite"] = device.isTimersEnabled;
-    doc["iet"] = device.isEncyclateTimers;
-    doc["ise"] = device.isScheduleEnabled;
-    doc["iae"] = device.isActionEnabled;
-
-    convertBooleansToIntegers(doc);
-
-    if (request != nullptr) {
-
-      AsyncResponseStream *response = request->beginResponseStream("application/json");
-        serializeJson(doc, *response);
-        request->send(response);
-        appState.isProcessWorkingJson = false;
-        return "sending";
+    for (auto& temperature : device.temperatures) {
+      if (temperature.relayId == targetRelayId && relay) {
+        relay->statePin = temperature.lastState;
+      }
     }
 
-    if (fileName != nullptr) {
-
-    String jsonString;
-    serializeJson(doc, jsonString);
-
-    File file = SPIFFS.open(fileName, "w");
-    if (!file) {
-      appState.isProcessWorkingJson = false;
-      return "error";
+    for (auto& timer : device.timers) {
+      if (timer.initialStateRelay.relayId == targetRelayId) {
+        if (relay) {
+          relay->statePin = timer.initialStateRelay.lastState;
+        }
+      }
+      if (timer.endStateRelay.relayId == targetRelayId) {
+        if (relay) {
+          relay->statePin = timer.endStateRelay.lastState;
+        }
+      }
     }
-    if (file.print(jsonString) == 0) {
-      file.close();
 
-      appState.isProcessWorkingJson = false;
-      return "error";
+    for (auto& scenario : device.scheduleScenarios) {
+      if (scenario.initialStateRelay.relayId == targetRelayId) {
+        if (relay) {
+          relay->statePin = scenario.initialStateRelay.lastState;
+        }
+      }
+      if (scenario.endStateRelay.relayId == targetRelayId) {
+        if (relay) {
+          relay->statePin = scenario.endStateRelay.lastState;
+        }
+      }
     }
-    file.println();
-    file.close();
-
-    appState.isProcessWorkingJson = false;
-    return "success";
   }
-
-  String jsonString;
-  serializeJson(doc, jsonString);
-
-  appState.isProcessWorkingJson = false;
-  return jsonString;
 }
 
-void DeviceManager::convertBooleansToIntegers(JsonVariant variant) {
-  if (variant.is<JsonObject>()) {
-    JsonObject obj = variant.as<JsonObject>();
-    for (JsonPair kv : obj) {
-      convertBooleansToIntegers(kv.value());
+// Компилятор выражений разрешает id через таблицы плана
+struct PlanExpressionResolver : ExpressionResolver {
+  const RuntimePlan& plan;
+  explicit PlanExpressionResolver(const RuntimePlan& target) : plan(target) {}
+  int16_t sensorIndex(int id) const override { return plan.sensorIndex(id); }
+  int16_t relayIndex(int id) const override { return plan.relayIndex(id); }
+};
+
+void DeviceManager::buildRuntimePlan(Device& device) {
+  RuntimePlan& plan = device.plan;
+  plan.clear();
+
+  plan.inputSensorIndex.assign(device.relays.size(), PLAN_NO_INDEX);
+  plan.pinUsable.assign(device.relays.size(), false);
+
+  uint64_t usedPins = 0;
+  for (size_t i = 0; i < device.relays.size(); i++) {
+    const Relay& relay = device.relays[i];
+    plan.mapId(plan.relayIndexById, relay.id, i, PLAN_DUPLICATE_RELAY_ID);
+
+    if (relay.pin >= 64 || (usedPins & (1ULL << relay.pin))) {
+      plan.addIssue(PLAN_PIN_CONFLICT, relay.id, -1, relay.pin);
+      continue;
     }
-  } else if (variant.is<JsonArray>()) {
-    JsonArray arr = variant.as<JsonArray>();
-    for (JsonVariant elem : arr) {
-      convertBooleansToIntegers(elem);
+    usedPins |= (1ULL << relay.pin);
+
+    if (!relay.isOutput && std::find(device.pins.begin(), device.pins.end(), relay.pin) == device.pins.end()) {
+      plan.addIssue(PLAN_PIN_NOT_ALLOWED, relay.id, -1, relay.pin);
+      continue;
     }
-  } else if (variant.is<bool>()) {
-    variant.set(variant.as<bool>() ? 1 : 0);
+    plan.pinUsable[i] = true;
   }
-}
 
-bool DeviceManager::deserializeDevice(JsonObject doc, Device& device) {
+  for (size_t i = 0; i < device.sensors.size(); i++) {
+    Sensor& sensor = device.sensors[i];
+    plan.mapId(plan.sensorIndexById, sensor.sensorId, i, PLAN_DUPLICATE_SENSOR_ID);
 
- appState.isProcessWorkingJson = true;
- 
- if (doc.containsKey("nmd")) {
-        strncpy_safe(device.nameDevice, doc["nmd"], MAX_DESCRIPTION_LENGTH);
-      }
+    sensor.inputRelayIndex = PLAN_NO_INDEX;
+    sensor.inputPin = 0;
+    // Виртуальный сенсор ни к какому входу не привязан
+    if (sensor.typeSensor.get(5)) continue;
 
-  if (doc.containsKey("isl")) {
-    device.isSelected = doc["isl"].as<bool>();
-  }
-
-  if (doc.containsKey("rel")) {
-    device.relays.clear();
-    JsonArray relays = doc["rel"];
-    device.relays.reserve(relays.size());
-    for (JsonObject relayObj : relays) {
-      Relay relay;
-      if (relayObj.containsKey("id")) relay.id = relayObj["id"].as<int>();
-      if (relayObj.containsKey("pin")) relay.pin = relayObj["pin"].as<uint8_t>();
-      if (relayObj.containsKey("man")) relay.manualMode = relayObj["man"].as<bool>();
-      if (relayObj.containsKey("stp")) relay.statePin = relayObj["stp"].as<bool>();
-      if (relayObj.containsKey("lst")) relay.lastState = relayObj["lst"].as<bool>();
-      if (relayObj.containsKey("out")) relay.isOutput = relayObj["out"].as<bool>();
-      if (relayObj.containsKey("isPwm")) relay.isPwm = relayObj["isPwm"].as<bool>();
-      if (relayObj.containsKey("pwm")) relay.pwm = relayObj["pwm"].as<uint8_t>();
-      if (relayObj.containsKey("dig")) relay.isDigital = relayObj["dig"].as<bool>();
-      if (relayObj.containsKey("dsc")) {
-        strncpy_safe(relay.description, relayObj["dsc"], MAX_DESCRIPTION_LENGTH);
-      }
-      device.relays.push_back(relay);
+    sensor.inputRelayIndex = plan.relayIndex(sensor.relayId);
+
+    if (sensor.inputRelayIndex == PLAN_NO_INDEX || device.relays[sensor.inputRelayIndex].isOutput) {
+      sensor.inputRelayIndex = PLAN_NO_INDEX;
+      plan.addIssue(PLAN_SENSOR_RELAY_MISSING, sensor.sensorId, sensor.relayId);
+      continue;
     }
-  }
 
-  if (doc.containsKey("pinL")) {
-    device.pins.clear();
-    JsonArray pins = doc["pinL"];
-    device.pins.reserve(pins.size());
-    for (JsonVariant pin : pins) {
-      device.pins.push_back(pin.as<uint8_t>());
+    sensor.inputPin = device.relays[sensor.inputRelayIndex].pin;
+    if (plan.inputSensorIndex[sensor.inputRelayIndex] == PLAN_NO_INDEX) {
+      plan.inputSensorIndex[sensor.inputRelayIndex] = i;
     }
   }
 
-  if (doc.containsKey("sen")) {
-    JsonArray sensorsJson = doc["sen"];
-    std::vector<Sensor> newSensors;
-    newSensors.reserve(sensorsJson.size());
-
-    for (JsonObject sensorObj : sensorsJson) {
-      Sensor sensor;
-
-      if (sensorObj.containsKey("dsc")) {
-        strncpy_safe(sensor.description, sensorObj["dsc"], MAX_DESCRIPTION_LENGTH);
-      }
-      if (sensorObj.containsKey("use")) sensor.isUseSetting = sensorObj["use"].as<bool>();
-      if (sensorObj.containsKey("sid")) sensor.sensorId = sensorObj["sid"];
-      if (sensorObj.containsKey("rid")) sensor.relayId = sensorObj["rid"];
-
-      if (sensorObj.containsKey("typ")) {
-        JsonArray typeSensor = sensorObj["typ"];
-        for (int i = 0; i < 7 && i < typeSensor.size(); i++) {
-          sensor.typeSensor.set(i, typeSensor[i].as<bool>());
-        }
-      }
-
-      if (sensorObj.containsKey("ser")) sensor.serial_r = sensorObj["ser"];
-      if (sensorObj.containsKey("thm")) sensor.thermistor_r = sensorObj["thm"];
-
-      newSensors.push_back(sensor);
+  // Выражения - после всех сенсоров: ссылаться можно и на те, что идут дальше
+  PlanExpressionResolver resolver(plan);
+  ExpressionCompiler compiler;
+
+  for (Sensor& sensor : device.sensors) {
+    sensor.program = ExpressionProgram();
+    if (!sensor.typeSensor.get(5)) continue;
+    if (!compiler.compile(sensor.expression.c_str(), resolver, sensor.program)) {
+      Serial.printf("[Expression] Sensor %d: %s at %u in '%s'\n", sensor.sensorId, compiler.error(),
+                    (unsigned)compiler.errorPosition(), sensor.expression.c_str());
+      plan.addIssue(PLAN_SENSOR_EXPRESSION_INVALID, sensor.sensorId, compiler.errorPosition());
     }
-
-    noInterrupts();
-    device.sensors = std::move(newSensors);
-    interrupts();
   }
 
-  if (doc.containsKey("act")) {
-    JsonArray actionsJson = doc["act"];
-    std::vector<Action> newActions;
-    newActions.reserve(actionsJson.size());
-
-    for (JsonObject actionObj : actionsJson) {
-      Action action;
-
-      if (actionObj.containsKey("dsc")) {
-        strncpy_safe(action.description, actionObj["dsc"], MAX_DESCRIPTION_LENGTH);
-      }
-      if (actionObj.containsKey("use")) action.isUseSetting = actionObj["use"].as<bool>();
-      if (actionObj.containsKey("tsd")) action.targetSensorId = actionObj["tsd"].as<int>();;
-      if (actionObj.containsKey("tvm")) action.triggerValueMax = actionObj["tvm"].as<float>();
-      if (actionObj.containsKey("tvi")) action.triggerValueMin = actionObj["tvi"].as<float>();
-      if (actionObj.containsKey("hum")) action.isHumidity = actionObj["hum"].as<bool>();
-      if (actionObj.containsKey("ame")) action.actionMoreOrEqual = actionObj["ame"].as<bool>();
-      if (actionObj.containsKey("irs")) action.isReturnSetting = actionObj["irs"].as<bool>();
-  
-      if (actionObj.containsKey("msg")) action.sendMsg = actionObj["msg"].as<String>();
-
-      if (actionObj.containsKey("trd"))
-        action.targetRelayId = actionObj["trd"];
-      else
-        action.targetRelayId = -1;
-
-      if (actionObj.containsKey("rmb"))
-        action.relayMustBeOn = actionObj["rmb"].as<bool>();
-      else
-        action.relayMustBeOn = true;
-
-      if (actionObj.containsKey("cls")) {
-        JsonArray collectionSettings = actionObj["cls"];
-        for (int i = 0; i < 4 && i < collectionSettings.size(); i++) {
-          action.collectionSettings.set(i, collectionSettings[i].as<bool>());
-        }
-      }
-
-      if (actionObj.containsKey("outL")) {
-        JsonArray outputsJson = actionObj["outL"];
-        action.outputs.clear();
-        action.outputs.reserve(outputsJson.size());
-        for (JsonObject outputObj : outputsJson) {
-          OutPower output;
-          if (outputObj.containsKey("use")) output.isUseSetting = outputObj["use"].as<bool>();
-          if (outputObj.containsKey("rid")) output.relayId = outputObj["rid"];
-          if (outputObj.containsKey("stp")) output.statePin = outputObj["stp"].as<bool>();
-          if (outputObj.containsKey("lst")) output.lastState = outputObj["lst"].as<bool>();
-          if (outputObj.containsKey("rtn")) output.isReturn = outputObj["rtn"].as<bool>();
-
-          action.outputs.push_back(output);
-        }
-      }
-
-      newActions.push_back(action);
+  for (size_t i = 0; i < device.relays.size(); i++) {
+    if (!device.relays[i].isOutput && plan.pinUsable[i] && plan.inputSensorIndex[i] == PLAN_NO_INDEX) {
+      plan.addIssue(PLAN_INPUT_UNBOUND, device.relays[i].id, -1, device.relays[i].pin);
     }
-
-    noInterrupts();
-    device.actions = std::move(newActions);
-    interrupts();
   }
 
-  if (doc.containsKey("sch")) {
-    device.scheduleScenarios.clear();
-    JsonArray scenarios = doc["sch"];
-    device.scheduleScenarios.reserve(scenarios.size());
-    for (JsonObject scenarioObj : scenarios) {
-      ScheduleScenario scenario;
+  auto bindOutput = [&](OutPower& output, int ownerId) {
+    output.relayIndex = plan.relayIndex(output.relayId);
+    if (output.relayIndex == PLAN_NO_INDEX && output.isUseSetting) {
+      plan.addIssue(PLAN_OUTPUT_RELAY_MISSING, ownerId, output.relayId);
+    }
+  };
 
-        scenario.initialStateApplied = false;
-        scenario.endStateApplied = false;
+  for (size_t i = 0; i < device.actions.size(); i++) {
+    Action& action = device.actions[i];
 
-      if (scenarioObj.containsKey("use")) scenario.isUseSetting = scenarioObj["use"].as<bool>();
-      if (scenarioObj.containsKey("dsc")) {
-        strncpy_safe(scenario.description, scenarioObj["dsc"], MAX_DESCRIPTION_LENGTH);
-      }
-      if (scenarioObj.containsKey("iac")) scenario.isActive = scenarioObj["iac"].as<bool>();
+    // Условие-выражение заменяет порог; жесту сенсор нужен всегда
+    bool hasCondition = action.condition.length() > 0;
+    action.conditionProgram = ExpressionProgram();
+    if (hasCondition && !compiler.compile(action.condition.c_str(), resolver, action.conditionProgram)) {
+      Serial.printf("[Expression] Action %u: %s at %u in '%s'\n", (unsigned)i + 1, compiler.error(),
+                    (unsigned)compiler.errorPosition(), action.condition.c_str());
+      plan.addIssue(PLAN_ACTION_EXPRESSION_INVALID, i, compiler.errorPosition());
+    }
 
-      if (scenarioObj.containsKey("cls")) {
-        JsonArray collectionSettings = scenarioObj["cls"];
-        for (int i = 0; i < 4 && i < collectionSettings.size(); i++) {
-          scenario.collectionSettings.set(i, collectionSettings[i].as<bool>());
-        }
-      }
+    action.sensorIndex = plan.sensorIndex(action.targetSensorId);
+    bool needsSensor = !hasCondition || action.gesture != GESTURE_NONE;
+    if (action.sensorIndex == PLAN_NO_INDEX && action.isUseSetting && needsSensor) {
+      plan.addIssue(PLAN_ACTION_SENSOR_MISSING, i, action.targetSensorId);
+    }
 
-      if (scenarioObj.containsKey("sdt")) {
-        strncpy_safe(scenario.startDate, scenarioObj["sdt"], MAX_DATE_LENGTH);
-      }
-      if (scenarioObj.containsKey("edt")) {
-        strncpy_safe(scenario.endDate, scenarioObj["edt"], MAX_DATE_LENGTH);
+    action.conditionRelayIndex = PLAN_NO_INDEX;
+    if (action.targetRelayId != -1) {
+      action.conditionRelayIndex = plan.relayIndex(action.targetRelayId);
+      if (action.conditionRelayIndex == PLAN_NO_INDEX && action.isUseSetting) {
+        plan.addIssue(PLAN_ACTION_RELAY_MISSING, i, action.targetRelayId);
       }
+    }
 
-      if (scenarioObj.containsKey("set")) {
-        JsonArray startEndTimes = scenarioObj["set"];
-        for (JsonObject intervalObj : startEndTimes) {
-          startEndTime timeInterval;
-          if (intervalObj.containsKey("stm")) {
-            strncpy_safe(timeInterval.startTime, intervalObj["stm"], MAX_TIME_LENGTH);
-          }
-          if (intervalObj.containsKey("etm")) {
-            strncpy_safe(timeInterval.endTime, intervalObj["etm"], MAX_TIME_LENGTH);
-          }
-          scenario.startEndTimes.push_back(timeInterval);
-        }
-      }
+    for (auto& output : action.outputs) {
+      bindOutput(output, i);
+    }
+  }
 
-      if (scenarioObj.containsKey("wek")) {
-        JsonArray week = scenarioObj["wek"];
-        for (int i = 0; i < 7 && i < week.size(); i++) {
-          scenario.week.set(i, week[i].as<bool>());
-        }
-      }
+  // Индекс зависимостей: сенсор -> действия, реле-условие -> действия.
+  // Зависимости действия - его сенсор и реле-условие плюс всё, на что ссылается выражение.
+  std::vector<std::vector<uint16_t>> actionSensors(device.actions.size());
+  std::vector<std::vector<uint16_t>> actionRelays(device.actions.size());
 
-      if (scenarioObj.containsKey("mon")) {
-        JsonArray months = scenarioObj["mon"];
-        for (int i = 0; i < 12 && i < months.size(); i++) {
-          scenario.months.set(i, months[i].as<bool>());
-        }
-      }
+  auto addDependency = [](std::vector<uint16_t>& list, uint16_t index) {
+    if (std::find(list.begin(), list.end(), index) == list.end()) list.push_back(index);
+  };
 
-      if (scenarioObj.containsKey("isr")) {
-        JsonObject initialStateRelay = scenarioObj["isr"];
-        if (initialStateRelay.containsKey("use")) scenario.initialStateRelay.isUseSetting = initialStateRelay["use"].as<bool>();
-        if (initialStateRelay.containsKey("rid")) scenario.initialStateRelay.relayId = initialStateRelay["rid"];
-        if (initialStateRelay.containsKey("stp")) scenario.initialStateRelay.statePin = initialStateRelay["stp"].as<bool>();
-        if (initialStateRelay.containsKey("lst")) scenario.initialStateRelay.lastState = initialStateRelay["lst"].as<bool>();
+  for (size_t i = 0; i < device.actions.size(); i++) {
+    const Action& action = device.actions[i];
+    if (action.sensorIndex != PLAN_NO_INDEX) addDependency(actionSensors[i], action.sensorIndex);
+    if (action.conditionRelayIndex != PLAN_NO_INDEX) addDependency(actionRelays[i], action.conditionRelayIndex);
+    for (uint16_t index : action.conditionProgram.sensors()) addDependency(actionSensors[i], index);
+    for (uint16_t index : action.conditionProgram.relays()) addDependency(actionRelays[i], index);
+    if (action.conditionProgram.usesTime()) plan.timeActions.push_back(i);
+  }
 
+  plan.sensorActionStart.assign(device.sensors.size() + 1, 0);
+  std::vector<int16_t> conditionSlot(device.relays.size(), PLAN_NO_INDEX);
+  std::vector<uint16_t> conditionCount;
+
+  for (size_t i = 0; i < device.actions.size(); i++) {
+    for (uint16_t sensorIndex : actionSensors[i]) plan.sensorActionStart[sensorIndex + 1]++;
+    for (uint16_t relayIndex : actionRelays[i]) {
+      int16_t& slot = conditionSlot[relayIndex];
+      if (slot == PLAN_NO_INDEX) {
+        slot = plan.conditionRelays.size();
+        plan.conditionRelays.push_back(relayIndex);
+        conditionCount.push_back(0);
       }
+      conditionCount[slot]++;
+    }
+  }
 
-      if (scenarioObj.containsKey("esr")) {
-        JsonObject endStateRelay = scenarioObj["esr"];
-        if (endStateRelay.containsKey("use")) scenario.endStateRelay.isUseSetting = endStateRelay["use"].as<bool>();
-        if (endStateRelay.containsKey("rid")) scenario.endStateRelay.relayId = endStateRelay["rid"];
-        if (endStateRelay.containsKey("stp")) scenario.endStateRelay.statePin = endStateRelay["stp"].as<bool>();
-        if (endStateRelay.containsKey("lst")) scenario.endStateRelay.lastState = endStateRelay["lst"].as<bool>();
-
-      }
+  for (size_t i = 1; i < plan.sensorActionStart.size(); i++) {
+    plan.sensorActionStart[i] += plan.sensorActionStart[i - 1];
+  }
+  plan.conditionActionStart.assign(plan.conditionRelays.size() + 1, 0);
+  for (size_t i = 0; i < conditionCount.size(); i++) {
+    plan.conditionActionStart[i + 1] = plan.conditionActionStart[i] + conditionCount[i];
+  }
 
-      device.scheduleScenarios.push_back(scenario);
+  plan.sensorActions.resize(plan.sensorActionStart.back());
+  plan.conditionActions.resize(plan.conditionActionStart.back());
+  std::vector<uint16_t> sensorFill(plan.sensorActionStart.begin(), plan.sensorActionStart.end() - 1);
+  std::vector<uint16_t> conditionFill(plan.conditionActionStart.begin(), plan.conditionActionStart.end() - 1);
 
+  for (size_t i = 0; i < device.actions.size(); i++) {
+    for (uint16_t sensorIndex : actionSensors[i]) {
+      plan.sensorActions[sensorFill[sensorIndex]++] = i;
     }
-       for (auto& scenario : device.scheduleScenarios) {
-
-    if (scenario.startEndTimes.empty()) {
-      Serial.printf("Data Repair: Schedule '%s' had no time intervals. Adding a default one.\n", scenario.description);
-      scenario.startEndTimes.push_back({"08:00", "18:00"});
+    for (uint16_t relayIndex : actionRelays[i]) {
+      int16_t slot = conditionSlot[relayIndex];
+      plan.conditionActions[conditionFill[slot]++] = i;
     }
   }
 
+  plan.conditionState.resize(plan.conditionRelays.size());
+  for (size_t i = 0; i < plan.conditionRelays.size(); i++) {
+    plan.conditionState[i] = device.relays[plan.conditionRelays[i]].statePin;
   }
 
-  if (doc.containsKey("tmp")) {
-    JsonObject temperature = doc["tmp"];
-    if (temperature.containsKey("use")) device.temperature.isUseSetting = temperature["use"].as<bool>();
-    if (temperature.containsKey("rid")) device.temperature.relayId = temperature["rid"];
-    if (temperature.containsKey("lst")) device.temperature.lastState = temperature["lst"].as<bool>();
-    if (temperature.containsKey("sid")) device.temperature.sensorId = temperature["sid"];
-    if (temperature.containsKey("stT")) device.temperature.setTemperature = temperature["stT"];
-    if (temperature.containsKey("ctp")) device.temperature.currentTemp = temperature["ctp"];
-    if (temperature.containsKey("smt")) device.temperature.isSmoothly = temperature["smt"].as<bool>();
-    if (temperature.containsKey("inc")) device.temperature.isIncrease = temperature["inc"].as<bool>();
-    if (temperature.containsKey("cls")) {
-      JsonArray collectionSettings = temperature["cls"];
-      for (int i = 0; i < 4 && i < collectionSettings.size(); i++) {
-        device.temperature.collectionSettings.set(i, collectionSettings[i].as<bool>());
-      }
-    }
-    if (temperature.containsKey("spi")) device.temperature.selectedPidIndex = temperature["spi"];
+  for (size_t i = 0; i < device.timers.size(); i++) {
+    compileTimer(device.timers[i]);
+    bindOutput(device.timers[i].initialStateRelay, i);
+    bindOutput(device.timers[i].endStateRelay, i);
   }
 
-  if (doc.containsKey("pid")) {
-    device.pids.clear();
-    JsonArray pidsArray = doc["pid"].as<JsonArray>();
-    device.pids.reserve(pidsArray.size());
-    for (JsonObject pidObject : pidsArray) {
-      Pid pid;
-      if (pidObject.containsKey("dsc")) {
-        strncpy_safe(pid.description, pidObject["dsc"], MAX_DESCRIPTION_LENGTH);
-      }
-      if (pidObject.containsKey("Kp")) pid.Kp = pidObject["Kp"];
-      if (pidObject.containsKey("Ki")) pid.Ki = pidObject["Ki"];
-      if (pidObject.containsKey("Kd")) pid.Kd = pidObject["Kd"];
-      device.pids.push_back(pid);
+  for (size_t i = 0; i < device.scheduleScenarios.size(); i++) {
+    bindOutput(device.scheduleScenarios[i].initialStateRelay, i);
+    bindOutput(device.scheduleScenarios[i].endStateRelay, i);
+  }
+
+  // Указатели живут вместе с векторами устройства и переживают его перемещение
+  for (Temperature& temperature : device.temperatures) {
+    int16_t temperatureSensor = plan.sensorIndex(temperature.sensorId);
+    int16_t temperatureRelay = plan.relayIndex(temperature.relayId);
+    temperature.sensorPtr = temperatureSensor != PLAN_NO_INDEX ? &device.sensors[temperatureSensor] : nullptr;
+    temperature.relayPtr = temperatureRelay != PLAN_NO_INDEX ? &device.relays[temperatureRelay] : nullptr;
+    if (!temperature.relayPtr && temperature.isUseSetting) {
+      plan.addIssue(PLAN_OUTPUT_RELAY_MISSING, -1, temperature.relayId);
     }
   }
+}
 
-  if (doc.containsKey("tmr")) {
-    device.timers.clear();
-    JsonArray timers = doc["tmr"];
-    device.timers.reserve(timers.size());
-    for (JsonObject timerObj : timers) {
-      Timer timer;
-      if (timerObj.containsKey("use")) timer.isUseSetting = timerObj["use"].as<bool>();
-      if (timerObj.containsKey("tim")) {
-        strncpy_safe(timer.time, timerObj["tim"], MAX_TIME_LENGTH);
-      }
-      if (timerObj.containsKey("cls")) {
-        JsonArray collectionSettings = timerObj["cls"];
-        for (int i = 0; i < 4 && i < collectionSettings.size(); i++) {
-          timer.collectionSettings.set(i, collectionSettings[i].as<bool>());
-        }
-      }
-      if (timerObj.containsKey("isr")) {
-        JsonObject initialStateRelay = timerObj["isr"];
-        if (initialStateRelay.containsKey("use")) timer.initialStateRelay.isUseSetting = initialStateRelay["use"].as<bool>();
-        if (initialStateRelay.containsKey("rid")) timer.initialStateRelay.relayId = initialStateRelay["rid"];
-        if (initialStateRelay.containsKey("stp")) timer.initialStateRelay.statePin = initialStateRelay["stp"].as<bool>();
-        if (initialStateRelay.containsKey("lst")) timer.initialStateRelay.lastState = initialStateRelay["lst"].as<bool>();
+int DeviceManager::findRelayIndexById(const Device& device, uint8_t relayId) {
+  return device.plan.relayIndex(relayId);
+}
 
-      }
-      if (timerObj.containsKey("esr")) {
-        JsonObject endStateRelay = timerObj["esr"];
-        if (endStateRelay.containsKey("use")) timer.endStateRelay.isUseSetting = endStateRelay["use"].as<bool>();
-        if (endStateRelay.containsKey("rid")) timer.endStateRelay.relayId = endStateRelay["rid"];
-        if (endStateRelay.containsKey("stp")) timer.endStateRelay.statePin = endStateRelay["stp"].as<bool>();
-        if (endStateRelay.containsKey("lst")) timer.endStateRelay.lastState = endStateRelay["lst"].as<bool>();
+int DeviceManager::findSensorIndexById(const Device& device, int sensorId) {
+  return device.plan.sensorIndex(sensorId);
+}
 
-      }
-      device.timers.push_back(timer);
-    }
+Relay* DeviceManager::findRelayById(Device& device, uint8_t relayId) {
+  int index = device.plan.relayIndex(relayId);
+  return index != PLAN_NO_INDEX ? &device.relays[index] : nullptr;
+}
+
+// Указатели контуров - в записи своего устройства: копия приходит без них
+void DeviceManager::bindTemperatures(Device& device) {
+  for (auto& temp : device.temperatures) {
+    int sensorIndex = findSensorIndexById(device, temp.sensorId);
+    temp.sensorPtr = sensorIndex != PLAN_NO_INDEX ? &device.sensors[sensorIndex] : nullptr;
+    temp.relayPtr = findRelayById(device, temp.relayId);
   }
+}
 
-  if (doc.containsKey("ite")) device.isTimersEnabled = doc["ite"].as<bool>();
-  if (doc.containsKey("iet")) device.isEncyclateTimers = doc["iet"].as<bool>();
-  if (doc.containsKey("ise")) device.isScheduleEnabled = doc["ise"].as<bool>();
-  if (doc.containsKey("iae")) device.isActionEnabled = doc["iae"].as<bool>();
-   
-   appState.isProcessWorkingJson = false;
-   
-  return true;
+bool DeviceManager::writeDevicesToFile(const std::vector<Device>& myDevices, const char* filename) {
+  return DeviceConfigFile::write(myDevices, filename);
 }
 
-void DeviceManager::saveRelayStates(uint8_t targetRelayId) {
+bool DeviceManager::readDevicesFromFile(std::vector<Device>& myDevices, const char* filename) {
+  if (!DeviceConfigFile::read(myDevices, filename)) {
+    return false;
+  }
+
   for (auto& device : myDevices) {
+    compileDevice(device);
+  }
+  return true;
+}
 
-    Relay* relay = findRelayById(device, targetRelayId);
-    if (relay) {
-      relay->lastState = relay->statePin;
-    }
+// devices.json (прежний формат или копия из интерфейса): одно устройство,
+// файл читается кусками в DeviceJsonReader
+bool DeviceManager::importDevicesJson(std::vector<Device>& myDevices, const char* filename) {
+  File file = SPIFFS.open(filename, "r");
+  if (!file) {
+    return false;
+  }
 
-    if (device.temperature.relayId == targetRelayId) {
-      if (relay) {
-        device.temperature.lastState = relay->statePin;
-      }
-    }
+  std::vector<Device> imported(1);
+  DeviceJsonReader reader(imported[0]);
+  bool isParsed = file.size() <= DEVICE_JSON_MAX_BYTES;
 
-    for (auto& timer : device.timers) {
-      if (timer.initialStateRelay.relayId == targetRelayId) {
-        timer.initialStateRelay.lastState = relay ? relay->statePin : false;
-      }
-      if (timer.endStateRelay.relayId == targetRelayId) {
-        timer.endStateRelay.lastState = relay ? relay->statePin : false;
-      }
-    }
+  char chunk[256];
+  while (isParsed && file.available()) {
+    size_t length = file.readBytes(chunk, sizeof(chunk));
+    if (length == 0) break;
+    isParsed = reader.feed(chunk, length);
+  }
+  file.close();
 
-    for (auto& scenario : device.scheduleScenarios) {
-      if (scenario.initialStateRelay.relayId == targetRelayId) {
-        scenario.initialStateRelay.lastState = relay ? relay->statePin : false;
-      }
-      if (scenario.endStateRelay.relayId == targetRelayId) {
-        scenario.endStateRelay.lastState = relay ? relay->statePin : false;
-      }
-    }
+  if (!isParsed || !reader.finish()) {
+    Serial.printf("[Config] %s: %s, байт %u\n", filename,
+                  JsonStreamParser::errorText(reader.error()), (unsigned)reader.errorOffset());
+    return false;
   }
-}
 
-void DeviceManager::restoreRelayStates(uint8_t targetRelayId) {
-  for (auto& device : myDevices) {
+  compileDevice(imported[0]);
+  myDevices = std::move(imported);
+  return true;
+}
 
-    Relay* relay = findRelayById(device, targetRelayId);
-    if (relay) {
-      relay->statePin = relay->lastState;
-    }
+void DeviceManager::compileDevice(Device& device) {
+  for (auto& sensor : device.sensors) {
+    compileSensor(sensor);
+  }
 
-    if (device.temperature.relayId == targetRelayId) {
-      if (relay) {
-        relay->statePin = device.temperature.lastState;
-      }
+  for (auto& scenario : device.scheduleScenarios) {
+    if (scenario.startEndTimes.empty()) {
+      Serial.printf("Data Repair: Schedule '%s' had no time intervals. Adding a default one.\n", scenario.description);
+      scenario.startEndTimes.push_back({"08:00", "18:00"});
     }
+    compileSchedule(scenario);
+  }
+  device.scheduleHorizon.invalidate();
 
-    for (auto& timer : device.timers) {
-      if (timer.initialStateRelay.relayId == targetRelayId) {
-        if (relay) {
-          relay->statePin = timer.initialStateRelay.lastState;
-        }
-      }
-      if (timer.endStateRelay.relayId == targetRelayId) {
-        if (relay) {
-          relay->statePin = timer.endStateRelay.lastState;
-        }
-      }
-    }
+  buildRuntimePlan(device);
+}
 
-    for (auto& scenario : device.scheduleScenarios) {
-      if (scenario.initialStateRelay.relayId == targetRelayId) {
-        if (relay) {
-          relay->statePin = scenario.initialStateRelay.lastState;
-        }
+// Реле и сенсоры - по id, остальные записи - по индексу; -1 - нет такой
+int DeviceManager::findItemIndex(const Device& device, DevicePatchSection section, int id) {
+  switch (section) {
+    case PATCH_RELAY:
+      for (size_t i = 0; i < device.relays.size(); i++) {
+        if (device.relays[i].id == id) return i;
       }
-      if (scenario.endStateRelay.relayId == targetRelayId) {
-        if (relay) {
-          relay->statePin = scenario.endStateRelay.lastState;
-        }
+      return -1;
+    case PATCH_SENSOR:
+      for (size_t i = 0; i < device.sensors.size(); i++) {
+        if (device.sensors[i].sensorId == id) return i;
       }
-    }
+      return -1;
+    case PATCH_SCHEDULE: return id >= 0 && (size_t)id < device.scheduleScenarios.size() ? id : -1;
+    case PATCH_TIMER:    return id >= 0 && (size_t)id < device.timers.size() ? id : -1;
+    case PATCH_ACTION:   return id >= 0 && (size_t)id < device.actions.size() ? id : -1;
+    case PATCH_PID:      return id >= 0 && (size_t)id < device.pids.size() ? id : -1;
   }
+  return -1;
 }
 
-Relay* DeviceManager::findRelayById(Device& device, uint8_t relayId) {
-  for (auto& relay : device.relays) {
-    if (relay.id == relayId) {
-      return &relay;
-    }
+void* DeviceManager::copyItem(const Device& device, DevicePatchSection section, size_t index) {
+  switch (section) {
+    case PATCH_RELAY:    return index < device.relays.size() ? new (std::nothrow) Relay(device.relays[index]) : nullptr;
+    case PATCH_SENSOR:   return index < device.sensors.size() ? new (std::nothrow) Sensor(device.sensors[index]) : nullptr;
+    case PATCH_SCHEDULE: return index < device.scheduleScenarios.size() ? new (std::nothrow) ScheduleScenario(device.scheduleScenarios[index]) : nullptr;
+    case PATCH_TIMER:    return index < device.timers.size() ? new (std::nothrow) Timer(device.timers[index]) : nullptr;
+    case PATCH_ACTION:   return index < device.actions.size() ? new (std::nothrow) Action(device.actions[index]) : nullptr;
+    case PATCH_PID:      return index < device.pids.size() ? new (std::nothrow) Pid(device.pids[index]) : nullptr;
   }
   return nullptr;
 }
 
-bool DeviceManager::writeDevicesToFile(const std::vector<Device>& myDevices, const char* filename) {for (const auto& device : myDevices) {
-
-    serializeDevice(device, filename, nullptr);
-    appState.isProcessWorkingJson = false;
+void DeviceManager::deleteItem(DevicePatchSection section, void* record) {
+  switch (section) {
+    case PATCH_RELAY:    delete static_cast<Relay*>(record); break;
+    case PATCH_SENSOR:   delete static_cast<Sensor*>(record); break;
+    case PATCH_SCHEDULE: delete static_cast<ScheduleScenario*>(record); break;
+    case PATCH_TIMER:    delete static_cast<Timer*>(record); break;
+    case PATCH_ACTION:   delete static_cast<Action*>(record); break;
+    case PATCH_PID:      delete static_cast<Pid*>(record); break;
   }
-  return true;
 }
 
-bool DeviceManager::readDevicesFromFile(std::vector<Device>& myDevices, const char* filename) {File file = SPIFFS.open(filename, "r");
-    if (!file || !file.available()) {if (file) file.close();
-        return false;
+// То же, что compileDevice делает для записи; план соберёт задача управления
+void DeviceManager::compileItem(DevicePatchSection section, void* record) {
+  switch (section) {
+    case PATCH_SENSOR:
+      compileSensor(*static_cast<Sensor*>(record));
+      break;
+    case PATCH_SCHEDULE: {
+      ScheduleScenario& scenario = *static_cast<ScheduleScenario*>(record);
+      if (scenario.startEndTimes.empty()) {
+        scenario.startEndTimes.push_back({"08:00", "18:00"});
+      }
+      compileSchedule(scenario);
+      break;
     }
+    case PATCH_TIMER:
+      compileTimer(*static_cast<Timer*>(record));
+      break;
+    default:
+      break;
+  }
+}
 
-    size_t fileSize = file.size();DynamicJsonDocument doc(fileSize * 1.5);
-
-    DeserializationError error = deserializeJson(doc, file);
-    file.close();
-
-    if (error) {return false;
+// Правки уже в снимке: publishConfig идёт после команд, до задач. Снимок не
+// опубликован или от другого устройства - полная запись, здесь же, в задаче управления
+void DeviceManager::savePatchedItems() {
+  bool isLost = bridge.isPatchedLost.exchange(false);
+  bool isSaved = true;
+  std::shared_ptr<const DeviceConfigSnapshot> snapshot = isConfigChanged ? nullptr : configSnapshot();
+
+  PatchedItem item;
+  while (bridge.patched.pop(item)) {
+    if (isSaved && !isLost) {
+      isSaved = snapshot && snapshot->deviceIndex == item.device &&
+                DeviceConfigFile::writeItem(snapshot->device, item.device, (DevicePatchSection)item.section, item.index, DEVICE_CONFIG_PATH);
     }
+  }
 
-    myDevices.clear();
-
-    JsonObject deviceObj = doc.as<JsonObject>();
-    if (!deviceObj) {return false;
-    }
+  if (isLost || !isSaved) {
+    writeDevicesToFile(myDevices, DEVICE_CONFIG_PATH);
+  }
+}
 
-    Device device;
-    memset(&device, 0, sizeof(Device));
+// Перед полной записью: она уже включает применённые правки
+void DeviceManager::discardPatchedItems() {
+  PatchedItem item;
+  while (bridge.patched.pop(item)) {}
+  bridge.isPatchedLost = false;
+}
 
-    if (deserializeDevice(deviceObj, device)) {
-        myDevices.push_back(device);} else {return false;
-    }return true;
+bool DeviceManager::isLiveDevice(size_t index) const {
+  for (uint8_t live : liveDevices) {
+    if (live == index) return true;
+  }
+  return false;
 }
 
 int DeviceManager::getSelectedDeviceIndex(const std::vector<Device>& myDevices) {
@@ -917,23 +769,44 @@ int DeviceManager::getSelectedDeviceIndex(const std::vector<Device>& myDevices)
 }
 
 int DeviceManager::deviceInit() {
-  if (!SPIFFS.exists("/devices.json")) {
-    initializeDevice("MyDevice1", true);
-    writeDevicesToFile(myDevices, "/devices.json");} else {
-    if (readDevicesFromFile(myDevices, "/devices.json")) {
-      return currentDeviceIndex = getSelectedDeviceIndex(myDevices);
-    } else {initializeDevice("MyDevice1", true);
+  bool isLoaded = false;
+
+  // JSON - после обновления прошивки или восстановления из копии: переводится
+  // в двоичный файл один раз
+  if (SPIFFS.exists(DEVICE_CONFIG_LEGACY_PATH)) {
+    isLoaded = importDevicesJson(myDevices, DEVICE_CONFIG_LEGACY_PATH);
+    if (isLoaded && writeDevicesToFile(myDevices, DEVICE_CONFIG_PATH)) {
+      SPIFFS.remove(DEVICE_CONFIG_LEGACY_PATH);
+      Serial.println("[Config] devices.json импортирован");
+    }
+  }
+
+  if (!isLoaded) {
+    if (!SPIFFS.exists(DEVICE_CONFIG_PATH) && !SPIFFS.exists(DEVICE_CONFIG_PATH ".tmp")) {
+      initializeDevice("MyDevice1", true);
+      writeDevicesToFile(myDevices, DEVICE_CONFIG_PATH);
       return currentDeviceIndex = 0;
     }
+    isLoaded = readDevicesFromFile(myDevices, DEVICE_CONFIG_PATH);
   }
-  return currentDeviceIndex = 0;
+
+  if (!isLoaded || myDevices.empty()) {
+    // Испорченный файл не перезаписывается до сохранения из интерфейса
+    initializeDevice("MyDevice1", true);
+    return currentDeviceIndex = 0;
+  }
+
+  int selected = getSelectedDeviceIndex(myDevices);
+  return currentDeviceIndex = selected < 0 ? 0 : selected;
 }
 
 uint32_t DeviceManager::calculateDeviceFlagsChecksum() {
-  if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+  const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+  std::shared_ptr<const DeviceConfigSnapshot> config = configSnapshot();
+  if (!snapshot.valid || !config) {
     return 0;
   }
-  const Device& device = myDevices[currentDeviceIndex];
+  const Device& device = config->device;
   uint32_t hash = 5381;
 
   auto addToHash = [&hash](const void* data, size_t size) {
@@ -945,17 +818,24 @@ uint32_t DeviceManager::calculateDeviceFlagsChecksum() {
 
   addToHash(device.nameDevice, strlen(device.nameDevice));
   addToHash(&device.isSelected, sizeof(device.isSelected));
-  addToHash(&device.isTimersEnabled, sizeof(device.isTimersEnabled));
-  addToHash(&device.isEncyclateTimers, sizeof(device.isEncyclateTimers));
-  addToHash(&device.isScheduleEnabled, sizeof(device.isScheduleEnabled));
-  addToHash(&device.isActionEnabled, sizeof(device.isActionEnabled));
-  addToHash(&device.temperature.isUseSetting, sizeof(device.temperature.isUseSetting));
+  addToHash(&snapshot.isTimersEnabled, sizeof(snapshot.isTimersEnabled));
+  addToHash(&snapshot.isEncyclateTimers, sizeof(snapshot.isEncyclateTimers));
+  addToHash(&snapshot.isScheduleEnabled, sizeof(snapshot.isScheduleEnabled));
+  addToHash(&snapshot.isActionEnabled, sizeof(snapshot.isActionEnabled));
+  addToHash(&snapshot.isTemperatureUseSetting, sizeof(snapshot.isTemperatureUseSetting));
+  addToHash(&snapshot.autotuneState, sizeof(snapshot.autotuneState));
+  addToHash(&snapshot.autotuneCycles, sizeof(snapshot.autotuneCycles));
 
   return hash;
 }
 
 uint32_t DeviceManager::calculateOutputRelayChecksum() {
-  Device& device = myDevices[currentDeviceIndex];
+  const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+  std::shared_ptr<const DeviceConfigSnapshot> config = configSnapshot();
+  if (!snapshot.valid || !config) {
+    return 0;
+  }
+  const Device& device = config->device;
   uint32_t hash = 5381;
 
   auto addToHash = [&hash](const void* data, size_t size) {
@@ -965,7 +845,8 @@ uint32_t DeviceManager::calculateOutputRelayChecksum() {
     }
   };
 
-  for (const auto& relay : device.relays) {
+  for (uint8_t i = 0; i < snapshot.relayCount; i++) {
+    const RelaySnapshot& relay = snapshot.relays[i];
 
     if (relay.isOutput) {
 
@@ -975,7 +856,8 @@ uint32_t DeviceManager::calculateOutputRelayChecksum() {
       addToHash(&relay.isPwm, sizeof(relay.isPwm));
       addToHash(&relay.pwm, sizeof(relay.pwm));
       addToHash(&relay.manualMode, sizeof(relay.manualMode));
-      addToHash(relay.description, strnlen(relay.description, MAX_DESCRIPTION_LENGTH));
+      const char* description = relayDescription(device, relay);
+      addToHash(description, strlen(description));
 
       bool state = relay.statePin;
       addToHash(&state, sizeof(state));
@@ -985,7 +867,7 @@ uint32_t DeviceManager::calculateOutputRelayChecksum() {
 }
 
 uint32_t DeviceManager::calculateSensorValuesChecksum() {
-  Device& device = myDevices[currentDeviceIndex];
+  const ControlSnapshot& snapshot = bridge.webSnapshot.read();
   uint32_t hash = 5381;
 
   auto addToHash = [&hash](const void* data, size_t size) {
@@ -995,7 +877,8 @@ uint32_t DeviceManager::calculateSensorValuesChecksum() {
     }
   };
 
-  for (const auto& sensor : device.sensors) {
+  for (uint8_t i = 0; i < snapshot.sensorCount; i++) {
+    const SensorSnapshot& sensor = snapshot.sensors[i];
 
     if (sensor.isUseSetting) {
 
@@ -1008,10 +891,10 @@ uint32_t DeviceManager::calculateSensorValuesChecksum() {
 }
 
 uint32_t DeviceManager::calculateTimersProgressChecksum() {
-  if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+  const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+  if (!snapshot.valid) {
     return 0;
   }
-  const Device& device = myDevices[currentDeviceIndex];
   uint32_t hash = 5381;
 
   auto addToHash = [&hash](const void* data, size_t size) {
@@ -1021,87 +904,527 @@ uint32_t DeviceManager::calculateTimersProgressChecksum() {
     }
   };
 
-  for (const auto& timer : device.timers) {
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < snapshot.timerCount; i++) {
+    const TimerSnapshot& timer = snapshot.timers[i];
     if (timer.isUseSetting) {
+      unsigned long elapsedTime = timer.elapsedSeconds(now);
+      unsigned long remainingTime = timer.remainingSeconds(now);
 
-      addToHash(&timer.progress.elapsedTime, sizeof(timer.progress.elapsedTime));
-      addToHash(&timer.progress.remainingTime, sizeof(timer.progress.remainingTime));
-      addToHash(&timer.progress.isRunning, sizeof(timer.progress.isRunning));
-      addToHash(&timer.progress.isStopped, sizeof(timer.progress.isStopped));
+      addToHash(&elapsedTime, sizeof(elapsedTime));
+      addToHash(&remainingTime, sizeof(remainingTime));
+      addToHash(&timer.isRunning, sizeof(timer.isRunning));
+      addToHash(&timer.isStopped, sizeof(timer.isStopped));
     }
   }
   return hash;
 }
 
+uint32_t DeviceManager::calculateLiveDevicesChecksum() {
+  const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+  if (!snapshot.valid) {
+    return 0;
+  }
+  uint32_t hash = 5381;
+
+  auto addToHash = [&hash](const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash = ((hash << 5) + hash) + bytes[i];
+    }
+  };
+
+  addToHash(&snapshot.deviceCount, sizeof(snapshot.deviceCount));
+  for (uint8_t i = 0; i < snapshot.deviceCount; i++) {
+    const DeviceSnapshot& device = snapshot.devices[i];
+    addToHash(&device.index, sizeof(device.index));
+    addToHash(&device.outputsOn, sizeof(device.outputsOn));
+    addToHash(&device.isTimersEnabled, sizeof(device.isTimersEnabled));
+    addToHash(&device.isScheduleEnabled, sizeof(device.isScheduleEnabled));
+    addToHash(&device.isActionEnabled, sizeof(device.isActionEnabled));
+    addToHash(&device.isTemperatureUseSetting, sizeof(device.isTemperatureUseSetting));
+    addToHash(&device.currentTemp, sizeof(device.currentTemp));
+    addToHash(&device.setTemperature, sizeof(device.setTemperature));
+  }
+  return hash;
+}
+
 bool DeviceManager::handleRelayCommand(const JsonObject& command, uint32_t clientNum) {
 
-  if (myDevices.empty()) {
+  std::shared_ptr<const DeviceConfigSnapshot> config = configSnapshot();
+  if (!config) {
     return false;
   }
-  
-  Device& device = myDevices[currentDeviceIndex];
-
-  device.isForceControlRelay = true;
 
-  int relayId = command["relay"];
   const char* action = command["action"];
 
   if (!action) {return false;
   }
 
-  if (strcmp(action, "reset_all") == 0) {bool anyRelayFound = false;
-    for (auto& relay : device.relays) {
-      if (relay.isOutput) {
-        relay.statePin = false;
-        relay.manualMode = false;
-        anyRelayFound = true;
-      }
-    }
-    return anyRelayFound;
+  ControlCommand relayCommand;
+
+  if (strcmp(action, "reset_all") == 0) {
+    relayCommand.type = CMD_RELAY_RESET_ALL;
+    return bridge.post(relayCommand);
   }
 
   if (command["relay"].isNull()) {
     return false;
   }
 
-  bool found = false;for (auto& relay : device.relays) {
-    if (relay.id == relayId) {
+  if (strcmp(action, "reset") == 0) {
+    relayCommand.type = CMD_RELAY_RESET;
+  } else if (strcmp(action, "on") == 0) {
+    relayCommand.type = CMD_RELAY_ON;
+  } else if (strcmp(action, "off") == 0) {
+    relayCommand.type = CMD_RELAY_OFF;
+  } else {
+    return false;
+  }
+
+  relayCommand.id = command["relay"].as<int>();
+
+  if (findRelayIndexById(config->device, relayCommand.id) < 0) {
+    return false;
+  }
+
+  return bridge.post(relayCommand);
+}
+
+bool DeviceManager::applyCommand(const ControlCommand& command) {
+
+  if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+    if (command.type == CMD_APPLY_DEVICE) delete static_cast<Device*>(command.payload);
+    if (command.type == CMD_SET_ITEM) free(command.payload);
+    if (command.type == CMD_PATCH_ITEM) deleteItem((DevicePatchSection)command.field, command.payload);
+    return false;
+  }
+
+  // Снимок конфигурации публикуется заново только после правки его полей:
+  // состояния реле в нём не обновляются, флаги publishConfig сверяет сам
+  Device& device = myDevices[currentDeviceIndex];
+
+  switch (command.type) {
+
+    case CMD_RELAY_RESET_ALL: {
+      bool anyRelayFound = false;
+      for (auto& relay : device.relays) {
+        if (relay.isOutput) {
+          relay.statePin = false;
+          relay.manualMode = false;
+          anyRelayFound = true;
+        }
+      }
+      device.isForceControlRelay = true;
+      return anyRelayFound;
+    }
+
+    case CMD_RELAY_ON:
+    case CMD_RELAY_OFF:
+    case CMD_RELAY_RESET: {
+      Relay* relay = findRelayById(device, command.id);
+      if (!relay) return false;
+
+      if (command.type == CMD_RELAY_RESET) {
+        relay->manualMode = false;
+      } else {
+        bool newState = (command.type == CMD_RELAY_ON);
+        relay->statePin = newState;
+        relay->manualMode = true;
+      }
+      device.isForceControlRelay = true;
+      return true;
+    }
+
+    case CMD_SET_FLAG:
+      switch (command.field) {
+        case FLAG_TIMERS:      device.isTimersEnabled = command.value; break;
+        case FLAG_ENCYCLATE:   device.isEncyclateTimers = command.value; break;
+        case FLAG_SCHEDULE:    device.isScheduleEnabled = command.value; break;
+        case FLAG_ACTIONS:     device.isActionEnabled = command.value; break;
+        case FLAG_TEMPERATURE: device.temperature().isUseSetting = command.value; break;
+      }
+      return false;
+
+    case CMD_SET_ITEM: {
+      size_t index = command.id;
+      switch (command.field) {
+        case ITEM_ACTION_USE:
+          if (index < device.actions.size()) {
+            device.actions[index].isUseSetting = command.value;
+            isConfigChanged = true;
+          }
+          break;
+        case ITEM_ACTION_DESCRIPTION:
+          if (index < device.actions.size() && command.payload) {
+            strncpy_safe(device.actions[index].description, static_cast<const char*>(command.payload), MAX_DESCRIPTION_LENGTH);
+            isConfigChanged = true;
+          }
+          free(command.payload);
+          break;
+        case ITEM_TIMER_USE:
+          if (index < device.timers.size()) {
+            device.timers[index].isUseSetting = command.value;
+            isConfigChanged = true;
+          }
+          break;
+        case ITEM_SCHEDULE_USE:
+          if (index < device.scheduleScenarios.size()) {
+            device.scheduleScenarios[index].isUseSetting = command.value;
+            device.scheduleScenarios[index].compiled.invalidate();
+            device.scheduleHorizon.invalidate();
+            isConfigChanged = true;
+          }
+          break;
+        case ITEM_SENSOR_USE:
+          if (index < device.sensors.size()) {
+            device.sensors[index].isUseSetting = command.value;
+            isConfigChanged = true;
+          }
+          break;
+        case ITEM_RELAY_MANUAL:
+          if (index < device.relays.size()) {
+            device.relays[index].manualMode = command.value;
+            return true;
+          }
+          break;
+        case ITEM_TEMPERATURE_USE:
+          if (index < device.temperatures.size()) {
+            device.temperatures[index].isUseSetting = command.value;
+            isConfigChanged = true;
+          }
+          break;
+        case ITEM_RELAY_STATE:
+          if (index < device.relays.size()) {
+            device.relays[index].statePin = command.value;
+            return true;
+          }
+          break;
+      }
+      return false;
+    }
+
+    case CMD_SET_PID_KP:
+      if ((size_t)command.id < device.pids.size()) {
+        device.pids[command.id].Kp = command.number;
+        isConfigChanged = true;
+      }
+      return false;
+
+    case CMD_APPLY_DEVICE: {
+      // Новая конфигурация разобрана в сетевой задаче, здесь только подмена
+      Device* staged = static_cast<Device*>(command.payload);
+      if (!staged) return false;
+
+      std::swap(device, *staged);
+
+      // DHT-объекты старой конфигурации, которые не перешли в новую
+      for (auto& oldSensor : staged->sensors) {
+        if (!oldSensor.dht) continue;
+        bool isShared = false;
+        for (const auto& sensor : device.sensors) {
+          if (sensor.dht == oldSensor.dht) {
+            isShared = true;
+            break;
+          }
+        }
+        if (!isShared) delete oldSensor.dht;
+      }
+      delete staged;
+      bindTemperatures(device);
+      isConfigChanged = true;
+
+      appState.isSaveControlRequest = true;
+      return false;
+    }
+
+    case CMD_PATCH_ITEM:
+      return applyPatch(device, command);
+
+    default:
+      return false;
+  }
+}
+
+// Подмена одной записи. Состояние исполнения (выходы реле, показания и DHT
+// сенсора, ход таймера, сработавшее действие) остаётся от прежней записи;
+// прочие записи, датчики и контуры не переинициализируются.
+bool DeviceManager::applyPatch(Device& device, const ControlCommand& command) {
+  DevicePatchSection section = (DevicePatchSection)command.field;
+  size_t index = command.id;
+  bool isApplied = false;
+
+  switch (section) {
+    case PATCH_RELAY:
+      if (index < device.relays.size() && device.relays[index].id == (int)command.number) {
+        Relay& relay = device.relays[index];
+        Relay& patch = *static_cast<Relay*>(command.payload);
+        patch.manualMode = relay.manualMode;
+        patch.statePin = relay.statePin;
+        patch.lastState = relay.lastState;
+        patch.isPwm = relay.isPwm;
+        patch.pwm = relay.pwm;
+        relay = std::move(patch);
+        isApplied = true;
+      }
+      break;
 
-      found = true;if (strcmp(action, "reset") == 0) {
-        relay.manualMode = false;}
+    case PATCH_SENSOR:
+      if (index < device.sensors.size() && device.sensors[index].sensorId == (int)command.number) {
+        Sensor& sensor = device.sensors[index];
+        Sensor& patch = *static_cast<Sensor*>(command.payload);
+        patch.currentValue = sensor.currentValue;
+        patch.humidityValue = sensor.humidityValue;
+        patch.dht = sensor.dht;
+        // DHT11 <-> DHT22: датчик создаётся заново
+        if (patch.dht && (patch.typeSensor.bits & 0x03) != (sensor.typeSensor.bits & 0x03)) {
+          delete patch.dht;
+          patch.dht = nullptr;
+        }
+        sensor = std::move(patch);
+        isApplied = true;
+      }
+      break;
 
-      else if (strcmp(action, "on") == 0 || strcmp(action, "off") == 0) {
-        bool newState = (strcmp(action, "on") == 0);
+    case PATCH_SCHEDULE:
+      if (index < device.scheduleScenarios.size()) {
+        ScheduleScenario& scenario = device.scheduleScenarios[index];
+        ScheduleScenario& patch = *static_cast<ScheduleScenario*>(command.payload);
+        patch.isActive = scenario.isActive;
+        patch.initialStateApplied = scenario.initialStateApplied;
+        patch.endStateApplied = scenario.endStateApplied;
+        scenario = std::move(patch);
+        device.scheduleHorizon.invalidate();
+        isApplied = true;
+      }
+      break;
 
-        if (relay.statePin != newState || !relay.manualMode) {
-          relay.statePin = newState;
-          relay.manualMode = true;} else {}
+    case PATCH_TIMER:
+      if (index < device.timers.size()) {
+        Timer& timer = device.timers[index];
+        Timer& patch = *static_cast<Timer*>(command.payload);
+        patch.progress = timer.progress;
+        timer = std::move(patch);
+        isApplied = true;
       }
-      else {found = false;
+      break;
+
+    case PATCH_ACTION:
+      if (index < device.actions.size()) {
+        Action& action = device.actions[index];
+        Action& patch = *static_cast<Action*>(command.payload);
+        patch.wasTriggered = action.wasTriggered;
+        patch.isPending = action.isPending;
+        action = std::move(patch);
+        isApplied = true;
+      }
+      break;
+
+    case PATCH_PID:
+      if (index < device.pids.size()) {
+        device.pids[index] = std::move(*static_cast<Pid*>(command.payload));
+        isApplied = true;
       }
       break;
+  }
+
+  deleteItem(section, command.payload);
+
+  if (!isApplied) {
+    // Конфигурацию успели заменить целиком
+    Serial.printf("[Patch] Запись %u раздела %u не найдена, правка отброшена\n", (unsigned)index, (unsigned)section);
+    return false;
+  }
+  isConfigChanged = true;
+
+  if (section != PATCH_PID) {
+    buildRuntimePlan(device);
+
+    // DHT, чей вход сменил пин или перестал быть DHT; недостающие создаст Control::attachDhtSensors
+    for (auto& sensor : device.sensors) {
+      if (!sensor.dht) continue;
+      bool isDht = (sensor.typeSensor.get(0) || sensor.typeSensor.get(1)) && sensor.inputRelayIndex != PLAN_NO_INDEX;
+      if (!isDht || sensor.dht->pin() != sensor.inputPin) {
+        delete sensor.dht;
+        sensor.dht = nullptr;
+      }
+    }
+  }
+
+  PatchedItem item = { currentDeviceIndex, command.field, (uint16_t)index };
+  if (!bridge.patched.push(item)) bridge.isPatchedLost = true;
+
+  return section == PATCH_RELAY;
+}
+
+void DeviceManager::fillSnapshot(ControlSnapshot& snapshot) {
+  snapshot.seq++;
+  snapshot.relayCount = 0;
+  snapshot.sensorCount = 0;
+  snapshot.timerCount = 0;
+
+  if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+    snapshot.valid = false;
+    return;
+  }
+
+  const Device& device = myDevices[currentDeviceIndex];
+
+  for (size_t i = 0; i < device.relays.size() && snapshot.relayCount < SNAPSHOT_MAX_RELAYS; i++) {
+    const Relay& relay = device.relays[i];
+    RelaySnapshot& item = snapshot.relays[snapshot.relayCount++];
+    item.id = relay.id;
+    item.index = i;
+    item.pin = relay.pin;
+    item.isOutput = relay.isOutput;
+    item.statePin = relay.statePin;
+    item.manualMode = relay.manualMode;
+    item.isPwm = relay.isPwm;
+    item.pwm = relay.pwm;
+  }
+
+  for (size_t i = 0; i < device.sensors.size() && snapshot.sensorCount < SNAPSHOT_MAX_SENSORS; i++) {
+    const Sensor& sensor = device.sensors[i];
+    SensorSnapshot& item = snapshot.sensors[snapshot.sensorCount++];
+    item.sensorId = sensor.sensorId;
+    item.index = i;
+    item.isUseSetting = sensor.isUseSetting;
+    item.typeBits = sensor.typeSensor.bits;
+    item.currentValue = sensor.currentValue;
+    item.humidityValue = sensor.humidityValue;
+  }
+
+  for (size_t i = 0; i < device.timers.size() && snapshot.timerCount < SNAPSHOT_MAX_TIMERS; i++) {
+    const Timer& timer = device.timers[i];
+    TimerSnapshot& item = snapshot.timers[snapshot.timerCount++];
+    item.isUseSetting = timer.isUseSetting;
+    item.isRunning = timer.progress.isRunning;
+    item.isStopped = timer.progress.isStopped;
+    item.startedAt = timer.progress.startedAt;
+    item.durationMs = timer.durationMs;
+  }
+
+  snapshot.isTimersEnabled = device.isTimersEnabled;
+  snapshot.isEncyclateTimers = device.isEncyclateTimers;
+  snapshot.isScheduleEnabled = device.isScheduleEnabled;
+  snapshot.isActionEnabled = device.isActionEnabled;
+  snapshot.isTemperatureUseSetting = device.temperature().isUseSetting;
+  snapshot.autotuneState = device.temperature().autotune.state();
+  snapshot.autotuneCycles = device.temperature().autotune.cycles();
+
+  snapshot.deviceCount = 0;
+  for (uint8_t index : liveDevices) {
+    if (index >= myDevices.size() || snapshot.deviceCount >= SNAPSHOT_MAX_DEVICES) continue;
+    const Device& live = myDevices[index];
+    DeviceSnapshot& item = snapshot.devices[snapshot.deviceCount++];
+    item.index = index;
+    item.outputCount = 0;
+    item.outputsOn = 0;
+    for (const auto& relay : live.relays) {
+      if (!relay.isOutput) continue;
+      item.outputCount++;
+      if (relay.statePin) item.outputsOn++;
     }
+    item.isTimersEnabled = live.isTimersEnabled;
+    item.isScheduleEnabled = live.isScheduleEnabled;
+    item.isActionEnabled = live.isActionEnabled;
+    item.isTemperatureUseSetting = live.temperature().isUseSetting;
+    item.currentTemp = live.temperature().currentTemp;
+    item.setTemperature = live.temperature().setTemperature;
   }
+  snapshot.valid = true;
+}
 
-  if (!found) {}
+void DeviceManager::publishSnapshot() {
+  ControlSnapshot& web = bridge.webSnapshot.beginWrite();
+  fillSnapshot(web);
+  bridge.webSnapshot.publish();
 
-  return found;
+  ControlSnapshot& bot = bridge.botSnapshot.beginWrite();
+  fillSnapshot(bot);
+  bridge.botSnapshot.publish();
+}
+
+// Флаги устройства переключают и сами таймеры, расписания и действия - их
+// смена тоже публикует снимок; состояния реле в нём не обновляются
+static bool isSameFlags(const Device& a, const Device& b) {
+  if (a.isTimersEnabled != b.isTimersEnabled || a.isEncyclateTimers != b.isEncyclateTimers ||
+      a.isScheduleEnabled != b.isScheduleEnabled || a.isActionEnabled != b.isActionEnabled ||
+      a.temperatures.size() != b.temperatures.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.temperatures.size(); i++) {
+    if (a.temperatures[i].isUseSetting != b.temperatures[i].isUseSetting) return false;
+  }
+  return true;
+}
+
+void DeviceManager::publishConfig() {
+  bool isCurrent = currentDeviceIndex < myDevices.size();
+  if (!isConfigChanged) {
+    // config меняет только эта задача: читается без блокировки
+    if (!config || !isCurrent || isSameFlags(config->device, myDevices[currentDeviceIndex])) return;
+  }
+
+  std::shared_ptr<const DeviceConfigSnapshot> next;
+  if (isCurrent) {
+    DeviceConfigSnapshot* fresh = new (std::nothrow) DeviceConfigSnapshot();
+    if (!fresh) return;   // повтор на следующем проходе
+
+    fresh->deviceIndex = currentDeviceIndex;
+    fresh->device = myDevices[currentDeviceIndex];
+    for (auto& sensor : fresh->device.sensors) sensor.dht = nullptr;
+    for (auto& temp : fresh->device.temperatures) {
+      temp.sensorPtr = nullptr;
+      temp.relayPtr = nullptr;
+    }
+    fresh->deviceNames.reserve(myDevices.size());
+    for (const auto& device : myDevices) fresh->deviceNames.push_back(device.nameDevice);
+    next.reset(fresh);
+  }
+  isConfigChanged = false;
+
+  configLock.lock();
+  config.swap(next);
+  configLock.unlock();
+  // next - прежний снимок: освобождается здесь или последним читателем, вне блокировки
+}
+
+std::shared_ptr<const DeviceConfigSnapshot> DeviceManager::configSnapshot() const {
+  configLock.lock();
+  std::shared_ptr<const DeviceConfigSnapshot> snapshot = config;
+  configLock.unlock();
+  return snapshot;
+}
+
+// Запись снимка состояния по индексу - из той же версии конфигурации, если id совпал
+const char* DeviceManager::relayDescription(const Device& device, const RelaySnapshot& relay) {
+  if (relay.index >= device.relays.size() || device.relays[relay.index].id != relay.id) return "";
+  return device.relays[relay.index].description;
+}
+
+const char* DeviceManager::sensorDescription(const Device& device, const SensorSnapshot& sensor) {
+  if (sensor.index >= device.sensors.size() || device.sensors[sensor.index].sensorId != sensor.sensorId) return "";
+  return device.sensors[sensor.index].description;
 }
 
 void DeviceManager::serializeRelaysForControlTab(JsonObject& target) {
-    if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+    const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+    std::shared_ptr<const DeviceConfigSnapshot> config = configSnapshot();
+    if (!snapshot.valid || !config) {
         target["rel"] = JsonArray();
         return;
     }
 
-    const Device& device = myDevices[currentDeviceIndex];
+    const Device& device = config->device;
     JsonArray rel = target.createNestedArray("rel");
 
-    for (const auto& relay : device.relays) {
+    for (uint8_t i = 0; i < snapshot.relayCount; i++) {
+        const RelaySnapshot& relay = snapshot.relays[i];
         if (relay.isOutput) {
             JsonObject relayObj = rel.createNestedObject();
             relayObj["id"] = relay.id;
-            relayObj["dsc"] = relay.description;
+            relayObj["dsc"] = relayDescription(device, relay);
             relayObj["stp"] = relay.statePin;
             relayObj["man"] = relay.manualMode;
         }
@@ -1109,15 +1432,16 @@ void DeviceManager::serializeRelaysForControlTab(JsonObject& target) {
 }
 
 void DeviceManager::serializeSensorValues(JsonObject& target) {
-    if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+    const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+    if (!snapshot.valid) {
         target["sen"] = JsonArray();
         return;
     }
 
-    const Device& device = myDevices[currentDeviceIndex];
     JsonArray sen = target.createNestedArray("sen");
 
-    for (const auto& sensor : device.sensors) {
+    for (uint8_t i = 0; i < snapshot.sensorCount; i++) {
+        const SensorSnapshot& sensor = snapshot.sensors[i];
         if (sensor.isUseSetting) {
             JsonObject sensorObj = sen.createNestedObject();
             sensorObj["id"] = sensor.sensorId;
@@ -1129,51 +1453,79 @@ void DeviceManager::serializeSensorValues(JsonObject& target) {
 
 void DeviceManager::serializeTimersProgress(JsonObject& target) {
    Serial.println("serializeTimersProgress");
-    if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+    const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+    if (!snapshot.valid) {
         target["tmr"] = JsonArray();
         return;
     }
 
-    const Device& device = myDevices[currentDeviceIndex];
     JsonArray tmr = target.createNestedArray("tmr");
+    unsigned long now = millis();
 
-    for (size_t i = 0; i < device.timers.size(); ++i) {
-        const Timer& timer = device.timers[i];
-        const TimerInfo& progress = timer.progress;
+    for (uint8_t i = 0; i < snapshot.timerCount; ++i) {
+        const TimerSnapshot& timer = snapshot.timers[i];
 
         JsonObject timerObj = tmr.createNestedObject();
 
         timerObj["i"] = i;
         timerObj["e"] = timer.isUseSetting;
-        timerObj["et"] = progress.elapsedTime;
-        timerObj["rt"] = progress.remainingTime;
-        timerObj["r"] = progress.isRunning;
-        timerObj["s"] = progress.isStopped;
+        timerObj["et"] = timer.elapsedSeconds(now);
+        timerObj["rt"] = timer.remainingSeconds(now);
+        timerObj["r"] = timer.isRunning;
+        timerObj["s"] = timer.isStopped;
 
     }
 
 }
 
 void DeviceManager::serializeDeviceFlags(JsonObject& target) {
-    if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+    const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+    if (!snapshot.valid) {
         return;
     }
 
-    const Device& device = myDevices[currentDeviceIndex];
+    target["ite"] = snapshot.isTimersEnabled;
+    target["iet"] = snapshot.isEncyclateTimers;
+    target["ise"] = snapshot.isScheduleEnabled;
+    target["iae"] = snapshot.isActionEnabled;
+    target["tmp_use"] = snapshot.isTemperatureUseSetting;
+    target["tmp_atn"] = snapshot.autotuneState;
+    target["tmp_atc"] = snapshot.autotuneCycles;
+}
 
-    target["ite"] = device.isTimersEnabled;
-    target["iet"] = device.isEncyclateTimers;
-    target["ise"] = device.isScheduleEnabled;
-    target["iae"] = device.isActionEnabled;
-    target["tmp_use"] = device.temperature.isUseSetting;
+// Все устройства, которые сейчас исполняются; первым - текущее
+void DeviceManager::serializeLiveDevices(JsonObject& target) {
+    const ControlSnapshot& snapshot = bridge.webSnapshot.read();
+    std::shared_ptr<const DeviceConfigSnapshot> config = configSnapshot();
+    if (!snapshot.valid || !config) {
+        return;
+    }
+
+    JsonArray devices = target.createNestedArray("dev");
+    for (uint8_t i = 0; i < snapshot.deviceCount; i++) {
+        const DeviceSnapshot& device = snapshot.devices[i];
+        JsonObject item = devices.createNestedObject();
+        item["idx"] = device.index;
+        item["nmd"] = device.index < config->deviceNames.size() ? config->deviceNames[device.index].c_str() : "";
+        item["out"] = device.outputCount;
+        item["on"] = device.outputsOn;
+        item["ite"] = device.isTimersEnabled;
+        item["ise"] = device.isScheduleEnabled;
+        item["iae"] = device.isActionEnabled;
+        item["tmp_use"] = device.isTemperatureUseSetting;
+        item["ctp"] = device.currentTemp;
+        item["stT"] = device.setTemperature;
+    }
 }
 
 size_t DeviceManager::currentStateSensors(char* buffer, size_t bufferSize, bool includeHeader) {
-    if (myDevices.empty() || currentDeviceIndex >= myDevices.size()) {
+    const ControlSnapshot& snapshot = bridge.botSnapshot.read();
+    std::shared_ptr<const DeviceConfigSnapshot> config = configSnapshot();
+    if (!snapshot.valid || !config) {
         return snprintf(buffer, bufferSize, "Ошибка: Устройство не найдено или не настроено.");
     }
 
-    Device& device = myDevices[currentDeviceIndex];
+    const Device& device = config->device;
     size_t offset = 0;
     int written = 0;
 
@@ -1183,13 +1535,16 @@ size_t DeviceManager::currentStateSensors(char* buffer, size_t bufferSize, bool
         offset += written;
     }
 
-    for (size_t i = 0; i < device.sensors.size(); i++) {
-        const auto& sensor = device.sensors[i];
+    for (uint8_t i = 0; i < snapshot.sensorCount; i++) {
+        const SensorSnapshot& sensor = snapshot.sensors[i];
         if (!sensor.isUseSetting) {
             continue;
         }
 
-        const char* sensorName = sensor.description;
+        BitArray7 typeSensor;
+        typeSensor.bits = sensor.typeBits;
+
+        const char* sensorName = sensorDescription(device, sensor);
         if (strlen(sensorName) == 0) {
             written = snprintf(buffer + offset, bufferSize - offset, "  ID:%d: ", sensor.sensorId);
         } else {
@@ -1200,7 +1555,7 @@ size_t DeviceManager::currentStateSensors(char* buffer, size_t bufferSize, bool
 
         bool hasData = false;
 
-        if (sensor.typeSensor.get(0) || sensor.typeSensor.get(1)) {
+        if (typeSensor.get(0) || typeSensor.get(1)) {
             if (!isnan(sensor.currentValue)) {
                 written = snprintf(buffer + offset, bufferSize - offset, "T=%.1f°C", sensor.currentValue);
                 hasData = true;
@@ -1219,7 +1574,7 @@ size_t DeviceManager::currentStateSensors(char* buffer, size_t bufferSize, bool
             offset += written;
         }
 
-        else if (sensor.typeSensor.get(2)) {
+        else if (typeSensor.get(2)) {
             if (!isnan(sensor.currentValue)) {
                 written = snprintf(buffer + offset, bufferSize - offset, "NTC=%.1f°C", sensor.currentValue);
             } else {
@@ -1229,14 +1584,14 @@ size_t DeviceManager::currentStateSensors(char* buffer, size_t bufferSize, bool
             offset += written;
         }
 
-        else if (sensor.typeSensor.get(3)) {
+        else if (typeSensor.get(3)) {
             const char* state = (sensor.currentValue > 0.5) ? "НАЖАТО" : "ОТПУЩЕНО";
             written = snprintf(buffer + offset, bufferSize - offset, "Кнопка=%s", state);
             if (written < 0 || offset + written >= bufferSize) return offset;
             offset += written;
         }
 
-        else if (sensor.typeSensor.get(4)) {
+        else if (typeSensor.get(4)) {
             if (!isnan(sensor.currentValue) && sensor.currentValue != -1.0f) {
                 written = snprintf(buffer + offset, bufferSize - offset, "Аналог=%.0f", sensor.currentValue);
             } else {
@@ -1244,6 +1599,16 @@ size_t DeviceManager::currentStateSensors(char* buffer, size_t bufferSize, bool
             }
             if (written < 0 || offset + written >= bufferSize) return offset;
             offset += written;
+        }
+
+        else if (typeSensor.get(5)) {
+            if (!isnan(sensor.currentValue) && sensor.currentValue > -998.0f) {
+                written = snprintf(buffer + offset, bufferSize - offset, "Вирт=%.2f", sensor.currentValue);
+            } else {
+                written = snprintf(buffer + offset, bufferSize - offset, "Вирт=Ошибка");
+            }
+            if (written < 0 || offset + written >= bufferSize) return offset;
+            offset += written;
         } else {
              written = snprintf(buffer + offset, bufferSize - offset, "Не настроен");
              if (written < 0 || offset + written >= bufferSize) return offset;
@@ -1263,7 +1628,10 @@ void DeviceManager::saveDeviceFlagsState() {
     savedFlags.isEncyclateTimers = device.isEncyclateTimers;
     savedFlags.isScheduleEnabled = device.isScheduleEnabled;
     savedFlags.isActionEnabled = device.isActionEnabled;
-    savedFlags.isTemperatureUseSetting = device.temperature.isUseSetting;
+    savedFlags.temperatureUseMask = 0;
+    for (size_t i = 0; i < device.temperatures.size(); i++) {
+      if (device.temperatures[i].isUseSetting) savedFlags.temperatureUseMask |= 1 << i;
+    }
 }
 
 void DeviceManager::restoreDeviceFlagsState() {
@@ -1272,7 +1640,9 @@ void DeviceManager::restoreDeviceFlagsState() {
     device.isEncyclateTimers = savedFlags.isEncyclateTimers;
     device.isScheduleEnabled = savedFlags.isScheduleEnabled;
     device.isActionEnabled = savedFlags.isActionEnabled;
-    device.temperature.isUseSetting = savedFlags.isTemperatureUseSetting;
+    for (size_t i = 0; i < device.temperatures.size(); i++) {
+      device.temperatures[i].isUseSetting = savedFlags.temperatureUseMask & (1 << i);
+    }
 }
 
 void DeviceManager::deviceFlagsOff() {
@@ -1281,5 +1651,5 @@ void DeviceManager::deviceFlagsOff() {
     device.isEncyclateTimers = false;
     device.isScheduleEnabled = false;
     device.isActionEnabled = false;
-    device.temperature.isUseSetting = false;
+    for (auto& temperature : device.temperatures) temperature.isUseSetting = false;
 }
@@ -1,22 +1,28 @@
 #pragma once
 
-#include <DHT.h>
 #include "ESPAsyncWebServer.h"
 #include "CommonTypes.h"
 #include "AppState.h"
+#include "ControlBridge.h"
+#include "ScheduleIndex.h"
+#include "RuntimePlan.h"
+#include "PwmPlanner.h"
+#include "DhtReader.h"
+#include "AdcSampler.h"
+#include "NtcModel.h"
+#include "PidAutotune.h"
+#include "GestureRecognizer.h"
+#include "ExpressionVm.h"
+#include "SensorHistory.h"
+#include "SpinLock.h"
 
 #define MAX_DESCRIPTION_LENGTH 120
+#define MAX_TEMPERATURE_LOOPS 4
 #define MAX_TXT_DESCRIPTION_LENGTH 512
-#define MAX_TIME_LENGTH 10
+#define MAX_TIME_LENGTH 13            // "ЧЧ:ММ:СС.мсм"
+#define TIMER_MIN_STEP_MS 10
 #define MAX_DATE_LENGTH 11
 
-struct TouchSensorState {
-  unsigned long lastDebounceTime = 0;
-  bool lastState = HIGH;
-  bool pressed = false;
-  unsigned long pressStartTime = 0;
-};
-
 struct BitArray4 {
     uint8_t bits;
     bool get(int index) const { return (bits >> index) & 1; }
@@ -62,7 +68,7 @@ struct DeviceRuntimeState {
     bool isEncyclateTimers;
     bool isScheduleEnabled;
     bool isActionEnabled;
-    bool isTemperatureUseSetting; 
+    uint8_t temperatureUseMask;  // бит на контур температуры
 };
 
 struct Relay {
@@ -76,6 +82,11 @@ struct Relay {
   uint8_t pwm;
   bool lastState;
   char description[MAX_DESCRIPTION_LENGTH];
+
+  // Параметры ШИМ: частота, разрядность (до 14 бит), время плавного перехода 0 -> 100%
+  uint32_t pwmFrequency = PWM_DEFAULT_FREQUENCY;
+  uint8_t pwmResolution = PWM_DEFAULT_RESOLUTION;
+  uint16_t pwmRampMs = 0;
 };
 
 struct OutPower {
@@ -87,6 +98,7 @@ struct OutPower {
   uint8_t pwm;
   bool isReturn;
 
+  int16_t relayIndex = PLAN_NO_INDEX;
 };
 
 struct startEndTime {
@@ -109,6 +121,8 @@ struct ScheduleScenario {
 
   bool initialStateApplied;
   bool endStateApplied;
+
+  CompiledSchedule compiled;
 };
 
 struct Pid {
@@ -127,8 +141,25 @@ struct Sensor {
   uint16_t thermistor_r;
   float currentValue = -999.0f;
   float humidityValue = -999.0f;
-  DHT* dht = nullptr;
+  DhtReader* dht = nullptr;
   char description[MAX_DESCRIPTION_LENGTH];
+
+  int16_t inputRelayIndex = PLAN_NO_INDEX;
+  uint8_t inputPin = 0;
+
+  uint8_t filter = ADC_FILTER_MEAN;   // AdcFilter для аналоговых входов
+
+  // Модель NTC: Beta или коэффициенты Стейнхарта-Харта (все нули - Beta), поправка в °C
+  float ntcBeta = 3950.0f;
+  float ntcShA = 0.0f;
+  float ntcShB = 0.0f;
+  float ntcShC = 0.0f;
+  float ntcOffset = -1.0f;
+  LinearTable ntcTable;   // мВ * 16 -> сотые доли °C, строит compileSensor
+
+  // Виртуальный сенсор (тип 5): значение - выражение над другими сенсорами и реле
+  String expression;
+  ExpressionProgram program;   // строит buildRuntimePlan
 };
 
 struct Action {
@@ -145,7 +176,17 @@ struct Action {
    BitArray4 collectionSettings;
    String sendMsg;
    bool isReturnSetting;
+   // GESTURE_NONE - срабатывание по порогу; иначе по жесту кнопки-сенсора,
+   // повторный жест при isReturnSetting возвращает выходы
+   uint8_t gesture = GESTURE_NONE;
+   // Непустое условие заменяет порог сенсора: истинно - срабатывание, ложно - сброс
+   String condition;
+   ExpressionProgram conditionProgram;   // строит buildRuntimePlan
    bool wasTriggered = false;
+   bool isPending = false;
+
+   int16_t conditionRelayIndex = PLAN_NO_INDEX;
+   int16_t sensorIndex = PLAN_NO_INDEX;
 };
 
 struct Temperature {
@@ -163,18 +204,19 @@ struct Temperature {
 
      Sensor* sensorPtr = nullptr;
     Relay* relayPtr = nullptr;
+
+    PidAutotune autotune;   // не сохраняется, прерывается при смене конфигурации
 };
 
+// Прошедшее и оставшееся время не хранятся: их считают от startedAt при чтении
 struct TimerInfo {
 
-    unsigned long elapsedTime = 0;
-    unsigned long remainingTime = 0;
+    unsigned long startedAt = 0;
     bool isRunning = false;
     bool isStopped = false;
 
     void clear() {
-        elapsedTime = 0;
-        remainingTime = 0;
+        startedAt = 0;
         isRunning = false;
         isStopped = false;
     }
@@ -183,6 +225,7 @@ struct TimerInfo {
 struct Timer {
   bool isUseSetting;
   char time[MAX_TIME_LENGTH];
+  uint32_t durationMs = 0;        // из time, строит compileTimer
   BitArray4 collectionSettings;
   OutPower initialStateRelay;
   OutPower endStateRelay;
@@ -195,7 +238,9 @@ struct Device {
   std::vector<Relay> relays;
   std::vector<uint8_t> pins;
   std::vector<ScheduleScenario> scheduleScenarios;
-  Temperature temperature;
+  // [0] - основной контур ("tmp"), им управляют таймеры, расписания и действия;
+  // остальные - независимые зоны ("tzn")
+  std::vector<Temperature> temperatures = std::vector<Temperature>(1);
 
   std::vector<Pid> pids;
   std::vector<Timer> timers;
@@ -208,6 +253,23 @@ struct Device {
   bool isActionEnabled;
 
   bool isForceControlRelay;
+
+  uint16_t adcRateHz = ADC_DEFAULT_RATE_HZ;   // отсчётов в секунду на аналоговый вход
+
+  RuntimePlan plan;
+  ScheduleHorizon scheduleHorizon;
+
+  Temperature& temperature() { return temperatures[0]; }
+  const Temperature& temperature() const { return temperatures[0]; }
+};
+
+// Конфигурация текущего устройства для сетевых задач: выдача настроек, копии
+// для /saveDevice и PATCH /device, имена и описания в статусе. Публикует задача
+// управления после изменений; снимок не меняется, без DHT и указателей контуров.
+struct DeviceConfigSnapshot {
+  uint8_t deviceIndex = 0;              // currentDeviceIndex на момент публикации
+  Device device;
+  std::vector<String> deviceNames;      // nameDevice всех устройств
 };
 
 class DeviceManager {
@@ -216,7 +278,13 @@ public:
 
     std::vector<Device> myDevices;
     uint8_t currentDeviceIndex = 0;
-    bool isSaveControl = false;
+
+    // Устройства, исполняемые задачей управления; первым - текущее.
+    // Меняется только в задаче управления (Control::setupControl).
+    std::vector<uint8_t> liveDevices;
+    bool isMultiDevice = false;   // все устройства с непересекающимися пинами работают одновременно
+    bool isLiveDevice(size_t index) const;
+    std::atomic<bool> isSaveControl{false};
     bool isResultSaveControl = false;
 
     struct {
@@ -228,11 +296,29 @@ public:
     void initializeDevice(const char* name, bool activ, bool isNewDevice = false);
     int deviceInit();
 
-    String serializeDevice(const Device& device, const char* fileName = nullptr, AsyncWebServerRequest *request = nullptr);
-    bool deserializeDevice(JsonObject doc, Device& device);
+    // JSON только для интерфейса: выгрузка - DeviceJsonWriter, приём -
+    // DeviceJsonReader; на флеше - DeviceConfigFile
+    void compileSchedule(ScheduleScenario& scenario);
+    void compileSensor(Sensor& sensor);
+    void compileTimer(Timer& timer);
+    void buildRuntimePlan(Device& device);
+    void compileDevice(Device& device);   // всё перечисленное для загруженного устройства
+
+    // PATCH /device: копия записи из снимка конфигурации разбирается и компилируется
+    // в сетевой задаче, подменяет оригинал задача управления (CMD_PATCH_ITEM)
+    int findItemIndex(const Device& device, DevicePatchSection section, int id);
+    static void* copyItem(const Device& device, DevicePatchSection section, size_t index);
+    static void deleteItem(DevicePatchSection section, void* record);
+    void compileItem(DevicePatchSection section, void* record);
+
+    // Задача управления (saveControl): применённые правки - в журнал из снимка
+    // конфигурации, без перезаписи всей конфигурации
+    void savePatchedItems();
+    void discardPatchedItems();
 
     bool writeDevicesToFile(const std::vector<Device>& myDevices, const char* filename);
     bool readDevicesFromFile(std::vector<Device>& myDevices, const char* filename);
+    bool importDevicesJson(std::vector<Device>& myDevices, const char* filename);
 
     void saveRelayStates(uint8_t targetRelayId);
     void restoreRelayStates(uint8_t targetRelayId);
@@ -240,17 +326,36 @@ public:
     int getSelectedDeviceIndex(const std::vector<Device>& myDevices);
     size_t currentStateSensors(char* buffer, size_t bufferSize, bool includeHeader = true);
 
+    // Команды от сети: проверяются и ставятся в очередь задачи управления.
+    ControlBridge bridge;
+
+    // История показаний: пишет задача управления, читает /history.
+    SensorHistory history;
     bool handleRelayCommand(const JsonObject& command, uint32_t clientNum);
 
+    // Вызываются только из задачи управления.
+    bool applyCommand(const ControlCommand& command);
+    void publishSnapshot();
+    void markConfigChanged() { isConfigChanged = true; }
+    void publishConfig();   // если отмечено markConfigChanged или сменились флаги устройства
+
+    // Любая задача; пустой до первой публикации
+    std::shared_ptr<const DeviceConfigSnapshot> configSnapshot() const;
+    // Описание записи из снимка состояния; "" - снимки от разных версий конфигурации
+    static const char* relayDescription(const Device& device, const RelaySnapshot& relay);
+    static const char* sensorDescription(const Device& device, const SensorSnapshot& sensor);
+
     void serializeRelaysForControlTab(JsonObject& target);
     void serializeTimersProgress(JsonObject& target);
     void serializeDeviceFlags(JsonObject& target);
     void serializeSensorValues(JsonObject& target);
+    void serializeLiveDevices(JsonObject& target);
 
     uint32_t calculateDeviceFlagsChecksum();
     uint32_t calculateOutputRelayChecksum();
     uint32_t calculateSensorValuesChecksum();
     uint32_t calculateTimersProgressChecksum();
+    uint32_t calculateLiveDevicesChecksum();
 
     String serializeRelaysOnly();
 
@@ -266,7 +371,13 @@ AppState& appState;
     int findSensorIndexById(const Device& device, int sensorId);
     Relay* findRelayById(Device& device, uint8_t relayId);
 
-    void convertBooleansToIntegers(JsonVariant variant);
+    void fillSnapshot(ControlSnapshot& snapshot);
+    void bindTemperatures(Device& device);
+    bool applyPatch(Device& device, const ControlCommand& command);
+
+    std::shared_ptr<const DeviceConfigSnapshot> config;
+    mutable SpinLock configLock;
+    bool isConfigChanged = true;
 
     void strncpy_safe(char* dest, const char* src, size_t destSize) {
         strncpy(dest, src, destSize - 1);
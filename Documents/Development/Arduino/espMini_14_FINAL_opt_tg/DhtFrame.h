@@ -0,0 +1,100 @@
+#ifndef DHT_FRAME_H
+#define DHT_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Разбор кадра DHT11/DHT22 по длительностям уровней на линии.
+// Без Arduino: проверяется на хосте по записанным временам фронтов,
+// захват (RMT или прерывания) - в DhtReader.
+
+// Ответ датчика: низкий ~80 мкс, затем высокий ~80 мкс
+#define DHT_RESPONSE_MIN_US 40
+#define DHT_RESPONSE_MAX_US 120
+// Бит: низкий ~50 мкс, затем высокий 26-28 мкс (0) или ~70 мкс (1)
+#define DHT_BIT_LOW_MIN_US 30
+#define DHT_BIT_LOW_MAX_US 90
+#define DHT_BIT_HIGH_MIN_US 10
+#define DHT_BIT_HIGH_MAX_US 95
+#define DHT_BIT_ONE_THRESHOLD_US 48
+
+#define DHT_FRAME_BITS 40
+
+// Уровень линии и время, которое она в нём провела.
+struct DhtEdge {
+    uint8_t level;
+    uint16_t durationUs;
+};
+
+enum DhtStatus : uint8_t {
+    DHT_OK,
+    DHT_PENDING,       // чтения ещё не было
+    DHT_NO_RESPONSE,
+    DHT_TRUNCATED,
+    DHT_BAD_TIMING,
+    DHT_BAD_CHECKSUM
+};
+
+struct DhtReading {
+    float temperature;
+    float humidity;
+};
+
+class DhtFrameDecoder {
+public:
+    static DhtStatus decodeBits(const DhtEdge* edges, size_t count, uint8_t data[5]) {
+        size_t i = 0;
+        for (; i + 1 < count; i++) {
+            if (isPulse(edges[i], 0, DHT_RESPONSE_MIN_US, DHT_RESPONSE_MAX_US) &&
+                isPulse(edges[i + 1], 1, DHT_RESPONSE_MIN_US, DHT_RESPONSE_MAX_US)) {
+                break;
+            }
+        }
+        if (i + 1 >= count) return DHT_NO_RESPONSE;
+        i += 2;
+
+        memset(data, 0, 5);
+        for (uint8_t bit = 0; bit < DHT_FRAME_BITS; bit++, i += 2) {
+            if (i + 1 >= count) return DHT_TRUNCATED;
+
+            if (!isPulse(edges[i], 0, DHT_BIT_LOW_MIN_US, DHT_BIT_LOW_MAX_US) ||
+                !isPulse(edges[i + 1], 1, DHT_BIT_HIGH_MIN_US, DHT_BIT_HIGH_MAX_US)) {
+                return DHT_BAD_TIMING;
+            }
+
+            data[bit / 8] <<= 1;
+            if (edges[i + 1].durationUs > DHT_BIT_ONE_THRESHOLD_US) data[bit / 8] |= 1;
+        }
+
+        if ((uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4]) return DHT_BAD_CHECKSUM;
+        return DHT_OK;
+    }
+
+    static void convert(const uint8_t data[5], bool isDht11, DhtReading& reading) {
+        if (isDht11) {
+            float temperature = data[2];
+            if (data[3] & 0x80) temperature = -1 - temperature;
+            reading.temperature = temperature + (data[3] & 0x0F) * 0.1f;
+            reading.humidity = data[0] + data[1] * 0.1f;
+        } else {
+            float temperature = (((uint16_t)(data[2] & 0x7F)) << 8 | data[3]) * 0.1f;
+            reading.temperature = (data[2] & 0x80) ? -temperature : temperature;
+            reading.humidity = (((uint16_t)data[0]) << 8 | data[1]) * 0.1f;
+        }
+    }
+
+    static DhtStatus decode(const DhtEdge* edges, size_t count, bool isDht11, DhtReading& reading) {
+        uint8_t data[5];
+        DhtStatus status = decodeBits(edges, count, data);
+        if (status == DHT_OK) convert(data, isDht11, reading);
+        return status;
+    }
+
+private:
+    static bool isPulse(const DhtEdge& edge, uint8_t level, uint16_t minUs, uint16_t maxUs) {
+        return edge.level == level && edge.durationUs >= minUs && edge.durationUs <= maxUs;
+    }
+};
+
+#endif
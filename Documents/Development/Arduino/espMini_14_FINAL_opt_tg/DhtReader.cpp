@@ -0,0 +1,263 @@
+#include "DhtReader.h"
+
+// Стартовый импульс: DHT11 - не меньше 18 мс, DHT22 - не меньше 1 мс
+#define DHT11_START_MS 20
+#define DHT22_START_MS 2
+// Минимальный интервал между чтениями датчика
+#define DHT11_INTERVAL_MS 1000
+#define DHT22_INTERVAL_MS 2000
+
+#if defined(ESP32)
+// Тишина на линии дольше этого - конец кадра
+#define DHT_RMT_IDLE_US 150
+// Импульсы короче - помехи
+#define DHT_RMT_FILTER_NS 1250
+
+// Символ RMT - два уровня с длительностями; у обоих драйверов поля одинаковые
+template<typename Item>
+static size_t appendRmtItems(const Item* items, size_t itemCount, DhtEdge* edges) {
+    size_t count = 0;
+    for (size_t i = 0; i < itemCount && count + 2 <= DHT_MAX_EDGES; i++) {
+        if (items[i].duration0 == 0) break;
+        edges[count++] = { (uint8_t)items[i].level0, (uint16_t)items[i].duration0 };
+        if (items[i].duration1 == 0) break;
+        edges[count++] = { (uint8_t)items[i].level1, (uint16_t)items[i].duration1 };
+    }
+    return count;
+}
+#endif
+
+#if defined(ESP32) && !defined(DHT_RMT_RX)
+#if defined(SOC_RMT_RX_CANDIDATES_PER_GROUP)
+#define DHT_RMT_CHANNELS SOC_RMT_RX_CANDIDATES_PER_GROUP
+#else
+#define DHT_RMT_CHANNELS 8
+#endif
+
+#if defined(RMT_ENCODE_RX_CHANNEL)
+#define DHT_RMT_CHANNEL(n) ((rmt_channel_t)RMT_ENCODE_RX_CHANNEL(n))
+#else
+#define DHT_RMT_CHANNEL(n) ((rmt_channel_t)(n))
+#endif
+
+uint8_t DhtReader::usedChannels = 0;
+#endif
+
+DhtReader::DhtReader(uint8_t pin, bool isDht11) : dataPin(pin), isDht11(isDht11) {}
+
+DhtReader::~DhtReader() {
+    releaseTimer.detach();
+    if (state.load() == CAPTURING) {
+        stopCapture();
+    }
+
+#if defined(DHT_RMT_RX)
+    if (rxChannel) {
+        rmt_disable(rxChannel);
+        rmt_del_channel(rxChannel);
+    }
+#elif defined(ESP32)
+    if (rmtChannel >= 0) {
+        rmt_driver_uninstall(DHT_RMT_CHANNEL(rmtChannel));
+        usedChannels &= ~(1U << rmtChannel);
+    }
+#endif
+}
+
+bool DhtReader::begin() {
+#if defined(DHT_RMT_RX)
+    rmt_rx_channel_config_t config = {};
+    config.gpio_num = (gpio_num_t)dataPin;
+    config.clk_src = RMT_CLK_SRC_DEFAULT;
+    config.resolution_hz = 1000000;  // 1 тик = 1 мкс
+    config.mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL;
+    if (rmt_new_rx_channel(&config, &rxChannel) != ESP_OK) {
+        rxChannel = nullptr;
+        return false;
+    }
+
+    rmt_rx_event_callbacks_t callbacks = {};
+    callbacks.on_recv_done = onReceived;
+    if (rmt_rx_register_event_callbacks(rxChannel, &callbacks, this) != ESP_OK ||
+        rmt_enable(rxChannel) != ESP_OK) {
+        rmt_del_channel(rxChannel);
+        rxChannel = nullptr;
+        return false;
+    }
+
+    gpio_set_direction((gpio_num_t)dataPin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode((gpio_num_t)dataPin, GPIO_PULLUP_ONLY);
+    gpio_set_level((gpio_num_t)dataPin, 1);
+#elif defined(ESP32)
+    for (int8_t n = 0; n < DHT_RMT_CHANNELS; n++) {
+        if (!(usedChannels & (1U << n))) {
+            rmtChannel = n;
+            break;
+        }
+    }
+    if (rmtChannel < 0) return false;
+
+    rmt_config_t config = {};
+    config.rmt_mode = RMT_MODE_RX;
+    config.channel = DHT_RMT_CHANNEL(rmtChannel);
+    config.gpio_num = (gpio_num_t)dataPin;
+    config.clk_div = 80;  // 1 тик = 1 мкс
+    config.mem_block_num = 1;
+    config.rx_config.filter_en = true;
+    config.rx_config.filter_ticks_thresh = 100;
+    config.rx_config.idle_threshold = DHT_RMT_IDLE_US;
+
+    if (rmt_config(&config) != ESP_OK ||
+        rmt_driver_install(config.channel, 512, 0) != ESP_OK) {
+        rmtChannel = -1;
+        return false;
+    }
+    rmt_get_ringbuf_handle(config.channel, &ringBuffer);
+    usedChannels |= 1U << rmtChannel;
+
+    // Открытый сток: вход остаётся подключён к RMT, линию тянет подтяжка
+    gpio_set_direction((gpio_num_t)dataPin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode((gpio_num_t)dataPin, GPIO_PULLUP_ONLY);
+    gpio_set_level((gpio_num_t)dataPin, 1);
+#else
+    pinMode(dataPin, INPUT_PULLUP);
+#endif
+
+    ready = true;
+    return true;
+}
+
+bool DhtReader::start(uint32_t now) {
+    if (!ready || state.load() != IDLE) return false;
+
+    uint32_t interval = isDht11 ? DHT11_INTERVAL_MS : DHT22_INTERVAL_MS;
+    if (hasStarted && now - startedAt < interval) return false;
+
+    hasStarted = true;
+    startedAt = now;
+    state.store(START_PULSE);
+
+#if defined(ESP32)
+    gpio_set_level((gpio_num_t)dataPin, 0);
+#else
+    pinMode(dataPin, OUTPUT);
+    digitalWrite(dataPin, LOW);
+#endif
+
+    releaseTimer.once_ms(isDht11 ? DHT11_START_MS : DHT22_START_MS, onRelease, this);
+    return true;
+}
+
+void DhtReader::onRelease(DhtReader* reader) {
+    reader->release();
+}
+
+// Конец стартового импульса: отпускаем линию и начинаем захват
+void DhtReader::release() {
+#if defined(DHT_RMT_RX)
+    rmt_receive_config_t config = {};
+    config.signal_range_min_ns = DHT_RMT_FILTER_NS;
+    config.signal_range_max_ns = DHT_RMT_IDLE_US * 1000;
+    symbolCount.store(0);
+    rmt_receive(rxChannel, symbols, sizeof(symbols), &config);
+    gpio_set_level((gpio_num_t)dataPin, 1);
+#elif defined(ESP32)
+    rmt_rx_start(DHT_RMT_CHANNEL(rmtChannel), true);
+    gpio_set_level((gpio_num_t)dataPin, 1);
+#else
+    edgeCount = 0;
+    lastEdgeUs = micros();
+    lastLevel = 0;
+    attachInterruptArg(dataPin, onEdge, this, CHANGE);
+    pinMode(dataPin, INPUT_PULLUP);
+#endif
+
+    releasedAt.store(millis());
+    state.store(CAPTURING);
+}
+
+#if defined(DHT_RMT_RX)
+bool IRAM_ATTR DhtReader::onReceived(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t* data, void* arg) {
+    static_cast<DhtReader*>(arg)->symbolCount.store(data->num_symbols);
+    return false;
+}
+#elif !defined(ESP32)
+void IRAM_ATTR DhtReader::onEdge(void* arg) {
+    DhtReader* reader = static_cast<DhtReader*>(arg);
+    uint32_t now = micros();
+    uint8_t level = digitalRead(reader->dataPin);
+
+    uint8_t count = reader->edgeCount;
+    if (count < DHT_MAX_EDGES) {
+        uint32_t duration = now - reader->lastEdgeUs;
+        reader->edges[count].level = reader->lastLevel;
+        reader->edges[count].durationUs = duration > 0xFFFF ? 0xFFFF : duration;
+        reader->edgeCount = count + 1;
+    }
+    reader->lastEdgeUs = now;
+    reader->lastLevel = level;
+}
+#endif
+
+void DhtReader::stopCapture() {
+#if defined(DHT_RMT_RX)
+    // Незавершённый приём отменяется только выключением канала
+    if (symbolCount.load() == 0) {
+        rmt_disable(rxChannel);
+        rmt_enable(rxChannel);
+    }
+#elif defined(ESP32)
+    rmt_rx_stop(DHT_RMT_CHANNEL(rmtChannel));
+#else
+    detachInterrupt(dataPin);
+#endif
+}
+
+bool DhtReader::poll(uint32_t now) {
+    if (state.load() != CAPTURING) return false;
+
+    size_t count = collectEdges(now);
+    if (count == 0 && now - releasedAt.load() < DHT_FRAME_TIMEOUT_MS) return false;
+
+    stopCapture();
+    if (count == 0) {
+        finish(DHT_NO_RESPONSE);
+        return true;
+    }
+
+    DhtReading reading;
+    DhtStatus status = DhtFrameDecoder::decode(edges, count, isDht11, reading);
+    if (status == DHT_OK) lastReading = reading;
+    finish(status);
+    return true;
+}
+
+// Готовые длительности уровней; 0 - кадр ещё не завершён.
+size_t DhtReader::collectEdges(uint32_t now) {
+#if defined(DHT_RMT_RX)
+    size_t received = symbolCount.load();
+    if (received == 0) return 0;
+    return appendRmtItems(symbols, received, edges);
+#elif defined(ESP32)
+    size_t size = 0;
+    rmt_item32_t* items = (rmt_item32_t*)xRingbufferReceive(ringBuffer, &size, 0);
+    if (!items) return 0;
+
+    size_t count = appendRmtItems(items, size / sizeof(rmt_item32_t), edges);
+    vRingbufferReturnItem(ringBuffer, items);
+    return count;
+#else
+    // Кадр занимает ~5 мс: ждём таймаут или заполнения буфера
+    if (now - releasedAt.load() < DHT_FRAME_TIMEOUT_MS && edgeCount < DHT_MAX_EDGES) return 0;
+    return edgeCount;
+#endif
+}
+
+void DhtReader::finish(DhtStatus status) {
+    lastStatus = status;
+    if (status != DHT_OK) {
+        lastReading.temperature = -999.0f;
+        lastReading.humidity = -999.0f;
+    }
+    state.store(IDLE);
+}
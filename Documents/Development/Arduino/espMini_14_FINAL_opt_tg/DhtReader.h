@@ -0,0 +1,92 @@
+#ifndef DHT_READER_H
+#define DHT_READER_H
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <atomic>
+#include "DhtFrame.h"
+
+#if defined(ESP32)
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION_MAJOR >= 5
+// IDF 5 (Arduino-ESP32 3.x): только новый драйвер RMT, вместе со старым он не работает
+#include "driver/rmt_rx.h"
+#include "soc/soc_caps.h"
+#define DHT_RMT_RX
+#else
+#include "driver/rmt.h"
+#endif
+#endif
+
+// Неблокирующее чтение DHT11/DHT22. Стартовый импульс снимается по таймеру,
+// кадр захватывается RMT (ESP32) или прерыванием по фронтам (ESP8266),
+// разбор - в poll(). Цикл управления на чтении не ждёт.
+
+#define DHT_MAX_EDGES 96
+#define DHT_FRAME_TIMEOUT_MS 10
+
+class DhtReader {
+public:
+    DhtReader(uint8_t pin, bool isDht11);
+    ~DhtReader();
+
+    DhtReader(const DhtReader&) = delete;
+    DhtReader& operator=(const DhtReader&) = delete;
+
+    // false - не удалось занять канал захвата.
+    bool begin();
+
+    // Начинает чтение, если шина свободна и прошёл минимальный интервал датчика.
+    bool start(uint32_t now);
+
+    // true - чтение завершилось (успешно или с ошибкой), результат в status()/reading().
+    bool poll(uint32_t now);
+
+    DhtStatus status() const { return lastStatus; }
+    const DhtReading& reading() const { return lastReading; }
+    uint8_t pin() const { return dataPin; }
+
+private:
+    enum State : uint8_t { IDLE, START_PULSE, CAPTURING };
+
+    uint8_t dataPin;
+    bool isDht11;
+    bool ready = false;
+
+    std::atomic<uint8_t> state{IDLE};
+    std::atomic<uint32_t> releasedAt{0};
+    uint32_t startedAt = 0;
+    bool hasStarted = false;
+
+    Ticker releaseTimer;
+
+    DhtStatus lastStatus = DHT_PENDING;
+    DhtReading lastReading = { -999.0f, -999.0f };
+
+    DhtEdge edges[DHT_MAX_EDGES];
+
+#if defined(DHT_RMT_RX)
+    // Каналы раздаёт драйвер; кадр пишется в symbols, число символов - из прерывания
+    rmt_channel_handle_t rxChannel = nullptr;
+    rmt_symbol_word_t symbols[DHT_MAX_EDGES / 2];
+    std::atomic<size_t> symbolCount{0};
+    static bool IRAM_ATTR onReceived(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t* data, void* arg);
+#elif defined(ESP32)
+    int8_t rmtChannel = -1;
+    RingbufHandle_t ringBuffer = nullptr;
+    static uint8_t usedChannels;
+#else
+    volatile uint8_t edgeCount = 0;
+    volatile uint32_t lastEdgeUs = 0;
+    volatile uint8_t lastLevel = 1;
+    static void IRAM_ATTR onEdge(void* arg);
+#endif
+
+    static void onRelease(DhtReader* reader);
+    void release();
+    void stopCapture();
+    size_t collectEdges(uint32_t now);
+    void finish(DhtStatus status);
+};
+
+#endif
@@ -0,0 +1,382 @@
+#ifndef EXPRESSION_VM_H
+#define EXPRESSION_VM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+// Выражения условий действий и виртуальных сенсоров, например
+//   s3 > 30 and h3 < 40 and r2 and between(08:00, 20:00)
+//   dew(s1, h1)        abs(s4 - s5)
+// s<id> - значение сенсора, h<id> - влажность, r<id> - реле включено (1/0),
+// now - минута суток, ЧЧ:ММ - минута суток как число. Операции: + - * /,
+// сравнения, and/or/not (&& || !), функции min, max, abs, dew, between.
+// Текст компилируется при загрузке конфигурации в байткод регистровой
+// машины: id уже заменены индексами, вычисление без выделения памяти и строк.
+// Ошибка сенсора (-999) даёт NaN, сравнение с NaN ложно.
+// Без Arduino: проверяется на хосте.
+
+#define EXPR_MAX_REGISTERS 16
+#define EXPR_MAX_NESTING 32      // скобки, not и унарный минус: глубина рекурсии разбора
+#define EXPR_SENSOR_ERROR -998.0f
+
+enum ExpressionOp : uint8_t {
+    EXPR_LOADK,      // dst = constants[index]
+    EXPR_SENSOR,     // dst = значение сенсора index
+    EXPR_HUMIDITY,
+    EXPR_RELAY,
+    EXPR_NOW,
+    EXPR_ADD, EXPR_SUB, EXPR_MUL, EXPR_DIV,
+    EXPR_NEG,
+    EXPR_LT, EXPR_LE, EXPR_GT, EXPR_GE, EXPR_EQ, EXPR_NE,
+    EXPR_AND, EXPR_OR, EXPR_NOT,
+    EXPR_MIN, EXPR_MAX, EXPR_ABS,
+    EXPR_DEW,        // точка росы по температуре a и влажности b
+    EXPR_BETWEEN     // now в [a, b), окно может переходить через полночь
+};
+
+struct ExpressionInstruction {
+    uint8_t op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+    uint16_t index;
+};
+
+// id -> индекс при компиляции (план устройства); PLAN_NO_INDEX (-1) - нет такого
+class ExpressionResolver {
+public:
+    virtual int16_t sensorIndex(int id) const = 0;
+    virtual int16_t relayIndex(int id) const = 0;
+};
+
+// Текущие значения при вычислении
+class ExpressionEnv {
+public:
+    virtual float sensorValue(uint16_t index) const = 0;
+    virtual float humidityValue(uint16_t index) const = 0;
+    virtual bool relayState(uint16_t index) const = 0;
+    virtual int minuteOfDay() const = 0;
+};
+
+class ExpressionProgram {
+public:
+    bool empty() const { return code.empty(); }
+
+    float evaluate(const ExpressionEnv& env) const {
+        float r[EXPR_MAX_REGISTERS];
+        for (const ExpressionInstruction& in : code) {
+            const float& a = r[in.a];
+            const float& b = r[in.b];
+            float& d = r[in.dst];
+            switch (in.op) {
+                case EXPR_LOADK:    d = constants[in.index]; break;
+                case EXPR_SENSOR:   d = checked(env.sensorValue(in.index)); break;
+                case EXPR_HUMIDITY: d = checked(env.humidityValue(in.index)); break;
+                case EXPR_RELAY:    d = env.relayState(in.index) ? 1.0f : 0.0f; break;
+                case EXPR_NOW:      d = env.minuteOfDay(); break;
+                case EXPR_ADD:      d = a + b; break;
+                case EXPR_SUB:      d = a - b; break;
+                case EXPR_MUL:      d = a * b; break;
+                case EXPR_DIV:      d = b != 0.0f ? a / b : NAN; break;
+                case EXPR_NEG:      d = -a; break;
+                case EXPR_LT:       d = a < b; break;
+                case EXPR_LE:       d = a <= b; break;
+                case EXPR_GT:       d = a > b; break;
+                case EXPR_GE:       d = a >= b; break;
+                case EXPR_EQ:       d = a == b; break;
+                case EXPR_NE:       d = a != b; break;
+                case EXPR_AND:      d = isTrue(a) && isTrue(b); break;
+                case EXPR_OR:       d = isTrue(a) || isTrue(b); break;
+                case EXPR_NOT:      d = !isTrue(a); break;
+                case EXPR_MIN:      d = a < b ? a : b; break;
+                case EXPR_MAX:      d = a > b ? a : b; break;
+                case EXPR_ABS:      d = fabsf(a); break;
+                case EXPR_DEW:      d = dewPoint(a, b); break;
+                case EXPR_BETWEEN: {
+                    float now = env.minuteOfDay();
+                    d = a <= b ? (now >= a && now < b) : (now >= a || now < b);
+                    break;
+                }
+            }
+        }
+        return code.empty() ? NAN : r[0];
+    }
+
+    static bool isTrue(float value) { return value != 0.0f && !isnan(value); }
+
+    // Зависимости для плана: по ним выражение пересчитывается
+    const std::vector<uint16_t>& sensors() const { return sensorRefs; }
+    const std::vector<uint16_t>& relays() const { return relayRefs; }
+    bool usesTime() const { return timeRef; }
+    size_t size() const { return code.size(); }
+
+private:
+    friend class ExpressionCompiler;
+
+    std::vector<ExpressionInstruction> code;
+    std::vector<float> constants;
+    std::vector<uint16_t> sensorRefs;
+    std::vector<uint16_t> relayRefs;
+    bool timeRef = false;
+
+    static float checked(float value) { return value <= EXPR_SENSOR_ERROR ? NAN : value; }
+
+    // Формула Магнуса
+    static float dewPoint(float temperature, float humidity) {
+        if (isnan(temperature) || !(humidity > 0.0f)) return NAN;
+        const float a = 17.62f;
+        const float b = 243.12f;
+        float gamma = logf(humidity / 100.0f) + a * temperature / (b + temperature);
+        return b * gamma / (a - gamma);
+    }
+};
+
+// Рекурсивный спуск; результат подвыражения на глубине n лежит в регистре n
+class ExpressionCompiler {
+public:
+    // false - ошибка: текст в error(), позиция в errorPosition()
+    bool compile(const char* text, const ExpressionResolver& resolver, ExpressionProgram& program) {
+        source = text;
+        cursor = text;
+        target = &program;
+        names = &resolver;
+        errorText = nullptr;
+        nesting = 0;
+        program = ExpressionProgram();
+
+        if (!parseOr(0)) return fail();
+        skipSpaces();
+        if (*cursor != '\0') {
+            setError("лишний текст после выражения");
+            return fail();
+        }
+        return true;
+    }
+
+    const char* error() const { return errorText ? errorText : ""; }
+    size_t errorPosition() const { return errorAt; }
+
+private:
+    const char* source = nullptr;
+    const char* cursor = nullptr;
+    ExpressionProgram* target = nullptr;
+    const ExpressionResolver* names = nullptr;
+    const char* errorText = nullptr;
+    size_t errorAt = 0;
+    uint8_t nesting = 0;
+
+    bool fail() {
+        if (!errorText) setError("ошибка разбора");
+        *target = ExpressionProgram();
+        return false;
+    }
+
+    bool setError(const char* text) {
+        if (!errorText) {
+            errorText = text;
+            errorAt = cursor - source;
+        }
+        return false;
+    }
+
+    void skipSpaces() {
+        while (*cursor == ' ' || *cursor == '\t') cursor++;
+    }
+
+    bool accept(const char* token) {
+        skipSpaces();
+        size_t length = strlen(token);
+        if (strncmp(cursor, token, length) != 0) return false;
+        // Слово не должно быть началом более длинного имени
+        if (isWordChar(token[length - 1]) && isWordChar(cursor[length])) return false;
+        cursor += length;
+        return true;
+    }
+
+    static bool isWordChar(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    bool emit(uint8_t op, uint8_t dst, uint8_t a = 0, uint8_t b = 0, uint16_t index = 0) {
+        if (dst >= EXPR_MAX_REGISTERS || a >= EXPR_MAX_REGISTERS || b >= EXPR_MAX_REGISTERS) {
+            return setError("выражение слишком глубокое");
+        }
+        ExpressionInstruction instruction = { op, dst, a, b, index };
+        target->code.push_back(instruction);
+        return true;
+    }
+
+    bool binary(uint8_t op, uint8_t reg) {
+        return emit(op, reg, reg, reg + 1);
+    }
+
+    bool enter() {
+        return ++nesting <= EXPR_MAX_NESTING || setError("выражение слишком глубокое");
+    }
+
+    bool parseOr(uint8_t reg) {
+        if (!enter() || !parseAnd(reg)) return false;
+        while (accept("or") || accept("||")) {
+            if (!parseAnd(reg + 1) || !binary(EXPR_OR, reg)) return false;
+        }
+        nesting--;
+        return true;
+    }
+
+    bool parseAnd(uint8_t reg) {
+        if (!parseNot(reg)) return false;
+        while (accept("and") || accept("&&")) {
+            if (!parseNot(reg + 1) || !binary(EXPR_AND, reg)) return false;
+        }
+        return true;
+    }
+
+    bool parseNot(uint8_t reg) {
+        skipSpaces();
+        if (accept("not") || (cursor[0] == '!' && cursor[1] != '=' && accept("!"))) {
+            if (!enter() || !parseNot(reg)) return false;
+            nesting--;
+            return emit(EXPR_NOT, reg, reg);
+        }
+        return parseComparison(reg);
+    }
+
+    bool parseComparison(uint8_t reg) {
+        if (!parseSum(reg)) return false;
+        uint8_t op;
+        if (accept("<=")) op = EXPR_LE;
+        else if (accept(">=")) op = EXPR_GE;
+        else if (accept("==")) op = EXPR_EQ;
+        else if (accept("!=")) op = EXPR_NE;
+        else if (accept("<")) op = EXPR_LT;
+        else if (accept(">")) op = EXPR_GT;
+        else return true;
+        return parseSum(reg + 1) && binary(op, reg);
+    }
+
+    bool parseSum(uint8_t reg) {
+        if (!parseProduct(reg)) return false;
+        for (;;) {
+            if (accept("+")) {
+                if (!parseProduct(reg + 1) || !binary(EXPR_ADD, reg)) return false;
+            } else if (accept("-")) {
+                if (!parseProduct(reg + 1) || !binary(EXPR_SUB, reg)) return false;
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parseProduct(uint8_t reg) {
+        if (!parseUnary(reg)) return false;
+        for (;;) {
+            if (accept("*")) {
+                if (!parseUnary(reg + 1) || !binary(EXPR_MUL, reg)) return false;
+            } else if (accept("/")) {
+                if (!parseUnary(reg + 1) || !binary(EXPR_DIV, reg)) return false;
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parseUnary(uint8_t reg) {
+        if (accept("-")) {
+            if (!enter() || !parseUnary(reg)) return false;
+            nesting--;
+            return emit(EXPR_NEG, reg, reg);
+        }
+        return parsePrimary(reg);
+    }
+
+    bool constant(uint8_t reg, float value) {
+        target->constants.push_back(value);
+        return emit(EXPR_LOADK, reg, 0, 0, target->constants.size() - 1);
+    }
+
+    static void addRef(std::vector<uint16_t>& refs, uint16_t index) {
+        for (uint16_t ref : refs) {
+            if (ref == index) return;
+        }
+        refs.push_back(index);
+    }
+
+    bool parsePrimary(uint8_t reg) {
+        skipSpaces();
+
+        if (accept("(")) {
+            if (!parseOr(reg)) return false;
+            return accept(")") || setError("нет закрывающей скобки");
+        }
+
+        if ((*cursor >= '0' && *cursor <= '9') || *cursor == '.') {
+            char* end;
+            float value = strtof(cursor, &end);
+            // ЧЧ:ММ - минута суток
+            if (*end == ':' && end[1] >= '0' && end[1] <= '9') {
+                char* minutesEnd;
+                long minutes = strtol(end + 1, &minutesEnd, 10);
+                if (minutes > 59 || value >= 24 || value != floorf(value)) return setError("неверное время");
+                value = value * 60 + minutes;
+                end = minutesEnd;
+            }
+            cursor = end;
+            return constant(reg, value);
+        }
+
+        if (accept("true")) return constant(reg, 1.0f);
+        if (accept("false")) return constant(reg, 0.0f);
+        if (accept("now")) {
+            target->timeRef = true;
+            return emit(EXPR_NOW, reg);
+        }
+
+        if (accept("min")) return parseCall(reg, EXPR_MIN, 2);
+        if (accept("max")) return parseCall(reg, EXPR_MAX, 2);
+        if (accept("abs")) return parseCall(reg, EXPR_ABS, 1);
+        if (accept("dew")) return parseCall(reg, EXPR_DEW, 2);
+        if (accept("between")) {
+            target->timeRef = true;
+            return parseCall(reg, EXPR_BETWEEN, 2);
+        }
+
+        // s<id>, h<id>, r<id>
+        char kind = *cursor;
+        if ((kind == 's' || kind == 'h' || kind == 'r') && cursor[1] >= '0' && cursor[1] <= '9') {
+            char* end;
+            long id = strtol(cursor + 1, &end, 10);
+            if (isWordChar(*end)) return setError("неизвестное имя");
+            cursor++;
+
+            int16_t index = kind == 'r' ? names->relayIndex((int)id) : names->sensorIndex((int)id);
+            if (index < 0) return setError(kind == 'r' ? "нет реле с таким id" : "нет сенсора с таким id");
+            cursor = end;
+
+            if (kind == 'r') {
+                addRef(target->relayRefs, index);
+                return emit(EXPR_RELAY, reg, 0, 0, index);
+            }
+            addRef(target->sensorRefs, index);
+            return emit(kind == 's' ? EXPR_SENSOR : EXPR_HUMIDITY, reg, 0, 0, index);
+        }
+
+        return setError("ожидается значение");
+    }
+
+    bool parseCall(uint8_t reg, uint8_t op, uint8_t arguments) {
+        if (!accept("(")) return setError("ожидается '('");
+        if (!parseOr(reg)) return false;
+        if (arguments == 2) {
+            if (!accept(",")) return setError("ожидается ','");
+            if (!parseOr(reg + 1)) return false;
+        }
+        if (!accept(")")) return setError("нет закрывающей скобки");
+        return emit(op, reg, reg, arguments == 2 ? reg + 1 : reg);
+    }
+};
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef GESTURE_RECOGNIZER_H
+#define GESTURE_RECOGNIZER_H
+
+#include <stdint.h>
+
+// Жесты кнопки по меткам времени фронтов. Дребезг отсекается по времени:
+// уровень принимается, если после фронта debounceMs не было другого фронта,
+// и момент перехода - время этого фронта, а не момент обработки. Поэтому
+// пачку фронтов из очереди можно скормить позже, результат тот же.
+// Без Arduino: проверяется на хосте на синтетических последовательностях.
+
+#define GESTURE_DEBOUNCE_MS 20
+#define GESTURE_LONG_MS 800
+#define GESTURE_DOUBLE_MS 300
+#define GESTURE_REPEAT_MS 200
+#define GESTURE_QUEUE 4
+
+enum GestureType : uint8_t {
+    GESTURE_NONE,
+    GESTURE_SHORT,          // короткое нажатие, когда вышло время на второе
+    GESTURE_LONG,           // удержание дошло до longMs (не дожидаясь отпускания)
+    GESTURE_DOUBLE,         // второе короткое нажатие за doubleMs после первого
+    GESTURE_HOLD_REPEAT     // каждые repeatMs после GESTURE_LONG, пока держат
+};
+
+struct GestureTiming {
+    uint16_t debounceMs;
+    uint16_t longMs;
+    uint16_t doubleMs;
+    uint16_t repeatMs;      // 0 - без повтора
+};
+
+class GestureRecognizer {
+public:
+    explicit GestureRecognizer(const GestureTiming& newTiming = defaultTiming()) : timing(newTiming) {}
+
+    static GestureTiming defaultTiming() {
+        GestureTiming result = { GESTURE_DEBOUNCE_MS, GESTURE_LONG_MS, GESTURE_DOUBLE_MS, GESTURE_REPEAT_MS };
+        return result;
+    }
+
+    // Начальный уровень. Кнопка, зажатая при старте, длинного жеста не даёт.
+    void reset(bool isPressed, uint32_t now) {
+        stablePressed = isPressed;
+        hasPending = false;
+        pressTime = now;
+        longFired = isPressed;
+        // И повторов тоже: до отпускания счётчик не дойдёт
+        nextRepeat = UINT32_MAX;
+        clickPending = false;
+        secondClick = false;
+        head = 0;
+        count = 0;
+    }
+
+    // Сырой фронт: pressed - уровень после фронта, time - метка из прерывания
+    void edge(uint32_t time, bool isPressed) {
+        if (hasPending && time - pendingTime >= timing.debounceMs) {
+            commit(pendingTime, pendingPressed);
+        }
+        runTimers(time);
+        hasPending = true;
+        pendingPressed = isPressed;
+        pendingTime = time;
+    }
+
+    // Таймауты жестов и приём уровня, после которого фронтов не было
+    void update(uint32_t now) {
+        if (hasPending) {
+            if (now - pendingTime < timing.debounceMs) {
+                // Уровень ещё не принят: время за фронтом жестам не засчитываем
+                runTimers(pendingTime);
+                return;
+            }
+            commit(pendingTime, pendingPressed);
+        }
+        runTimers(now);
+    }
+
+    bool nextGesture(GestureType& gesture) {
+        if (count == 0) return false;
+        gesture = events[head];
+        head = (head + 1) % GESTURE_QUEUE;
+        count--;
+        return true;
+    }
+
+    bool isPressed() const { return stablePressed; }
+
+private:
+    GestureTiming timing;
+
+    bool stablePressed = false;
+    bool hasPending = false;
+    bool pendingPressed = false;
+    uint32_t pendingTime = 0;
+
+    uint32_t pressTime = 0;
+    uint32_t releaseTime = 0;
+    uint32_t nextRepeat = 0;     // смещение от pressTime
+    bool longFired = false;
+    bool clickPending = false;   // первое короткое нажатие ждёт второго
+    bool secondClick = false;    // идёт второе нажатие двойного
+
+    GestureType events[GESTURE_QUEUE];
+    uint8_t head = 0;
+    uint8_t count = 0;
+
+    void emit(GestureType gesture) {
+        // Переполнение - теряется самый старый жест
+        if (count == GESTURE_QUEUE) {
+            head = (head + 1) % GESTURE_QUEUE;
+            count--;
+        }
+        events[(head + count) % GESTURE_QUEUE] = gesture;
+        count++;
+    }
+
+    void runTimers(uint32_t now) {
+        if (stablePressed) {
+            if (!longFired && now - pressTime >= timing.longMs) {
+                longFired = true;
+                secondClick = false;
+                nextRepeat = (uint32_t)timing.longMs + timing.repeatMs;
+                emit(GESTURE_LONG);
+            }
+            if (longFired && timing.repeatMs > 0) {
+                // Отставание больше очереди не навёрстываем
+                uint8_t repeats = 0;
+                while (now - pressTime >= nextRepeat && repeats++ < GESTURE_QUEUE) {
+                    nextRepeat += timing.repeatMs;
+                    emit(GESTURE_HOLD_REPEAT);
+                }
+                if (now - pressTime >= nextRepeat) {
+                    nextRepeat = now - pressTime + timing.repeatMs;
+                }
+            }
+        } else if (clickPending && now - releaseTime >= timing.doubleMs) {
+            clickPending = false;
+            emit(GESTURE_SHORT);
+        }
+    }
+
+    void commit(uint32_t time, bool isPressed) {
+        hasPending = false;
+        if (isPressed == stablePressed) return;
+
+        // Таймеры, истёкшие до самого перехода, идут раньше него
+        runTimers(time);
+        stablePressed = isPressed;
+
+        if (isPressed) {
+            pressTime = time;
+            longFired = false;
+            secondClick = clickPending;
+            clickPending = false;
+            return;
+        }
+
+        if (longFired) return;
+        if (secondClick) {
+            secondClick = false;
+            emit(GESTURE_DOUBLE);
+            return;
+        }
+        clickPending = true;
+        releaseTime = time;
+    }
+};
+
+#endif
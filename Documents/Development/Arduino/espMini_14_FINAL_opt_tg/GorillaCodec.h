@@ -0,0 +1,330 @@
+#ifndef GORILLA_CODEC_H
+#define GORILLA_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Сжатие рядов "время + до трёх float" по схеме Gorilla: время - разность
+// разностей с кодами переменной длины, значения - XOR с предыдущим, от
+// которого хранятся только значащие биты. Ряд пишется блоками фиксированного
+// размера; каждый блок декодируется сам по себе, перед ним на флеше лежит
+// GorillaBlockHeader. Без Arduino: проверяется на хосте.
+
+#define GORILLA_BLOCK_BYTES 240
+#define GORILLA_MAX_COLUMNS 3
+#define GORILLA_BLOCK_MAGIC 0x4247   // "GB"
+
+// Худший случай на запись: '1111' + 32 бита времени, на значение '11' + 5 + 5 + 32
+#define GORILLA_MAX_TIME_BITS 36
+#define GORILLA_MAX_VALUE_BITS 44
+
+struct GorillaBlockHeader {
+    uint16_t magic;
+    uint8_t columns;
+    uint8_t field;
+    int32_t sensorId;
+    uint16_t count;
+    uint16_t bytes;       // длина сжатых данных за заголовком
+    uint32_t firstTime;
+    uint32_t lastTime;
+
+    bool isValid() const {
+        return magic == GORILLA_BLOCK_MAGIC && columns >= 1 && columns <= GORILLA_MAX_COLUMNS &&
+               count > 0 && bytes > 0 && bytes <= GORILLA_BLOCK_BYTES && firstTime <= lastTime;
+    }
+};
+
+class GorillaBitWriter {
+public:
+    void reset(uint8_t* target, size_t capacityBytes) {
+        data = target;
+        capacityBits = capacityBytes * 8;
+        position = 0;
+        memset(data, 0, capacityBytes);
+    }
+
+    void write(uint32_t value, uint8_t bits) {
+        while (bits > 0) {
+            bits--;
+            if ((value >> bits) & 1) data[position >> 3] |= 0x80 >> (position & 7);
+            position++;
+        }
+    }
+
+    size_t bitsLeft() const { return capacityBits - position; }
+    size_t bytes() const { return (position + 7) / 8; }
+
+private:
+    uint8_t* data = nullptr;
+    size_t capacityBits = 0;
+    size_t position = 0;
+};
+
+class GorillaBitReader {
+public:
+    GorillaBitReader(const uint8_t* source, size_t sizeBytes) : data(source), sizeBits(sizeBytes * 8) {}
+
+    // false - данные кончились раньше, чем ожидалось
+    bool read(uint8_t bits, uint32_t& value) {
+        if (position + bits > sizeBits) return false;
+        value = 0;
+        while (bits > 0) {
+            value = (value << 1) | ((data[position >> 3] >> (7 - (position & 7))) & 1);
+            position++;
+            bits--;
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* data;
+    size_t sizeBits;
+    size_t position = 0;
+};
+
+// Состояние XOR-кодирования одного столбца
+struct GorillaColumnState {
+    uint32_t previous;
+    uint8_t leading;
+    uint8_t trailing;
+    bool hasWindow;
+};
+
+class GorillaCodec {
+public:
+    static uint32_t floatBits(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static float bitsFloat(uint32_t bits) {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static uint8_t leadingZeros(uint32_t value) {
+        uint8_t count = 0;
+        for (uint32_t mask = 0x80000000u; mask && !(value & mask); mask >>= 1) count++;
+        return count;
+    }
+
+    static uint8_t trailingZeros(uint32_t value) {
+        uint8_t count = 0;
+        while (count < 32 && !((value >> count) & 1)) count++;
+        return count;
+    }
+};
+
+class GorillaEncoder {
+public:
+    void begin(uint8_t columnCount) {
+        columns = columnCount;
+        count = 0;
+        writer.reset(buffer, sizeof(buffer));
+    }
+
+    // false - блок заполнен, запись не добавлена.
+    bool append(uint32_t time, const float* values) {
+        if (writer.bitsLeft() < GORILLA_MAX_TIME_BITS + (size_t)columns * GORILLA_MAX_VALUE_BITS) return false;
+
+        if (count == 0) {
+            writer.write(time, 32);
+            for (uint8_t i = 0; i < columns; i++) {
+                state[i].previous = GorillaCodec::floatBits(values[i]);
+                state[i].hasWindow = false;
+                writer.write(state[i].previous, 32);
+            }
+            firstTime = time;
+            previousDelta = 0;
+        } else {
+            int32_t delta = (int32_t)(time - lastTime);
+            writeDeltaOfDelta(delta - previousDelta);
+            previousDelta = delta;
+            for (uint8_t i = 0; i < columns; i++) writeValue(state[i], GorillaCodec::floatBits(values[i]));
+        }
+
+        lastTime = time;
+        count++;
+        return true;
+    }
+
+    GorillaBlockHeader header(int32_t sensorId, uint8_t field) const {
+        GorillaBlockHeader result;
+        result.magic = GORILLA_BLOCK_MAGIC;
+        result.columns = columns;
+        result.field = field;
+        result.sensorId = sensorId;
+        result.count = count;
+        result.bytes = (uint16_t)writer.bytes();
+        result.firstTime = firstTime;
+        result.lastTime = lastTime;
+        return result;
+    }
+
+    const uint8_t* data() const { return buffer; }
+    uint16_t size() const { return count; }
+
+private:
+    uint8_t buffer[GORILLA_BLOCK_BYTES];
+    GorillaBitWriter writer;
+    GorillaColumnState state[GORILLA_MAX_COLUMNS];
+    uint8_t columns = 1;
+    uint16_t count = 0;
+    uint32_t firstTime = 0;
+    uint32_t lastTime = 0;
+    int32_t previousDelta = 0;
+
+    void writeDeltaOfDelta(int32_t dod) {
+        if (dod == 0) {
+            writer.write(0, 1);
+        } else if (dod >= -64 && dod <= 63) {
+            writer.write(0x2, 2);
+            writer.write((uint32_t)dod & 0x7F, 7);
+        } else if (dod >= -256 && dod <= 255) {
+            writer.write(0x6, 3);
+            writer.write((uint32_t)dod & 0x1FF, 9);
+        } else if (dod >= -2048 && dod <= 2047) {
+            writer.write(0xE, 4);
+            writer.write((uint32_t)dod & 0xFFF, 12);
+        } else {
+            writer.write(0xF, 4);
+            writer.write((uint32_t)dod, 32);
+        }
+    }
+
+    void writeValue(GorillaColumnState& column, uint32_t bits) {
+        uint32_t xored = bits ^ column.previous;
+        column.previous = bits;
+        if (xored == 0) {
+            writer.write(0, 1);
+            return;
+        }
+
+        uint8_t leading = GorillaCodec::leadingZeros(xored);
+        uint8_t trailing = GorillaCodec::trailingZeros(xored);
+        if (leading > 31) leading = 31;
+
+        if (column.hasWindow && leading >= column.leading && trailing >= column.trailing) {
+            // Значащие биты укладываются в окно предыдущего значения
+            writer.write(0x2, 2);
+            writer.write(xored >> column.trailing, 32 - column.leading - column.trailing);
+            return;
+        }
+
+        uint8_t length = 32 - leading - trailing;
+        writer.write(0x3, 2);
+        writer.write(leading, 5);
+        writer.write(length - 1, 5);
+        writer.write(xored >> trailing, length);
+
+        column.leading = leading;
+        column.trailing = trailing;
+        column.hasWindow = true;
+    }
+};
+
+class GorillaDecoder {
+public:
+    GorillaDecoder(const GorillaBlockHeader& blockHeader, const uint8_t* payload)
+        : reader(payload, blockHeader.bytes), columns(blockHeader.columns), remaining(blockHeader.count) {}
+
+    // false - блок кончился или повреждён.
+    bool next(uint32_t& time, float* values) {
+        if (remaining == 0) return false;
+
+        uint32_t bits;
+        if (first) {
+            if (!reader.read(32, time)) return fail();
+            for (uint8_t i = 0; i < columns; i++) {
+                if (!reader.read(32, state[i].previous)) return fail();
+                state[i].hasWindow = false;
+                values[i] = GorillaCodec::bitsFloat(state[i].previous);
+            }
+            first = false;
+        } else {
+            int32_t dod;
+            if (!readDeltaOfDelta(dod)) return fail();
+            previousDelta += dod;
+            time = lastTime + previousDelta;
+            for (uint8_t i = 0; i < columns; i++) {
+                if (!readValue(state[i], bits)) return fail();
+                values[i] = GorillaCodec::bitsFloat(bits);
+            }
+        }
+
+        lastTime = time;
+        remaining--;
+        return true;
+    }
+
+private:
+    GorillaBitReader reader;
+    GorillaColumnState state[GORILLA_MAX_COLUMNS];
+    uint8_t columns;
+    uint16_t remaining;
+    bool first = true;
+    uint32_t lastTime = 0;
+    int32_t previousDelta = 0;
+
+    bool fail() {
+        remaining = 0;
+        return false;
+    }
+
+    static int32_t signExtend(uint32_t value, uint8_t bits) {
+        uint32_t sign = 1u << (bits - 1);
+        return (int32_t)((value ^ sign) - sign);
+    }
+
+    bool readDeltaOfDelta(int32_t& dod) {
+        uint32_t bit, value;
+        uint8_t prefix = 0;
+        while (prefix < 4) {
+            if (!reader.read(1, bit)) return false;
+            if (!bit) break;
+            prefix++;
+        }
+
+        switch (prefix) {
+            case 0: dod = 0; return true;
+            case 1: if (!reader.read(7, value)) return false; dod = signExtend(value, 7); return true;
+            case 2: if (!reader.read(9, value)) return false; dod = signExtend(value, 9); return true;
+            case 3: if (!reader.read(12, value)) return false; dod = signExtend(value, 12); return true;
+            default: if (!reader.read(32, value)) return false; dod = (int32_t)value; return true;
+        }
+    }
+
+    bool readValue(GorillaColumnState& column, uint32_t& bits) {
+        uint32_t flag;
+        if (!reader.read(1, flag)) return false;
+        if (!flag) {
+            bits = column.previous;
+            return true;
+        }
+
+        if (!reader.read(1, flag)) return false;
+        uint32_t meaningful;
+        if (!flag) {
+            if (!column.hasWindow) return false;
+            if (!reader.read(32 - column.leading - column.trailing, meaningful)) return false;
+        } else {
+            uint32_t leading, length;
+            if (!reader.read(5, leading) || !reader.read(5, length)) return false;
+            length += 1;
+            if (leading + length > 32) return false;
+            column.leading = leading;
+            column.trailing = 32 - leading - length;
+            column.hasWindow = true;
+            if (!reader.read(length, meaningful)) return false;
+        }
+
+        bits = column.previous ^ (meaningful << column.trailing);
+        column.previous = bits;
+        return true;
+    }
+};
+
+#endif
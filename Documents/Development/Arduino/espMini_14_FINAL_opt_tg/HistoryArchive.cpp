@@ -0,0 +1,256 @@
+#include "HistoryArchive.h"
+
+void HistoryArchive::segmentPath(uint32_t seq, char* buffer, size_t size) {
+    snprintf(buffer, size, "/hist%lu.seg", (unsigned long)seq);
+}
+
+bool HistoryArchive::begin(uint32_t budgetBytes) {
+    budget = max(budgetBytes, (uint32_t)HISTORY_ARCHIVE_MIN_KB * 1024);
+    segmentLimit = budget / HISTORY_ARCHIVE_SEGMENTS;
+
+    uint32_t first = 1;
+    uint32_t last = 0;
+    File index = SPIFFS.open(HISTORY_ARCHIVE_INDEX, "r");
+    if (index) {
+        first = index.readStringUntil(' ').toInt();
+        last = index.readStringUntil('\n').toInt();
+        index.close();
+        if (first == 0) first = 1;
+    }
+
+    // Сегменты за last: запись прервалась до обновления индекса
+    char path[24];
+    segmentPath(last + 1, path, sizeof(path));
+    while (SPIFFS.exists(path)) {
+        last++;
+        segmentPath(last + 1, path, sizeof(path));
+    }
+
+    segments.clear();
+    for (uint32_t seq = first; seq <= last; seq++) {
+        ArchiveSegment segment = { seq, 0, 0, 0 };
+        if (scanSegment(segment)) segments.push_back(segment);
+        yield();
+    }
+
+    nextSeq = last + 1;
+    writeOpen = false;
+    while (segments.size() > 1 && bytes() > budget) removeOldest();
+
+    Serial.printf("[History] Архив: %u сегментов, %lu байт, бюджет %lu байт\n",
+                  (unsigned)segments.size(), (unsigned long)bytes(), (unsigned long)budget);
+    return true;
+}
+
+// Индекс сегмента по заголовкам блоков; повреждённый хвост отбрасывается
+bool HistoryArchive::scanSegment(ArchiveSegment& segment) {
+    char path[24];
+    segmentPath(segment.seq, path, sizeof(path));
+    File file = SPIFFS.open(path, "r");
+    if (!file) return false;
+
+    uint32_t size = file.size();
+    uint32_t offset = 0;
+    GorillaBlockHeader header;
+
+    while (offset + sizeof(header) <= size) {
+        file.seek(offset);
+        if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || !header.isValid() ||
+            offset + sizeof(header) + header.bytes > size) {
+            break;
+        }
+        if (segment.bytes == 0 || header.firstTime < segment.firstTime) segment.firstTime = header.firstTime;
+        if (segment.bytes == 0 || header.lastTime > segment.lastTime) segment.lastTime = header.lastTime;
+        offset += sizeof(header) + header.bytes;
+        segment.bytes = offset;
+    }
+    file.close();
+    return true;
+}
+
+void HistoryArchive::saveIndex() {
+    File index = SPIFFS.open(HISTORY_ARCHIVE_INDEX, "w");
+    if (!index) return;
+    uint32_t first = segments.empty() ? nextSeq : segments.front().seq;
+    index.printf("%lu %lu\n", (unsigned long)first, (unsigned long)(nextSeq - 1));
+    index.close();
+}
+
+void HistoryArchive::removeOldest() {
+    lock.lock();
+    uint32_t seq = segments.front().seq;
+    segments.erase(segments.begin());
+    lock.unlock();
+
+    char path[24];
+    segmentPath(seq, path, sizeof(path));
+    SPIFFS.remove(path);
+    saveIndex();
+}
+
+bool HistoryArchive::append(const GorillaBlockHeader& header, const uint8_t* payload) {
+    if (segmentLimit == 0 || !header.isValid()) return false;
+    uint32_t blockSize = sizeof(header) + header.bytes;
+
+    // После старта пишем в новый сегмент: хвост старого мог быть оборван
+    if (!writeOpen || segments.empty() || segments.back().bytes + blockSize > segmentLimit) {
+        ArchiveSegment segment = { nextSeq++, header.firstTime, header.lastTime, 0 };
+        lock.lock();
+        segments.push_back(segment);
+        lock.unlock();
+        writeOpen = true;
+        saveIndex();
+    }
+
+    while (segments.size() > 1 && bytes() + blockSize > budget) removeOldest();
+
+    char path[24];
+    segmentPath(segments.back().seq, path, sizeof(path));
+    File file = SPIFFS.open(path, "a");
+    if (!file) {
+        Serial.printf("[History] Не удалось открыть %s\n", path);
+        return false;
+    }
+    bool written = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                   file.write(payload, header.bytes) == header.bytes;
+    file.close();
+    if (!written) return false;
+
+    lock.lock();
+    ArchiveSegment& segment = segments.back();
+    if (segment.bytes == 0 || header.firstTime < segment.firstTime) segment.firstTime = header.firstTime;
+    if (segment.bytes == 0 || header.lastTime > segment.lastTime) segment.lastTime = header.lastTime;
+    segment.bytes += blockSize;
+    lock.unlock();
+    return true;
+}
+
+uint32_t HistoryArchive::bytes() {
+    uint32_t total = 0;
+    lock.lock();
+    for (const ArchiveSegment& segment : segments) total += segment.bytes;
+    lock.unlock();
+    return total;
+}
+
+size_t HistoryArchive::segmentCount() {
+    lock.lock();
+    size_t count = segments.size();
+    lock.unlock();
+    return count;
+}
+
+// Первый сегмент с номером >= fromSeq, пересекающий окно [from, to]
+bool HistoryArchive::findSegment(uint32_t fromSeq, uint32_t from, uint32_t to, ArchiveSegment& out) {
+    bool found = false;
+    lock.lock();
+    for (const ArchiveSegment& segment : segments) {
+        if (segment.seq >= fromSeq && segment.bytes > 0 && segment.lastTime >= from && segment.firstTime <= to) {
+            out = segment;
+            found = true;
+            break;
+        }
+    }
+    lock.unlock();
+    return found;
+}
+
+// payload == nullptr - только заголовок. limit - сколько байт сегмента уже записано целиком.
+bool HistoryArchive::readBlock(File& file, uint32_t offset, uint32_t limit, GorillaBlockHeader& header, uint8_t* payload) {
+    if (offset + sizeof(header) > limit) return false;
+    file.seek(offset);
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || !header.isValid() ||
+        offset + sizeof(header) + header.bytes > limit) {
+        return false;
+    }
+    return !payload || file.read(payload, header.bytes) == header.bytes;
+}
+
+size_t HistoryArchive::read(ArchiveCursor& cursor, int32_t sensorId, uint8_t field, uint32_t from, uint32_t to,
+                            HistoryAggregate* out, size_t maxCount) {
+    size_t copied = 0;
+    uint8_t payload[GORILLA_BLOCK_BYTES];
+
+    while (copied < maxCount) {
+        ArchiveSegment segment;
+        if (!findSegment(cursor.seq, from, to, segment)) break;
+        if (segment.seq != cursor.seq) {
+            cursor.seq = segment.seq;
+            cursor.offset = 0;
+            cursor.consumed = 0;
+        }
+
+        char path[24];
+        segmentPath(segment.seq, path, sizeof(path));
+        File file = SPIFFS.open(path, "r");
+
+        GorillaBlockHeader header;
+        while (copied < maxCount && file && readBlock(file, cursor.offset, segment.bytes, header, nullptr)) {
+            uint32_t next = cursor.offset + sizeof(header) + header.bytes;
+            if (header.sensorId != sensorId || header.field != field ||
+                header.lastTime < from || header.firstTime > to) {
+                cursor.offset = next;
+                cursor.consumed = 0;
+                continue;
+            }
+            if (!readBlock(file, cursor.offset, segment.bytes, header, payload)) break;
+
+            GorillaDecoder decoder(header, payload);
+            uint32_t time;
+            float values[GORILLA_MAX_COLUMNS];
+            uint16_t index = 0;
+            bool finished = true;
+            while (decoder.next(time, values)) {
+                if (index++ < cursor.consumed) continue;
+                if (copied == maxCount) {
+                    finished = false;
+                    break;
+                }
+                cursor.consumed = index;
+                if (time < from || time > to) continue;
+
+                HistoryAggregate& item = out[copied++];
+                item.time = time;
+                item.min = values[0];
+                item.avg = header.columns > 1 ? values[1] : values[0];
+                item.max = header.columns > 2 ? values[2] : values[0];
+            }
+            if (finished) {
+                cursor.offset = next;
+                cursor.consumed = 0;
+            }
+        }
+
+        bool segmentDone = copied < maxCount;
+        if (file) file.close();
+        if (segmentDone) {
+            cursor.seq = segment.seq + 1;
+            cursor.offset = 0;
+            cursor.consumed = 0;
+        }
+    }
+    return copied;
+}
+
+void HistoryArchive::forEachBlock(ArchiveBlockFn fn) {
+    uint8_t payload[GORILLA_BLOCK_BYTES];
+    ArchiveSegment segment;
+    uint32_t seq = 0;
+
+    while (findSegment(seq, 0, UINT32_MAX, segment)) {
+        char path[24];
+        segmentPath(segment.seq, path, sizeof(path));
+        File file = SPIFFS.open(path, "r");
+        if (file) {
+            GorillaBlockHeader header;
+            uint32_t offset = 0;
+            while (readBlock(file, offset, segment.bytes, header, payload)) {
+                fn(header, payload);
+                offset += sizeof(header) + header.bytes;
+            }
+            file.close();
+        }
+        seq = segment.seq + 1;
+        yield();
+    }
+}
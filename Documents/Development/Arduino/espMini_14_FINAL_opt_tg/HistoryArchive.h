@@ -0,0 +1,78 @@
+#ifndef HISTORY_ARCHIVE_H
+#define HISTORY_ARCHIVE_H
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+#include "CommonTypes.h"
+#include "GorillaCodec.h"
+#include "TimeSeriesStore.h"
+#include "SpinLock.h"
+
+// Архив истории на флеше: сжатые блоки GorillaCodec дописываются в файлы-сегменты
+// /hist<N>.seg, при превышении бюджета удаляется самый старый сегмент. Файлы
+// не переписываются. Индекс сегментов (номер, интервал времени, размер) строится
+// при старте по заголовкам блоков; чтение за интервал пропускает сегменты и
+// блоки по индексу и заголовкам, распаковывая только нужные.
+
+#if defined(ESP8266)
+#define HISTORY_ARCHIVE_BUDGET_KB 64
+#else
+#define HISTORY_ARCHIVE_BUDGET_KB 256
+#endif
+
+#define HISTORY_ARCHIVE_MIN_KB 8
+#define HISTORY_ARCHIVE_SEGMENTS 8      // бюджет делится на столько сегментов
+#define HISTORY_ARCHIVE_INDEX "/hist.idx"
+
+struct ArchiveSegment {
+    uint32_t seq;
+    uint32_t firstTime;
+    uint32_t lastTime;
+    uint32_t bytes;
+};
+
+// Позиция потокового чтения: сегмент, смещение блока и сколько точек блока уже пройдено
+struct ArchiveCursor {
+    uint32_t seq = 0;
+    uint32_t offset = 0;
+    uint16_t consumed = 0;
+};
+
+typedef std::function<void(const GorillaBlockHeader&, const uint8_t*)> ArchiveBlockFn;
+
+class HistoryArchive {
+public:
+    bool begin(uint32_t budgetBytes);
+
+    // Задача управления. Новый сегмент открывается при переполнении текущего.
+    bool append(const GorillaBlockHeader& header, const uint8_t* payload);
+
+    // Минутные агрегаты ряда в окне [from, to] начиная с cursor. 0 - дочитано.
+    size_t read(ArchiveCursor& cursor, int32_t sensorId, uint8_t field, uint32_t from, uint32_t to,
+                HistoryAggregate* out, size_t maxCount);
+
+    // Все блоки в порядке записи: восстановление истории при старте.
+    void forEachBlock(ArchiveBlockFn fn);
+
+    uint32_t bytes();
+    size_t segmentCount();
+
+private:
+    std::vector<ArchiveSegment> segments;
+    SpinLock lock;
+    uint32_t budget = 0;
+    uint32_t segmentLimit = 0;
+    uint32_t nextSeq = 1;
+    bool writeOpen = false;   // последний сегмент открыт в этом запуске
+
+    static void segmentPath(uint32_t seq, char* buffer, size_t size);
+    static bool readBlock(File& file, uint32_t offset, uint32_t limit, GorillaBlockHeader& header, uint8_t* payload);
+
+    bool scanSegment(ArchiveSegment& segment);
+    void removeOldest();
+    void saveIndex();
+    bool findSegment(uint32_t fromSeq, uint32_t from, uint32_t to, ArchiveSegment& out);
+};
+
+#endif
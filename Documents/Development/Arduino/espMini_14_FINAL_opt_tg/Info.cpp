@@ -17,6 +17,9 @@ namespace {
 }
 
 Info::Info()
+#ifdef CONTROL_PROFILER
+    : profiler([]() -> uint32_t { return micros(); })
+#endif
 {
 
 }
@@ -141,3 +144,29 @@ size_t Info::getSystemStatus(char* buffer, size_t bufferSize) {
 
     return offset;
 }
+
+#ifdef CONTROL_PROFILER
+size_t Info::getProfileReport(char* buffer, size_t bufferSize) {
+    size_t offset = 0;
+    if (bufferSize > 0) buffer[0] = '\0';
+    offset = appendToBuffer(buffer, bufferSize, offset, "<b>Этапы цикла, мкс</b> (ср / p99 / макс, превышений / пропусков)\n");
+
+    bool hasData = false;
+    for (int i = 0; i < profiler.getStageCount(); i++) {
+        const ProfileStage* stage = profiler.getStage(i);
+        if (stage->count == 0) continue;
+        hasData = true;
+        offset = appendToBuffer(buffer, bufferSize, offset, "%s: %lu / %lu / %lu, %lu / %lu\n",
+                                stage->name,
+                                (unsigned long)stage->averageUs(),
+                                (unsigned long)StageProfiler::percentile(*stage, 990),
+                                (unsigned long)stage->maxUs,
+                                (unsigned long)stage->overruns,
+                                (unsigned long)stage->missed);
+    }
+    if (!hasData) {
+        offset = appendToBuffer(buffer, bufferSize, offset, "Замеров ещё нет\n");
+    }
+    return offset;
+}
+#endif
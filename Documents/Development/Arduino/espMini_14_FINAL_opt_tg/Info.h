@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdio>
 #include <cstdint>
+#include "StageProfiler.h"
 
 #ifdef ESP32
 #include <WiFi.h>
@@ -24,6 +25,13 @@ public:
 
      size_t getSystemStatus(char* buffer, size_t bufferSize);
 
+#ifdef CONTROL_PROFILER
+    // Этапы регистрирует скетч до запуска задач, пишут планировщики
+    StageProfiler profiler;
+
+    size_t getProfileReport(char* buffer, size_t bufferSize);
+#endif
+
 private:
 
 };
@@ -0,0 +1,64 @@
+#include "InputEdges.h"
+
+InputEdges::InputEdges() {
+    for (Slot& slot : slots) {
+        slot.owner = this;
+        slot.pin = 0;
+        slot.used = false;
+    }
+}
+
+InputEdges::~InputEdges() {
+    for (Slot& slot : slots) {
+        if (slot.used) detachInterrupt(slot.pin);
+    }
+}
+
+bool InputEdges::attach(uint8_t pin) {
+    Slot* freeSlot = nullptr;
+    for (Slot& slot : slots) {
+        if (slot.used && slot.pin == pin) return true;
+        if (!slot.used && !freeSlot) freeSlot = &slot;
+    }
+    if (!freeSlot) return false;
+
+    freeSlot->pin = pin;
+    freeSlot->used = true;
+    attachInterruptArg(pin, onEdge, freeSlot, CHANGE);
+    return true;
+}
+
+void InputEdges::detach(uint8_t pin) {
+    for (Slot& slot : slots) {
+        if (slot.used && slot.pin == pin) {
+            detachInterrupt(pin);
+            slot.used = false;
+        }
+    }
+}
+
+bool InputEdges::pop(InputEdge& edge) {
+    uint32_t currentTail = tail.load(std::memory_order_relaxed);
+    if (currentTail == head.load(std::memory_order_acquire)) return false;
+
+    edge = ring[currentTail % INPUT_EDGE_QUEUE];
+    tail.store(currentTail + 1, std::memory_order_release);
+    return true;
+}
+
+void IRAM_ATTR InputEdges::onEdge(void* arg) {
+    Slot* slot = static_cast<Slot*>(arg);
+    InputEdges* owner = slot->owner;
+
+    uint32_t currentHead = owner->head.load(std::memory_order_relaxed);
+    if (currentHead - owner->tail.load(std::memory_order_acquire) >= INPUT_EDGE_QUEUE) {
+        owner->overflow = owner->overflow + 1;
+        return;
+    }
+
+    InputEdge& edge = owner->ring[currentHead % INPUT_EDGE_QUEUE];
+    edge.pin = slot->pin;
+    edge.level = digitalRead(slot->pin);
+    edge.time = millis();
+    owner->head.store(currentHead + 1, std::memory_order_release);
+}
@@ -0,0 +1,57 @@
+#ifndef INPUT_EDGES_H
+#define INPUT_EDGES_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Фронты цифровых входов по прерываниям: обработчик только ставит в очередь
+// пин, уровень и millis(), дребезг и жесты разбирает задача управления
+// (GestureRecognizer). Прерывания всех пинов на одном ядре не вкладываются
+// друг в друга, так что писатель у очереди один.
+
+#define INPUT_EDGE_MAX_PINS 16
+#define INPUT_EDGE_QUEUE 64
+
+struct InputEdge {
+    uint8_t pin;
+    uint8_t level;
+    uint32_t time;
+};
+
+class InputEdges {
+public:
+    InputEdges();
+    ~InputEdges();
+
+    InputEdges(const InputEdges&) = delete;
+    InputEdges& operator=(const InputEdges&) = delete;
+
+    // false - слоты кончились
+    bool attach(uint8_t pin);
+    void detach(uint8_t pin);
+
+    bool pop(InputEdge& edge);
+
+    // Фронты, не влезшие в очередь
+    uint32_t dropped() const { return overflow; }
+
+private:
+    struct Slot {
+        InputEdges* owner;
+        uint8_t pin;
+        bool used;
+    };
+
+    Slot slots[INPUT_EDGE_MAX_PINS];
+
+    // Своё кольцо, а не SpscQueue: обработчик должен целиком лежать в IRAM,
+    // а атомарные операции встраиваются всегда, в отличие от SpscQueue::push
+    InputEdge ring[INPUT_EDGE_QUEUE];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    volatile uint32_t overflow = 0;   // пишет только обработчик
+
+    static void IRAM_ATTR onEdge(void* arg);
+};
+
+#endif
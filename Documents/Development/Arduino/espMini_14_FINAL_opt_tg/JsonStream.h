@@ -0,0 +1,448 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Потоковый разбор JSON без документа: вход подаётся кусками любой длины
+// (как их отдаёт веб-сервер или файл), обработчик получает события начала и
+// конца объектов/массивов и значения вместе с именем поля. В памяти - только
+// текущий токен и стек вложенности. Ошибка синтаксиса, слишком глубокая
+// вложенность или слишком длинная строка обрывают разбор сразу, на том байте,
+// где обнаружены. Без Arduino: проверяется на хосте.
+
+#define JSON_STREAM_MAX_DEPTH 8
+#define JSON_STREAM_MAX_TOKEN 512    // строка или число, без нуля
+#define JSON_STREAM_MAX_KEY 31
+
+enum JsonStreamError : uint8_t {
+    JSON_STREAM_OK,
+    JSON_STREAM_SYNTAX,
+    JSON_STREAM_TOO_DEEP,
+    JSON_STREAM_TOO_LONG,
+    JSON_STREAM_REJECTED,     // обработчик вернул false
+    JSON_STREAM_INCOMPLETE    // вход кончился внутри документа
+};
+
+enum JsonValueType : uint8_t {
+    JSON_VALUE_STRING,
+    JSON_VALUE_NUMBER,
+    JSON_VALUE_BOOL,
+    JSON_VALUE_NULL
+};
+
+struct JsonStreamValue {
+    JsonValueType type;
+    const char* text;     // строка без кавычек или запись числа; живёт до возврата
+    size_t length;
+    double number;        // число; для bool - 0 или 1
+    bool boolean;
+
+    // Как as<bool>() у ArduinoJson: число - не ноль
+    bool asBool() const { return type == JSON_VALUE_BOOL ? boolean : (type == JSON_VALUE_NUMBER && number != 0); }
+    double asNumber() const { return (type == JSON_VALUE_NUMBER || type == JSON_VALUE_BOOL) ? number : 0; }
+    long asInt() const { return (long)asNumber(); }
+    const char* asText() const { return type == JSON_VALUE_STRING ? text : ""; }
+};
+
+// key - имя поля, если событие внутри объекта, иначе nullptr.
+// false из любого метода прекращает разбор с JSON_STREAM_REJECTED.
+class JsonStreamHandler {
+public:
+    virtual ~JsonStreamHandler() {}
+    virtual bool beginContainer(const char* key, bool isArray) = 0;
+    virtual bool endContainer(bool isArray) = 0;
+    virtual bool value(const char* key, const JsonStreamValue& value) = 0;
+};
+
+class JsonStreamParser {
+public:
+    explicit JsonStreamParser(JsonStreamHandler& handler) : handler(handler) { reset(); }
+
+    void reset() {
+        state = STATE_VALUE;
+        depth = 0;
+        tokenLength = 0;
+        key[0] = '\0';
+        hasKey = false;
+        status = JSON_STREAM_OK;
+        offset = 0;
+        highSurrogate = 0;
+    }
+
+    // false - разбор остановлен, остаток входа не нужен
+    bool feed(const char* data, size_t length) {
+        for (size_t i = 0; i < length && status == JSON_STREAM_OK; i++) {
+            step(data[i]);
+            if (status == JSON_STREAM_OK) offset++;   // при ошибке - номер байта, где она найдена
+        }
+        return status == JSON_STREAM_OK;
+    }
+
+    // Конец входа: true, если документ полный и корректный
+    bool finish() {
+        if (status != JSON_STREAM_OK) return false;
+        // Число заканчивает вход только на верхнем уровне, внутри скобок - обрыв
+        if (state == STATE_NUMBER && depth == 0) endNumber();
+        if (status == JSON_STREAM_OK && state != STATE_DONE) status = JSON_STREAM_INCOMPLETE;
+        return status == JSON_STREAM_OK;
+    }
+
+    JsonStreamError error() const { return status; }
+    size_t errorOffset() const { return offset; }
+    uint8_t getDepth() const { return depth; }
+
+    static const char* errorText(JsonStreamError error) {
+        switch (error) {
+            case JSON_STREAM_OK: return "ok";
+            case JSON_STREAM_SYNTAX: return "syntax error";
+            case JSON_STREAM_TOO_DEEP: return "nesting too deep";
+            case JSON_STREAM_TOO_LONG: return "value too long";
+            case JSON_STREAM_REJECTED: return "invalid value";
+            case JSON_STREAM_INCOMPLETE: return "unexpected end";
+        }
+        return "error";
+    }
+
+private:
+    enum State : uint8_t {
+        STATE_VALUE,            // значение: начало документа, после ':' или ',' в массиве
+        STATE_VALUE_OR_END,     // сразу после '['
+        STATE_KEY,              // после ',' в объекте
+        STATE_KEY_OR_END,       // сразу после '{'
+        STATE_COLON,
+        STATE_COMMA_OR_END,
+        STATE_STRING,
+        STATE_ESCAPE,
+        STATE_UNICODE,
+        STATE_NUMBER,
+        STATE_LITERAL,
+        STATE_DONE
+    };
+
+    JsonStreamHandler& handler;
+    State state;
+    bool isKeyString = false;
+    JsonStreamError status;
+    size_t offset;
+
+    uint8_t depth;
+    uint8_t arrays[(JSON_STREAM_MAX_DEPTH + 7) / 8];   // бит на уровень: массив или объект
+
+    char token[JSON_STREAM_MAX_TOKEN + 1];
+    size_t tokenLength;
+    char key[JSON_STREAM_MAX_KEY + 1];
+    bool hasKey;
+
+    const char* literal = nullptr;
+    uint8_t literalPosition = 0;
+    uint32_t unicode = 0;
+    uint8_t unicodeDigits = 0;
+    uint16_t highSurrogate;
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    bool inArray() const { return depth > 0 && (arrays[(depth - 1) / 8] >> ((depth - 1) % 8)) & 1; }
+
+    void fail(JsonStreamError error) { status = error; }
+
+    const char* currentKey() const { return hasKey ? key : nullptr; }
+
+    // Значение закончено: дальше ',' или закрывающая скобка, на верхнем уровне - конец
+    void afterValue() {
+        hasKey = false;
+        state = depth == 0 ? STATE_DONE : STATE_COMMA_OR_END;
+    }
+
+    void emit(JsonValueType type, double number, bool boolean) {
+        token[tokenLength] = '\0';
+        JsonStreamValue value = { type, token, tokenLength, number, boolean };
+        if (!handler.value(currentKey(), value)) {
+            fail(JSON_STREAM_REJECTED);
+            return;
+        }
+        tokenLength = 0;
+        afterValue();
+    }
+
+    void append(char c) {
+        if (tokenLength >= JSON_STREAM_MAX_TOKEN) {
+            fail(JSON_STREAM_TOO_LONG);
+            return;
+        }
+        token[tokenLength++] = c;
+    }
+
+    void appendUtf8(uint32_t code) {
+        if (code < 0x80) {
+            append((char)code);
+        } else if (code < 0x800) {
+            append((char)(0xC0 | (code >> 6)));
+            append((char)(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            append((char)(0xE0 | (code >> 12)));
+            append((char)(0x80 | ((code >> 6) & 0x3F)));
+            append((char)(0x80 | (code & 0x3F)));
+        } else {
+            append((char)(0xF0 | (code >> 18)));
+            append((char)(0x80 | ((code >> 12) & 0x3F)));
+            append((char)(0x80 | ((code >> 6) & 0x3F)));
+            append((char)(0x80 | (code & 0x3F)));
+        }
+    }
+
+    void open(bool isArray) {
+        if (depth >= JSON_STREAM_MAX_DEPTH) {
+            fail(JSON_STREAM_TOO_DEEP);
+            return;
+        }
+        if (!handler.beginContainer(currentKey(), isArray)) {
+            fail(JSON_STREAM_REJECTED);
+            return;
+        }
+        uint8_t& bits = arrays[depth / 8];
+        if (isArray) bits |= 1 << (depth % 8);
+        else bits &= ~(1 << (depth % 8));
+        depth++;
+        hasKey = false;
+        state = isArray ? STATE_VALUE_OR_END : STATE_KEY_OR_END;
+    }
+
+    void close(bool isArray) {
+        if (depth == 0 || inArray() != isArray) {
+            fail(JSON_STREAM_SYNTAX);
+            return;
+        }
+        depth--;
+        if (!handler.endContainer(isArray)) {
+            fail(JSON_STREAM_REJECTED);
+            return;
+        }
+        afterValue();
+    }
+
+    void beginValue(char c) {
+        tokenLength = 0;
+        if (c == '{') {
+            open(false);
+        } else if (c == '[') {
+            open(true);
+        } else if (c == '"') {
+            isKeyString = false;
+            state = STATE_STRING;
+        } else if (c == '-' || isDigit(c)) {
+            append(c);
+            state = STATE_NUMBER;
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            literal = c == 't' ? "true" : (c == 'f' ? "false" : "null");
+            literalPosition = 1;
+            state = STATE_LITERAL;
+        } else {
+            fail(JSON_STREAM_SYNTAX);
+        }
+    }
+
+    // Грамматика числа JSON: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    // strtod принимает больше: "-.5", "1.e5", ведущий '+', "inf", шестнадцатеричные
+    static bool isJsonNumber(const char* text) {
+        const char* p = text;
+        if (*p == '-') p++;
+        if (*p == '0') p++;
+        else if (isDigit(*p)) while (isDigit(*p)) p++;
+        else return false;
+        if (*p == '.') {
+            if (!isDigit(*++p)) return false;
+            while (isDigit(*p)) p++;
+        }
+        if (*p == 'e' || *p == 'E') {
+            p++;
+            if (*p == '+' || *p == '-') p++;
+            if (!isDigit(*p)) return false;
+            while (isDigit(*p)) p++;
+        }
+        return *p == '\0';
+    }
+
+    void endNumber() {
+        token[tokenLength] = '\0';
+        if (!isJsonNumber(token)) {
+            fail(JSON_STREAM_SYNTAX);
+            return;
+        }
+        emit(JSON_VALUE_NUMBER, strtod(token, nullptr), false);
+    }
+
+    void endString() {
+        if (highSurrogate) {
+            appendUtf8(0xFFFD);
+            highSurrogate = 0;
+        }
+        if (status != JSON_STREAM_OK) return;
+
+        if (!isKeyString) {
+            emit(JSON_VALUE_STRING, 0, false);
+            return;
+        }
+        if (tokenLength > JSON_STREAM_MAX_KEY) {
+            fail(JSON_STREAM_TOO_LONG);
+            return;
+        }
+        memcpy(key, token, tokenLength);
+        key[tokenLength] = '\0';
+        hasKey = true;
+        tokenLength = 0;
+        state = STATE_COLON;
+    }
+
+    void endUnicode() {
+        uint32_t code = unicode;
+        if (code >= 0xD800 && code <= 0xDBFF) {
+            if (highSurrogate) appendUtf8(0xFFFD);
+            highSurrogate = code;
+            return;
+        }
+        if (code >= 0xDC00 && code <= 0xDFFF) {
+            if (!highSurrogate) {
+                appendUtf8(0xFFFD);
+                return;
+            }
+            code = 0x10000 + ((uint32_t)(highSurrogate - 0xD800) << 10) + (code - 0xDC00);
+            highSurrogate = 0;
+        } else if (highSurrogate) {
+            appendUtf8(0xFFFD);
+            highSurrogate = 0;
+        }
+        appendUtf8(code);
+    }
+
+    void step(char c) {
+        switch (state) {
+            case STATE_STRING:
+                if (c == '"') {
+                    endString();
+                } else if (c == '\\') {
+                    state = STATE_ESCAPE;
+                } else if ((uint8_t)c < 0x20) {
+                    fail(JSON_STREAM_SYNTAX);
+                } else {
+                    if (highSurrogate) {
+                        appendUtf8(0xFFFD);
+                        highSurrogate = 0;
+                    }
+                    append(c);
+                }
+                return;
+
+            case STATE_ESCAPE: {
+                state = STATE_STRING;
+                if (c == 'u') {
+                    unicode = 0;
+                    unicodeDigits = 0;
+                    state = STATE_UNICODE;
+                    return;
+                }
+                if (highSurrogate) {
+                    appendUtf8(0xFFFD);
+                    highSurrogate = 0;
+                }
+                const char* from = "\"\\/bfnrt";
+                const char* to = "\"\\/\b\f\n\r\t";
+                const char* found = strchr(from, c);
+                if (!found || c == '\0') fail(JSON_STREAM_SYNTAX);
+                else append(to[found - from]);
+                return;
+            }
+
+            case STATE_UNICODE: {
+                uint8_t digit;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                else {
+                    fail(JSON_STREAM_SYNTAX);
+                    return;
+                }
+                unicode = (unicode << 4) | digit;
+                if (++unicodeDigits == 4) {
+                    state = STATE_STRING;
+                    endUnicode();
+                }
+                return;
+            }
+
+            case STATE_NUMBER:
+                if (isDigit(c) || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                    append(c);
+                    return;
+                }
+                endNumber();
+                if (status != JSON_STREAM_OK) return;
+                break;   // разделитель разбирается ниже
+
+            case STATE_LITERAL:
+                if (c != literal[literalPosition]) {
+                    fail(JSON_STREAM_SYNTAX);
+                    return;
+                }
+                if (literal[++literalPosition] == '\0') {
+                    if (literal[0] == 'n') emit(JSON_VALUE_NULL, 0, false);
+                    else emit(JSON_VALUE_BOOL, literal[0] == 't', literal[0] == 't');
+                }
+                return;
+
+            default:
+                break;
+        }
+
+        if (isSpace(c)) return;
+
+        switch (state) {
+            case STATE_VALUE_OR_END:
+                if (c == ']') {
+                    close(true);
+                    return;
+                }
+                beginValue(c);
+                return;
+
+            case STATE_VALUE:
+                beginValue(c);
+                return;
+
+            case STATE_KEY_OR_END:
+                if (c == '}') {
+                    close(false);
+                    return;
+                }
+                // fallthrough
+            case STATE_KEY:
+                if (c != '"') {
+                    fail(JSON_STREAM_SYNTAX);
+                    return;
+                }
+                tokenLength = 0;
+                isKeyString = true;
+                state = STATE_STRING;
+                return;
+
+            case STATE_COLON:
+                if (c != ':') fail(JSON_STREAM_SYNTAX);
+                else state = STATE_VALUE;
+                return;
+
+            case STATE_COMMA_OR_END:
+                if (c == ',') state = inArray() ? STATE_VALUE : STATE_KEY;
+                else if (c == ']' || c == '}') close(c == ']');
+                else fail(JSON_STREAM_SYNTAX);
+                return;
+
+            default:
+                fail(JSON_STREAM_SYNTAX);   // мусор после документа
+                return;
+        }
+    }
+};
+
+#endif
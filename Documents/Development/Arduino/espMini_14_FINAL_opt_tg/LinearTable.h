@@ -0,0 +1,47 @@
+#ifndef LINEAR_TABLE_H
+#define LINEAR_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Кусочно-линейная таблица с равномерным шагом 2^shift по x.
+// Строится один раз (калибровка АЦП, кривая термистора), в работе -
+// одна выборка и целочисленная интерполяция.
+struct LinearTable {
+    int32_t x0 = 0;
+    uint8_t shift = 0;
+    std::vector<int32_t> y;
+
+    bool empty() const { return y.size() < 2; }
+
+    // Узлы x0, x0 + step, ..., покрывающие [x0, xMax]; fn(x) - точное значение в узле.
+    template<typename Fn>
+    void build(int32_t start, int32_t xMax, uint8_t stepShift, Fn fn) {
+        x0 = start;
+        shift = stepShift;
+        y.clear();
+        int32_t step = 1L << stepShift;
+        for (int32_t x = start; ; x += step) {
+            y.push_back(fn(x));
+            if (x >= xMax) break;
+        }
+    }
+
+    // Вне диапазона - значение крайнего узла.
+    int32_t lookup(int32_t x) const {
+        if (y.empty()) return 0;
+        if (x <= x0) return y.front();
+
+        uint32_t offset = (uint32_t)(x - x0);
+        size_t index = offset >> shift;
+        if (index >= y.size() - 1) return y.back();
+
+        int32_t frac = offset & ((1UL << shift) - 1);
+        int32_t a = y[index];
+        int32_t b = y[index + 1];
+        return a + (int32_t)(((int64_t)(b - a) * frac) >> shift);
+    }
+};
+
+#endif
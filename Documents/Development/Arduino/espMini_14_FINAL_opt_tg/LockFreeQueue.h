@@ -0,0 +1,148 @@
+#ifndef LOCK_FREE_QUEUE_H
+#define LOCK_FREE_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Ограниченные lock-free очереди для обмена между задачами/ядрами.
+// Только <atomic>, без Arduino и FreeRTOS - собираются и на хосте под std::thread.
+// Ёмкость N должна быть степенью двойки.
+
+// Один писатель, один читатель.
+template<typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue: N must be a power of two");
+
+public:
+    bool push(const T& item) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        if (head - tail >= N) return false;
+
+        _items[head & (N - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t head = _head.load(std::memory_order_acquire);
+        if (tail == head) return false;
+
+        item = _items[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    T _items[N];
+    alignas(4) std::atomic<size_t> _head{0};
+    alignas(4) std::atomic<size_t> _tail{0};
+};
+
+// Несколько писателей, один читатель (ячейки с номерами последовательности, схема Вьюкова).
+template<typename T, size_t N>
+class MpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "MpscQueue: N must be a power of two");
+
+public:
+    MpscQueue() {
+        for (size_t i = 0; i < N; i++) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const T& item) {
+        size_t pos = _head.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& cell = _cells[pos & (N - 1)];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0) {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.item = item;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T& item) {
+        Cell& cell = _cells[_tail & (N - 1)];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(_tail + 1) < 0) return false;
+
+        item = cell.item;
+        cell.sequence.store(_tail + N, std::memory_order_release);
+        _tail++;
+        return true;
+    }
+
+    // Количество отклонённых push из-за переполнения.
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    Cell _cells[N];
+    alignas(4) std::atomic<size_t> _head{0};
+    size_t _tail = 0;
+    std::atomic<uint32_t> _dropped{0};
+};
+
+// Снимок "последнего значения": один писатель, один читатель, три буфера.
+// Писатель никогда не ждёт читателя, читатель всегда получает самый свежий
+// полностью записанный снимок.
+template<typename T>
+class SnapshotBuffer {
+public:
+    // Буфер для заполнения писателем; после заполнения вызвать publish().
+    T& beginWrite() { return _buffers[_back]; }
+
+    void publish() {
+        uint8_t prev = _middle.exchange(_back | DIRTY, std::memory_order_acq_rel);
+        _back = prev & INDEX_MASK;
+    }
+
+    // Переключается на свежий снимок, если он есть. Возвращает true, если снимок обновился.
+    bool update() {
+        if (!(_middle.load(std::memory_order_relaxed) & DIRTY)) return false;
+
+        uint8_t prev = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = prev & INDEX_MASK;
+        return true;
+    }
+
+    const T& read() const { return _buffers[_front]; }
+
+private:
+    static constexpr uint8_t DIRTY = 0x80;
+    static constexpr uint8_t INDEX_MASK = 0x03;
+
+    T _buffers[3];
+    uint8_t _back = 0;
+    std::atomic<uint8_t> _middle{1};
+    uint8_t _front = 2;
+};
+
+#endif
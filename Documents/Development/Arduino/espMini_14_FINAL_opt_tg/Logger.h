@@ -2,14 +2,16 @@
 #define LOGGER_H_
 
 #include <algorithm>
+#include <new>
 #include <utility>
 
 #include "CommonTypes.h"
+#include "SpinLock.h"
 
 constexpr uint8_t MAX_LOG_MESSAGES = 50;
 constexpr size_t MAX_MESSAGE_LENGTH = 128;
 constexpr size_t MAX_TIMESTAMP_LENGTH = 20;
-constexpr uint16_t MAX_FILE_LOG_LINES = 100;
+constexpr size_t MAX_LOG_FILE_BYTES = 16384;   // дальше /log.txt уходит в /log.old
 
 enum LogType {
     LOG_ERROR = 0,
@@ -22,12 +24,17 @@ struct LogEntry {
     char timestamp[MAX_TIMESTAMP_LENGTH];
     bool isSay = false;
     uint8_t typeMsg = LOG_USER;
+    uint32_t sequence = 0;   // номер записи: ячейку кольца могли перезаписать
 };
 
+// Пишут обе задачи (управление и сеть). Кольцо и счётчики меняются только под
+// ringLock; наружу записи отдаются копиями, файл пишется вне блокировки.
 class Logger {
 private:
 
     LogEntry* logList = nullptr;
+    mutable SpinLock ringLock;
+    uint32_t nextSequence = 1;
 
     uint8_t currentIndex = 0;
     uint8_t logCount = 0;
@@ -53,11 +60,12 @@ private:
 
     uint8_t _unsentCount = 0;
     uint8_t _sentSinceLastSave = 0;
+    uint8_t _unsavedCount = 0;   // записи, ещё не дописанные в файл
     static constexpr uint8_t SAVE_TRIGGER_COUNT = 10;
 
     void initMemory() {
         size_t totalSize = sizeof(LogEntry) * MAX_LOG_MESSAGES;
-        Serial.printf("[LOGGER_DBG] Attempting to allocate %d bytes for log buffer...\n", totalSize);
+        Serial.printf("[LOGGER_DBG] Attempting to allocate %u bytes for log buffer...\n", (unsigned)totalSize);
 
     #ifdef ESP32
         if (psramFound()) {
@@ -80,8 +88,11 @@ private:
             }
         }
 
+        // Память из malloc/ps_malloc: записи создаются на месте, текст обнулён
         if (logList) {
-            memset(logList, 0, totalSize);
+            for (uint8_t i = 0; i < MAX_LOG_MESSAGES; ++i) {
+                new (&logList[i]) LogEntry();
+            }
         }
     }
 
@@ -133,6 +144,10 @@ public:
     void addLog(const String& message, uint8_t typeMsg = LOG_INFO) {
         if (!_loggingEnabled || !logList) return;
 
+        char timeBuffer[MAX_TIMESTAMP_LENGTH];
+        formatTime(timeBuffer, sizeof(timeBuffer));
+
+        ringLock.lock();
         if (logCount >= MAX_LOG_MESSAGES) {
             if (!logList[currentIndex].isSay) {
                 _unsentCount--;
@@ -140,10 +155,6 @@ public:
         }
 
         LogEntry& newEntry = logList[currentIndex];
-
-        char timeBuffer[MAX_TIMESTAMP_LENGTH];
-        formatTime(timeBuffer, sizeof(timeBuffer));
-
         strncpy(newEntry.timestamp, timeBuffer, MAX_TIMESTAMP_LENGTH - 1);
         newEntry.timestamp[MAX_TIMESTAMP_LENGTH - 1] = '\0';
 
@@ -152,63 +163,80 @@ public:
 
         newEntry.isSay = false;
         newEntry.typeMsg = (typeMsg <= LOG_USER) ? typeMsg : LOG_USER;
-
-        #ifdef LOGGER_DEBUG
-        Serial.printf("[LOG] Add: idx=%d, type=%d, isSay=%d, msg='%s'\n",
-                     currentIndex, typeMsg, newEntry.isSay, newEntry.message);
-        #endif
+        newEntry.sequence = nextSequence++;
 
         if (logCount < MAX_LOG_MESSAGES) {
             logCount++;
         }
         currentIndex = (currentIndex + 1) % MAX_LOG_MESSAGES;
         _unsentCount++;
+        if (_unsavedCount < MAX_LOG_MESSAGES) {
+            _unsavedCount++;
+        }
+        LogEntry added = _newLogCallback ? newEntry : LogEntry();
+        ringLock.unlock();
+
+        #ifdef LOGGER_DEBUG
+        Serial.printf("[LOG] Add: type=%d, msg='%s'\n", typeMsg, message.c_str());
+        #endif
 
         if (_newLogCallback) {
-            _newLogCallback(newEntry);
+            _newLogCallback(added);
         }
     }
 
-    LogEntry* getLogEntry(uint8_t index) {
-        if (index >= logCount || !logList) return nullptr;
+    bool getLogEntry(uint8_t index, LogEntry& entry) const {
+        if (!logList) return false;
 
-        uint8_t bufferIndex;
-        if (logCount < MAX_LOG_MESSAGES) {
-            bufferIndex = index;
-        } else {
-            bufferIndex = (currentIndex + index) % MAX_LOG_MESSAGES;
+        ringLock.lock();
+        bool isFound = index < logCount;
+        if (isFound) {
+            uint8_t bufferIndex;
+            if (logCount < MAX_LOG_MESSAGES) {
+                bufferIndex = index;
+            } else {
+                bufferIndex = (currentIndex + index) % MAX_LOG_MESSAGES;
+            }
+            entry = logList[bufferIndex];
         }
-
-        return &logList[bufferIndex];
+        ringLock.unlock();
+        return isFound;
     }
 
-    bool markAsSent(uint8_t bufferIndex) {
-        if (bufferIndex < MAX_LOG_MESSAGES && logList) {
-            if (!logList[bufferIndex].isSay) {
-                logList[bufferIndex].isSay = true;
-
-                _unsentCount--;
-                _sentSinceLastSave++;
+    // sequence - из копии, отданной getUnsentMessages: перезаписанная с тех пор
+    // ячейка не помечается
+    bool markAsSent(uint8_t bufferIndex, uint32_t sequence) {
+        if (bufferIndex >= MAX_LOG_MESSAGES || !logList) return false;
+
+        bool isSaveDue = false;
+        ringLock.lock();
+        LogEntry& entry = logList[bufferIndex];
+        if (entry.sequence == sequence && !entry.isSay) {
+            entry.isSay = true;
+            _unsentCount--;
+            _sentSinceLastSave++;
+            isSaveDue = _sentSinceLastSave >= SAVE_TRIGGER_COUNT;
+        }
+        ringLock.unlock();
 
-                #ifdef LOGGER_DEBUG
-                Serial.printf("[LOG] Marked as sent: bufferIdx=%d. Unsent left: %d, Sent since save: %d\n",
-                             bufferIndex, _unsentCount, _sentSinceLastSave);
-                #endif
+        #ifdef LOGGER_DEBUG
+        Serial.printf("[LOG] Marked as sent: bufferIdx=%d. Unsent left: %d, Sent since save: %d\n",
+                     bufferIndex, _unsentCount, _sentSinceLastSave);
+        #endif
 
-                if (_sentSinceLastSave >= SAVE_TRIGGER_COUNT) {
-                    Serial.printf("[LOGGER_DBG] %d messages sent, triggering save to SPIFFS.\n", _sentSinceLastSave);
-                    saveLogsToSPIFFS();
-                }
-            }
-            return true;
+        if (isSaveDue) {
+            Serial.printf("[LOGGER_DBG] %d messages sent, triggering save to SPIFFS.\n", _sentSinceLastSave);
+            saveLogsToSPIFFS();
         }
-        return false;
+        return true;
     }
 
-    uint8_t getUnsentMessages(std::vector<std::pair<LogEntry*, uint8_t>>& result, uint8_t maxCount) {
+    uint8_t getUnsentMessages(std::vector<std::pair<LogEntry, uint8_t>>& result, uint8_t maxCount) const {
         result.clear();
-        if (logCount == 0 || !logList) return 0;
+        if (!logList) return 0;
+        result.reserve(maxCount);
 
+        ringLock.lock();
         uint8_t startIdx;
         if (logCount < MAX_LOG_MESSAGES) {
             startIdx = 0;
@@ -219,72 +247,70 @@ public:
         for (size_t i = 0; i < logCount && result.size() < maxCount; ++i) {
             uint8_t idx = (startIdx + i) % MAX_LOG_MESSAGES;
             if (!logList[idx].isSay) {
-                result.push_back({&logList[idx], idx});
+                result.push_back({logList[idx], idx});
             }
         }
+        ringLock.unlock();
         return result.size();
     }
 
+    // Файл только дописывается: новые записи в конец, при переполнении
+    // текущий файл становится /log.old, а старый /log.old удаляется.
     void saveLogsToSPIFFS() {
         if (!logList) return;
 
         const char* filename = "/log.txt";
-        const char* tempFilename = "/log.tmp";
-
-        File originalFile = SPIFFS.open(filename, "r");
-        File tempFile = SPIFFS.open(tempFilename, "w");
-        if (!originalFile || !tempFile) {
-            Serial.println("Ошибка открытия файлов для ротации");
-            if (originalFile) originalFile.close();
-            if (tempFile) tempFile.close();
-            return;
-        }
-
-        std::vector<String> oldLines;
-        while (originalFile.available()) {
-            String line = originalFile.readStringUntil('\n');
-            line.trim();
-            if (line.length() > 0) {
-                oldLines.push_back(line);
+        const char* oldFilename = "/log.old";
+
+        ringLock.lock();
+        bool hasUnsaved = _unsavedCount > 0;
+        ringLock.unlock();
+
+        if (hasUnsaved) {
+            File sizeCheck = SPIFFS.open(filename, "r");
+            if (sizeCheck) {
+                size_t size = sizeCheck.size();
+                sizeCheck.close();
+                if (size >= MAX_LOG_FILE_BYTES) {
+                    SPIFFS.remove(oldFilename);
+                    SPIFFS.rename(filename, oldFilename);
+                }
             }
-              yield();
-        }
-        originalFile.close();
 
-        int linesToKeep = MAX_FILE_LOG_LINES - logCount;
-        if (linesToKeep > 0 && oldLines.size() > 0) {
-            auto start_it = oldLines.end() - min(linesToKeep, (int)oldLines.size());
-            for (auto it = start_it; it != oldLines.end(); ++it) {
-                tempFile.println(*it);
+            File file = SPIFFS.open(filename, "a");
+            if (!file) {
+                Serial.println("Ошибка открытия файла лога для записи");
+                return;
             }
-        }
-
-        if (oldLines.size() >= MAX_FILE_LOG_LINES) {
-            tempFile.println("[]==================[]=================[]\n");
-        }
 
-        uint8_t startIdx = (logCount < MAX_LOG_MESSAGES) ? 0 : currentIndex;
-        for (size_t i = 0; i < logCount; ++i) {
-            uint8_t idx = (startIdx + i) % MAX_LOG_MESSAGES;
-
-            char logBuffer[MAX_MESSAGE_LENGTH + MAX_TIMESTAMP_LENGTH + 10];
-            snprintf(logBuffer, sizeof(logBuffer), "%s;%c;%d;%s",
-                     logList[idx].timestamp,
-                     logList[idx].isSay ? '1' : '0',
-                     logList[idx].typeMsg,
-                     logList[idx].message);
-            tempFile.println(logBuffer);
-
-           if (i % 20 == 0) {
-            yield();
-            delay(1);
-          }
+            // По одной записи: старейшая недописанная копируется под блокировкой,
+            // в файл - без неё. Не больше кольца, даже если пишут параллельно.
+            for (uint8_t i = 0; i < MAX_LOG_MESSAGES; ++i) {
+                LogEntry entry;
+                ringLock.lock();
+                bool hasEntry = _unsavedCount > 0;
+                if (hasEntry) {
+                    entry = logList[(currentIndex + MAX_LOG_MESSAGES - _unsavedCount) % MAX_LOG_MESSAGES];
+                    _unsavedCount--;
+                }
+                ringLock.unlock();
+                if (!hasEntry) break;
+
+                char logBuffer[MAX_MESSAGE_LENGTH + MAX_TIMESTAMP_LENGTH + 10];
+                snprintf(logBuffer, sizeof(logBuffer), "%s;%c;%d;%s",
+                         entry.timestamp,
+                         entry.isSay ? '1' : '0',
+                         entry.typeMsg,
+                         entry.message);
+                file.println(logBuffer);
+
+                if (i % 20 == 0) {
+                    yield();
+                }
+            }
+            file.close();
         }
 
-        tempFile.close();
-        SPIFFS.remove(filename);
-        SPIFFS.rename(tempFilename, filename);
-
         _sentSinceLastSave = 0;
 
         #ifdef LOGGER_DEBUG
@@ -308,7 +334,9 @@ public:
             return;
         }
 
+        ringLock.lock();
         _unsentCount = 0;
+        ringLock.unlock();
 
         uint8_t loadedCount = 0;
         while (file.available() && logCount < MAX_LOG_MESSAGES) {
@@ -323,21 +351,26 @@ public:
             if (separator1 != -1 && separator2 != -1 && separator3 != -1 &&
                 separator3 > separator2 && separator2 > separator1) {
 
-                strncpy(logList[currentIndex].timestamp, line.substring(0, separator1).c_str(), MAX_TIMESTAMP_LENGTH - 1);
-                logList[currentIndex].timestamp[MAX_TIMESTAMP_LENGTH - 1] = '\0';
+                // Разбор - в локальную запись: под блокировкой только копирование
+                LogEntry loaded;
+                strncpy(loaded.timestamp, line.substring(0, separator1).c_str(), MAX_TIMESTAMP_LENGTH - 1);
+                loaded.timestamp[MAX_TIMESTAMP_LENGTH - 1] = '\0';
 
-                logList[currentIndex].isSay = line.substring(separator1 + 1, separator2).equalsIgnoreCase("1");
+                loaded.isSay = line.substring(separator1 + 1, separator2).equalsIgnoreCase("1");
 
                 String typeStr = line.substring(separator2 + 1, separator3);
-                logList[currentIndex].typeMsg = typeStr.toInt();
-                if (logList[currentIndex].typeMsg > LOG_USER) {
-                    logList[currentIndex].typeMsg = LOG_USER;
+                loaded.typeMsg = typeStr.toInt();
+                if (loaded.typeMsg > LOG_USER) {
+                    loaded.typeMsg = LOG_USER;
                 }
 
-                strncpy(logList[currentIndex].message, line.substring(separator3 + 1).c_str(), MAX_MESSAGE_LENGTH - 1);
-                logList[currentIndex].message[MAX_MESSAGE_LENGTH - 1] = '\0';
+                strncpy(loaded.message, line.substring(separator3 + 1).c_str(), MAX_MESSAGE_LENGTH - 1);
+                loaded.message[MAX_MESSAGE_LENGTH - 1] = '\0';
 
-                if (!logList[currentIndex].isSay) {
+                ringLock.lock();
+                loaded.sequence = nextSequence++;
+                logList[currentIndex] = loaded;
+                if (!loaded.isSay) {
                     _unsentCount++;
                 }
 
@@ -345,6 +378,7 @@ public:
                 if (logCount < MAX_LOG_MESSAGES) {
                     logCount++;
                 }
+                ringLock.unlock();
                 loadedCount++;
             }
         }
@@ -360,26 +394,14 @@ public:
         StaticJsonDocument<8192> jsonDoc;
         JsonArray logsArray = jsonDoc.to<JsonArray>();
 
-        if (logCount == 0 || !logList) {
-            String output;
-            serializeJson(jsonDoc, output);
-            return output;
-        }
-
-        uint8_t startIdx;
-        if (logCount < MAX_LOG_MESSAGES) {
-            startIdx = 0;
-        } else {
-            startIdx = currentIndex;
-        }
-
-        for (size_t i = 0; i < logCount; ++i) {
-            uint8_t idx = (startIdx + i) % MAX_LOG_MESSAGES;
+        // Копии по одной записи; char* (не const) ArduinoJson копирует в документ
+        LogEntry entry;
+        for (uint8_t i = 0; i < MAX_LOG_MESSAGES && getLogEntry(i, entry); ++i) {
             JsonObject logEntry = logsArray.createNestedObject();
-            logEntry["timestamp"] = logList[idx].timestamp;
-            logEntry["message"] = logList[idx].message;
-            logEntry["isSay"] = logList[idx].isSay;
-            logEntry["typeMsg"] = logList[idx].typeMsg;
+            logEntry["timestamp"] = (char*)entry.timestamp;
+            logEntry["message"] = (char*)entry.message;
+            logEntry["isSay"] = entry.isSay;
+            logEntry["typeMsg"] = entry.typeMsg;
 
              if (i % 30 == 0) yield();
         }
@@ -392,6 +414,7 @@ public:
     void clearLogs() {
         if (!logList) return;
 
+        ringLock.lock();
         for (uint8_t i = 0; i < logCount; ++i) {
 
             memset(logList[i].message, 0, MAX_MESSAGE_LENGTH);
@@ -404,6 +427,10 @@ public:
         currentIndex = 0;
         _unsentCount = 0;
         _sentSinceLastSave = 0;
+        _unsavedCount = 0;
+        ringLock.unlock();
+
+        SPIFFS.remove("/log.old");
 
         const char* filename = "/log.txt";
         File file = SPIFFS.open(filename, "w");
@@ -414,10 +441,12 @@ public:
         file.close();
     }
 
-    std::vector<LogEntry*> getLogsByType(uint8_t type, uint8_t maxCount = 10) {
-        std::vector<LogEntry*> result;
-        if (logCount == 0 || type > LOG_USER || !logList) return result;
+    std::vector<LogEntry> getLogsByType(uint8_t type, uint8_t maxCount = 10) const {
+        std::vector<LogEntry> result;
+        if (type > LOG_USER || !logList) return result;
+        result.reserve(maxCount);
 
+        ringLock.lock();
         uint8_t startIdx;
         if (logCount < MAX_LOG_MESSAGES) {
             startIdx = 0;
@@ -428,9 +457,10 @@ public:
         for (size_t i = 0; i < logCount && result.size() < maxCount; ++i) {
             uint8_t idx = (startIdx + i) % MAX_LOG_MESSAGES;
             if (logList[idx].typeMsg == type) {
-                result.push_back(&logList[idx]);
+                result.push_back(logList[idx]);
             }
         }
+        ringLock.unlock();
         return result;
     }
 };
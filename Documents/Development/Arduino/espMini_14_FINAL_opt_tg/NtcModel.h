@@ -0,0 +1,77 @@
+#ifndef NTC_MODEL_H
+#define NTC_MODEL_H
+
+#include <stdint.h>
+#include <math.h>
+#include "LinearTable.h"
+
+// Модель термистора NTC: Beta или полный Стейнхарт-Харт, делитель с
+// последовательным резистором. При смене конфигурации модель компилируется
+// в кусочно-линейную таблицу "мВ на входе -> сотые доли градуса", и замер
+// обходится без log() и делений с плавающей точкой.
+// Без Arduino: точность таблицы проверяется на хосте.
+
+#define NTC_NOMINAL_KELVIN 298.15    // R25
+#define NTC_INPUT_SHIFT 4            // вход таблицы - мВ * 16
+#define NTC_TABLE_SHIFT 8            // шаг узлов - 16 мВ
+#define NTC_RATIO_MIN 0.001
+#define NTC_RATIO_MAX 0.999
+
+struct NtcParams {
+    uint16_t seriesR;
+    uint16_t nominalR;
+    float beta;
+    // Коэффициенты Стейнхарта-Харта; все нули - используется Beta
+    float shA;
+    float shB;
+    float shC;
+    float offset;   // поправка, °C
+};
+
+class NtcModel {
+public:
+    static bool usesSteinhartHart(const NtcParams& params) {
+        return params.shA != 0.0f || params.shB != 0.0f || params.shC != 0.0f;
+    }
+
+    // ratio = Uвх / Uпитания
+    static double resistance(const NtcParams& params, double ratio) {
+        return params.seriesR / (1.0 / ratio - 1.0);
+    }
+
+    static double exactCelsius(const NtcParams& params, double ratio) {
+        if (ratio < NTC_RATIO_MIN) ratio = NTC_RATIO_MIN;
+        if (ratio > NTC_RATIO_MAX) ratio = NTC_RATIO_MAX;
+
+        double lnR = log(resistance(params, ratio));
+        double inverseKelvin;
+        if (usesSteinhartHart(params)) {
+            inverseKelvin = params.shA + params.shB * lnR + params.shC * lnR * lnR * lnR;
+        } else {
+            inverseKelvin = (lnR - log((double)params.nominalR)) / params.beta + 1.0 / NTC_NOMINAL_KELVIN;
+        }
+        return 1.0 / inverseKelvin - 273.15 + params.offset;
+    }
+
+    static bool isValid(const NtcParams& params) {
+        return params.seriesR > 0 && (usesSteinhartHart(params) || (params.nominalR > 0 && params.beta > 0));
+    }
+
+    static void buildTable(const NtcParams& params, uint16_t fullScaleMv, LinearTable& table) {
+        if (!isValid(params)) {
+            table.y.clear();
+            return;
+        }
+        table.build(0, (int32_t)fullScaleMv << NTC_INPUT_SHIFT, NTC_TABLE_SHIFT, [&](int32_t x) -> int32_t {
+            double ratio = (double)x / ((int32_t)fullScaleMv << NTC_INPUT_SHIFT);
+            return (int32_t)lround(exactCelsius(params, ratio) * 100.0);
+        });
+    }
+
+    // Сотые доли градуса по напряжению входа в мВ.
+    static int32_t lookupCentiCelsius(const LinearTable& table, float mv) {
+        return table.lookup((int32_t)(mv * (1 << NTC_INPUT_SHIFT)));
+    }
+};
+
+#endif
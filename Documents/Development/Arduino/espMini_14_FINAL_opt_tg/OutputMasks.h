@@ -0,0 +1,92 @@
+#ifndef OUTPUT_MASKS_H
+#define OUTPUT_MASKS_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Теневое состояние цифровых выходов по номеру пина и расчёт масок set/clear.
+// Без Arduino: проверяется на хосте, аппаратная запись - в OutputStage.
+
+#define OUTPUT_MAX_PINS 64
+#define OUTPUT_BANKS (OUTPUT_MAX_PINS / 32)
+
+struct OutputMasks {
+    uint32_t set[OUTPUT_BANKS];
+    uint32_t clear[OUTPUT_BANKS];
+
+    bool empty() const {
+        for (int i = 0; i < OUTPUT_BANKS; i++) {
+            if (set[i] || clear[i]) return false;
+        }
+        return true;
+    }
+
+    uint8_t count() const {
+        uint8_t total = 0;
+        for (int i = 0; i < OUTPUT_BANKS; i++) {
+            total += __builtin_popcount(set[i]) + __builtin_popcount(clear[i]);
+        }
+        return total;
+    }
+};
+
+class OutputMaskBuilder {
+public:
+    OutputMaskBuilder() { reset(); }
+
+    // Забыть состояние: следующий stage() любого пина даст запись.
+    void reset() {
+        memset(shadowLevel, 0, sizeof(shadowLevel));
+        memset(shadowKnown, 0, sizeof(shadowKnown));
+        memset(&pending, 0, sizeof(pending));
+    }
+
+    // Забыть состояние одного пина (пин был занят ШИМ).
+    void forget(uint8_t pin) {
+        if (pin >= OUTPUT_MAX_PINS) return;
+        shadowKnown[pin / 32] &= ~(1UL << (pin % 32));
+    }
+
+    // Запланировать уровень пина. force - записать, даже если уровень не менялся.
+    bool stage(uint8_t pin, bool level, bool force = false) {
+        if (pin >= OUTPUT_MAX_PINS) return false;
+
+        uint8_t bank = pin / 32;
+        uint32_t bit = 1UL << (pin % 32);
+
+        bool known = shadowKnown[bank] & bit;
+        bool current = shadowLevel[bank] & bit;
+        if (known && current == level && !force) return false;
+
+        if (level) {
+            pending.set[bank] |= bit;
+            pending.clear[bank] &= ~bit;
+        } else {
+            pending.clear[bank] |= bit;
+            pending.set[bank] &= ~bit;
+        }
+        return true;
+    }
+
+    // Забрать накопленные маски и перенести их в теневое состояние.
+    OutputMasks take() {
+        OutputMasks masks = pending;
+        for (int i = 0; i < OUTPUT_BANKS; i++) {
+            shadowLevel[i] = (shadowLevel[i] | masks.set[i]) & ~masks.clear[i];
+            shadowKnown[i] |= masks.set[i] | masks.clear[i];
+        }
+        memset(&pending, 0, sizeof(pending));
+        return masks;
+    }
+
+    bool level(uint8_t pin) const {
+        return pin < OUTPUT_MAX_PINS && (shadowLevel[pin / 32] & (1UL << (pin % 32)));
+    }
+
+private:
+    uint32_t shadowLevel[OUTPUT_BANKS];
+    uint32_t shadowKnown[OUTPUT_BANKS];
+    OutputMasks pending;
+};
+
+#endif
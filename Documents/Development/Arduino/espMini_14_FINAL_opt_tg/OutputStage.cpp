@@ -0,0 +1,69 @@
+#include "OutputStage.h"
+
+#if defined(ESP32)
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#endif
+
+OutputStage::OutputStage() {
+    reset();
+}
+
+void OutputStage::reset() {
+    digital.reset();
+    pwm.reset();
+}
+
+bool OutputStage::setDigital(uint8_t pin, bool level, bool force) {
+    if (pwm.release(pin)) {
+        // Пин вернулся из ШИМ - уровень надо записать заново
+        digital.forget(pin);
+    }
+    return digital.stage(pin, level, force);
+}
+
+PwmWriteResult OutputStage::setPwm(uint8_t pin, uint32_t duty, uint8_t bits, const PwmOutputConfig& config, uint32_t now, bool force) {
+    PwmWriteResult result = pwm.write(pin, duty, bits, config, now, force);
+    if (result == PWM_WRITTEN || result == PWM_ATTACHED) {
+        tickWrites++;
+    }
+    return result;
+}
+
+OutputMasks OutputStage::commit() {
+    OutputMasks masks = digital.take();
+    if (!masks.empty()) {
+        applyMasks(masks);
+        tickWrites += masks.count();
+    }
+
+    tickWritesLast = tickWrites;
+    if (tickWrites > tickWritesMax) tickWritesMax = tickWrites;
+    writesTotal += tickWrites;
+    tickWrites = 0;
+    return masks;
+}
+
+void OutputStage::applyMasks(const OutputMasks& masks) {
+#if defined(ESP32)
+    // GPIO.out_w1ts / out_w1tc: пины 0-31, out1_* - пины 32 и выше
+    if (masks.set[0]) REG_WRITE(GPIO_OUT_W1TS_REG, masks.set[0]);
+    if (masks.clear[0]) REG_WRITE(GPIO_OUT_W1TC_REG, masks.clear[0]);
+#if defined(GPIO_OUT1_W1TS_REG)
+    if (masks.set[1]) REG_WRITE(GPIO_OUT1_W1TS_REG, masks.set[1]);
+    if (masks.clear[1]) REG_WRITE(GPIO_OUT1_W1TC_REG, masks.clear[1]);
+#endif
+#elif defined(ESP8266)
+    // GPIO16 живёт в RTC-блоке и в GPOS/GPOC не входит
+    if (masks.set[0] & 0xFFFF) GPOS = masks.set[0] & 0xFFFF;
+    if (masks.clear[0] & 0xFFFF) GPOC = masks.clear[0] & 0xFFFF;
+    if (masks.set[0] & (1UL << 16)) digitalWrite(16, HIGH);
+    if (masks.clear[0] & (1UL << 16)) digitalWrite(16, LOW);
+#else
+    for (uint8_t pin = 0; pin < OUTPUT_MAX_PINS; pin++) {
+        uint32_t bit = 1UL << (pin % 32);
+        if (masks.set[pin / 32] & bit) digitalWrite(pin, HIGH);
+        else if (masks.clear[pin / 32] & bit) digitalWrite(pin, LOW);
+    }
+#endif
+}
@@ -0,0 +1,46 @@
+#ifndef OUTPUT_STAGE_H
+#define OUTPUT_STAGE_H
+
+#include <Arduino.h>
+#include "OutputMasks.h"
+#include "PwmEngine.h"
+
+// Выходной каскад реле: за цикл updatePins копит изменения цифровых пинов
+// и применяет их одной записью в регистры set/clear GPIO. ШИМ-выходы - через PwmEngine.
+class OutputStage {
+public:
+    OutputStage();
+
+    // Цифровой выход: только планирует запись, на пин она попадёт в commit().
+    bool setDigital(uint8_t pin, bool level, bool force = false);
+
+    // ШИМ-выход уходит в PwmEngine сразу; duty в разрядности bits.
+    PwmWriteResult setPwm(uint8_t pin, uint32_t duty, uint8_t bits, const PwmOutputConfig& config, uint32_t now, bool force = false);
+
+    // Шаг плавных переходов ШИМ.
+    void tick(uint32_t now) { pwm.tick(now); }
+
+    // Записывает накопленные маски в регистры. Возвращает применённые маски для лога.
+    OutputMasks commit();
+
+    // Сброс теней (после перенастройки пинов): следующий цикл перезапишет все выходы.
+    void reset();
+
+    uint8_t lastTickWrites() const { return tickWritesLast; }
+    uint8_t maxTickWrites() const { return tickWritesMax; }
+    uint32_t totalWrites() const { return writesTotal; }
+    const PwmEngine& pwmEngine() const { return pwm; }
+
+private:
+    OutputMaskBuilder digital;
+    PwmEngine pwm;
+
+    uint8_t tickWrites = 0;
+    uint8_t tickWritesLast = 0;
+    uint8_t tickWritesMax = 0;
+    uint32_t writesTotal = 0;
+
+    void applyMasks(const OutputMasks& masks);
+};
+
+#endif
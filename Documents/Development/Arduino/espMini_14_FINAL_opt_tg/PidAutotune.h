@@ -0,0 +1,150 @@
+#ifndef PID_AUTOTUNE_H
+#define PID_AUTOTUNE_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Автонастройка ПИД релейным методом Острёма-Хеглунда: выход переключается
+// между нулём и максимумом вокруг уставки с гистерезисом, по установившимся
+// автоколебаниям меряются период Tu и амплитуда a. Критический коэффициент
+// Ku = 4d / (pi * a), где d - половина размаха выхода; коэффициенты - по
+// правилу Циглера-Николса "без перерегулирования". Без Arduino: проверяется
+// на хосте на модели нагревателя.
+
+#define AUTOTUNE_CYCLES 4                       // периодов в расчёте, первый (переходный) отбрасывается
+#define AUTOTUNE_TIMEOUT_MS (4UL * 3600 * 1000)
+#define AUTOTUNE_DEFAULT_HYSTERESIS 0.3f
+#define AUTOTUNE_MIN_HYSTERESIS 0.05f
+
+enum AutotuneState : uint8_t {
+    AUTOTUNE_IDLE,
+    AUTOTUNE_RUNNING,
+    AUTOTUNE_DONE,
+    AUTOTUNE_FAILED
+};
+
+// Коэффициенты в единицах выхода регулятора: Ki - в секунду, Kd - в секундах
+struct AutotuneResult {
+    double ku;
+    double tuSeconds;
+    double amplitude;
+    double kp;
+    double ki;
+    double kd;
+};
+
+class PidAutotune {
+public:
+    // direct - выход увеличивает вход (нагрев); иначе охлаждение.
+    // outputSpan - полный размах выхода регулятора.
+    void start(float newSetpoint, float newHysteresis, double newOutputSpan, bool isDirect, uint32_t now) {
+        setpoint = isDirect ? newSetpoint : -newSetpoint;
+        hysteresis = newHysteresis < AUTOTUNE_MIN_HYSTERESIS ? AUTOTUNE_MIN_HYSTERESIS : newHysteresis;
+        outputSpan = newOutputSpan;
+        direct = isDirect;
+        startTime = now;
+        output = false;
+        started = false;
+        cycleCount = 0;
+        periodSum = 0;
+        highSum = 0;
+        lowSum = 0;
+        result = AutotuneResult();
+        currentState = AUTOTUNE_RUNNING;
+    }
+
+    void cancel() {
+        if (currentState == AUTOTUNE_RUNNING) currentState = AUTOTUNE_IDLE;
+    }
+
+    // Выход реле на очередной замер: true - нагрев (охлаждение) включён.
+    bool update(uint32_t now, float input) {
+        if (currentState != AUTOTUNE_RUNNING) return false;
+        if (isnan(input) || now - startTime > AUTOTUNE_TIMEOUT_MS) {
+            currentState = AUTOTUNE_FAILED;
+            return false;
+        }
+
+        float y = direct ? input : -input;
+
+        if (started) {
+            if (y > cycleHigh) cycleHigh = y;
+            if (y < cycleLow) cycleLow = y;
+        }
+
+        if (!output && y < setpoint - hysteresis) {
+            output = true;
+            onSwitchOn(now, y);
+        } else if (output && y > setpoint + hysteresis) {
+            output = false;
+        }
+        return output;
+    }
+
+    AutotuneState state() const { return currentState; }
+    uint8_t cycles() const { return cycleCount > 0 ? cycleCount - 1 : 0; }
+    const AutotuneResult& getResult() const { return result; }
+
+private:
+    AutotuneState currentState = AUTOTUNE_IDLE;
+    float setpoint = 0;
+    float hysteresis = AUTOTUNE_DEFAULT_HYSTERESIS;
+    double outputSpan = 0;
+    bool direct = true;
+    bool output = false;
+    bool started = false;
+    uint32_t startTime = 0;
+
+    // Цикл - от включения до следующего включения, в нём оба экстремума
+    uint32_t cycleStart = 0;
+    float cycleHigh = 0;
+    float cycleLow = 0;
+    uint8_t cycleCount = 0;
+    double periodSum = 0;
+    double highSum = 0;
+    double lowSum = 0;
+
+    AutotuneResult result = AutotuneResult();
+
+    void onSwitchOn(uint32_t now, float y) {
+        if (started) {
+            // Первый полный цикл - переходный процесс от начальной температуры
+            if (cycleCount > 0) {
+                periodSum += (now - cycleStart) / 1000.0;
+                highSum += cycleHigh;
+                lowSum += cycleLow;
+            }
+            cycleCount++;
+            if (cycleCount > AUTOTUNE_CYCLES) {
+                finish();
+                return;
+            }
+        }
+        started = true;
+        cycleStart = now;
+        cycleHigh = y;
+        cycleLow = y;
+    }
+
+    void finish() {
+        double tu = periodSum / AUTOTUNE_CYCLES;
+        double amplitude = (highSum - lowSum) / AUTOTUNE_CYCLES / 2.0;
+        // Поправка на гистерезис реле
+        double effective = amplitude > hysteresis ? sqrt(amplitude * amplitude - (double)hysteresis * hysteresis) : amplitude;
+
+        if (tu <= 0 || effective <= 0) {
+            currentState = AUTOTUNE_FAILED;
+            return;
+        }
+
+        result.tuSeconds = tu;
+        result.amplitude = amplitude;
+        result.ku = 4.0 * (outputSpan / 2.0) / (M_PI * effective);
+        result.kp = 0.2 * result.ku;
+        result.ki = result.kp / (0.5 * tu);
+        result.kd = result.kp * tu / 3.0;
+        currentState = AUTOTUNE_DONE;
+    }
+};
+
+#endif
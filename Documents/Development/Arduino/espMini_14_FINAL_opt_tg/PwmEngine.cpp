@@ -0,0 +1,207 @@
+#include "PwmEngine.h"
+
+#if defined(ESP32)
+#include "driver/ledc.h"
+
+// Таймеры LEDC тактируются от APB 80 МГц
+static const PwmHardwareLimits PWM_LIMITS = { LEDC_SPEED_MODE_MAX, LEDC_TIMER_MAX, LEDC_CHANNEL_MAX, 80000000UL };
+#else
+// ESP8266: одна частота и один диапазон на все пины
+static const PwmHardwareLimits PWM_LIMITS = { 1, 1, 17, 80000000UL };
+#endif
+
+#define PWM_NO_OUTPUT 0xFF
+
+PwmEngine::PwmEngine() : allocator(PWM_LIMITS) {
+    memset(outputByPin, PWM_NO_OUTPUT, sizeof(outputByPin));
+}
+
+void PwmEngine::reset() {
+    for (auto& output : outputs) {
+        release(output.pin);
+    }
+    outputs.clear();
+    allocator.reset();
+    memset(outputByPin, PWM_NO_OUTPUT, sizeof(outputByPin));
+    failedPins = 0;
+}
+
+PwmEngine::Output* PwmEngine::find(uint8_t pin) {
+    if (pin >= OUTPUT_MAX_PINS || outputByPin[pin] == PWM_NO_OUTPUT) return nullptr;
+    return &outputs[outputByPin[pin]];
+}
+
+const PwmSlot* PwmEngine::slotFor(uint8_t pin) const {
+    if (pin >= OUTPUT_MAX_PINS || outputByPin[pin] == PWM_NO_OUTPUT) return nullptr;
+    return &outputs[outputByPin[pin]].slot;
+}
+
+bool PwmEngine::isAttached(uint8_t pin) const {
+    if (pin >= OUTPUT_MAX_PINS || outputByPin[pin] == PWM_NO_OUTPUT) return false;
+    return outputs[outputByPin[pin]].attached;
+}
+
+PwmEngine::Output* PwmEngine::attach(uint8_t pin, const PwmOutputConfig& config, bool& attachedNow) {
+    Output* output = find(pin);
+    if (output && output->attached) return output;
+
+    if (!output) {
+        if (failedPins & (1ULL << pin)) return nullptr;
+
+        PwmSlot slot = allocator.allocate(config.frequency, config.resolution);
+        if (!slot.valid()) return nullptr;
+
+        if (slot.newTimer) {
+#if defined(ESP32)
+            ledc_timer_config_t timerConfig = {};
+            timerConfig.speed_mode = (ledc_mode_t)slot.mode;
+            timerConfig.duty_resolution = (ledc_timer_bit_t)slot.resolution;
+            timerConfig.timer_num = (ledc_timer_t)slot.timer;
+            timerConfig.freq_hz = slot.frequency;
+            timerConfig.clk_cfg = LEDC_AUTO_CLK;
+            if (ledc_timer_config(&timerConfig) != ESP_OK) return nullptr;
+#else
+            analogWriteFreq(slot.frequency);
+            analogWriteRange(1UL << slot.resolution);
+#endif
+        }
+
+        Output created = {};
+        created.pin = pin;
+        created.slot = slot;
+        outputs.push_back(created);
+        outputByPin[pin] = outputs.size() - 1;
+        output = &outputs.back();
+    }
+
+#if defined(ESP32)
+    ledc_channel_config_t channelConfig = {};
+    channelConfig.gpio_num = pin;
+    channelConfig.speed_mode = (ledc_mode_t)output->slot.mode;
+    channelConfig.channel = (ledc_channel_t)output->slot.channel;
+    channelConfig.intr_type = LEDC_INTR_DISABLE;
+    channelConfig.timer_sel = (ledc_timer_t)output->slot.timer;
+    channelConfig.duty = 0;
+    channelConfig.hpoint = 0;
+    if (ledc_channel_config(&channelConfig) != ESP_OK) return nullptr;
+
+    if (!fadeInstalled) {
+        fadeInstalled = ledc_fade_func_install(0) == ESP_OK;
+    }
+#endif
+
+    // Подключение всегда с нуля: первый переход и есть плавный пуск
+    output->attached = true;
+    output->applied = 0;
+    output->fading = false;
+    attachedNow = true;
+    return output;
+}
+
+PwmWriteResult PwmEngine::write(uint8_t pin, uint32_t duty, uint8_t bits, const PwmOutputConfig& config, uint32_t now, bool force) {
+    if (pin >= OUTPUT_MAX_PINS) return PWM_UNCHANGED;
+
+    bool attachedNow = false;
+    Output* output = attach(pin, config, attachedNow);
+    if (!output) {
+        if (failedPins & (1ULL << pin)) return PWM_UNCHANGED;
+        failedPins |= 1ULL << pin;
+        return PWM_NO_CHANNEL;
+    }
+
+    uint32_t target = PwmFadePlanner::scaleDuty(duty, bits, output->slot.resolution);
+    output->rampMs = config.rampMs;
+    if (!attachedNow && !force && target == output->target) return PWM_UNCHANGED;
+
+    output->target = target;
+
+    if (output->fading && now - output->fadeStart < output->fade.durationMs) {
+#if defined(ESP32)
+        // Аппаратный переход не прерываем: новая цель уйдёт в tick() после его окончания
+        return attachedNow ? PWM_ATTACHED : PWM_WRITTEN;
+#else
+        output->applied = PwmFadePlanner::dutyAt(output->fade, now - output->fadeStart);
+#endif
+    }
+
+    apply(*output, now);
+    return attachedNow ? PWM_ATTACHED : PWM_WRITTEN;
+}
+
+void PwmEngine::apply(Output& output, uint32_t now) {
+    PwmFade fade = PwmFadePlanner::plan(output.applied, output.target, output.slot.resolution, output.rampMs);
+    output.applied = output.target;
+    output.fading = false;
+
+    if (fade.durationMs == 0) {
+        writeDuty(output, fade.toDuty);
+        return;
+    }
+
+#if defined(ESP32)
+    if (!fadeInstalled ||
+        ledc_set_fade_with_time((ledc_mode_t)output.slot.mode, (ledc_channel_t)output.slot.channel,
+                                fade.toDuty, fade.durationMs) != ESP_OK ||
+        ledc_fade_start((ledc_mode_t)output.slot.mode, (ledc_channel_t)output.slot.channel,
+                        LEDC_FADE_NO_WAIT) != ESP_OK) {
+        writeDuty(output, fade.toDuty);
+        return;
+    }
+#else
+    writeDuty(output, fade.fromDuty);
+#endif
+
+    output.fade = fade;
+    output.fadeStart = now;
+    output.fading = true;
+}
+
+void PwmEngine::writeDuty(const Output& output, uint32_t duty) {
+#if defined(ESP32)
+    ledc_set_duty((ledc_mode_t)output.slot.mode, (ledc_channel_t)output.slot.channel, duty);
+    ledc_update_duty((ledc_mode_t)output.slot.mode, (ledc_channel_t)output.slot.channel);
+#else
+    analogWrite(output.pin, duty);
+#endif
+}
+
+void PwmEngine::tick(uint32_t now) {
+    for (auto& output : outputs) {
+        if (!output.attached || !output.fading) continue;
+
+        uint32_t elapsed = now - output.fadeStart;
+        if (elapsed < output.fade.durationMs) {
+#if !defined(ESP32)
+            writeDuty(output, PwmFadePlanner::dutyAt(output.fade, elapsed));
+#endif
+            continue;
+        }
+
+        output.fading = false;
+#if !defined(ESP32)
+        writeDuty(output, output.fade.toDuty);
+#endif
+        if (output.target != output.applied) {
+            apply(output, now);
+        }
+    }
+}
+
+bool PwmEngine::release(uint8_t pin) {
+    Output* output = find(pin);
+    if (!output || !output->attached) return false;
+
+#if defined(ESP32)
+    ledc_stop((ledc_mode_t)output->slot.mode, (ledc_channel_t)output->slot.channel, 0);
+#else
+    analogWrite(pin, 0);
+#endif
+    // pinMode возвращает пин от LEDC/waveform обычному GPIO
+    pinMode(pin, OUTPUT);
+
+    output->attached = false;
+    output->fading = false;
+    output->applied = 0;
+    output->target = 0;
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef PWM_ENGINE_H
+#define PWM_ENGINE_H
+
+#include <Arduino.h>
+#include <vector>
+#include "PwmPlanner.h"
+#include "OutputMasks.h"
+
+// Аппаратный ШИМ реле: на ESP32 - каналы и таймеры LEDC с аппаратными
+// плавными переходами, на ESP8266 - генератор waveform (analogWrite) с общей
+// частотой и программными переходами.
+
+struct PwmOutputConfig {
+    uint32_t frequency;
+    uint8_t resolution;
+    uint32_t rampMs;     // время перехода 0 -> 100%, 0 - без плавности
+};
+
+enum PwmWriteResult : uint8_t {
+    PWM_UNCHANGED,
+    PWM_WRITTEN,
+    PWM_ATTACHED,     // пин впервые подключён к каналу и записан
+    PWM_NO_CHANNEL    // свободных каналов нет (сообщается один раз до reset())
+};
+
+class PwmEngine {
+public:
+    PwmEngine();
+
+    // Освобождает все каналы; вызывается при перенастройке пинов.
+    void reset();
+
+    // duty в разрядности bits (relay.pwm - 8 бит, ПИД - 16 бит); now - часы
+    // управления, те же, что получает tick().
+    PwmWriteResult write(uint8_t pin, uint32_t duty, uint8_t bits, const PwmOutputConfig& config, uint32_t now, bool force = false);
+
+    // Отключает пин от ШИМ и возвращает его обычному GPIO. Канал остаётся за пином.
+    bool release(uint8_t pin);
+
+    // Отложенные цели после аппаратного перехода, программные переходы на ESP8266.
+    void tick(uint32_t now);
+
+    const PwmSlot* slotFor(uint8_t pin) const;
+    bool isAttached(uint8_t pin) const;
+
+private:
+    struct Output {
+        uint8_t pin;
+        PwmSlot slot;
+        bool attached;
+        uint32_t rampMs;
+        uint32_t target;     // последняя запрошенная цель
+        uint32_t applied;    // цель, отправленная в железо
+        PwmFade fade;
+        uint32_t fadeStart;
+        bool fading;
+    };
+
+    PwmChannelAllocator allocator;
+    std::vector<Output> outputs;
+    uint8_t outputByPin[OUTPUT_MAX_PINS];
+    uint64_t failedPins = 0;
+    bool fadeInstalled = false;
+
+    Output* find(uint8_t pin);
+    Output* attach(uint8_t pin, const PwmOutputConfig& config, bool& attachedNow);
+    void apply(Output& output, uint32_t now);
+    void writeDuty(const Output& output, uint32_t duty);
+};
+
+#endif
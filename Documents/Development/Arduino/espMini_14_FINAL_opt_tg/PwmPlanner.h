@@ -0,0 +1,162 @@
+#ifndef PWM_PLANNER_H
+#define PWM_PLANNER_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Распределение каналов/таймеров ШИМ и расчёт плавных переходов.
+// Без Arduino и ESP-IDF: проверяется на хосте, работа с железом - в PwmEngine.
+
+#define PWM_MAX_RESOLUTION 14
+#define PWM_DEFAULT_FREQUENCY 1000
+#define PWM_DEFAULT_RESOLUTION 8
+#define PWM_INPUT_RESOLUTION 8      // relay.pwm: 0-255
+#define PWM_MIN_FADE_MS 20          // короче - пишем сразу
+
+#define PWM_MAX_MODES 2
+#define PWM_MAX_TIMERS 4
+#define PWM_CHANNEL_NONE 0xFF
+
+struct PwmHardwareLimits {
+    uint8_t speedModes;
+    uint8_t timersPerMode;
+    uint8_t channelsPerMode;
+    uint32_t sourceClockHz;
+};
+
+struct PwmSlot {
+    uint8_t mode = 0;
+    uint8_t timer = 0;
+    uint8_t channel = PWM_CHANNEL_NONE;
+    uint8_t resolution = 0;
+    uint32_t frequency = 0;
+    bool newTimer = false;  // таймер нужно настроить
+    bool shared = false;    // свободных таймеров нет, взяты частота/разрядность чужого
+
+    bool valid() const { return channel != PWM_CHANNEL_NONE; }
+};
+
+class PwmChannelAllocator {
+public:
+    explicit PwmChannelAllocator(const PwmHardwareLimits& limits) : limits(limits) {
+        if (this->limits.speedModes > PWM_MAX_MODES) this->limits.speedModes = PWM_MAX_MODES;
+        if (this->limits.timersPerMode > PWM_MAX_TIMERS) this->limits.timersPerMode = PWM_MAX_TIMERS;
+        reset();
+    }
+
+    void reset() {
+        memset(timers, 0, sizeof(timers));
+        memset(channelsUsed, 0, sizeof(channelsUsed));
+    }
+
+    // Наибольшая разрядность, при которой freq * 2^res укладывается в тактовую частоту.
+    static uint8_t fitResolution(uint32_t frequency, uint8_t resolution, uint32_t sourceClockHz) {
+        if (resolution < 1) resolution = 1;
+        if (resolution > PWM_MAX_RESOLUTION) resolution = PWM_MAX_RESOLUTION;
+        while (resolution > 1 && (uint64_t)frequency << resolution > sourceClockHz) {
+            resolution--;
+        }
+        return resolution;
+    }
+
+    // Таймер с той же частотой и разрядностью переиспользуется, иначе берётся новый.
+    PwmSlot allocate(uint32_t frequency, uint8_t resolution) {
+        PwmSlot slot;
+        if (frequency == 0) frequency = PWM_DEFAULT_FREQUENCY;
+        resolution = fitResolution(frequency, resolution, limits.sourceClockHz);
+
+        int8_t freeMode = -1, freeTimer = -1;
+        int8_t anyMode = -1;
+
+        for (uint8_t mode = 0; mode < limits.speedModes; mode++) {
+            if (channelsUsed[mode] >= limits.channelsPerMode) continue;
+            if (anyMode < 0) anyMode = mode;
+
+            for (uint8_t timer = 0; timer < limits.timersPerMode; timer++) {
+                TimerState& state = timers[mode][timer];
+                if (state.used && state.frequency == frequency && state.resolution == resolution) {
+                    return take(slot, mode, timer, false, false);
+                }
+                if (!state.used && freeTimer < 0) {
+                    freeMode = mode;
+                    freeTimer = timer;
+                }
+            }
+        }
+
+        if (freeTimer >= 0) {
+            TimerState& state = timers[freeMode][freeTimer];
+            state.used = true;
+            state.frequency = frequency;
+            state.resolution = resolution;
+            return take(slot, freeMode, freeTimer, true, false);
+        }
+
+        // Все таймеры заняты: канал есть, но работать он будет на первом таймере режима
+        if (anyMode >= 0) {
+            return take(slot, anyMode, 0, false, true);
+        }
+        return slot;
+    }
+
+private:
+    struct TimerState {
+        bool used;
+        uint8_t resolution;
+        uint32_t frequency;
+    };
+
+    PwmHardwareLimits limits;
+    TimerState timers[PWM_MAX_MODES][PWM_MAX_TIMERS];
+    uint8_t channelsUsed[PWM_MAX_MODES];
+
+    PwmSlot& take(PwmSlot& slot, uint8_t mode, uint8_t timer, bool newTimer, bool shared) {
+        slot.mode = mode;
+        slot.timer = timer;
+        slot.channel = channelsUsed[mode]++;
+        slot.resolution = timers[mode][timer].resolution;
+        slot.frequency = timers[mode][timer].frequency;
+        slot.newTimer = newTimer;
+        slot.shared = shared;
+        return slot;
+    }
+};
+
+struct PwmFade {
+    uint32_t fromDuty = 0;
+    uint32_t toDuty = 0;
+    uint32_t durationMs = 0;  // 0 - записать сразу
+};
+
+class PwmFadePlanner {
+public:
+    // Перевод заполнения между разрядностями; максимум входа - полное включение (2^bits).
+    static uint32_t scaleDuty(uint32_t value, uint8_t fromBits, uint8_t toBits) {
+        uint32_t fromMax = (1UL << fromBits) - 1;
+        if (value >= fromMax) return 1UL << toBits;
+        return (uint32_t)(((uint64_t)value << toBits) / fromMax);
+    }
+
+    // fullRampMs - время перехода 0 -> 100%; меньшие шаги пропорционально быстрее.
+    static PwmFade plan(uint32_t fromDuty, uint32_t toDuty, uint8_t resolution,
+                        uint32_t fullRampMs, uint32_t minFadeMs = PWM_MIN_FADE_MS) {
+        PwmFade fade;
+        fade.fromDuty = fromDuty;
+        fade.toDuty = toDuty;
+
+        uint32_t delta = fromDuty > toDuty ? fromDuty - toDuty : toDuty - fromDuty;
+        uint32_t duration = (uint32_t)(((uint64_t)delta * fullRampMs) >> resolution);
+        fade.durationMs = duration >= minFadeMs ? duration : 0;
+        return fade;
+    }
+
+    // Заполнение через elapsedMs от начала перехода (для программных переходов).
+    static uint32_t dutyAt(const PwmFade& fade, uint32_t elapsedMs) {
+        if (fade.durationMs == 0 || elapsedMs >= fade.durationMs) return fade.toDuty;
+
+        int64_t delta = (int64_t)fade.toDuty - (int64_t)fade.fromDuty;
+        return (uint32_t)((int64_t)fade.fromDuty + delta * (int64_t)elapsedMs / (int64_t)fade.durationMs);
+    }
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef RUNTIME_PLAN_H
+#define RUNTIME_PLAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Таблицы id -> индекс для реле и сенсоров текущей конфигурации.
+// Строятся один раз при загрузке конфигурации (DeviceManager::buildRuntimePlan),
+// вместе с привязкой сенсоров, действий и выходов к индексам реле.
+// В рабочих циклах поиска по id больше нет.
+
+#define PLAN_MAX_ID 1023
+#define PLAN_NO_INDEX -1
+
+enum PlanIssueType : uint8_t {
+    PLAN_DUPLICATE_RELAY_ID,
+    PLAN_DUPLICATE_SENSOR_ID,
+    PLAN_ID_OUT_OF_RANGE,
+    PLAN_PIN_CONFLICT,
+    PLAN_PIN_NOT_ALLOWED,
+    PLAN_SENSOR_RELAY_MISSING,
+    PLAN_ACTION_SENSOR_MISSING,
+    PLAN_ACTION_RELAY_MISSING,
+    PLAN_OUTPUT_RELAY_MISSING,
+    PLAN_INPUT_UNBOUND,
+    PLAN_SENSOR_EXPRESSION_INVALID,   // refId - позиция ошибки в тексте
+    PLAN_ACTION_EXPRESSION_INVALID
+};
+
+struct PlanIssue {
+    PlanIssueType type;
+    int id;        // id элемента, к которому относится проблема
+    int refId;     // id, на который он ссылается
+    uint8_t pin;
+};
+
+struct RuntimePlan {
+    std::vector<int16_t> relayIndexById;
+    std::vector<int16_t> sensorIndexById;
+
+    // По индексу реле: индекс сенсора на этом входе и можно ли настраивать пин.
+    std::vector<int16_t> inputSensorIndex;
+    std::vector<bool> pinUsable;
+
+    // Зависимости действий: по индексу сенсора / реле-условия - список индексов действий
+    // (CSR: действия сенсора i лежат в sensorActions[sensorActionStart[i] .. sensorActionStart[i+1])).
+    std::vector<uint16_t> sensorActionStart;
+    std::vector<uint16_t> sensorActions;
+
+    // Реле, от состояния которых зависят действия, и последнее увиденное состояние
+    std::vector<int16_t> conditionRelays;
+    std::vector<uint16_t> conditionActionStart;
+    std::vector<uint16_t> conditionActions;
+    std::vector<bool> conditionState;
+
+    // Действия с условием от времени суток: пересчитываются раз в минуту
+    std::vector<uint16_t> timeActions;
+
+    std::vector<PlanIssue> issues;
+
+    void clear() {
+        relayIndexById.clear();
+        sensorIndexById.clear();
+        inputSensorIndex.clear();
+        pinUsable.clear();
+        sensorActionStart.clear();
+        sensorActions.clear();
+        conditionRelays.clear();
+        conditionActionStart.clear();
+        conditionActions.clear();
+        conditionState.clear();
+        timeActions.clear();
+        issues.clear();
+    }
+
+    int16_t relayIndex(int id) const {
+        return (id >= 0 && (size_t)id < relayIndexById.size()) ? relayIndexById[id] : PLAN_NO_INDEX;
+    }
+
+    int16_t sensorIndex(int id) const {
+        return (id >= 0 && (size_t)id < sensorIndexById.size()) ? sensorIndexById[id] : PLAN_NO_INDEX;
+    }
+
+    void addIssue(PlanIssueType type, int id, int refId = -1, uint8_t pin = 0) {
+        issues.push_back({type, id, refId, pin});
+    }
+
+    // Регистрирует id в плотной таблице. false - дубликат или id вне диапазона.
+    bool mapId(std::vector<int16_t>& table, int id, int16_t index, PlanIssueType duplicateType) {
+        if (id < 0 || id > PLAN_MAX_ID) {
+            addIssue(PLAN_ID_OUT_OF_RANGE, id);
+            return false;
+        }
+        if ((size_t)id >= table.size()) {
+            table.resize(id + 1, PLAN_NO_INDEX);
+        }
+        if (table[id] != PLAN_NO_INDEX) {
+            addIssue(duplicateType, id);
+            return false;
+        }
+        table[id] = index;
+        return true;
+    }
+};
+
+#endif
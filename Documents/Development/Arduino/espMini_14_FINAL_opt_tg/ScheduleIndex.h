@@ -0,0 +1,163 @@
+#ifndef SCHEDULE_INDEX_H
+#define SCHEDULE_INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+// Скомпилированное расписание: даты в днях от эпохи, интервалы в секундах суток,
+// дни недели и месяцы битовыми масками. Строится один раз при загрузке конфигурации,
+// в setSchedules строки больше не разбираются.
+
+#define SECONDS_PER_DAY 86400UL
+#define SCHEDULE_NO_START_DAY INT32_MIN
+#define SCHEDULE_NO_END_DAY INT32_MAX
+
+struct ScheduleInterval {
+    uint32_t startSec;
+    uint32_t endSec;
+};
+
+struct CompiledSchedule {
+    int32_t startDay = SCHEDULE_NO_START_DAY;
+    int32_t endDay = SCHEDULE_NO_END_DAY;
+    uint8_t weekMask = 0;     // бит 0 - понедельник
+    uint16_t monthMask = 0;   // бит 0 - январь
+    std::vector<ScheduleInterval> intervals;
+
+    // Момент, до которого состояние сценария гарантированно не меняется.
+    // 0 - требуется пересчёт.
+    time_t nextTransition = 0;
+    time_t evaluatedAt = 0;
+
+    void invalidate() { nextTransition = 0; }
+
+    // Дней от 1970-01-01 для григорианской даты (алгоритм days_from_civil).
+    static int32_t daysFromCivil(int year, unsigned month, unsigned day) {
+        year -= month <= 2;
+        const int era = (year >= 0 ? year : year - 399) / 400;
+        const unsigned yoe = (unsigned)(year - era * 400);
+        const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + (int32_t)doe - 719468;
+    }
+
+    // "YYYY-MM-DD" -> номер дня. false, если строка пустая или некорректная.
+    static bool parseDate(const char* date, int32_t& day) {
+        int y = 0, m = 0, d = 0;
+        if (!date || sscanf(date, "%4d-%2d-%2d", &y, &m, &d) != 3) return false;
+        if (m < 1 || m > 12 || d < 1 || d > 31) return false;
+        day = daysFromCivil(y, m, d);
+        return true;
+    }
+
+    // "HH:MM" или "HH:MM:SS" -> секунды суток.
+    static bool parseTimeOfDay(const char* time, uint32_t& seconds) {
+        int h = 0, m = 0, s = 0;
+        if (!time) return false;
+        int fields = sscanf(time, "%d:%d:%d", &h, &m, &s);
+        if (fields < 2) return false;
+        if (fields == 2) s = 0;
+        if (h < 0 || h > 24 || m < 0 || m > 59 || s < 0 || s > 59) return false;
+        if (h == 24 && (m != 0 || s != 0)) return false;
+        seconds = h * 3600UL + m * 60UL + s;
+        return true;
+    }
+
+    void setDates(const char* startDate, const char* endDate) {
+        if (!parseDate(startDate, startDay)) startDay = SCHEDULE_NO_START_DAY;
+        if (!parseDate(endDate, endDay)) endDay = SCHEDULE_NO_END_DAY;
+    }
+
+    // Некорректные интервалы пропускаются, как и раньше.
+    bool addInterval(const char* startTime, const char* endTime) {
+        ScheduleInterval interval;
+        if (!parseTimeOfDay(startTime, interval.startSec) || !parseTimeOfDay(endTime, interval.endSec)) {
+            return false;
+        }
+        intervals.push_back(interval);
+        return true;
+    }
+
+    // weekday: 0 - понедельник, month: 0 - январь.
+    bool isActiveAt(int32_t day, uint8_t weekday, uint8_t month, uint32_t secOfDay) const {
+        if (day < startDay || day > endDay) return false;
+        if (!(monthMask & (1U << month))) return false;
+        if (!(weekMask & (1U << weekday))) return false;
+
+        for (const auto& interval : intervals) {
+            if (interval.startSec <= interval.endSec) {
+                if (secOfDay >= interval.startSec && secOfDay < interval.endSec) return true;
+            } else {
+                // Интервал через полночь
+                if (secOfDay >= interval.startSec || secOfDay < interval.endSec) return true;
+            }
+        }
+        return false;
+    }
+
+    // Ближайшая граница после secOfDay в пределах суток; смена суток - SECONDS_PER_DAY.
+    uint32_t nextEdge(uint32_t secOfDay) const {
+        uint32_t next = SECONDS_PER_DAY;
+        for (const auto& interval : intervals) {
+            if (interval.startSec > secOfDay && interval.startSec < next) next = interval.startSec;
+            if (interval.endSec > secOfDay && interval.endSec < next) next = interval.endSec;
+        }
+        return next;
+    }
+
+    // Нужно ли пересчитывать состояние в момент now. Часы, переведённые назад, тоже сбрасывают кэш.
+    bool isDue(time_t now) const {
+        return nextTransition == 0 || now >= nextTransition || now < evaluatedAt;
+    }
+
+    // Вычисляет состояние и запоминает момент следующего возможного переключения.
+    bool evaluate(time_t now, const struct tm& local) {
+        int32_t day = daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+        uint8_t weekday = local.tm_wday == 0 ? 6 : local.tm_wday - 1;
+        uint32_t secOfDay = local.tm_hour * 3600UL + local.tm_min * 60UL + local.tm_sec;
+
+        bool active = isActiveAt(day, weekday, local.tm_mon, secOfDay);
+
+        evaluatedAt = now;
+        nextTransition = edgeTime(now, local, nextEdge(secOfDay));
+        return active;
+    }
+
+    // Граница - местное время: через mktime, чтобы сутки перехода на летнее
+    // или зимнее время не сдвигали её на час. Граница в пропущенном часе
+    // нормализуется mktime; если при повторе часа она оказалась не позже now,
+    // отсчитывается по часам, как без перехода.
+    static time_t edgeTime(time_t now, const struct tm& local, uint32_t edgeSec) {
+        // Поля - уже нормализованные: летнее ли время, mktime решает по ним
+        struct tm edge = local;
+        edge.tm_mday += edgeSec / SECONDS_PER_DAY;
+        edge.tm_hour = edgeSec % SECONDS_PER_DAY / 3600;
+        edge.tm_min = edgeSec % 3600 / 60;
+        edge.tm_sec = edgeSec % 60;
+        edge.tm_isdst = -1;
+        time_t at = mktime(&edge);
+        if (at == (time_t)-1 || at <= now) {
+            uint32_t secOfDay = local.tm_hour * 3600UL + local.tm_min * 60UL + local.tm_sec;
+            at = now + (time_t)(edgeSec - secOfDay);
+        }
+        return at;
+    }
+};
+
+// Все сценарии устройства: ближайший nextTransition среди них. Пока он не
+// наступил, setSchedules не перебирает сценарии - тик остаётся одним
+// сравнением при любом их числе. Сбрасывается вместе с любым сценарием.
+struct ScheduleHorizon {
+    time_t nextTransition = 0;
+    time_t evaluatedAt = 0;
+
+    void invalidate() { nextTransition = 0; }
+
+    bool isDue(time_t now) const {
+        return nextTransition == 0 || now >= nextTransition || now < evaluatedAt;
+    }
+};
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <functional>
+#include "StageProfiler.h"
+
+// Кооперативный планировщик периодических задач с дедлайнами.
+// Не зависит от Arduino: время и сон передаются извне, поэтому
+// на хосте его можно гонять на виртуальных часах.
+
+#define SCHEDULER_MAX_TASKS 20
+
+class Scheduler {
+public:
+    typedef uint32_t (*ClockFn)();
+    typedef void (*SleepFn)(uint32_t ms);
+    typedef std::function<void()> TaskFn;
+    typedef std::function<void(const char* name, uint32_t lateMs)> OverrunFn;
+
+    struct Task {
+        const char* name = nullptr;
+        TaskFn fn;
+        uint32_t period = 0;
+        uint32_t nextRun = 0;
+        uint8_t priority = 0;
+        bool enabled = false;
+
+        uint32_t runs = 0;
+        uint32_t overruns = 0;
+        uint32_t maxLateMs = 0;
+#ifdef CONTROL_PROFILER
+        int16_t stage = -1;
+#endif
+    };
+
+    Scheduler(ClockFn clock, SleepFn sleep, uint32_t maxSleepMs = 100)
+        : clock(clock), sleep(sleep), maxSleepMs(maxSleepMs) {}
+
+    // Возвращает id задачи или -1, если таблица заполнена.
+    // phase - смещение первого запуска относительно текущего момента.
+    int addTask(const char* name, uint32_t periodMs, uint32_t phaseMs, uint8_t priority, TaskFn fn) {
+        if (taskCount >= SCHEDULER_MAX_TASKS || periodMs == 0 || !fn) return -1;
+
+        Task& task = tasks[taskCount];
+        task.name = name;
+        task.fn = fn;
+        task.period = periodMs;
+        task.nextRun = clock() + phaseMs;
+        task.priority = priority;
+        task.enabled = true;
+        task.runs = 0;
+        task.overruns = 0;
+        task.maxLateMs = 0;
+#ifdef CONTROL_PROFILER
+        task.stage = profiler ? profiler->addStage(name, periodMs * 1000UL) : -1;
+#endif
+
+        return taskCount++;
+    }
+
+#ifdef CONTROL_PROFILER
+    // Длительность задачи пишется в этап с её именем, бюджет этапа - период задачи
+    void setProfiler(StageProfiler* target) {
+        profiler = target;
+        for (int i = 0; i < taskCount; i++) {
+            tasks[i].stage = profiler ? profiler->addStage(tasks[i].name, tasks[i].period * 1000UL) : -1;
+        }
+    }
+#endif
+
+    void setEnabled(int id, bool enabled) {
+        if (id < 0 || id >= taskCount) return;
+        if (enabled && !tasks[id].enabled) {
+            tasks[id].nextRun = clock();
+        }
+        tasks[id].enabled = enabled;
+    }
+
+    // Запустить задачу при ближайшем проходе; дальше она идёт с периодом от этого момента.
+    void trigger(int id) {
+        if (id < 0 || id >= taskCount) return;
+        tasks[id].nextRun = clock();
+    }
+
+    void setOverrunCallback(OverrunFn callback) { onOverrun = callback; }
+
+    // Выполняет все задачи, у которых наступил дедлайн, в порядке приоритета
+    // (при равном приоритете - раньше тот, чей дедлайн раньше). Каждая задача
+    // выполняется не более одного раза за вызов. Возвращает мс до следующего дедлайна.
+    uint32_t runDue() {
+        uint32_t ranMask = 0;
+
+        while (true) {
+            uint32_t now = clock();
+            int best = -1;
+
+            for (int i = 0; i < taskCount; i++) {
+                const Task& task = tasks[i];
+                if (!task.enabled || (ranMask & (1UL << i))) continue;
+                if ((int32_t)(now - task.nextRun) < 0) continue;
+
+                if (best < 0 ||
+                    task.priority > tasks[best].priority ||
+                    (task.priority == tasks[best].priority && (int32_t)(task.nextRun - tasks[best].nextRun) < 0)) {
+                    best = i;
+                }
+            }
+
+            if (best < 0) break;
+
+            ranMask |= (1UL << best);
+            runTask(tasks[best], now);
+        }
+
+        return timeToNext();
+    }
+
+    // Один проход главного цикла: выполнить должные задачи и спать ровно до следующего дедлайна.
+    void loop() {
+        uint32_t wait = runDue();
+        if (wait > 0) {
+            sleep(wait);
+        }
+    }
+
+    uint32_t timeToNext() const {
+        uint32_t now = clock();
+        uint32_t wait = maxSleepMs;
+
+        for (int i = 0; i < taskCount; i++) {
+            const Task& task = tasks[i];
+            if (!task.enabled) continue;
+
+            int32_t delta = (int32_t)(task.nextRun - now);
+            if (delta <= 0) return 0;
+            if ((uint32_t)delta < wait) wait = delta;
+        }
+        return wait;
+    }
+
+    int getTaskCount() const { return taskCount; }
+    const Task* getTask(int id) const { return (id >= 0 && id < taskCount) ? &tasks[id] : nullptr; }
+
+private:
+    ClockFn clock;
+    SleepFn sleep;
+    uint32_t maxSleepMs;
+    OverrunFn onOverrun = nullptr;
+#ifdef CONTROL_PROFILER
+    StageProfiler* profiler = nullptr;
+#endif
+
+    Task tasks[SCHEDULER_MAX_TASKS];
+    int taskCount = 0;
+
+    void runTask(Task& task, uint32_t startTime) {
+        uint32_t late = startTime - task.nextRun;
+        if (late > task.maxLateMs) task.maxLateMs = late;
+
+#ifdef CONTROL_PROFILER
+        uint32_t startedUs = profiler ? profiler->now() : 0;
+#endif
+        task.fn();
+        task.runs++;
+#ifdef CONTROL_PROFILER
+        if (profiler) profiler->record(task.stage, profiler->now() - startedUs);
+#endif
+
+        // Следующий дедлайн считается от предыдущего, а не от момента запуска,
+        // поэтому фаза не уплывает. Пропущенные периоды не догоняются.
+        uint32_t finished = clock();
+        task.nextRun += task.period;
+
+        if ((int32_t)(finished - task.nextRun) >= 0) {
+            uint32_t behind = finished - task.nextRun;
+            task.nextRun += (behind / task.period + 1) * task.period;
+            task.overruns++;
+#ifdef CONTROL_PROFILER
+            if (profiler) profiler->recordMissed(task.stage);
+#endif
+
+            if (onOverrun) onOverrun(task.name, behind);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "SensorHistory.h"
+#include "DeviceManager.h"
+
+SensorHistory::~SensorHistory() {
+    if (memory) {
+        free(memory);
+        memory = nullptr;
+    }
+}
+
+bool SensorHistory::begin(uint32_t archiveBudgetBytes) {
+    if (memory) return true;
+
+    HistoryLayout layout = { HISTORY_SRAM_SERIES, HISTORY_SRAM_RAW, HISTORY_SRAM_MINUTES, HISTORY_SRAM_HOURS };
+
+#ifdef ESP32
+    if (psramFound()) {
+        HistoryLayout large = { HISTORY_PSRAM_SERIES, HISTORY_PSRAM_RAW, HISTORY_PSRAM_MINUTES, HISTORY_PSRAM_HOURS };
+        memorySize = TimeSeriesStore::bytesFor(large);
+        memory = ps_malloc(memorySize);
+        if (memory) {
+            layout = large;
+            _isPsramUsed = true;
+        }
+    }
+#endif
+
+    if (!memory) {
+        memorySize = TimeSeriesStore::bytesFor(layout);
+        memory = malloc(memorySize);
+        _isPsramUsed = false;
+    }
+
+    if (!memory || !store.begin(layout, memory, memorySize)) {
+        Serial.printf("[History] Не удалось выделить %u байт под историю\n", (unsigned)memorySize);
+        free(memory);
+        memory = nullptr;
+        memorySize = 0;
+        return false;
+    }
+
+    Serial.printf("[History] %u байт в %s: %u рядов, %u/%u/%u точек\n", (unsigned)memorySize,
+                  _isPsramUsed ? "PSRAM" : "SRAM", layout.series,
+                  layout.rawCapacity, layout.minuteCapacity, layout.hourCapacity);
+
+    for (GorillaEncoder& encoder : encoders) encoder.begin(GORILLA_MAX_COLUMNS);
+    archive.begin(archiveBudgetBytes);
+    restore();
+    lastFlush = millis();
+    return true;
+}
+
+// Минутные агрегаты из архива: минутное кольцо и часовой уровень
+void SensorHistory::restore() {
+    uint32_t restored = 0;
+    archive.forEachBlock([this, &restored](const GorillaBlockHeader& header, const uint8_t* payload) {
+        GorillaDecoder decoder(header, payload);
+        uint32_t time;
+        float values[GORILLA_MAX_COLUMNS];
+
+        lock.lock();
+        int16_t series = store.findOrAdd(header.sensorId, header.field);
+        while (series >= 0 && decoder.next(time, values)) {
+            HistoryAggregate minute = { time, values[0], values[1], values[2] };
+            store.restore(series, minute);
+            restored++;
+        }
+        lock.unlock();
+    });
+    Serial.printf("[History] Восстановлено минутных точек: %lu\n", (unsigned long)restored);
+}
+
+uint32_t SensorHistory::timestamp() {
+    time_t now = time(nullptr);
+    if (now >= (time_t)HISTORY_EPOCH_VALID) return (uint32_t)now;
+    return millis() / 1000;
+}
+
+void SensorHistory::record(const Device& device) {
+    if (!store.isReady()) return;
+    uint32_t now = timestamp();
+
+    // Закрытые минуты уходят в архив после снятия блокировки
+    int16_t closed[HISTORY_MAX_SERIES];
+    HistoryAggregate minutes[HISTORY_MAX_SERIES];
+    uint8_t closedCount = 0;
+
+    lock.lock();
+    for (const Sensor& sensor : device.sensors) {
+        if (!sensor.isUseSetting) continue;
+
+        for (uint8_t field = HISTORY_FIELD_VALUE; field <= HISTORY_FIELD_HUMIDITY; field++) {
+            float value = field == HISTORY_FIELD_VALUE ? sensor.currentValue : sensor.humidityValue;
+            if (value == -999.0f) continue;
+
+            int16_t series = store.findOrAdd(sensor.sensorId, field);
+            if (store.insert(series, now, value) && closedCount < HISTORY_MAX_SERIES &&
+                store.latest(series, HISTORY_MINUTE, minutes[closedCount])) {
+                closed[closedCount++] = series;
+            }
+        }
+    }
+    lock.unlock();
+
+    for (uint8_t i = 0; i < closedCount; i++) archiveMinute(closed[i], minutes[i]);
+
+    if (millis() - lastFlush >= HISTORY_FLUSH_MS) flush();
+}
+
+void SensorHistory::archiveMinute(int16_t series, const HistoryAggregate& minute) {
+    if (series < 0 || series >= HISTORY_MAX_SERIES) return;
+
+    float values[GORILLA_MAX_COLUMNS] = { minute.min, minute.avg, minute.max };
+    if (!encoders[series].append(minute.time, values)) {
+        writeBlock(series);
+        encoders[series].append(minute.time, values);
+    }
+}
+
+void SensorHistory::writeBlock(int16_t series) {
+    GorillaEncoder& encoder = encoders[series];
+    if (encoder.size() == 0) return;
+
+    int32_t sensorId;
+    uint8_t field;
+    lock.lock();
+    bool known = store.key(series, sensorId, field);
+    lock.unlock();
+
+    if (known && !archive.append(encoder.header(sensorId, field), encoder.data())) {
+        Serial.println("[History] Ошибка записи блока в архив");
+    }
+    encoder.begin(GORILLA_MAX_COLUMNS);
+}
+
+void SensorHistory::flush() {
+    if (!store.isReady()) return;
+    for (int16_t series = 0; series < HISTORY_MAX_SERIES; series++) writeBlock(series);
+    lastFlush = millis();
+}
+
+size_t SensorHistory::readArchive(ArchiveCursor& cursor, int32_t sensorId, uint8_t field, uint32_t from, uint32_t to,
+                                  HistoryAggregate* out, size_t maxCount) {
+    return archive.read(cursor, sensorId, field, from, to, out, maxCount);
+}
+
+int16_t SensorHistory::find(int32_t sensorId, uint8_t field) {
+    lock.lock();
+    int16_t series = store.find(sensorId, field);
+    lock.unlock();
+    return series;
+}
+
+size_t SensorHistory::readRaw(int16_t series, uint32_t& cursor, uint32_t from, uint32_t to,
+                              HistoryPoint* out, size_t maxCount) {
+    lock.lock();
+    size_t count = store.readRaw(series, cursor, from, to, out, maxCount);
+    lock.unlock();
+    return count;
+}
+
+size_t SensorHistory::readAggregate(int16_t series, HistoryTier tier, uint32_t& cursor, uint32_t from, uint32_t to,
+                                    HistoryAggregate* out, size_t maxCount) {
+    lock.lock();
+    size_t count = store.readAggregate(series, tier, cursor, from, to, out, maxCount);
+    lock.unlock();
+    return count;
+}
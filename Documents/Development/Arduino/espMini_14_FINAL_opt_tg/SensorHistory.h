@@ -0,0 +1,95 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <Arduino.h>
+#include "TimeSeriesStore.h"
+#include "SpinLock.h"
+#include "HistoryArchive.h"
+
+// История показаний сенсоров текущего устройства. Размеры колец заданы при
+// компиляции; с PSRAM используется большой профиль, без неё - малый в SRAM.
+// Пишет задача управления, читают обработчики веб-сервера: доступ к кольцам
+// под спин-блокировкой, копиями по несколько точек.
+// Законченные минутные агрегаты сжимаются и дописываются в архив на флеше,
+// после перезагрузки минутный и часовой уровни восстанавливаются из него.
+
+struct Device;
+
+#if defined(ESP8266)
+#define HISTORY_SRAM_SERIES 4
+#define HISTORY_SRAM_RAW 30
+#define HISTORY_SRAM_MINUTES 30
+#define HISTORY_SRAM_HOURS 24
+#else
+#define HISTORY_SRAM_SERIES 8
+#define HISTORY_SRAM_RAW 60        // 5 минут
+#define HISTORY_SRAM_MINUTES 120   // 2 часа
+#define HISTORY_SRAM_HOURS 96      // 4 суток
+#endif
+
+#define HISTORY_PSRAM_SERIES 16
+
+#if defined(ESP8266)
+#define HISTORY_MAX_SERIES HISTORY_SRAM_SERIES
+#else
+#define HISTORY_MAX_SERIES HISTORY_PSRAM_SERIES
+#endif
+#define HISTORY_PSRAM_RAW 720      // 1 час
+#define HISTORY_PSRAM_MINUTES 1440 // сутки
+#define HISTORY_PSRAM_HOURS 720    // 30 суток
+
+#define HISTORY_SAMPLE_MS 5000
+#define HISTORY_FIELD_VALUE 0
+#define HISTORY_FIELD_HUMIDITY 1
+#define HISTORY_FLUSH_MS (15UL * 60 * 1000)   // неполные блоки на флеш не реже
+#define HISTORY_EPOCH_VALID 1700000000UL   // раньше - часы не синхронизированы, пишется аптайм
+
+class SensorHistory {
+public:
+    SensorHistory() = default;
+    ~SensorHistory();
+
+    SensorHistory(const SensorHistory&) = delete;
+    SensorHistory& operator=(const SensorHistory&) = delete;
+
+    bool begin(uint32_t archiveBudgetBytes);
+
+    // Задача управления: по отсчёту на каждое значение включённых сенсоров.
+    void record(const Device& device);
+
+    // Задача управления: дописывает неполные блоки в архив. Перед перезагрузкой.
+    void flush();
+
+    int16_t find(int32_t sensorId, uint8_t field);
+    size_t readRaw(int16_t series, uint32_t& cursor, uint32_t from, uint32_t to,
+                   HistoryPoint* out, size_t maxCount);
+    size_t readAggregate(int16_t series, HistoryTier tier, uint32_t& cursor, uint32_t from, uint32_t to,
+                         HistoryAggregate* out, size_t maxCount);
+    size_t readArchive(ArchiveCursor& cursor, int32_t sensorId, uint8_t field, uint32_t from, uint32_t to,
+                       HistoryAggregate* out, size_t maxCount);
+
+    bool isReady() const { return store.isReady(); }
+    bool isPsramUsed() const { return _isPsramUsed; }
+    size_t bytes() const { return memorySize; }
+
+private:
+    TimeSeriesStore store;
+    void* memory = nullptr;
+    size_t memorySize = 0;
+    bool _isPsramUsed = false;
+
+    SpinLock lock;
+
+    // Открытые блоки архива по рядам хранилища
+    HistoryArchive archive;
+    GorillaEncoder encoders[HISTORY_MAX_SERIES];
+    uint32_t lastFlush = 0;
+
+    void archiveMinute(int16_t series, const HistoryAggregate& minute);
+    void writeBlock(int16_t series);
+    void restore();
+
+    static uint32_t timestamp();
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SPIN_LOCK_H
+#define SPIN_LOCK_H
+
+#include <Arduino.h>
+
+// Короткая блокировка между задачами на разных ядрах ESP32 (portMUX).
+// Внутри - только копирование в памяти, без ввода-вывода и ожиданий.
+// На ESP8266 всё выполняется в одном потоке, блокировка пустая.
+class SpinLock {
+public:
+#if defined(ESP32)
+    void lock() { portENTER_CRITICAL(&mux); }
+    void unlock() { portEXIT_CRITICAL(&mux); }
+
+private:
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#else
+    void lock() {}
+    void unlock() {}
+#endif
+};
+
+#endif
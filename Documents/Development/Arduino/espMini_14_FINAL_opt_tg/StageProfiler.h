@@ -0,0 +1,164 @@
+#ifndef STAGE_PROFILER_H
+#define STAGE_PROFILER_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Длительности этапов цикла управления: гистограмма с корзинами по
+// полуоктавам (1, 2, 3, 4, 6, 8, 12... мкс), точные min/max и счётчики
+// превышений. Каждый этап пишет одна задача, читать можно из другой:
+// отдельные поля согласованы между собой не строго, для статистики этого
+// достаточно. Сброс выполняет сам писатель при следующем замере.
+// Без Arduino: проверяется на хосте.
+
+// Без этого определения замеры не компилируются вовсе: ни в планировщике,
+// ни в проходе управления, ни в ответах веб-сервера и бота
+#define CONTROL_PROFILER
+
+#define PROFILER_MAX_STAGES 24
+#define PROFILER_SUB_BITS 1
+#define PROFILER_SUB_BUCKETS (1 << PROFILER_SUB_BITS)
+#define PROFILER_BUCKETS 42     // до ~2 с, длиннее - в последнюю корзину
+
+struct ProfileStage {
+    const char* name = nullptr;
+    uint32_t budgetUs = 0;      // 0 - без бюджета
+    uint32_t count = 0;
+    uint32_t overruns = 0;      // дольше бюджета
+    uint32_t missed = 0;        // планировщик не успел к следующему дедлайну
+    uint32_t minUs = 0;
+    uint32_t maxUs = 0;
+    uint64_t totalUs = 0;
+    uint32_t buckets[PROFILER_BUCKETS] = {};
+    volatile bool resetPending = false;
+
+    uint32_t averageUs() const { return count ? (uint32_t)(totalUs / count) : 0; }
+};
+
+class StageProfiler {
+public:
+    typedef uint32_t (*ClockFn)();   // микросекунды
+
+    explicit StageProfiler(ClockFn clock) : clock(clock) {}
+
+    // Повторная регистрация с тем же именем возвращает тот же этап.
+    // -1 - таблица заполнена. Регистрировать до запуска задач.
+    int addStage(const char* name, uint32_t budgetUs) {
+        for (int i = 0; i < stageCount; i++) {
+            if (strcmp(stages[i].name, name) == 0) return i;
+        }
+        if (stageCount >= PROFILER_MAX_STAGES) return -1;
+
+        stages[stageCount].name = name;
+        stages[stageCount].budgetUs = budgetUs;
+        return stageCount++;
+    }
+
+    uint32_t now() const { return clock(); }
+
+    void record(int id, uint32_t us) {
+        if (id < 0 || id >= stageCount) return;
+        ProfileStage& stage = stages[id];
+        if (stage.resetPending) clearStage(stage);
+
+        if (stage.count == 0 || us < stage.minUs) stage.minUs = us;
+        if (us > stage.maxUs) stage.maxUs = us;
+        stage.totalUs += us;
+        stage.buckets[bucketOf(us)]++;
+        if (stage.budgetUs && us > stage.budgetUs) stage.overruns++;
+        stage.count++;
+    }
+
+    void recordMissed(int id) {
+        if (id < 0 || id >= stageCount) return;
+        if (stages[id].resetPending) clearStage(stages[id]);
+        stages[id].missed++;
+    }
+
+    void reset() {
+        for (int i = 0; i < stageCount; i++) stages[i].resetPending = true;
+    }
+
+    int getStageCount() const { return stageCount; }
+    const ProfileStage* getStage(int id) const { return (id >= 0 && id < stageCount) ? &stages[id] : nullptr; }
+
+    // Верхняя граница корзины, в которую попал permille-й замер, не больше max
+    static uint32_t percentile(const ProfileStage& stage, uint16_t permille) {
+        if (stage.count == 0) return 0;
+        uint64_t target = ((uint64_t)stage.count * permille + 999) / 1000;
+        if (target == 0) target = 1;
+
+        uint64_t seen = 0;
+        for (uint8_t i = 0; i < PROFILER_BUCKETS; i++) {
+            seen += stage.buckets[i];
+            if (seen >= target) {
+                uint32_t upper = bucketUpper(i);
+                if (upper > stage.maxUs) upper = stage.maxUs;
+                if (upper < stage.minUs) upper = stage.minUs;
+                return upper;
+            }
+        }
+        return stage.maxUs;
+    }
+
+    static uint8_t bucketOf(uint32_t us) {
+        if (us < PROFILER_SUB_BUCKETS) return us;
+        uint8_t msb = 31 - __builtin_clz(us);
+        uint8_t group = msb - PROFILER_SUB_BITS + 1;
+        uint32_t index = group * PROFILER_SUB_BUCKETS + ((us >> (group - 1)) - PROFILER_SUB_BUCKETS);
+        return index < PROFILER_BUCKETS ? index : PROFILER_BUCKETS - 1;
+    }
+
+    static uint32_t bucketLower(uint8_t index) {
+        if (index < PROFILER_SUB_BUCKETS) return index;
+        uint8_t group = index / PROFILER_SUB_BUCKETS;
+        return (uint32_t)(PROFILER_SUB_BUCKETS + index % PROFILER_SUB_BUCKETS) << (group - 1);
+    }
+
+    // Включительно; у последней корзины границы нет
+    static uint32_t bucketUpper(uint8_t index) {
+        if (index + 1 >= PROFILER_BUCKETS) return UINT32_MAX;
+        return bucketLower(index + 1) - 1;
+    }
+
+private:
+    ClockFn clock;
+    ProfileStage stages[PROFILER_MAX_STAGES];
+    int stageCount = 0;
+
+    static void clearStage(ProfileStage& stage) {
+        stage.count = 0;
+        stage.overruns = 0;
+        stage.missed = 0;
+        stage.minUs = 0;
+        stage.maxUs = 0;
+        stage.totalUs = 0;
+        memset(stage.buckets, 0, sizeof(stage.buckets));
+        stage.resetPending = false;
+    }
+};
+
+// Замер до конца области видимости
+class ProfileScope {
+public:
+    ProfileScope(StageProfiler& profiler, int id) : profiler(profiler), id(id), started(profiler.now()) {}
+    ~ProfileScope() { profiler.record(id, profiler.now() - started); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    StageProfiler& profiler;
+    int id;
+    uint32_t started;
+};
+
+#ifdef CONTROL_PROFILER
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#define PROFILE_STAGE(profiler, id) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(profiler, id)
+#else
+#define PROFILE_STAGE(profiler, id)
+#endif
+
+#endif
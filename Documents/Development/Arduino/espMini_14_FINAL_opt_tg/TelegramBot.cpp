@@ -75,7 +75,9 @@ void TelegramBot::begin() {
 }
 
 void TelegramBot::sendSimpleStatus(int64_t chatId) {
-  if (deviceManager.myDevices.empty()) {
+  // Имена и описания - из снимка конфигурации, задача управления его не трогает
+  std::shared_ptr<const DeviceConfigSnapshot> config = deviceManager.configSnapshot();
+  if (!config) {
     TBMessage msg;
     msg.chatId = chatId;
     myBot.sendMessage(msg, "❌ Устройства не настроены.");
@@ -86,7 +88,11 @@ void TelegramBot::sendSimpleStatus(int64_t chatId) {
   char messageBuffer[STATUS_BUFFER_SIZE];
   int offset = 0;
 
-  const Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
+  const Device& currentDevice = config->device;
+
+  // Состояние реле, сенсоров и флагов - из снимка задачи управления
+  deviceManager.bridge.botSnapshot.update();
+  const ControlSnapshot& snapshot = deviceManager.bridge.botSnapshot.read();
 
   offset += snprintf(messageBuffer + offset, STATUS_BUFFER_SIZE - offset,
                      "📊 Текущий статус системы\n\n"
@@ -109,13 +115,13 @@ void TelegramBot::sendSimpleStatus(int64_t chatId) {
                      urlBuffer);
 
   int outputRelayCount = 0;
-  for (size_t i = 0; i < currentDevice.relays.size(); ++i) {
-    const auto& relay = currentDevice.relays[i];
+  for (uint8_t i = 0; i < snapshot.relayCount; ++i) {
+    const RelaySnapshot& relay = snapshot.relays[i];
     if (relay.isOutput) {
       outputRelayCount++;
       offset += snprintf(messageBuffer + offset, STATUS_BUFFER_SIZE - offset,
                          "%s | /on%d /off%d | %s | %s\n\n",
-                         relay.description,
+                         DeviceManager::relayDescription(currentDevice, relay),
                          outputRelayCount,
                          outputRelayCount,
                          relay.statePin ? "✅ ВКЛ" : "❌ ВЫКЛ",
@@ -125,6 +131,28 @@ void TelegramBot::sendSimpleStatus(int64_t chatId) {
 
   offset += deviceManager.currentStateSensors(messageBuffer + offset, STATUS_BUFFER_SIZE - offset, false);
 
+  // Остальные устройства, работающие одновременно с текущим
+  if (snapshot.deviceCount > 1) {
+    offset += snprintf(messageBuffer + offset, STATUS_BUFFER_SIZE - offset, "\n🔀 Также работают:\n");
+    for (uint8_t i = 1; i < snapshot.deviceCount; i++) {
+      const DeviceSnapshot& device = snapshot.devices[i];
+      if (device.index >= config->deviceNames.size()) continue;
+      offset += snprintf(messageBuffer + offset, STATUS_BUFFER_SIZE - offset,
+                         "📟 %s | выходы %d/%d",
+                         config->deviceNames[device.index].c_str(),
+                         device.outputsOn, device.outputCount);
+      if (device.isTemperatureUseSetting) {
+        offset += snprintf(messageBuffer + offset, STATUS_BUFFER_SIZE - offset,
+                           " | 🌡 %.1f → %.1f°C", device.currentTemp, device.setTemperature);
+      }
+      offset += snprintf(messageBuffer + offset, STATUS_BUFFER_SIZE - offset,
+                         "%s%s%s\n",
+                         device.isTimersEnabled ? " | ⏱ таймеры" : "",
+                         device.isScheduleEnabled ? " | 📅 расписания" : "",
+                         device.isActionEnabled ? " | ⚡ действия" : "");
+    }
+  }
+
   offset += snprintf(messageBuffer + offset, STATUS_BUFFER_SIZE - offset,
                      "\nСброс реле /resetmanual \n\n"
                      "⚙️ Настройки системы:\n"
@@ -132,10 +160,10 @@ void TelegramBot::sendSimpleStatus(int64_t chatId) {
                      "• /schedule_on /schedule_off — Расписания [%s]\n"
                      "• /temp_on /temp_off — Температурный контроль [%s]\n"
                      "• /sensors_on /sensors_off — Действия на сенсоры [%s]\n\n",
-                     currentDevice.isTimersEnabled ? "✅ ВКЛ" : "❌ ВЫКЛ",
-                     currentDevice.isScheduleEnabled ? "✅ ВКЛ" : "❌ ВЫКЛ",
-                     currentDevice.temperature.isUseSetting ? "✅ ВКЛ" : "❌ ВЫКЛ",
-                     currentDevice.isActionEnabled ? "✅ ВКЛ" : "❌ ВЫКЛ");
+                     snapshot.isTimersEnabled ? "✅ ВКЛ" : "❌ ВЫКЛ",
+                     snapshot.isScheduleEnabled ? "✅ ВКЛ" : "❌ ВЫКЛ",
+                     snapshot.isTemperatureUseSetting ? "✅ ВКЛ" : "❌ ВЫКЛ",
+                     snapshot.isActionEnabled ? "✅ ВКЛ" : "❌ ВЫКЛ");
 
   offset += snprintf(messageBuffer + offset, STATUS_BUFFER_SIZE - offset,
                      "🔔 Уведомления в Telegram:\n"
@@ -179,6 +207,10 @@ void TelegramBot::sendHelpMessage(int64_t chatId) {
                          "• /reset — Перезагрузить устройство\n"
                          "• /update — Обновить файл или прошивку\n"
                          "• /get — Получить файл с устройства (/get log.txt)\n"
+#ifdef CONTROL_PROFILER
+                         "• /profile — Длительности этапов цикла управления\n"
+                         "• /profile_reset — Сбросить их статистику\n"
+#endif
                          "• /newtoken &lt;token&gt; — Установить новый токен\n\n"
                          "📌 <i>Некоторые команды требуют прав доступа.</i>";
 
@@ -202,6 +234,22 @@ void TelegramBot::sendInfoMessage(int64_t chatId) {
   myBot.setFormattingStyle(AsyncTelegram2::FormatStyle::MARKDOWN);
 }
 
+#ifdef CONTROL_PROFILER
+void TelegramBot::sendProfileMessage(int64_t chatId) {
+  constexpr size_t PROFILE_BUFFER_SIZE = 2048;
+  char* profileBuffer = new char[PROFILE_BUFFER_SIZE];
+
+  sysInfo.getProfileReport(profileBuffer, PROFILE_BUFFER_SIZE);
+
+  TBMessage msg;
+  msg.chatId = chatId;
+  myBot.setFormattingStyle(AsyncTelegram2::FormatStyle::HTML);
+  myBot.sendMessage(msg, profileBuffer);
+  myBot.setFormattingStyle(AsyncTelegram2::FormatStyle::MARKDOWN);
+  delete[] profileBuffer;
+}
+#endif
+
 bool TelegramBot::hasPermission(const String& userId, const String& permission) {
   for (const auto& user : settings.ws.telegramSettings.telegramUsers) {
     if (user.id == userId) {
@@ -213,7 +261,9 @@ bool TelegramBot::hasPermission(const String& userId, const String& permission)
 }
 
 int TelegramBot::getOutputRelayNumber(size_t relayIndex) {
-  const Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
+  std::shared_ptr<const DeviceConfigSnapshot> config = deviceManager.configSnapshot();
+  if (!config) return 0;
+  const Device& currentDevice = config->device;
   int outputNumber = 0;
   for (size_t i = 0; i <= relayIndex; i++) {
     if (i < currentDevice.relays.size() && currentDevice.relays[i].isOutput) {
@@ -235,6 +285,14 @@ void TelegramBot::handleRelayCommand(int64_t chatId, const String& command) {
   int relayIndex = -1;
   int relayNumber = -1;
 
+  // Номер реле и его id - по одной версии конфигурации
+  std::shared_ptr<const DeviceConfigSnapshot> config = deviceManager.configSnapshot();
+  if (!config) {
+    myBot.sendMessage(msg, "❌ Устройства не настроены.");
+    return;
+  }
+  const Device& currentDevice = config->device;
+
   if (command.startsWith("/on") || command.equalsIgnoreCase("on")) {
     action = "on";
     String numStr = command.startsWith("/on") ? command.substring(3) : command.substring(2);
@@ -252,7 +310,6 @@ void TelegramBot::handleRelayCommand(int64_t chatId, const String& command) {
       myBot.sendMessage(msg, "❌ Неверный формат команды. Используйте /on1, /off2 и т.д.");
       return;
     }
-    const Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
     int currentOutputNumber = 0;
     bool relayFound = false;
     for (size_t i = 0; i < currentDevice.relays.size(); ++i) {
@@ -275,7 +332,6 @@ void TelegramBot::handleRelayCommand(int64_t chatId, const String& command) {
   if (action == "reset_all") {
     doc["action"] = "reset_all";
   } else {
-    const Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
     doc["relay"] = currentDevice.relays[relayIndex].id;
     doc["action"] = action;
   }
@@ -285,7 +341,6 @@ void TelegramBot::handleRelayCommand(int64_t chatId, const String& command) {
     if (action == "reset_all") {
       successMsg += "Все реле сброшены в автоматический режим";
     } else {
-      const Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
       String relayName = currentDevice.relays[relayIndex].description;
       successMsg += String(action == "on" ? "Включено" : "Выключено") + " реле " + String(relayNumber) + " (" + relayName + ")";
     }
@@ -303,59 +358,52 @@ void TelegramBot::handleSystemToggleCommand(int64_t chatId, const String& comman
     myBot.sendMessage(msg, "❌ У вас нет прав для выполнения этой команды.");
     return;
   }
-  if (deviceManager.myDevices.empty() || deviceManager.currentDeviceIndex >= deviceManager.myDevices.size()) {
+  if (!deviceManager.configSnapshot()) {
     return;
   }
 
-  Device& device = deviceManager.myDevices[deviceManager.currentDeviceIndex];
+  deviceManager.bridge.botSnapshot.update();
+  const ControlSnapshot& snapshot = deviceManager.bridge.botSnapshot.read();
   bool stateChanged = false;
 
   if (command == "/timers_on") {
-    if (!device.isTimersEnabled) {
-      device.isTimersEnabled = true;
-      stateChanged = true;
+    if (!snapshot.isTimersEnabled) {
+      stateChanged = postFlag(FLAG_TIMERS, true);
     }
   }
   else if (command == "/timers_off") {
-    if (device.isTimersEnabled) {
-      device.isTimersEnabled = false;
-      stateChanged = true;
+    if (snapshot.isTimersEnabled) {
+      stateChanged = postFlag(FLAG_TIMERS, false);
     }
   }
   else if (command == "/schedule_on") {
-    if (!device.isScheduleEnabled) {
-      device.isScheduleEnabled = true;
-      stateChanged = true;
+    if (!snapshot.isScheduleEnabled) {
+      stateChanged = postFlag(FLAG_SCHEDULE, true);
     }
   }
   else if (command == "/schedule_off") {
-    if (device.isScheduleEnabled) {
-      device.isScheduleEnabled = false;
-      stateChanged = true;
+    if (snapshot.isScheduleEnabled) {
+      stateChanged = postFlag(FLAG_SCHEDULE, false);
     }
   }
   else if (command == "/temp_on") {
-    if (!device.temperature.isUseSetting) {
-      device.temperature.isUseSetting = true;
-      stateChanged = true;
+    if (!snapshot.isTemperatureUseSetting) {
+      stateChanged = postFlag(FLAG_TEMPERATURE, true);
     }
   }
   else if (command == "/temp_off") {
-    if (device.temperature.isUseSetting) {
-      device.temperature.isUseSetting = false;
-      stateChanged = true;
+    if (snapshot.isTemperatureUseSetting) {
+      stateChanged = postFlag(FLAG_TEMPERATURE, false);
     }
   }
   else if (command == "/sensors_on") {
-    if (!device.isActionEnabled) {
-      device.isActionEnabled = true;
-      stateChanged = true;
+    if (!snapshot.isActionEnabled) {
+      stateChanged = postFlag(FLAG_ACTIONS, true);
     }
   }
   else if (command == "/sensors_off") {
-    if (device.isActionEnabled) {
-      device.isActionEnabled = false;
-      stateChanged = true;
+    if (snapshot.isActionEnabled) {
+      stateChanged = postFlag(FLAG_ACTIONS, false);
     }
   }
   else if (command == "/push_error_on") {
@@ -401,6 +449,14 @@ void TelegramBot::handleSystemToggleCommand(int64_t chatId, const String& comman
   sendSimpleStatus(chatId);
 }
 
+bool TelegramBot::postFlag(ControlFlag flag, bool value) {
+  ControlCommand command;
+  command.type = CMD_SET_FLAG;
+  command.field = flag;
+  command.value = value;
+  return deviceManager.bridge.post(command);
+}
+
 void TelegramBot::loop() {
   yield();
   if (!settings.ws.telegramSettings.isTelegramOn) {
@@ -454,6 +510,19 @@ void TelegramBot::loop() {
           Serial.println("Sending info...");
           sendInfoMessage(msg.sender.id);
         }
+#ifdef CONTROL_PROFILER
+        else if (text == "/profile" || text == "profile") {
+          sendProfileMessage(msg.sender.id);
+        }
+        else if (text == "/profile_reset") {
+          if (hasPermission(userId, "writing")) {
+            sysInfo.profiler.reset();
+            myBot.sendMessage(msg, "✅ Статистика этапов сброшена.");
+          } else {
+            myBot.sendMessage(msg, "❌ Нет прав на сброс статистики.");
+          }
+        }
+#endif
         else if (text == "/reset" || text == "reset") {
           if (hasPermission(userId, "writing")) {
             myBot.sendMessage(msg, "🔄 Перезагрузка устройства...");
@@ -664,10 +733,8 @@ void TelegramBot::doRestartProcedure() {
     return;
   }
 
-  Serial.println("✅ Перезагрузка разрешена. Перезагружаем через 1 секунду...");
-  delay(1000);
-  Serial.println("🚀 Restarting ESP...");
-  ESP.restart();
+  Serial.println("✅ Перезагрузка разрешена. Перезагрузка после сохранения истории...");
+  appState.isReboot = true;
 }
 
 void TelegramBot::checkAndSendLogs() {
@@ -700,7 +767,7 @@ void TelegramBot::checkAndSendLogs() {
       break;
     }
 
-    LogEntry* logEntry = log_pair.first;
+    const LogEntry* logEntry = &log_pair.first;
     uint8_t logIndex = log_pair.second;
 
     bool logWasSent = false;
@@ -719,7 +786,7 @@ void TelegramBot::checkAndSendLogs() {
     }
 
     if (logWasSent || !shouldSendLog(*logEntry)) {
-      logger.markAsSent(logIndex);
+      logger.markAsSent(logIndex, logEntry->sequence);
       if (logWasSent) {
         sentThisCycle++;
       }
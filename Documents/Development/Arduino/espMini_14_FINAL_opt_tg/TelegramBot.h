@@ -51,14 +51,18 @@ private:
     void sendSimpleStatus(int64_t chatId);
     void sendHelpMessage(int64_t chatId);
     void sendInfoMessage(int64_t chatId);
+#ifdef CONTROL_PROFILER
+    void sendProfileMessage(int64_t chatId);
+#endif
     void handleRelayCommand(int64_t chatId, const String& command);
     void handleSystemToggleCommand(int64_t chatId, const String& command);
+    bool postFlag(ControlFlag flag, bool value);
     bool hasPermission(const String& userId, const String& permission);
     void sendDocument(TBMessage &msg, AsyncTelegram2::DocumentType fileType, const char* filename, const char* caption = nullptr);
     int getOutputRelayNumber(size_t relayIndex);
     void doRestartProcedure();
 
-    std::vector<std::pair<LogEntry*, uint8_t>> _unsentLogsBuffer;
+    std::vector<std::pair<LogEntry, uint8_t>> _unsentLogsBuffer;   // копии записей и их ячейки
 
 #ifdef ESP32
     static constexpr uint32_t MIN_FREE_MEMORY = 8 * 1024;
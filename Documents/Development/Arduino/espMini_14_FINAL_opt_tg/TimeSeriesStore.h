@@ -0,0 +1,259 @@
+#ifndef TIME_SERIES_STORE_H
+#define TIME_SERIES_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// История значений сенсоров: сырые отсчёты и агрегаты min/avg/max за минуту
+// и за час, по кольцевому буферу на каждый уровень. Вся память - один блок
+// фиксированного размера (HistoryLayout), выделяет его владелец.
+// Без Arduino: проверяется на хосте.
+
+#define HISTORY_MINUTE_S 60
+#define HISTORY_HOUR_S 3600
+
+enum HistoryTier : uint8_t {
+    HISTORY_RAW,
+    HISTORY_MINUTE,
+    HISTORY_HOUR
+};
+
+struct HistoryPoint {
+    uint32_t time;
+    float value;
+};
+
+// time - начало интервала
+struct HistoryAggregate {
+    uint32_t time;
+    float min;
+    float avg;
+    float max;
+};
+
+struct HistoryLayout {
+    uint8_t series;
+    uint16_t rawCapacity;
+    uint16_t minuteCapacity;
+    uint16_t hourCapacity;
+};
+
+// Кольцо с абсолютными номерами записей: читатель держит номер, а не позицию,
+// и замечает, что его записи уже перезаписаны.
+template<typename T>
+struct HistoryRing {
+    T* items;
+    uint16_t capacity;
+    uint32_t total;
+
+    void push(const T& item) {
+        items[total % capacity] = item;
+        total++;
+    }
+
+    uint32_t first() const { return total > capacity ? total - capacity : 0; }
+    const T& at(uint32_t seq) const { return items[seq % capacity]; }
+};
+
+struct HistoryAccumulator {
+    uint32_t bucket;
+    uint32_t count;
+    float min;
+    float max;
+    double sum;
+
+    void add(float value) {
+        if (count == 0 || value < min) min = value;
+        if (count == 0 || value > max) max = value;
+        sum += value;
+        count++;
+    }
+
+    // Готовый агрегат (восстановление с флеша): вес как у одного отсчёта
+    void merge(const HistoryAggregate& aggregate) {
+        if (count == 0 || aggregate.min < min) min = aggregate.min;
+        if (count == 0 || aggregate.max > max) max = aggregate.max;
+        sum += aggregate.avg;
+        count++;
+    }
+
+    HistoryAggregate result(uint32_t bucketSeconds) const {
+        HistoryAggregate aggregate;
+        aggregate.time = bucket * bucketSeconds;
+        aggregate.min = min;
+        aggregate.avg = (float)(sum / count);
+        aggregate.max = max;
+        return aggregate;
+    }
+
+    void reset(uint32_t newBucket) {
+        bucket = newBucket;
+        count = 0;
+        sum = 0;
+    }
+};
+
+struct HistorySeries {
+    bool used;
+    uint8_t field;
+    int32_t sensorId;
+
+    HistoryRing<HistoryPoint> raw;
+    HistoryRing<HistoryAggregate> minute;
+    HistoryRing<HistoryAggregate> hour;
+
+    HistoryAccumulator minuteAcc;
+    HistoryAccumulator hourAcc;
+};
+
+class TimeSeriesStore {
+public:
+    static size_t bytesFor(const HistoryLayout& layout) {
+        return layout.series * (sizeof(HistorySeries) +
+                                layout.rawCapacity * sizeof(HistoryPoint) +
+                                (layout.minuteCapacity + layout.hourCapacity) * sizeof(HistoryAggregate));
+    }
+
+    // Размечает переданный блок памяти (bytesFor(layout) байт).
+    bool begin(const HistoryLayout& newLayout, void* memory, size_t size) {
+        if (!memory || size < bytesFor(newLayout) || newLayout.series == 0 ||
+            !newLayout.rawCapacity || !newLayout.minuteCapacity || !newLayout.hourCapacity) {
+            return false;
+        }
+
+        layout = newLayout;
+        memset(memory, 0, size);
+
+        uint8_t* cursor = static_cast<uint8_t*>(memory);
+        seriesList = reinterpret_cast<HistorySeries*>(cursor);
+        cursor += layout.series * sizeof(HistorySeries);
+
+        for (uint8_t i = 0; i < layout.series; i++) {
+            HistorySeries& series = seriesList[i];
+            series.raw.items = reinterpret_cast<HistoryPoint*>(cursor);
+            series.raw.capacity = layout.rawCapacity;
+            cursor += layout.rawCapacity * sizeof(HistoryPoint);
+
+            series.minute.items = reinterpret_cast<HistoryAggregate*>(cursor);
+            series.minute.capacity = layout.minuteCapacity;
+            cursor += layout.minuteCapacity * sizeof(HistoryAggregate);
+
+            series.hour.items = reinterpret_cast<HistoryAggregate*>(cursor);
+            series.hour.capacity = layout.hourCapacity;
+            cursor += layout.hourCapacity * sizeof(HistoryAggregate);
+        }
+        return true;
+    }
+
+    bool isReady() const { return seriesList != nullptr; }
+    const HistoryLayout& getLayout() const { return layout; }
+
+    int16_t find(int32_t sensorId, uint8_t field) const {
+        if (!seriesList) return -1;
+        for (uint8_t i = 0; i < layout.series; i++) {
+            if (seriesList[i].used && seriesList[i].sensorId == sensorId && seriesList[i].field == field) return i;
+        }
+        return -1;
+    }
+
+    // -1 - все ряды заняты.
+    int16_t findOrAdd(int32_t sensorId, uint8_t field) {
+        int16_t index = find(sensorId, field);
+        if (index >= 0 || !seriesList) return index;
+
+        for (uint8_t i = 0; i < layout.series; i++) {
+            if (!seriesList[i].used) {
+                seriesList[i].used = true;
+                seriesList[i].sensorId = sensorId;
+                seriesList[i].field = field;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // true - закрылся минутный интервал, его агрегат отдаёт latest().
+    bool insert(int16_t index, uint32_t time, float value) {
+        if (index < 0 || index >= layout.series) return false;
+        HistorySeries& series = seriesList[index];
+
+        series.raw.push({ time, value });
+        bool minuteClosed = roll(series.minuteAcc, series.minute, time / HISTORY_MINUTE_S, HISTORY_MINUTE_S);
+        series.minuteAcc.add(value);
+        roll(series.hourAcc, series.hour, time / HISTORY_HOUR_S, HISTORY_HOUR_S);
+        series.hourAcc.add(value);
+        return minuteClosed;
+    }
+
+    // Минутный агрегат из архива: в минутное кольцо и в часовой интервал.
+    void restore(int16_t index, const HistoryAggregate& minute) {
+        if (index < 0 || index >= layout.series) return;
+        HistorySeries& series = seriesList[index];
+
+        series.minute.push(minute);
+        roll(series.hourAcc, series.hour, minute.time / HISTORY_HOUR_S, HISTORY_HOUR_S);
+        series.hourAcc.merge(minute);
+    }
+
+    bool latest(int16_t index, HistoryTier tier, HistoryAggregate& out) const {
+        if (index < 0 || index >= layout.series || tier == HISTORY_RAW) return false;
+        const HistoryRing<HistoryAggregate>& ring = tier == HISTORY_MINUTE ? seriesList[index].minute : seriesList[index].hour;
+        if (ring.total == 0) return false;
+        out = ring.at(ring.total - 1);
+        return true;
+    }
+
+    bool key(int16_t index, int32_t& sensorId, uint8_t& field) const {
+        if (index < 0 || index >= layout.series || !seriesList[index].used) return false;
+        sensorId = seriesList[index].sensorId;
+        field = seriesList[index].field;
+        return true;
+    }
+
+    // Сырые точки с номера cursor во временном окне [from, to]; cursor сдвигается
+    // за последнюю просмотренную запись. 0 - ряд дочитан до конца.
+    size_t readRaw(int16_t index, uint32_t& cursor, uint32_t from, uint32_t to,
+                   HistoryPoint* out, size_t maxCount) const {
+        if (index < 0 || index >= layout.series) return 0;
+        return read(seriesList[index].raw, cursor, from, to, out, maxCount);
+    }
+
+    // Законченные интервалы уровня minute/hour; текущий незаконченный не отдаётся.
+    size_t readAggregate(int16_t index, HistoryTier tier, uint32_t& cursor, uint32_t from, uint32_t to,
+                         HistoryAggregate* out, size_t maxCount) const {
+        if (index < 0 || index >= layout.series || tier == HISTORY_RAW) return 0;
+        const HistorySeries& series = seriesList[index];
+        return read(tier == HISTORY_MINUTE ? series.minute : series.hour, cursor, from, to, out, maxCount);
+    }
+
+private:
+    HistoryLayout layout = {};
+    HistorySeries* seriesList = nullptr;
+
+    // Переход в новый интервал: законченный уходит в кольцо. true - интервал закрыт.
+    static bool roll(HistoryAccumulator& acc, HistoryRing<HistoryAggregate>& ring,
+                     uint32_t bucket, uint32_t bucketSeconds) {
+        if (acc.count > 0 && acc.bucket == bucket) return false;
+
+        bool closed = acc.count > 0;
+        if (closed) ring.push(acc.result(bucketSeconds));
+        acc.reset(bucket);
+        return closed;
+    }
+
+    template<typename T>
+    static size_t read(const HistoryRing<T>& ring, uint32_t& cursor, uint32_t from, uint32_t to,
+                       T* out, size_t maxCount) {
+        if (cursor < ring.first()) cursor = ring.first();
+
+        size_t copied = 0;
+        while (cursor < ring.total && copied < maxCount) {
+            const T& item = ring.at(cursor++);
+            if (item.time >= from && item.time <= to) out[copied++] = item;
+        }
+        return copied;
+    }
+};
+
+#endif
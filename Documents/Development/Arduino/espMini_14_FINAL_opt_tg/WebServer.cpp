@@ -1,4 +1,8 @@
 #include "WebServer.h"
+#include "DeviceConfigFile.h"
+#include "DeviceJsonReader.h"
+#include "DeviceJsonWriter.h"
+#include <new>
 
 WebServer::WebServer(Settings& settings,
                      DeviceManager& deviceManager,
@@ -59,34 +63,20 @@ return;
     handleGetLogs(request);
   });
 
+  server.on("/history", HTTP_GET, [this](AsyncWebServerRequest * request) {
+    handleGetHistory(request);
+  });
+
   server.on("/saveSettings", HTTP_POST, [this](AsyncWebServerRequest * request) {
     handleSaveSettings(request);
   });
 
 server.on("/saveDevice", HTTP_POST,
 
+  // Ответ отправляет обработчик тела; без тела он не вызывается
   [this](AsyncWebServerRequest * request) {
-
-    if (request->hasHeader("Content-Length")) {
-      size_t contentLength = request->header("Content-Length").toInt();
-
-      size_t freeHeap = ESP.getFreeHeap();
-
-      size_t requiredMemory = contentLength + SIZE_JSON_S + ESP8266_SAFETY_MARGIN_HEAP;
-
-      Serial.printf("[MEMORY] Check: Required=%u, Free=%u\n", requiredMemory, freeHeap);
-
-      if (freeHeap < requiredMemory) {
-        Serial.printf("❌ ОШИБКА: Недостаточно памяти. Требуется: %u байт, доступно: %u байт. Отклоняю запрос.\n", requiredMemory, freeHeap);
-
-        sendError(request, 507, "Insufficient Storage. Device memory is low. Try simplifying the configuration or rebooting the device.");
-        request->client()->close();
-        return;
-      }
-      Serial.println("[MEMORY] Памяти достаточно, продолжаю обработку.");
-
-    } else {
-      Serial.println("[MEMORY] Заголовок Content-Length отсутствую, не могу проверить память.");
+    if (request->contentLength() == 0) {
+request->send(400, "application/json", R"({"error":"Empty request body"})");
     }
   },
 
@@ -96,6 +86,21 @@ server.on("/saveDevice", HTTP_POST,
   }
 );
 
+  // Правка одной записи без полной замены устройства: ?section=relay|sensor|
+  // schedule|timer|action|pid&id=<id реле/сенсора или индекс>, тело - объект
+  // записи с ключами GET /device; отсутствующие поля не меняются
+  server.on("/device", HTTP_PATCH,
+    [this](AsyncWebServerRequest * request) {
+      if (request->contentLength() == 0) {
+        sendError(request, 400, "Empty request body");
+      }
+    },
+    NULL,
+    [this](AsyncWebServerRequest * request, uint8_t* data, size_t len, size_t index, size_t total) {
+      handlePatchDevice(request, data, len, index, total);
+    }
+  );
+
   server.on("/updateDevice", HTTP_POST, [this](AsyncWebServerRequest * request) {
 
     handleUpdateDeviceProperty(request);
@@ -129,6 +134,16 @@ server.on("/saveDevice", HTTP_POST,
     handleSysinfo(request);
   });
 
+#ifdef CONTROL_PROFILER
+  server.on("/profile", HTTP_GET, [this](AsyncWebServerRequest * request) {
+    handleGetProfile(request);
+  });
+
+  server.on("/resetProfile", HTTP_POST, [this](AsyncWebServerRequest * request) {
+    handleResetProfile(request);
+  });
+#endif
+
   server.on("/scan", HTTP_POST, [this](AsyncWebServerRequest * request) {
 if (wifiManager.isScanInProgress()) {
 sendError(request, 503, "Scanning already in progress, please wait.");
@@ -154,11 +169,17 @@ ota.resetUploadState();
   }
            );
 
-  server.on("/download", HTTP_POST, [](AsyncWebServerRequest * request) {
+  server.on("/download", HTTP_POST, [this](AsyncWebServerRequest * request) {
     if (request->hasParam("file", true)) {
       String filename = request->getParam("file", true)->value();
       filename = "/" + filename;
 
+      // Конфигурация хранится двоично, копия для интерфейса - JSON текущего устройства
+      if (filename == DEVICE_CONFIG_LEGACY_PATH && !SPIFFS.exists(filename)) {
+        handleGetDeviceSettings(request);
+        return;
+      }
+
 #ifdef ESP32
       if (!SPIFFS.begin(true)) {
 #elif defined(ESP8266)
@@ -309,18 +330,22 @@ String json = settings.serializeSettings(settings.ws);
   _webServerIsBusy = false;
 }
 
+// Выдача кусками по мере отправки: память - одна запись, размер не ограничен
 void WebServer::handleGetDeviceSettings(AsyncWebServerRequest * request) {
-processRequestSetting = true;
-
-  const Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
+  std::shared_ptr<const DeviceConfigSnapshot> config = deviceManager.configSnapshot();
+  if (!config) {
+    sendError(request, 500, "No current device");
+    return;
+  }
 
-  String status = deviceManager.serializeDevice(currentDevice, nullptr, request);
-  if (status != "sending") {
-request->send(500, "text/plain", "Failed to start streaming");
-  } else {
-}
+  auto writer = std::make_shared<DeviceJsonWriter>(std::shared_ptr<const Device>(config, &config->device));
 
-  processRequestSetting = false;
+  AsyncWebServerResponse* response = request->beginChunkedResponse("application/json",
+    [writer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      return writer->read(buffer, maxLen);
+    });
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
 }
 
 void WebServer::handleGetLiveData(AsyncWebServerRequest * request) {
@@ -333,12 +358,15 @@ void WebServer::handleGetLiveData(AsyncWebServerRequest * request) {
 
   bool forceUpdate = _forceLiveDataUpdate;
 
-  const Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
+  // Живые данные берутся из снимка, опубликованного задачей управления
+  deviceManager.bridge.webSnapshot.update();
+  const ControlSnapshot& snapshot = deviceManager.bridge.webSnapshot.read();
 
   static uint32_t lastSentRelayChecksum = 0;
   static uint32_t lastSentSensorChecksum = 0;
   static uint32_t lastSentTimerChecksum = 0;
   static uint32_t lastSentSettingsChecksum = 0;
+  static uint32_t lastSentDevicesChecksum = 0;
 
   DynamicJsonDocument doc(4096);
   bool hasUpdates = false;
@@ -364,7 +392,7 @@ void WebServer::handleGetLiveData(AsyncWebServerRequest * request) {
 
   uint32_t currentTimerChecksum = deviceManager.calculateTimersProgressChecksum();
 
-  if (currentDevice.isTimersEnabled && (forceUpdate || currentTimerChecksum != lastSentTimerChecksum)) {
+  if (snapshot.isTimersEnabled && (forceUpdate || currentTimerChecksum != lastSentTimerChecksum)) {
     //if (!forceUpdate) Serial.println("[WebServer:LiveData] Event: Timers data changed.");
     JsonObject timersUpdate = doc.createNestedObject("timers_update");
     deviceManager.serializeTimersProgress(timersUpdate);
@@ -381,6 +409,14 @@ void WebServer::handleGetLiveData(AsyncWebServerRequest * request) {
     hasUpdates = true;
   }
 
+  uint32_t currentDevicesChecksum = deviceManager.calculateLiveDevicesChecksum();
+  if (snapshot.deviceCount > 1 && (forceUpdate || currentDevicesChecksum != lastSentDevicesChecksum)) {
+    JsonObject devicesUpdate = doc.createNestedObject("devices_update");
+    deviceManager.serializeLiveDevices(devicesUpdate);
+    lastSentDevicesChecksum = currentDevicesChecksum;
+    hasUpdates = true;
+  }
+
   JsonObject staticInfo = doc.createNestedObject("static_info");
   staticInfo["freeHeap"] = ESP.getFreeHeap();
   staticInfo["systemLoad"] = settings.ws.systemLoading;
@@ -422,6 +458,114 @@ StaticJsonDocument<200> doc;
   _webServerIsBusy = false;
 }
 
+// /history?sensor=<id>[&field=0|1][&tier=raw|min|hour|arch][&from=<сек>][&to=<сек>][&format=csv|bin]
+// field=1 - влажность DHT, arch - минутные агрегаты из архива на флеше.
+// Время - unix-секунды, до синхронизации часов - аптайм.
+// bin: заголовок "TSH1", tier (arch - 3), field, 2 байта резерва, sensorId (int32), далее записи
+// little-endian: raw - {uint32 time, float value}, остальные - {uint32 time, float min, avg, max}.
+void WebServer::handleGetHistory(AsyncWebServerRequest * request) {
+  if (!deviceManager.history.isReady()) {
+    sendError(request, 503, "History is not available");
+    return;
+  }
+  if (!request->hasParam("sensor")) {
+    sendError(request, 400, "Missing parameter: sensor");
+    return;
+  }
+
+  auto stream = std::make_shared<HistoryStream>();
+  stream->sensorId = request->getParam("sensor")->value().toInt();
+  stream->field = request->hasParam("field") ? request->getParam("field")->value().toInt() : HISTORY_FIELD_VALUE;
+  stream->from = request->hasParam("from") ? strtoul(request->getParam("from")->value().c_str(), nullptr, 10) : 0;
+  stream->to = request->hasParam("to") ? strtoul(request->getParam("to")->value().c_str(), nullptr, 10) : UINT32_MAX;
+  stream->binary = request->hasParam("format") && request->getParam("format")->value() == "bin";
+
+  String tier = request->hasParam("tier") ? request->getParam("tier")->value() : "raw";
+  stream->archived = tier == "arch";
+  if (tier == "raw") stream->tier = HISTORY_RAW;
+  else if (tier == "min" || stream->archived) stream->tier = HISTORY_MINUTE;
+  else if (tier == "hour") stream->tier = HISTORY_HOUR;
+  else {
+    sendError(request, 400, "Invalid tier: " + tier);
+    return;
+  }
+
+  stream->series = deviceManager.history.find(stream->sensorId, stream->field);
+  if (stream->series < 0 && !stream->archived) {
+    sendError(request, 404, "No history for sensor");
+    return;
+  }
+
+  AsyncWebServerResponse* response = request->beginChunkedResponse(
+    stream->binary ? "application/octet-stream" : "text/csv",
+    [this, stream](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      return fillHistoryChunk(*stream, buffer, maxLen);
+    });
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+size_t WebServer::fillHistoryChunk(HistoryStream& stream, uint8_t* buffer, size_t maxLen) {
+  const bool raw = stream.tier == HISTORY_RAW;
+  const size_t recordMax = stream.binary ? (raw ? sizeof(HistoryPoint) : sizeof(HistoryAggregate)) : HISTORY_CSV_LINE_MAX;
+  size_t used = 0;
+
+  if (!stream.headerSent) {
+    if (maxLen < HISTORY_CSV_LINE_MAX) return RESPONSE_TRY_AGAIN;
+    if (stream.binary) {
+      memcpy(buffer, "TSH1", 4);
+      buffer[4] = stream.archived ? 3 : stream.tier;
+      buffer[5] = stream.field;
+      buffer[6] = 0;
+      buffer[7] = 0;
+      memcpy(buffer + 8, &stream.sensorId, sizeof(stream.sensorId));
+      used = 12;
+    } else {
+      used = snprintf((char*)buffer, maxLen, raw ? "time,value\n" : "time,min,avg,max\n");
+    }
+    stream.headerSent = true;
+  }
+
+  HistoryPoint points[HISTORY_CHUNK_POINTS];
+  HistoryAggregate aggregates[HISTORY_CHUNK_POINTS];
+
+  while (!stream.finished && maxLen - used >= recordMax) {
+    size_t room = min((size_t)HISTORY_CHUNK_POINTS, (maxLen - used) / recordMax);
+    size_t count;
+    if (raw) {
+      count = deviceManager.history.readRaw(stream.series, stream.cursor, stream.from, stream.to, points, room);
+    } else if (stream.archived) {
+      count = deviceManager.history.readArchive(stream.archiveCursor, stream.sensorId, stream.field,
+                                                stream.from, stream.to, aggregates, room);
+    } else {
+      count = deviceManager.history.readAggregate(stream.series, stream.tier, stream.cursor, stream.from, stream.to, aggregates, room);
+    }
+    if (count == 0) {
+      stream.finished = true;
+      break;
+    }
+
+    if (stream.binary) {
+      size_t bytes = count * (raw ? sizeof(HistoryPoint) : sizeof(HistoryAggregate));
+      memcpy(buffer + used, raw ? (const void*)points : (const void*)aggregates, bytes);
+      used += bytes;
+      continue;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      char* line = (char*)buffer + used;
+      if (raw) {
+        used += snprintf(line, HISTORY_CSV_LINE_MAX, "%lu,%.2f\n", (unsigned long)points[i].time, points[i].value);
+      } else {
+        used += snprintf(line, HISTORY_CSV_LINE_MAX, "%lu,%.2f,%.2f,%.2f\n", (unsigned long)aggregates[i].time,
+                         aggregates[i].min, aggregates[i].avg, aggregates[i].max);
+      }
+    }
+  }
+
+  return used;
+}
+
 void WebServer::handleSysinfo(AsyncWebServerRequest * request) {
   _webServerIsBusy = true;
 StaticJsonDocument<800> doc;
@@ -437,6 +581,56 @@ StaticJsonDocument<800> doc;
   _webServerIsBusy = false;
 }
 
+#ifdef CONTROL_PROFILER
+// /profile[?stage=<имя>] - длительности этапов в мкс; для stage ещё и
+// непустые корзины гистограммы: [нижняя граница, число замеров]
+void WebServer::handleGetProfile(AsyncWebServerRequest * request) {
+  _webServerIsBusy = true;
+  const StageProfiler& profiler = info.profiler;
+  String detail = request->hasParam("stage") ? request->getParam("stage")->value() : "";
+
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(PROFILER_MAX_STAGES) +
+                          PROFILER_MAX_STAGES * JSON_OBJECT_SIZE(11) +
+                          JSON_ARRAY_SIZE(PROFILER_BUCKETS) + PROFILER_BUCKETS * JSON_ARRAY_SIZE(2));
+  JsonArray stages = doc.createNestedArray("stages");
+
+  for (int i = 0; i < profiler.getStageCount(); i++) {
+    const ProfileStage* stage = profiler.getStage(i);
+    JsonObject item = stages.createNestedObject();
+    item["name"] = stage->name;
+    item["count"] = stage->count;
+    item["minUs"] = stage->minUs;
+    item["avgUs"] = stage->averageUs();
+    item["p50Us"] = StageProfiler::percentile(*stage, 500);
+    item["p99Us"] = StageProfiler::percentile(*stage, 990);
+    item["maxUs"] = stage->maxUs;
+    item["budgetUs"] = stage->budgetUs;
+    item["overruns"] = stage->overruns;
+    item["missed"] = stage->missed;
+
+    if (detail == stage->name) {
+      JsonArray buckets = item.createNestedArray("buckets");
+      for (uint8_t b = 0; b < PROFILER_BUCKETS; b++) {
+        if (stage->buckets[b] == 0) continue;
+        JsonArray bucket = buckets.createNestedArray();
+        bucket.add(StageProfiler::bucketLower(b));
+        bucket.add(stage->buckets[b]);
+      }
+    }
+  }
+
+  sendJson(request, doc);
+  _webServerIsBusy = false;
+}
+
+void WebServer::handleResetProfile(AsyncWebServerRequest * request) {
+  _webServerIsBusy = true;
+  info.profiler.reset();
+  sendSuccess(request, "Profile reset");
+  _webServerIsBusy = false;
+}
+#endif
+
 void WebServer::handleSaveSettings(AsyncWebServerRequest * request) {
   _webServerIsBusy = true;
 if (request->hasParam("body", true)) {
@@ -466,62 +660,190 @@ if (request->hasParam("body", true)) {
   _webServerIsBusy = false;
 }
 
-void WebServer::handleSaveDeviceSettings(AsyncWebServerRequest * request, uint8_t* data, size_t len, size_t index, size_t total) {
-  processRequestSetting = true;
-
-  static char* jsonBuffer = nullptr;
-  static size_t expectedTotalSize = 0;
+void WebServer::releaseDeviceUpload() {
+  delete deviceReader;
+  deviceReader = nullptr;
+  delete stagedDevice;
+  stagedDevice = nullptr;
+  deviceUploadRequest = nullptr;
+  appState.isProcessWorkingJson = false;
+  processRequestSetting = false;
+}
 
+// Тело разбирается по мере прихода кусков прямо в копию устройства:
+// ни буфера под всё тело, ни JSON-документа
+void WebServer::handleSaveDeviceSettings(AsyncWebServerRequest * request, uint8_t* data, size_t len, size_t index, size_t total) {
   if (index == 0) {
+    releaseDeviceUpload();
 
-    if (jsonBuffer) {
-      free(jsonBuffer);
-      jsonBuffer = nullptr;
+    if (total > DEVICE_JSON_MAX_BYTES) {
+request->send(413, "application/json", R"({"error":"Configuration is too large"})");
+      return;
+    }
+    if (ESP.getFreeHeap() < ESP8266_SAFETY_MARGIN_HEAP) {
+request->send(507, "application/json", R"({"error":"Device memory is low"})");
+      return;
     }
 
-    expectedTotalSize = total;
-
-    jsonBuffer = (char*)malloc(expectedTotalSize + 1);
+    processRequestSetting = true;
+    appState.isProcessWorkingJson = true;
 
-    if (!jsonBuffer) {
+    // Разбор в копию снимка конфигурации, подмену выполнит задача управления
+    std::shared_ptr<const DeviceConfigSnapshot> config = deviceManager.configSnapshot();
+    stagedDevice = config ? new (std::nothrow) Device(config->device) : nullptr;
+    deviceReader = stagedDevice ? new (std::nothrow) DeviceJsonReader(*stagedDevice) : nullptr;
+    if (!deviceReader) {
 request->send(500, "application/json", R"({"error":"Memory allocation failed on server"})");
-      processRequestSetting = false;
+      releaseDeviceUpload();
       return;
     }
-}
 
-  if (jsonBuffer) {
-    memcpy(jsonBuffer + index, data, len);
+    // Обрыв соединения посреди тела
+    deviceUploadRequest = request;
+    request->onDisconnect([this, request]() {
+      if (deviceUploadRequest == request) releaseDeviceUpload();
+    });
   }
 
-  if (index + len != expectedTotalSize) {
+  // Запрос уже отклонён: остаток тела пропускается
+  if (!deviceReader || deviceUploadRequest != request) {
     return;
   }
 
-  jsonBuffer[expectedTotalSize] = '\0';
-{
-    DynamicJsonDocument doc(SIZE_JSON_S);
-    DeserializationError error = deserializeJson(doc, jsonBuffer);
+  bool isParsed = deviceReader->feed((const char*)data, len);
+  if (isParsed && index + len < total) {
+    return;
+  }
+  if (isParsed) {
+    isParsed = deviceReader->finish();
+  }
 
-    if (error) {
-request->send(400, "application/json", R"({"error":"Invalid JSON content"})");
-    } else {
+  if (!isParsed) {
+    char message[96];
+    snprintf(message, sizeof(message), R"({"error":"Invalid JSON content: %s at byte %u"})",
+             JsonStreamParser::errorText(deviceReader->error()), (unsigned)deviceReader->errorOffset());
+request->send(400, "application/json", message);
+    releaseDeviceUpload();
+    return;
+  }
 
-      Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
-      if (deviceManager.deserializeDevice(doc.as<JsonObject>(), currentDevice)) {
-        appState.isSaveControlRequest = true;
+  deviceManager.compileDevice(*stagedDevice);
+
+  ControlCommand command;
+  command.type = CMD_APPLY_DEVICE;
+  command.payload = stagedDevice;
+
+  if (deviceManager.bridge.post(command)) {
+    stagedDevice = nullptr;
 request->send(200, "application/json", R"({"status":"ok", "message":"Настройки сохранены"})");
-      } else {
-request->send(500, "application/json", R"({"error":"Failed to apply settings"})");
-      }
+  } else {
+request->send(503, "application/json", R"({"error":"Control queue is full"})");
+  }
+  releaseDeviceUpload();
+}
+
+void WebServer::releasePatchUpload() {
+  delete patchUpload.reader;
+  patchUpload.reader = nullptr;
+  DeviceManager::deleteItem(patchUpload.section, patchUpload.record);
+  patchUpload.record = nullptr;
+  patchUpload.request = nullptr;
+}
+
+// Как /saveDevice, но для одной записи: разбор в её копию, подмена в задаче
+// управления - без перезаписи всей конфигурации и переинициализации датчиков
+void WebServer::handlePatchDevice(AsyncWebServerRequest * request, uint8_t* data, size_t len, size_t index, size_t total) {
+  static const char* const sectionNames[] = { "relay", "sensor", "schedule", "timer", "action", "pid" };
+
+  if (index == 0) {
+    releasePatchUpload();
+
+    if (total > DEVICE_PATCH_MAX_BYTES) {
+      sendError(request, 413, "Record is too large");
+      return;
     }
+    if (!request->hasParam("section") || !request->hasParam("id")) {
+      sendError(request, 400, "Missing parameter: section or id");
+      return;
+    }
+
+    String name = request->getParam("section")->value();
+    int section = -1;
+    for (size_t i = 0; i < sizeof(sectionNames) / sizeof(sectionNames[0]); i++) {
+      if (name == sectionNames[i]) section = i;
+    }
+    if (section < 0) {
+      sendError(request, 400, "Invalid section: " + name);
+      return;
+    }
+
+    // Запись ищется и копируется в снимке конфигурации, не в живом устройстве
+    std::shared_ptr<const DeviceConfigSnapshot> config = deviceManager.configSnapshot();
+    if (!config) {
+      sendError(request, 500, "No current device");
+      return;
+    }
+    const Device& device = config->device;
+
+    patchUpload.section = (DevicePatchSection)section;
+    patchUpload.id = request->getParam("id")->value().toInt();
+    patchUpload.index = deviceManager.findItemIndex(device, patchUpload.section, patchUpload.id);
+    if (patchUpload.index < 0) {
+      sendError(request, 404, "No such " + name);
+      return;
+    }
+
+    patchUpload.record = DeviceManager::copyItem(device, patchUpload.section, patchUpload.index);
+    patchUpload.reader = patchUpload.record ? new (std::nothrow) DeviceJsonReader(patchUpload.section, patchUpload.record) : nullptr;
+    if (!patchUpload.reader) {
+      sendError(request, 500, "Memory allocation failed on server");
+      releasePatchUpload();
+      return;
+    }
+
+    patchUpload.request = request;
+    request->onDisconnect([this, request]() {
+      if (patchUpload.request == request) releasePatchUpload();
+    });
   }
 
-  if (jsonBuffer) {
-    free(jsonBuffer);
-    jsonBuffer = nullptr;
+  if (!patchUpload.reader || patchUpload.request != request) {
+    return;
   }
-processRequestSetting = false;
+
+  bool isParsed = patchUpload.reader->feed((const char*)data, len);
+  if (isParsed && index + len < total) {
+    return;
+  }
+  if (isParsed) {
+    isParsed = patchUpload.reader->finish();
+  }
+
+  if (!isParsed) {
+    char message[96];
+    snprintf(message, sizeof(message), "Invalid JSON content: %s at byte %u",
+             JsonStreamParser::errorText(patchUpload.reader->error()), (unsigned)patchUpload.reader->errorOffset());
+    sendError(request, 400, message);
+    releasePatchUpload();
+    return;
+  }
+
+  deviceManager.compileItem(patchUpload.section, patchUpload.record);
+
+  ControlCommand command;
+  command.type = CMD_PATCH_ITEM;
+  command.field = patchUpload.section;
+  command.id = patchUpload.index;
+  command.number = patchUpload.id;
+  command.payload = patchUpload.record;
+
+  if (deviceManager.bridge.post(command)) {
+    patchUpload.record = nullptr;
+    sendSuccess(request, "Запись сохранена");
+  } else {
+    sendError(request, 503, "Control queue is full");
+  }
+  releasePatchUpload();
 }
 
 void WebServer::handleUpdateDeviceProperty(AsyncWebServerRequest * request) {
@@ -544,15 +866,45 @@ request->send(400, "application/json", R"({"error":"Invalid JSON content"})");
     return;
   }
 
-  if (deviceManager.currentDeviceIndex >= deviceManager.myDevices.size()) {
+  std::shared_ptr<const DeviceConfigSnapshot> config = deviceManager.configSnapshot();
+  if (!config) {
 request->send(400, "application/json", R"({"error":"Invalid device index"})");
     return;
   }
 
-  Device& currentDevice = deviceManager.myDevices[deviceManager.currentDeviceIndex];
+  // Только проверка индексов по снимку; сами изменения применяет задача управления
+  const Device& currentDevice = config->device;
   bool anyFieldUpdated = false;
   String updatedPropertiesList = "";
 
+  auto postItem = [this](ControlItemField field, int index, bool value, void* payload = nullptr) {
+    ControlCommand command;
+    command.type = CMD_SET_ITEM;
+    command.field = field;
+    command.id = index;
+    command.value = value;
+    command.payload = payload;
+    return deviceManager.bridge.post(command);
+  };
+
+  auto postFlag = [this](ControlFlag flag, bool value) {
+    ControlCommand command;
+    command.type = CMD_SET_FLAG;
+    command.field = flag;
+    command.value = value;
+    return deviceManager.bridge.post(command);
+  };
+
+  // Автонастройка ПИД: false - стоп, true или гистерезис в °C - старт
+  auto postAutotune = [this](int loopIndex, JsonVariant value) {
+    ControlCommand command;
+    command.type = CMD_AUTOTUNE;
+    command.id = loopIndex;
+    command.value = value.is<bool>() ? value.as<bool>() : true;
+    command.number = value.is<bool>() ? AUTOTUNE_DEFAULT_HYSTERESIS : value.as<float>();
+    return deviceManager.bridge.post(command);
+  };
+
   for (JsonPair kv : doc.as<JsonObject>()) {
     const char* key = kv.key().c_str();
     JsonVariant value = kv.value();
@@ -593,13 +945,12 @@ continue;
       if (arrayName == "act") {
 
         if (index >= 0 && index < currentDevice.actions.size()) {
-          Action& action = currentDevice.actions[index];
           if (propertyName == "use" && value.is<bool>()) {
-            action.isUseSetting = value.as<bool>();
-            updated = true;
+            updated = postItem(ITEM_ACTION_USE, index, value.as<bool>());
           } else if (propertyName == "dsc" && value.is<String>()) {
-            strlcpy(action.description, value.as<String>().c_str(), MAX_DESCRIPTION_LENGTH);
-            updated = true;
+            char* description = strdup(value.as<String>().c_str());
+            updated = description && postItem(ITEM_ACTION_DESCRIPTION, index, false, description);
+            if (!updated) free(description);
           }
         } else {
           Serial.printf("⚠️ Пропускаем свойство с индексом за пределами массива actions: %s (индекс: %d, размер: %d)\n",
@@ -609,10 +960,8 @@ continue;
       else if (arrayName == "tmr") {
 
         if (index >= 0 && index < currentDevice.timers.size()) {
-          Timer& timer = currentDevice.timers[index];
           if (propertyName == "use" && value.is<bool>()) {
-            timer.isUseSetting = value.as<bool>();
-            updated = true;
+            updated = postItem(ITEM_TIMER_USE, index, value.as<bool>());
           }
         } else {
           Serial.printf("⚠️ Пропускаем свойство с индексом за пределами массива timers: %s (индекс: %d, размер: %d)\n",
@@ -622,10 +971,8 @@ continue;
       else if (arrayName == "sch") {
 
         if (index >= 0 && index < currentDevice.scheduleScenarios.size()) {
-          ScheduleScenario& schedule = currentDevice.scheduleScenarios[index];
           if (propertyName == "use" && value.is<bool>()) {
-            schedule.isUseSetting = value.as<bool>();
-            updated = true;
+            updated = postItem(ITEM_SCHEDULE_USE, index, value.as<bool>());
           }
         } else {
           Serial.printf("⚠️ Пропускаем свойство с индексом за пределами массива scheduleScenarios: %s (индекс: %d, размер: %d)\n",
@@ -635,10 +982,8 @@ continue;
       else if (arrayName == "sen") {
 
         if (index >= 0 && index < currentDevice.sensors.size()) {
-          Sensor& sensor = currentDevice.sensors[index];
           if (propertyName == "use" && value.is<bool>()) {
-            sensor.isUseSetting = value.as<bool>();
-            updated = true;
+            updated = postItem(ITEM_SENSOR_USE, index, value.as<bool>());
           }
         } else {
           Serial.printf("⚠️ Пропускаем свойство с индексом за пределами массива sensors: %s (индекс: %d, размер: %d)\n",
@@ -648,26 +993,39 @@ continue;
       else if (arrayName == "rel") {
 
         if (index >= 0 && index < currentDevice.relays.size()) {
-          Relay& relay = currentDevice.relays[index];
           if (propertyName == "man" && value.is<bool>()) {
-            relay.manualMode = value.as<bool>();
-            updated = true;
+            updated = postItem(ITEM_RELAY_MANUAL, index, value.as<bool>());
           } else if (propertyName == "stp" && value.is<bool>()) {
-            relay.statePin = value.as<bool>();
-            updated = true;
+            updated = postItem(ITEM_RELAY_STATE, index, value.as<bool>());
           }
         } else {
           Serial.printf("⚠️ Пропускаем свойство с индексом за пределами массива relays: %s (индекс: %d, размер: %d)\n",
                         key, index, currentDevice.relays.size());
         }
       }
+      else if (arrayName == "tzn") {
+
+        // Зоны температуры: tzn[0] - контур 1, контур 0 - это "tmp"
+        if (index >= 0 && index + 1 < currentDevice.temperatures.size()) {
+          if (propertyName == "use" && value.is<bool>()) {
+            updated = postItem(ITEM_TEMPERATURE_USE, index + 1, value.as<bool>());
+          } else if (propertyName == "atn" && (value.is<bool>() || value.is<float>())) {
+            updated = postAutotune(index + 1, value);
+          }
+        } else {
+          Serial.printf("⚠️ Пропускаем свойство с индексом за пределами массива tzn: %s (индекс: %d, размер: %d)\n",
+                        key, index, currentDevice.temperatures.size() - 1);
+        }
+      }
       else if (arrayName == "pid") {
 
         if (index >= 0 && index < currentDevice.pids.size()) {
-          Pid& pid = currentDevice.pids[index];
           if (propertyName == "Kp" && value.is<double>()) {
-            pid.Kp = value.as<double>();
-            updated = true;
+            ControlCommand command;
+            command.type = CMD_SET_PID_KP;
+            command.id = index;
+            command.number = value.as<double>();
+            updated = deviceManager.bridge.post(command);
           }
         } else {
           Serial.printf("⚠️ Пропускаем свойство с индексом за пределами массива pids: %s (индекс: %d, размер: %d)\n",
@@ -678,20 +1036,17 @@ continue;
 }
     }
     else if (strcmp(key, "ite") == 0 && value.is<bool>()) {
-      currentDevice.isTimersEnabled = value.as<bool>();
-      updated = true;
+      updated = postFlag(FLAG_TIMERS, value.as<bool>());
     } else if (strcmp(key, "iet") == 0 && value.is<bool>()) {
-      currentDevice.isEncyclateTimers = value.as<bool>();
-      updated = true;
+      updated = postFlag(FLAG_ENCYCLATE, value.as<bool>());
     } else if (strcmp(key, "ise") == 0 && value.is<bool>()) {
-      currentDevice.isScheduleEnabled = value.as<bool>();
-      updated = true;
+      updated = postFlag(FLAG_SCHEDULE, value.as<bool>());
     } else if (strcmp(key, "iae") == 0 && value.is<bool>()) {
-      currentDevice.isActionEnabled = value.as<bool>();
-      updated = true;
+      updated = postFlag(FLAG_ACTIONS, value.as<bool>());
     } else if (strcmp(key, "tmp.use") == 0 && value.is<bool>()) {
-      currentDevice.temperature.isUseSetting = value.as<bool>();
-      updated = true;
+      updated = postFlag(FLAG_TEMPERATURE, value.as<bool>());
+    } else if (strcmp(key, "tmp.atn") == 0 && (value.is<bool>() || value.is<float>())) {
+      updated = postAutotune(0, value);
     } else {
 }
 
@@ -805,8 +1160,12 @@ sendSuccess(request, "Reset initiated");
 
 void WebServer::handleResetDevice(AsyncWebServerRequest * request) {
   _webServerIsBusy = true;
-if (SPIFFS.exists("/devices.json")) {
-    bool success = SPIFFS.remove("/devices.json");
+  // Прежний devices.json тоже, иначе при старте он импортируется заново
+  SPIFFS.remove(DEVICE_CONFIG_LEGACY_PATH);
+  SPIFFS.remove(DEVICE_CONFIG_PATH ".tmp");
+  SPIFFS.remove(DEVICE_CONFIG_PATH DEVICE_CONFIG_JOURNAL_SUFFIX);
+if (SPIFFS.exists(DEVICE_CONFIG_PATH)) {
+    bool success = SPIFFS.remove(DEVICE_CONFIG_PATH);
     if (success) {
       sendSuccess(request, "Reset Device executed");
       appState.isReboot = true;
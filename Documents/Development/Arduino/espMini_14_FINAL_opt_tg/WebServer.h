@@ -12,9 +12,14 @@
 #include "WiFiManager.h"
 #include "index_html_gz.h"
 
+class DeviceJsonReader;
+
 #define MAX_JSON_PAYLOAD_SIZE_ESP8266 3500
 #define ESP8266_SAFETY_MARGIN_HEAP 5000
 
+#define HISTORY_CHUNK_POINTS 16
+#define HISTORY_CSV_LINE_MAX 64
+
 class WebServer {
 public:
     WebServer(Settings& settings,
@@ -46,15 +51,51 @@ private:
     bool _forceLiveDataUpdate = false;
     bool processRequestSetting = false;
 
+    // Приём /saveDevice: копия устройства и разбор между кусками тела
+    Device* stagedDevice = nullptr;
+    DeviceJsonReader* deviceReader = nullptr;
+    AsyncWebServerRequest* deviceUploadRequest = nullptr;
+
+    // Приём PATCH /device: копия записи и её разбор между кусками тела
+    struct PatchUpload {
+        DevicePatchSection section = PATCH_RELAY;
+        int32_t id = 0;             // id реле/сенсора или индекс записи
+        int index = -1;
+        void* record = nullptr;     // тип по section, см. DeviceManager::copyItem
+        DeviceJsonReader* reader = nullptr;
+        AsyncWebServerRequest* request = nullptr;
+    } patchUpload;
+
+    // Состояние потоковой выдачи /history между вызовами заполнителя ответа
+    struct HistoryStream {
+        int32_t sensorId;
+        int16_t series;
+        uint8_t field;
+        HistoryTier tier;
+        bool archived;          // минутные агрегаты из архива на флеше
+        bool binary;
+        bool headerSent = false;
+        bool finished = false;
+        uint32_t cursor = 0;
+        ArchiveCursor archiveCursor;
+        uint32_t from;
+        uint32_t to;
+    };
+
     AsyncWebServerResponse* getIndexResponse(AsyncWebServerRequest* request);
 
     void handleGetSettings(AsyncWebServerRequest* request);
     void handleGetDeviceSettings(AsyncWebServerRequest* request);
     void handleGetLiveData(AsyncWebServerRequest* request);
     void handleGetLogs(AsyncWebServerRequest* request);
+    void handleGetHistory(AsyncWebServerRequest* request);
+    size_t fillHistoryChunk(HistoryStream& stream, uint8_t* buffer, size_t maxLen);
 
     void handleSaveSettings(AsyncWebServerRequest* request);
     void handleSaveDeviceSettings(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+    void releaseDeviceUpload();
+    void handlePatchDevice(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+    void releasePatchUpload();
     void handleSaveDateTime(AsyncWebServerRequest* request);
     void handleUpdateDeviceProperty(AsyncWebServerRequest* request);
 
@@ -63,6 +104,10 @@ private:
     void handleReboot(AsyncWebServerRequest* request);
     void handleFullReset(AsyncWebServerRequest* request);
     void handleSysinfo(AsyncWebServerRequest* request);
+#ifdef CONTROL_PROFILER
+    void handleGetProfile(AsyncWebServerRequest* request);
+    void handleResetProfile(AsyncWebServerRequest* request);
+#endif
     void handleResetDevice(AsyncWebServerRequest* request);
 
     void printRequestParameters(AsyncWebServerRequest* request);
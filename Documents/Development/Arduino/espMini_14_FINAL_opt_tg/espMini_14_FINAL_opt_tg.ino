@@ -27,12 +27,14 @@
 #include "ConfigSettings.h"
 #include "TimeModule.h"
 #include "DeviceManager.h"
+#include "DeviceConfigFile.h"
 #include "Info.h"
 #include "Ota.h"
 #include "AppState.h"
 #include "Control.h"
 #include "Logger.h"
 #include "TelegramBot.h"
+#include "Scheduler.h"
 #include <locale.h>
 
 #if defined(ESP8266)
@@ -53,10 +55,21 @@
 
 #define CONTROL_BUTTON
 
+// На двухъядерных ESP32 управление и сеть работают в отдельных задачах на разных ядрах
+#if defined(ESP32) && !defined(CONFIG_FREERTOS_UNICORE)
+#define DUAL_CORE_CONTROL
+#define CONTROL_CORE 1
+#define NETWORK_CORE 0
+#define CONTROL_TASK_STACK 8192
+#define NETWORK_TASK_STACK 10240
+#endif
+
+#define SNAPSHOT_PUBLISH_INTERVAL 100
+// Проход управления дольше периода опроса входов задерживает кнопки
+#define CONTROL_PASS_BUDGET_US 10000
+
 #define LONG_PRESS_TIME 3000
 #define BUTTON_PIN 5
-unsigned long buttonPressStartTime = 0;
-bool wasButtonPressed = false;
 
 AppState appState;
 Settings settings(appState);
@@ -69,6 +82,37 @@ Control control(deviceManager, logger, appState);
 WiFiManager wifiManager(settings, timeModule, appState);
 WebServer webServer(settings, deviceManager, appState, timeModule, sysInfo, ota, wifiManager);
 TelegramBot telegramBot(settings, webServer, logger, appState, ota, sysInfo, deviceManager);
+
+uint32_t schedulerClock();
+void schedulerSleep(uint32_t ms);
+Scheduler controlScheduler(schedulerClock, schedulerSleep);
+#ifdef DUAL_CORE_CONTROL
+Scheduler networkScheduler(schedulerClock, schedulerSleep);
+TaskHandle_t controlTaskHandle = nullptr;
+TaskHandle_t networkTaskHandle = nullptr;
+void controlTask(void* parameter);
+void networkTask(void* parameter);
+void wakeControlTask();
+#else
+Scheduler& networkScheduler = controlScheduler;
+#endif
+
+#ifdef CONTROL_PROFILER
+int profilePassStage = -1;
+int profileCommandsStage = -1;
+int profileSnapshotStage = -1;
+#endif
+
+void registerTasks();
+void registerControlTasks(Scheduler& scheduler);
+void registerNetworkTasks(Scheduler& scheduler);
+uint32_t controlPass();
+void onButtonLongPress(uint8_t pin, GestureType gesture);
+void handleWifiToggle();
+void handleSaveControl();
+void handleSaveWifi();
+void handleFormat();
+void handleReboot();
 // -------------------------
 
 void setup() {
@@ -119,6 +163,7 @@ void setup() {
   }
 
   deviceManager.deviceInit();
+  deviceManager.history.begin(settings.ws.historyKb * 1024UL);
 
   Serial.printf("Free heap after DeviceInit: %d\n", ESP.getFreeHeap());
 
@@ -157,7 +202,21 @@ void setup() {
     webServer.begin();
   }
 
+  deviceManager.isMultiDevice = settings.ws.isMultiDevice;
   control.setup();
+#ifdef CONTROL_BUTTON
+  control.bindGesture(BUTTON_PIN, GESTURE_LONG, onButtonLongPress, LONG_PRESS_TIME);
+#endif
+  deviceManager.publishConfig();
+  deviceManager.publishSnapshot();
+
+  registerTasks();
+
+#ifdef DUAL_CORE_CONTROL
+  deviceManager.bridge.setWakeCallback(wakeControlTask);
+  xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, nullptr, 1, &controlTaskHandle, CONTROL_CORE);
+  xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, nullptr, 1, &networkTaskHandle, NETWORK_CORE);
+#endif
 
   digitalWrite(LED_PIN, LOW);
   delay(500);
@@ -165,123 +224,263 @@ void setup() {
 }
 
 void loop() {
+#ifdef DUAL_CORE_CONTROL
+  // Вся работа в задачах control/network, loopTask не нужен
+  vTaskDelete(NULL);
+#else
+  uint32_t wait = controlPass();
+  if (wait > 0) {
+    schedulerSleep(wait);
+  }
+#endif
+}
 
-#ifdef CONTROL_BUTTON
+// -------------------------
+
+uint32_t schedulerClock() {
+  return millis();
+}
+
+void schedulerSleep(uint32_t ms) {
+  delay(ms);
+}
 
-  bool isPressed = control.checkTouchSensor(BUTTON_PIN);
+bool isControlAllowed() {
+  return !ota.isUpdate && !appState.isSaveControlRequest && !appState.isStartWifi && !appState.isProcessWorkingJson;
+}
 
-  if (isPressed && !wasButtonPressed) {
-    Serial.println("Button press started, timer...");
-    buttonPressStartTime = millis();
+// Один проход задачи управления: команды из сети, задачи по дедлайнам, снимок для сети.
+// Возвращает мс до следующего дедлайна.
+uint32_t controlPass() {
+  static uint32_t lastPublish = 0;
+  PROFILE_STAGE(sysInfo.profiler, profilePassStage);
+
+  bool relaysChanged;
+  {
+    PROFILE_STAGE(sysInfo.profiler, profileCommandsStage);
+    bool isAllowed = isControlAllowed();
+    relaysChanged = control.processCommands(isAllowed);
+    if (relaysChanged && isAllowed) {
+      control.updatePins();
+    }
+    deviceManager.publishConfig();
   }
 
-  if (!isPressed && wasButtonPressed) {
-    unsigned long pressDuration = millis() - buttonPressStartTime;
-    Serial.printf("Button released. Press duration: %lu ms\n", pressDuration);
+  uint32_t wait = controlScheduler.runDue();
+  deviceManager.publishConfig();
 
-    if (pressDuration > LONG_PRESS_TIME) {
-      Serial.println("Long press detected! Toggling WiFi state and restarting...");
+  uint32_t now = millis();
+  if (relaysChanged || now - lastPublish >= SNAPSHOT_PUBLISH_INTERVAL) {
+    PROFILE_STAGE(sysInfo.profiler, profileSnapshotStage);
+    deviceManager.publishSnapshot();
+    lastPublish = now;
+  }
 
-      settings.ws.isWifiTurnedOn = !settings.ws.isWifiTurnedOn;
+  return wait < SNAPSHOT_PUBLISH_INTERVAL ? wait : SNAPSHOT_PUBLISH_INTERVAL;
+}
 
-      if (settings.saveSettings()) {
-        Serial.println("Settings saved successfully.");
-      } else {
-        Serial.println("ERROR: Failed to save settings!");
-      }
+#ifdef DUAL_CORE_CONTROL
+void controlTask(void* parameter) {
+  for (;;) {
+    uint32_t wait = controlPass();
+    if (wait > 0) {
+      // Спим до дедлайна, но просыпаемся сразу по команде из сети
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+    }
+  }
+}
 
-      if (!settings.ws.isWifiTurnedOn) {
-        Serial.println("Shutting down WiFi before restart...");
-        webServer.stop(); // Останавливаем сервер
-        WiFi.disconnect(true);
-        delay(100);
-#ifdef ESP32
-        WiFi.mode(WIFI_MODE_NULL);
-#elif defined(ESP8266)
-        WiFi.mode(WIFI_OFF);
+void networkTask(void* parameter) {
+  for (;;) {
+    networkScheduler.loop();
+  }
+}
+
+void wakeControlTask() {
+  if (controlTaskHandle) {
+    xTaskNotifyGive(controlTaskHandle);
+  }
+}
 #endif
 
-        Serial.println("WiFi is off. Ready for reboot.");
-      }
+void registerTasks() {
+  auto onOverrun = [](const char* name, uint32_t lateMs) {
+    Serial.printf("[Scheduler] Overrun '%s': +%lu ms\n", name, (unsigned long)lateMs);
+  };
+  controlScheduler.setOverrunCallback(onOverrun);
+#ifdef DUAL_CORE_CONTROL
+  networkScheduler.setOverrunCallback(onOverrun);
+#endif
 
-      ESP.restart();
+#ifdef CONTROL_PROFILER
+  // Задачи попадают в профиль под своими именами при регистрации
+  profilePassStage = sysInfo.profiler.addStage("controlPass", CONTROL_PASS_BUDGET_US);
+  profileCommandsStage = sysInfo.profiler.addStage("commands", 0);
+  profileSnapshotStage = sysInfo.profiler.addStage("snapshot", 0);
+  controlScheduler.setProfiler(&sysInfo.profiler);
+#ifdef DUAL_CORE_CONTROL
+  networkScheduler.setProfiler(&sysInfo.profiler);
+#endif
+#endif
 
-    } else {
-      Serial.println("Short press, ignoring.");
-    }
-  }
+  registerControlTasks(controlScheduler);
+  registerNetworkTasks(networkScheduler);
+}
+
+void registerControlTasks(Scheduler& scheduler) {
+  //                 имя            период фаза приоритет
+  scheduler.addTask("inputs",         10,   0, 9, []() { if (control.updateInputs(isControlAllowed())) control.updatePins(); });
+  scheduler.addTask("adcSampler",     20,   3, 8, []() { control.updateAdc(); });
+  scheduler.addTask("readSensors",   200,   0, 8, []() { if (isControlAllowed() && control.readSensors()) control.updatePins(); });
+  scheduler.addTask("sensorActions", 250,   5, 7, []() { if (isControlAllowed()) control.setSensorActions(); });
+  scheduler.addTask("updatePins",    250,   5, 6, []() { if (isControlAllowed()) control.updatePins(); });
+  scheduler.addTask("pwmFade",        20,  15, 6, []() { control.updatePwm(); });
+  scheduler.addTask("readDht",        50,  50, 5, []() { if (isControlAllowed() && control.readDhtSensors()) control.updatePins(); });
+  scheduler.addTask("schedules",    1000, 100, 4, []() { if (isControlAllowed()) control.setSchedules(); });
+  scheduler.addTask("timers",       1000, 100, 4, []() { if (isControlAllowed()) control.setTimersExecute(); });
+  scheduler.addTask("temperature",  1000, 100, 4, []() { if (isControlAllowed()) control.setTemperature(); });
+  scheduler.addTask("history",  HISTORY_SAMPLE_MS, 500, 2, []() { control.recordHistory(); });
+
+  scheduler.addTask("saveControl",    50,  20, 3, handleSaveControl);
+  // Перезагрузка из задачи управления: сначала архив истории дописывается на флеш
+  scheduler.addTask("reboot",        100,  80, 0, handleReboot);
+}
+
+void registerNetworkTasks(Scheduler& scheduler) {
+  scheduler.addTask("saveWifi",      100,  30, 3, handleSaveWifi);
+  scheduler.addTask("ota",           100,  40, 3, []() { ota.loop(); });
 
-  wasButtonPressed = isPressed;
+  if (settings.ws.isWifiTurnedOn) {
+    scheduler.addTask("wifi",         50,  10, 2, []() {
+      wifiManager.loop();
+      webServer.loop();
+    });
+    scheduler.addTask("telegram",    100,  60, 1, []() {
+      if (!ota.isUpdate && !deviceManager.isSaveControl && !appState.isStartWifi && timeModule.isInternetAvailable) {
+        telegramBot.loop();
+      }
+    });
+  }
 
+  scheduler.addTask("format",        100,  70, 0, handleFormat);
+#ifdef CONTROL_BUTTON
+  scheduler.addTask("wifiToggle",    100,  90, 0, handleWifiToggle);
 #endif
+}
 
-  if (appState.isSaveControlRequest && !ota.isUpdate && !appState.isStartWifi) {
-    static unsigned long saveTimer = 0;
+#ifdef CONTROL_BUTTON
+// Удержание кнопки LONG_PRESS_TIME: переключить WiFi и перезагрузиться
+// Жест приходит в задаче управления: там только запрос, сохранение настроек
+// и остановка Wi-Fi - в сетевой задаче (handleWifiToggle)
+void onButtonLongPress(uint8_t pin, GestureType gesture) {
+  Serial.println("Long press detected! Toggling WiFi state and restarting...");
+  appState.isWifiToggleRequest = true;
+}
 
-    if (saveTimer == 0) {
-      saveTimer = millis();
-    }
+void handleWifiToggle() {
+  if (!appState.isWifiToggleRequest.exchange(false)) {
+    return;
+  }
 
-    if (millis() - saveTimer >= 200) {
-      deviceManager.writeDevicesToFile(deviceManager.myDevices, "/devices.json");
+  settings.ws.isWifiTurnedOn = !settings.ws.isWifiTurnedOn;
 
-      saveTimer = 0;
-      Serial.println("Сохранение выполнено");
+  if (settings.saveSettings()) {
+    Serial.println("Settings saved successfully.");
+  } else {
+    Serial.println("ERROR: Failed to save settings!");
+  }
 
-      deviceManager.saveDeviceFlagsState(); // сохраняем флаги
-      deviceManager.deviceFlagsOff(); // сбрасываем в false
-      delay(100);
-      control.setupControl(true); // переинициализируем
-      delay(100);
-      deviceManager.restoreDeviceFlagsState(); // восстанавливаем флаги
+  if (!settings.ws.isWifiTurnedOn) {
+    Serial.println("Shutting down WiFi before restart...");
+    webServer.stop(); // Останавливаем сервер
+    WiFi.disconnect(true);
+    delay(100);
+#ifdef ESP32
+    WiFi.mode(WIFI_MODE_NULL);
+#elif defined(ESP8266)
+    WiFi.mode(WIFI_OFF);
+#endif
 
-      deviceManager.isSaveControl = false;
-      appState.isSaveControlRequest = false;
-    }
+    Serial.println("WiFi is off. Ready for reboot.");
   }
 
-  if (appState.isSaveWifiRequest && !appState.isStartWifi) {
-    delay(10);
-    settings.saveSettings();
-    appState.isSaveWifiRequest = false;
+  // Перезагрузит задача управления (handleReboot), дописав архив истории
+  appState.isReboot = true;
+}
+#endif
+
+void handleSaveControl() {
+  static unsigned long saveTimer = 0;
 
-    control.setupControl(true);
+  if (ota.isUpdate || appState.isStartWifi) {
+    return;
   }
 
-  ota.loop();
+  // Правки отдельных записей (PATCH /device) уже применены задачей управления:
+  // только дописать журнал, без паузы и переинициализации
+  if (!appState.isSaveControlRequest) {
+    deviceManager.savePatchedItems();
+    return;
+  }
 
-  if (!ota.isUpdate && !appState.isSaveControlRequest && !appState.isStartWifi && !appState.isProcessWorkingJson) {
-    control.loop();
+  if (saveTimer == 0) {
+    saveTimer = millis();
   }
 
-  if (settings.ws.isWifiTurnedOn) {
-    wifiManager.loop();
-    webServer.loop();
+  if (millis() - saveTimer >= 200) {
+    deviceManager.discardPatchedItems();
+    deviceManager.writeDevicesToFile(deviceManager.myDevices, DEVICE_CONFIG_PATH);
 
-    if (!ota.isUpdate && !deviceManager.isSaveControl && !appState.isStartWifi && timeModule.isInternetAvailable) {
-      telegramBot.loop();
-    }
+    saveTimer = 0;
+    Serial.println("Сохранение выполнено");
+
+    deviceManager.saveDeviceFlagsState(); // сохраняем флаги
+    deviceManager.deviceFlagsOff(); // сбрасываем в false
+    delay(100);
+    control.setupControl(true); // переинициализируем
+    delay(100);
+    deviceManager.restoreDeviceFlagsState(); // восстанавливаем флаги
+
+    deviceManager.isSaveControl = false;
+    appState.isSaveControlRequest = false;
+  }
+}
 
+void handleSaveWifi() {
+  if (!appState.isSaveWifiRequest || appState.isStartWifi) {
+    return;
   }
 
-  if (appState.isFormat) {
-    static unsigned long formatTimer = 0;
+  settings.saveSettings();
+  appState.isSaveWifiRequest = false;
 
-    if (formatTimer == 0) {
-      formatTimer = millis();
-    }
+  ControlCommand command;
+  command.type = CMD_REINIT_SENSORS;
+  deviceManager.bridge.post(command);
+}
 
-    if (millis() - formatTimer >= 1000) {
-      webServer.stop();
-      settings.format(true);
-      appState.isFormat = false;
-    }
+void handleFormat() {
+  static unsigned long formatTimer = 0;
+
+  if (!appState.isFormat) {
+    return;
   }
 
+  if (formatTimer == 0) {
+    formatTimer = millis();
+  }
+
+  if (millis() - formatTimer >= 1000) {
+    webServer.stop();
+    settings.format(true);
+    appState.isFormat = false;
+  }
+}
+
+void handleReboot() {
   if (appState.isReboot) {
+    deviceManager.history.flush();
     settings.reboot();
     appState.isReboot = false;
   }
-
-  delay(10);
 }
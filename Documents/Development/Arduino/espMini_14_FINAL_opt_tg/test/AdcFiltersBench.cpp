@@ -0,0 +1,48 @@
+#include "AdcFilters.h"
+#include "BenchCommon.h"
+
+// Стоимость добавления отсчёта и чтения каждого фильтра при разной длине окна.
+// push - в прерывании/задаче опроса, value() - при каждом readSensors.
+
+template<size_t N>
+static void benchWindow() {
+    AdcWindow<N> window;
+    window.clear();
+    uint32_t random = 1;
+    auto sample = [&random]() {
+        random = random * 1664525u + 1013904223u;
+        return (uint16_t)((random >> 8) % 3301);
+    };
+
+    const uint32_t pushes = benchIterations(2000000);
+    uint64_t start = benchNowNs();
+    for (uint32_t i = 0; i < pushes; i++) window.push(sample());
+    double pushNs = (double)(benchNowNs() - start) / pushes;
+    benchReport("AdcFiltersBench", "push", { { "n", (double)N }, { "ns_per_op", pushNs } });
+
+    struct { const char* name; AdcFilter filter; } filters[] = {
+        { "mean", ADC_FILTER_MEAN },
+        { "median", ADC_FILTER_MEDIAN },
+        { "ema", ADC_FILTER_EMA },
+        { "rms", ADC_FILTER_RMS },
+    };
+    const uint32_t reads = benchIterations(200000);
+    for (const auto& filter : filters) {
+        start = benchNowNs();
+        for (uint32_t i = 0; i < reads; i++) {
+            // Новый отсчёт между чтениями: медиана не должна попадать в кэш
+            window.push(sample());
+            benchKeep(window.value(filter.filter));
+        }
+        double ns = (double)(benchNowNs() - start) / reads - pushNs;
+        benchReport("AdcFiltersBench", filter.name, { { "n", (double)N }, { "ns_per_op", ns } });
+    }
+}
+
+int main(int argc, char** argv) {
+    benchInit(argc, argv);
+    benchWindow<16>();
+    benchWindow<32>();
+    benchWindow<64>();
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "AdcFilters.h"
+#include "TestCheck.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// Фильтры окна АЦП против прямого пересчёта по последним N отсчётам:
+// скользящие сумма и сумма квадратов не накапливают ошибку, медиана - точная.
+
+static const size_t N = 32;
+
+struct Reference {
+    std::vector<uint16_t> samples;
+
+    void push(uint16_t mv) {
+        samples.push_back(mv);
+        if (samples.size() > N) samples.erase(samples.begin());
+    }
+
+    double mean() const {
+        double sum = 0;
+        for (uint16_t v : samples) sum += v;
+        return sum / samples.size();
+    }
+
+    double rms() const {
+        double avg = mean();
+        double sum = 0;
+        for (uint16_t v : samples) sum += (v - avg) * (v - avg);
+        return sqrt(sum / samples.size());
+    }
+
+    double median() const {
+        std::vector<uint16_t> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        size_t middle = sorted.size() / 2;
+        if (sorted.size() & 1) return sorted[middle];
+        return (sorted[middle - 1] + sorted[middle]) / 2.0;
+    }
+};
+
+static void testEmpty() {
+    AdcWindow<N> window;
+    window.clear();
+    CHECK_EQ(window.count(), 0);
+    CHECK_NEAR(window.mean(), 0, 0);
+    CHECK_NEAR(window.median(), 0, 0);
+    CHECK_NEAR(window.rms(), 0, 0);
+}
+
+static void testAgainstReference() {
+    AdcWindow<N> window;
+    window.clear();
+    Reference reference;
+    uint32_t random = 7;
+
+    int mismatches = 0;
+    for (int i = 0; i < 100000; i++) {
+        random = random * 1664525u + 1013904223u;
+        // Полная шкала 0..3300 мВ, местами - выбросы к краям
+        uint16_t mv = (random >> 8) % 3301;
+        if (i % 97 == 0) mv = 3300;
+
+        window.push(mv);
+        reference.push(mv);
+
+        if (fabs(window.mean() - reference.mean()) > 1e-3) mismatches++;
+        if (fabs(window.median() - reference.median()) > 1e-6) mismatches++;
+        if (fabs(window.rms() - reference.rms()) > 0.05) mismatches++;
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK_EQ(window.count(), N);
+}
+
+static void testFilters() {
+    AdcWindow<N> window;
+    window.clear();
+
+    // Постоянный сигнал: все фильтры дают его, RMS переменной составляющей - 0
+    for (int i = 0; i < 100; i++) window.push(1650);
+    CHECK_NEAR(window.value(ADC_FILTER_MEAN), 1650, 1e-3);
+    CHECK_NEAR(window.value(ADC_FILTER_MEDIAN), 1650, 0);
+    CHECK_NEAR(window.value(ADC_FILTER_EMA), 1650, 1e-3);
+    CHECK_NEAR(window.value(ADC_FILTER_RMS), 0, 1e-3);
+
+    // Одиночный выброс: медиана его не видит, среднее сдвигается на 1/N
+    window.push(3300);
+    CHECK_NEAR(window.median(), 1650, 0);
+    CHECK_NEAR(window.mean(), 1650 + 1650.0 / N, 1e-3);
+
+    // EMA 1/16: после скачка за 16 отсчётов проходит ~64% пути
+    window.clear();
+    window.push(0);
+    for (int i = 0; i < 16; i++) window.push(1600);
+    double expected = 1600 * (1 - pow(1 - 1.0 / 16, 16));
+    CHECK_NEAR(window.ema(), expected, 5);
+
+    // Меандр 1000/2000 мВ: RMS переменной составляющей - половина размаха
+    window.clear();
+    for (size_t i = 0; i < N * 3; i++) window.push(i & 1 ? 2000 : 1000);
+    CHECK_NEAR(window.rms(), 500, 0.5);
+    CHECK_NEAR(window.median(), 1500, 0);
+}
+
+int main() {
+    testEmpty();
+    testAgainstReference();
+    testFilters();
+    return testResult("AdcFiltersTest");
+}
@@ -0,0 +1,50 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+#include <initializer_list>
+#include <utility>
+
+// Стенды производительности на хосте. Результат - по строке JSON на замер,
+// чтобы сравнивать прогоны скриптом:
+//   {"bench":"AdcFiltersBench","case":"median","n":64,"ns_per_op":41.2}
+// --quick - короткий прогон (так их запускает ctest: стенд собирается и не падает).
+// Абсолютные числа - хостовые; смысл имеют отношения между случаями.
+
+inline bool benchQuick = false;
+
+inline void benchInit(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) benchQuick = true;
+    }
+}
+
+// Число повторов: полное или сокращённое для --quick
+inline uint32_t benchIterations(uint32_t full) {
+    return benchQuick ? (full / 100 > 0 ? full / 100 : 1) : full;
+}
+
+inline uint64_t benchNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Не даёт компилятору выбросить вычисление
+inline volatile double benchSink = 0;
+template<typename T>
+inline void benchKeep(T value) { benchSink = benchSink + (double)value; }
+
+inline void benchReport(const char* bench, const char* name,
+                        std::initializer_list<std::pair<const char*, double>> fields) {
+    printf("{\"bench\":\"%s\",\"case\":\"%s\"", bench, name);
+    for (const auto& field : fields) {
+        printf(",\"%s\":%.6g", field.first, field.second);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include "Control.h"
+#include "HostHardware.h"
+#include "BenchCommon.h"
+
+// Стадии цикла управления на синтетических конфигурациях растущего размера:
+// readSensors, updatePins, setSensorActions, setSchedules, setTimersExecute,
+// setTemperature на модели платы и виртуальных часах. На стадию - время за
+// такт, выделения памяти за такт и пик кучи сверх уровня перед стадией.
+//   {"bench":"ControlScaleBench","case":"readSensors","relays":64,...,"ns_per_tick":420,"allocs_per_tick":0,...}
+// Выделения бывают только при переключениях (сообщения журнала); рост
+// allocs_per_tick с размером конфигурации - регрессия.
+
+namespace {
+
+// Счётчик кучи: размер блока - в заголовке перед ним
+size_t allocCount = 0;
+size_t liveBytes = 0;
+size_t peakBytes = 0;
+
+const size_t ALLOC_HEADER = 16;
+
+void* countedAlloc(size_t size) {
+    allocCount++;
+    liveBytes += size;
+    if (liveBytes > peakBytes) peakBytes = liveBytes;
+    size_t* block = (size_t*)malloc(size + ALLOC_HEADER);
+    if (!block) throw std::bad_alloc();
+    *block = size;
+    return (char*)block + ALLOC_HEADER;
+}
+
+void countedFree(void* ptr) {
+    if (!ptr) return;
+    size_t* block = (size_t*)((char*)ptr - ALLOC_HEADER);
+    liveBytes -= *block;
+    free(block);
+}
+
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { countedFree(ptr); }
+
+namespace {
+
+struct ConfigSize {
+    int relays;
+    int sensors;
+    int schedules;
+    int actions;
+};
+
+// Половина реле - выходы, остальные - входы сенсоров. Аналоговых сенсоров не
+// больше каналов АЦП, остальные - кнопки и виртуальные (выражения); часть
+// действий - с условием-выражением, к основному контуру - ещё две зоны.
+void buildDevice(DeviceManager& deviceManager, const ConfigSize& size) {
+    deviceManager.initializeDevice("Стенд", true);
+    Device& device = deviceManager.myDevices.back();
+
+    device.pins.clear();
+    for (int pin = 0; pin < size.relays; pin++) device.pins.push_back(pin);
+
+    Relay relayProto = device.relays[0];
+    device.relays.clear();
+    int outputs = size.relays / 2;
+    for (int i = 0; i < size.relays; i++) {
+        Relay relay = relayProto;
+        relay.id = i;
+        relay.pin = i;
+        relay.isOutput = i < outputs;
+        relay.manualMode = false;
+        relay.statePin = false;
+        relay.pwmRampMs = i % 4 == 3 ? 500 : 0;
+        snprintf(relay.description, MAX_DESCRIPTION_LENGTH, "Выход %d", i + 1);
+        device.relays.push_back(relay);
+    }
+
+    Sensor sensorProto = device.sensors[1];
+    device.sensors.clear();
+    int analogCount = 0;
+    for (int i = 0; i < size.sensors; i++) {
+        Sensor sensor = sensorProto;
+        sensor.isUseSetting = true;
+        sensor.sensorId = 100 + i;
+        sensor.relayId = outputs + (i % (size.relays - outputs));
+        sensor.typeSensor.clear();
+        if (i % 6 == 5) {
+            sensor.typeSensor.set(5, true);
+            sensor.expression = "(s100 + s101) / 2";
+        } else if (analogCount < ADC_MAX_CHANNELS) {
+            sensor.typeSensor.set(4, true);
+            analogCount++;
+        } else {
+            sensor.typeSensor.set(3, true);
+        }
+        snprintf(sensor.description, MAX_DESCRIPTION_LENGTH, "Сенсор %d", i + 1);
+        device.sensors.push_back(sensor);
+    }
+
+    Action actionProto = device.actions[0];
+    device.actions.clear();
+    for (int i = 0; i < size.actions; i++) {
+        Action action = actionProto;
+        action.isUseSetting = true;
+        action.targetSensorId = 100 + (i % size.sensors);
+        action.triggerValueMax = 80 + (i * 7) % 40;
+        action.triggerValueMin = action.triggerValueMax - 10;
+        action.outputs[0].relayId = i % outputs;
+        action.targetRelayId = i % 3 == 0 ? (i + 1) % outputs : -1;
+        action.relayMustBeOn = false;
+        if (i % 4 == 0) action.condition = "s100 > 90 && r1";
+        action.sendMsg = "";
+        snprintf(action.description, MAX_DESCRIPTION_LENGTH, "Действие %d", i + 1);
+        device.actions.push_back(action);
+    }
+
+    ScheduleScenario scheduleProto = device.scheduleScenarios[0];
+    device.scheduleScenarios.clear();
+    for (int i = 0; i < size.schedules; i++) {
+        ScheduleScenario scenario = scheduleProto;
+        scenario.isUseSetting = true;
+        scenario.startEndTimes.clear();
+        startEndTime interval;
+        snprintf(interval.startTime, sizeof interval.startTime, "%02d:%02d", i % 24, (i * 7) % 60);
+        snprintf(interval.endTime, sizeof interval.endTime, "%02d:%02d", (i + 3) % 24, (i * 11) % 60);
+        scenario.startEndTimes.push_back(interval);
+        snprintf(interval.startTime, sizeof interval.startTime, "%02d:%02d", (i + 12) % 24, (i * 3) % 60);
+        snprintf(interval.endTime, sizeof interval.endTime, "%02d:%02d", (i + 14) % 24, (i * 5) % 60);
+        scenario.startEndTimes.push_back(interval);
+        scenario.initialStateRelay.relayId = i % outputs;
+        scenario.endStateRelay.relayId = i % outputs;
+        scenario.endStateRelay.isUseSetting = true;
+        snprintf(scenario.description, MAX_DESCRIPTION_LENGTH, "Расписание %d", i + 1);
+        device.scheduleScenarios.push_back(scenario);
+    }
+
+    for (Timer& timer : device.timers) timer.isUseSetting = true;
+
+    device.temperature().isUseSetting = true;
+    device.temperature().sensorId = 100;
+    device.temperature().relayId = 0;
+    device.temperatures.resize(3, device.temperature());
+    device.temperatures[1].sensorId = 101;
+    device.temperatures[1].relayId = 1 % outputs;
+    device.temperatures[2].sensorId = 102;
+    device.temperatures[2].relayId = 2 % outputs;
+    device.temperatures[2].setTemperature = 42.5f;
+
+    device.isTimersEnabled = true;
+    device.isScheduleEnabled = true;
+    device.isActionEnabled = true;
+
+    deviceManager.compileDevice(device);
+}
+
+const char* const STAGE_NAMES[] = {
+    "readSensors", "updatePins", "setSensorActions", "setSchedules", "setTimersExecute", "setTemperature"
+};
+const int STAGE_COUNT = sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]);
+
+void runStage(Control& control, int stage) {
+    switch (stage) {
+        case 0: control.readSensors(); break;
+        case 1: control.updatePins(); break;
+        case 2: control.setSensorActions(); break;
+        case 3: control.setSchedules(); break;
+        case 4: control.setTimersExecute(); break;
+        case 5: control.setTemperature(); break;
+    }
+}
+
+void runSize(const ConfigSize& size, uint32_t ticks) {
+    HostHardware::reset(1709510400);   // 2024-03-04 00:00 UTC
+
+    size_t setupAllocs = allocCount;
+    size_t setupBase = liveBytes;
+    peakBytes = liveBytes;
+
+    AppState appState;
+    DeviceManager deviceManager(appState);
+    Logger logger;
+    buildDevice(deviceManager, size);
+    deviceManager.currentDeviceIndex = 0;
+    Control control(deviceManager, logger, appState);
+    control.setClock(HostHardware::nowMs, HostHardware::nowTime);
+    control.setupControl();
+
+    benchReport("ControlScaleBench", "setup", {
+        {"relays", (double)size.relays}, {"sensors", (double)size.sensors},
+        {"schedules", (double)size.schedules}, {"actions", (double)size.actions},
+        {"allocs", (double)(allocCount - setupAllocs)},
+        {"live_bytes", (double)(liveBytes - setupBase)},
+        {"peak_heap", (double)(peakBytes - setupBase)}});
+
+    uint64_t stageNs[STAGE_COUNT] = {};
+    size_t stageAllocs[STAGE_COUNT] = {};
+    size_t stagePeak[STAGE_COUNT] = {};
+    const int outputs = size.relays / 2;
+
+    // Такт 50 мс; аналоговые входы ходят вокруг порогов действий
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        for (int pin = outputs; pin < size.relays; pin++) {
+            HostHardware::setAnalogMv(pin, 900 + (tick * 7 + pin * 131) % 700);
+        }
+        HostHardware::advance(50);
+        control.updateAdc();
+
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            size_t allocsBefore = allocCount;
+            size_t liveBefore = liveBytes;
+            peakBytes = liveBytes;
+            uint64_t start = benchNowNs();
+            runStage(control, stage);
+            stageNs[stage] += benchNowNs() - start;
+            stageAllocs[stage] += allocCount - allocsBefore;
+            if (peakBytes - liveBefore > stagePeak[stage]) stagePeak[stage] = peakBytes - liveBefore;
+        }
+    }
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        benchReport("ControlScaleBench", STAGE_NAMES[stage], {
+            {"relays", (double)size.relays}, {"sensors", (double)size.sensors},
+            {"schedules", (double)size.schedules}, {"actions", (double)size.actions},
+            {"ns_per_tick", (double)stageNs[stage] / ticks},
+            {"allocs_per_tick", (double)stageAllocs[stage] / ticks},
+            {"peak_heap", (double)stagePeak[stage]}});
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    benchInit(argc, argv);
+    const ConfigSize sizes[] = {{8, 4, 12, 6}, {16, 8, 25, 12}, {32, 16, 50, 25}, {64, 32, 100, 50}};
+    uint32_t ticks = benchIterations(20000);
+    for (const ConfigSize& size : sizes) runSize(size, ticks);
+    return 0;
+}
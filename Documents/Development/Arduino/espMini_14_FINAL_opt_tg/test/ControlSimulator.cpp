@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Control.h"
+#include "DeviceConfigFile.h"
+#include "Scheduler.h"
+#include "HostHardware.h"
+#include <SPIFFS.h>
+
+// Симулятор платы: модули управления на модели железа (shims/) и виртуальных
+// часах. Сценарий задаёт входы и время и проверяет выходы:
+//
+//   start   2024-03-04 00:00:00      время загрузки, UTC; первой командой
+//   device  thermostat.json          конфигурация устройства (JSON интерфейса)
+//   step    1000                     шаг часов не меньше, мс (длинные прогоны)
+//   boot                             deviceInit, setupControl, задачи как в скетче
+//   analog  33 1200                  мВ на аналоговом входе
+//   dht     23 21.5 40 | dht 23 off  датчик DHT на пине
+//   input   4 0                      уровень цифрового входа
+//   relay   1 on|off|reset           команда реле, как из интерфейса
+//   run     90s | 15m | 2h | 7d      прогнать время
+//   expect  18 1                     уровень выхода
+//   expect_pwm 25 0.5 0.02           скважность ШИМ с допуском
+//   repeat 5 ... end                 повторить блок
+//
+// Код выхода: 0 - все expect сошлись, 1 - есть несовпадения, 2 - ошибка сценария.
+//   ControlSimulator scenarios/schedule_week.scn [--trace]
+// --trace - все проверки и вывод Serial прошивки.
+
+namespace {
+
+struct Line {
+    int number;
+    std::vector<std::string> words;
+};
+
+struct Board {
+    AppState appState;
+    DeviceManager deviceManager{appState};
+    Logger logger;
+    Control control{deviceManager, logger, appState};
+    Scheduler scheduler{HostHardware::nowMs, sleepMs};
+
+    // В прошивке управление не разбирается; датчики DHT сенсоры держат по указателю
+    ~Board() {
+        for (Device& device : deviceManager.myDevices) {
+            for (Sensor& sensor : device.sensors) {
+                delete sensor.dht;
+                sensor.dht = nullptr;
+            }
+        }
+    }
+
+    static void sleepMs(uint32_t ms) { HostHardware::advance(ms); }
+
+    // Задачи управления скетча (registerControlTasks); управление всегда разрешено
+    void registerTasks() {
+        scheduler.addTask("inputs",         10,   0, 9, [this]() { if (control.updateInputs(true)) control.updatePins(); });
+        scheduler.addTask("adcSampler",     20,   3, 8, [this]() { control.updateAdc(); });
+        scheduler.addTask("readSensors",   200,   0, 8, [this]() { if (control.readSensors()) control.updatePins(); });
+        scheduler.addTask("sensorActions", 250,   5, 7, [this]() { control.setSensorActions(); });
+        scheduler.addTask("updatePins",    250,   5, 6, [this]() { control.updatePins(); });
+        scheduler.addTask("pwmFade",        20,  15, 6, [this]() { control.updatePwm(); });
+        scheduler.addTask("readDht",        50,  50, 5, [this]() { if (control.readDhtSensors()) control.updatePins(); });
+        scheduler.addTask("schedules",    1000, 100, 4, [this]() { control.setSchedules(); });
+        scheduler.addTask("timers",       1000, 100, 4, [this]() { control.setTimersExecute(); });
+        scheduler.addTask("temperature",  1000, 100, 4, [this]() { control.setTemperature(); });
+        scheduler.addTask("history",  HISTORY_SAMPLE_MS, 500, 2, [this]() { control.recordHistory(); });
+    }
+
+    // Проход задачи управления (controlPass): команды, задачи по дедлайнам, снимок
+    uint32_t pass() {
+        if (control.processCommands(true)) control.updatePins();
+        deviceManager.publishConfig();
+        uint32_t wait = scheduler.runDue();
+        deviceManager.publishConfig();
+        deviceManager.publishSnapshot();
+        return wait;
+    }
+};
+
+class Simulator {
+public:
+    explicit Simulator(const std::string& path) : path(path) {
+        size_t slash = path.find_last_of('/');
+        directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    }
+
+    bool isTrace = false;
+
+    bool load() {
+        std::ifstream in(path);
+        if (!in) {
+            fprintf(stderr, "%s: не открывается\n", path.c_str());
+            return false;
+        }
+        std::string text;
+        for (int number = 1; std::getline(in, text); number++) {
+            size_t comment = text.find('#');
+            if (comment != std::string::npos) text.erase(comment);
+            std::istringstream words(text);
+            Line line = { number, {} };
+            for (std::string word; words >> word;) line.words.push_back(word);
+            if (!line.words.empty()) lines.push_back(line);
+        }
+        return true;
+    }
+
+    // Число ошибок; -1 - сценарий не разобран
+    int run() {
+        size_t end = 0;
+        if (!execute(0, lines.size(), end)) return -1;
+        printf("%s: %d проверок, %d ошибок, %.1f сут виртуального времени\n",
+               path.c_str(), checks, failures, HostHardware::nowMs() / 86400000.0);
+        return failures;
+    }
+
+private:
+    std::string path;
+    std::string directory;
+    std::vector<Line> lines;
+    std::unique_ptr<Board> board;
+    uint32_t minStepMs = 0;
+    bool isStarted = false;
+    int checks = 0;
+    int failures = 0;
+
+    bool fail(const Line& line, const char* message) {
+        fprintf(stderr, "%s:%d: %s\n", path.c_str(), line.number, message);
+        return false;
+    }
+
+    // Строки [from, to); repeat ... end - вложенный блок
+    bool execute(size_t from, size_t to, size_t& next) {
+        for (size_t i = from; i < to; i++) {
+            const Line& line = lines[i];
+            if (line.words[0] == "end") {
+                next = i;
+                return true;
+            }
+            if (line.words[0] == "repeat") {
+                if (line.words.size() != 2) return fail(line, "repeat <раз>");
+                int count = atoi(line.words[1].c_str());
+                size_t blockEnd = i + 1;
+                for (int pass = 0; pass < count; pass++) {
+                    if (!execute(i + 1, to, blockEnd)) return false;
+                }
+                if (blockEnd >= to) return fail(line, "repeat без end");
+                i = blockEnd;
+                continue;
+            }
+            if (!command(line)) return false;
+        }
+        next = to;
+        return true;
+    }
+
+    bool command(const Line& line) {
+        const std::vector<std::string>& w = line.words;
+        const std::string& name = w[0];
+
+        if (name == "start" && w.size() == 3) {
+            if (isStarted) return fail(line, "start - один раз, первой командой");
+            struct tm local = {};
+            if (!strptime((w[1] + " " + w[2]).c_str(), "%Y-%m-%d %H:%M:%S", &local)) return fail(line, "start ГГГГ-ММ-ДД чч:мм:сс");
+            HostHardware::reset(timegm(&local));
+            isStarted = true;
+            return true;
+        }
+        if (!isStarted) return fail(line, "сценарий начинается со start");
+
+        if (name == "device" && w.size() == 2) {
+            std::ifstream in(directory + w[1]);
+            if (!in) return fail(line, "файл устройства не открывается");
+            std::stringstream content;
+            content << in.rdbuf();
+            HostHardware::writeFile(DEVICE_CONFIG_LEGACY_PATH, content.str());
+            return true;
+        }
+        if (name == "step" && w.size() == 2) {
+            minStepMs = strtoul(w[1].c_str(), nullptr, 10);
+            return true;
+        }
+        if (name == "boot" && w.size() == 1) {
+            board.reset(new Board());
+            board->deviceManager.deviceInit();
+            // Разобранный devices.json переводится в devices.cfg и удаляется
+            if (SPIFFS.exists(DEVICE_CONFIG_LEGACY_PATH)) return fail(line, "devices.json не разобран");
+            board->control.setClock(HostHardware::nowMs, HostHardware::nowTime);
+            board->control.setupControl();
+            board->registerTasks();
+            return true;
+        }
+        if (name == "analog" && w.size() == 3) {
+            HostHardware::setAnalogMv(atoi(w[1].c_str()), atoi(w[2].c_str()));
+            return true;
+        }
+        if (name == "dht" && w.size() == 3 && w[2] == "off") {
+            HostHardware::setDht(atoi(w[1].c_str()), 0, 0, false);
+            return true;
+        }
+        if (name == "dht" && w.size() == 4) {
+            HostHardware::setDht(atoi(w[1].c_str()), atof(w[2].c_str()), atof(w[3].c_str()));
+            return true;
+        }
+        if (name == "input" && w.size() == 3) {
+            HostHardware::setInput(atoi(w[1].c_str()), atoi(w[2].c_str()) != 0);
+            return true;
+        }
+
+        if (!board) return fail(line, "до boot допустимы только start, device, step и входы");
+
+        if (name == "relay" && w.size() == 3) {
+            ControlCommand relayCommand;
+            if (w[2] == "on") relayCommand.type = CMD_RELAY_ON;
+            else if (w[2] == "off") relayCommand.type = CMD_RELAY_OFF;
+            else if (w[2] == "reset") relayCommand.type = CMD_RELAY_RESET;
+            else return fail(line, "relay <id> on|off|reset");
+            relayCommand.id = atoi(w[1].c_str());
+            board->deviceManager.bridge.post(relayCommand);
+            return true;
+        }
+        if (name == "run" && w.size() == 2) {
+            uint32_t duration;
+            if (!parseDuration(w[1], duration)) return fail(line, "run <число>ms|s|m|h|d");
+            runFor(duration);
+            return true;
+        }
+        if (name == "expect" && w.size() == 3) {
+            uint8_t pin = atoi(w[1].c_str());
+            bool expected = atoi(w[2].c_str()) != 0;
+            bool actual = HostHardware::outputLevel(pin);
+            check(line, actual == expected, "пин %d: ожидался %d, на выходе %d", pin, expected, actual);
+            return true;
+        }
+        if (name == "expect_pwm" && w.size() == 4) {
+            uint8_t pin = atoi(w[1].c_str());
+            float expected = atof(w[2].c_str());
+            float actual = HostHardware::pwmDuty(pin);
+            check(line, fabsf(actual - expected) <= atof(w[3].c_str()),
+                  "ШИМ пина %d: ожидалось %.3f, на выходе %.3f", pin, expected, actual);
+            return true;
+        }
+        return fail(line, "неизвестная команда или число аргументов");
+    }
+
+    // 90s, 15m, 7h58m: числа с единицами ms, s, m, h, d
+    static bool parseDuration(const std::string& text, uint32_t& ms) {
+        double total = 0;
+        const char* cursor = text.c_str();
+        while (*cursor) {
+            char* unit = nullptr;
+            double value = strtod(cursor, &unit);
+            if (unit == cursor || value < 0) return false;
+            size_t length = strspn(unit, "mshd");
+            std::string name(unit, length);
+            double scale;
+            if (name == "ms") scale = 1;
+            else if (name == "s") scale = 1000;
+            else if (name == "m") scale = 60000;
+            else if (name == "h") scale = 3600000;
+            else if (name == "d") scale = 86400000;
+            else return false;
+            total += value * scale;
+            cursor = unit + length;
+        }
+        if (total <= 0 || total > 40 * 86400000.0) return false;
+        ms = (uint32_t)total;
+        return true;
+    }
+
+    // Как задача управления: проход, затем сон до ближайшего дедлайна.
+    // Шаг не меньше minStepMs: задачи, пропустившие период, выполняются один раз.
+    void runFor(uint32_t duration) {
+        uint32_t until = HostHardware::nowMs() + duration;
+        while ((int32_t)(until - HostHardware::nowMs()) > 0) {
+            uint32_t wait = board->pass();
+            uint32_t left = until - HostHardware::nowMs();
+            uint32_t step = std::max(std::max(wait, minStepMs), (uint32_t)1);
+            HostHardware::advance(std::min(step, left));
+        }
+        board->pass();
+    }
+
+    void check(const Line& line, bool isOk, const char* format, ...) __attribute__((format(printf, 4, 5))) {
+        checks++;
+        if (isOk && !isTrace) return;
+
+        char message[160];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+
+        time_t now = HostHardware::nowTime();
+        struct tm local;
+        gmtime_r(&now, &local);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+        fprintf(isOk ? stdout : stderr, "%s:%d: [%s] %s%s\n", path.c_str(), line.number, stamp,
+                isOk ? "ok: " : "", message);
+        if (!isOk) failures++;
+    }
+};
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "ControlSimulator <сценарий.scn> [--trace]\n");
+        return 2;
+    }
+    // Расписания считаются в localtime: сценарии пишутся в UTC
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    Simulator simulator(argv[1]);
+    simulator.isTrace = argc > 2 && strcmp(argv[2], "--trace") == 0;
+    HostHardware::setSerialEcho(simulator.isTrace);
+    if (!simulator.load()) return 2;
+    int failures = simulator.run();
+    return failures < 0 ? 2 : (failures > 0 ? 1 : 0);
+}
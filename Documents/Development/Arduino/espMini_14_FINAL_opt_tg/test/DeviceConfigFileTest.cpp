@@ -0,0 +1,303 @@
+#include <memory>
+#include <string>
+#include "DeviceConfigFile.h"
+#include "DeviceJsonWriter.h"
+#include "HostHardware.h"
+#include "SPIFFS.h"
+#include "TestCheck.h"
+
+// Двоичная конфигурация на SPIFFS в памяти: запись и чтение без потерь,
+// порча любого байта и обрыв файла отклоняются без изменения загруженного,
+// после сбоя между удалением и переименованием читается path.tmp,
+// незнакомые секции и поля новой прошивки пропускаются по длине.
+
+namespace {
+
+const char* const PATH = "/devices.cfg";
+
+class StringPrint : public Print {
+public:
+    std::string text;
+    size_t write(uint8_t c) override { text += (char)c; return 1; }
+};
+
+// Устройство целиком - через JSON интерфейса: так сравниваются все поля
+std::string deviceJson(const Device& device) {
+    StringPrint out;
+    DeviceJsonWriter writer(std::make_shared<const Device>(device));
+    writer.writeTo(out);
+    return out.text;
+}
+
+std::string devicesJson(const std::vector<Device>& devices) {
+    std::string text;
+    for (const Device& device : devices) text += deviceJson(device) + "\n";
+    return text;
+}
+
+std::vector<Device> sampleDevices() {
+    AppState appState;
+    DeviceManager deviceManager(appState);
+    deviceManager.initializeDevice("Теплица", true, true);
+    deviceManager.initializeDevice("Котельная", false, true);
+
+    Device& first = deviceManager.myDevices[0];
+    first.relays[0].pwmRampMs = 750;
+    first.sensors[0].expression = "s100 * 2";
+    first.actions[0].condition = "s100 > 30 && r1";
+    first.actions[0].sendMsg = "Жарко";
+    first.temperature().setTemperature = 21.5f;
+    first.pids[0].Kp = 3.25;
+
+    Device& second = deviceManager.myDevices[1];
+    second.adcRateHz = ADC_MIN_RATE_HZ;
+    second.pins = { 4, 5, 12 };
+    second.temperatures.resize(2, second.temperature());
+    second.temperatures[1].sensorId = 7;
+    return deviceManager.myDevices;
+}
+
+// Заранее загруженное: read() с ошибкой не должен его трогать
+std::vector<Device> marker() {
+    std::vector<Device> devices(1);
+    strcpy(devices[0].nameDevice, "прежнее");
+    return devices;
+}
+
+std::string fileContent(const char* path) {
+    std::string content;
+    HostHardware::readFile(path, content);
+    return content;
+}
+
+void testRoundTrip() {
+    HostHardware::reset(1709510400);
+    std::vector<Device> devices = sampleDevices();
+    CHECK(DeviceConfigFile::write(devices, PATH));
+    CHECK(!SPIFFS.exists("/devices.cfg.tmp"));
+
+    std::vector<Device> loaded;
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK_EQ(loaded.size(), 2);
+    CHECK(devicesJson(loaded) == devicesJson(devices));
+}
+
+// Любой испорченный байт: CRC (или заголовок) не сходится
+void testCorruptByte() {
+    HostHardware::reset(1709510400);
+    CHECK(DeviceConfigFile::write(sampleDevices(), PATH));
+    const std::string original = fileContent(PATH);
+    const std::string before = devicesJson(marker());
+
+    for (size_t i = 0; i < original.size(); i++) {
+        std::string corrupt = original;
+        corrupt[i] ^= 0x20;
+        HostHardware::writeFile(PATH, corrupt);
+
+        std::vector<Device> devices = marker();
+        if (DeviceConfigFile::read(devices, PATH)) {
+            printf("accepted corrupt byte %u\n", (unsigned)i);
+            CHECK(false);
+            break;
+        }
+        CHECK(devicesJson(devices) == before);
+    }
+}
+
+// Файл, оборванный на любом байте, не загружается
+void testTruncated() {
+    HostHardware::reset(1709510400);
+    CHECK(DeviceConfigFile::write(sampleDevices(), PATH));
+    const std::string original = fileContent(PATH);
+    const std::string before = devicesJson(marker());
+
+    for (size_t length = 0; length < original.size(); length++) {
+        HostHardware::writeFile(PATH, original.substr(0, length));
+        std::vector<Device> devices = marker();
+        if (DeviceConfigFile::read(devices, PATH)) {
+            printf("accepted truncated file of %u bytes\n", (unsigned)length);
+            CHECK(false);
+            break;
+        }
+        CHECK(devicesJson(devices) == before);
+    }
+}
+
+// write(): path.tmp, удаление path, переименование. Сбой питания в любой
+// точке оставляет одну целую конфигурацию - прежнюю или новую.
+void testPowerCut() {
+    HostHardware::reset(1709510400);
+    std::vector<Device> oldDevices = sampleDevices();
+    std::vector<Device> newDevices = oldDevices;
+    strcpy(newDevices[0].nameDevice, "Новая");
+    newDevices.pop_back();
+
+    CHECK(DeviceConfigFile::write(newDevices, "/new.cfg"));
+    const std::string newFile = fileContent("/new.cfg");
+    CHECK(DeviceConfigFile::write(oldDevices, PATH));
+
+    // Сбой до удаления: .tmp записан, прежний файл на месте - читается он
+    HostHardware::writeFile("/devices.cfg.tmp", newFile);
+    std::vector<Device> loaded;
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) == devicesJson(oldDevices));
+
+    // Сбой посреди записи .tmp: обрывок не мешает
+    HostHardware::writeFile("/devices.cfg.tmp", newFile.substr(0, newFile.size() / 2));
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) == devicesJson(oldDevices));
+
+    // Сбой между удалением и переименованием: остался только .tmp
+    HostHardware::writeFile("/devices.cfg.tmp", newFile);
+    SPIFFS.remove(PATH);
+    loaded.clear();
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) == devicesJson(newDevices));
+
+    // Следующая запись приводит файлы в порядок
+    CHECK(DeviceConfigFile::write(loaded, PATH));
+    CHECK(SPIFFS.exists(PATH));
+    CHECK(!SPIFFS.exists("/devices.cfg.tmp"));
+    CHECK(fileContent(PATH) == newFile);
+
+    // Только обрывок .tmp - загружать нечего
+    SPIFFS.remove(PATH);
+    HostHardware::writeFile("/devices.cfg.tmp", newFile.substr(0, newFile.size() - 1));
+    std::vector<Device> devices = marker();
+    CHECK(!DeviceConfigFile::read(devices, PATH));
+    CHECK(devicesJson(devices) == devicesJson(marker()));
+}
+
+// Файл "новой прошивки", собранный по байтам
+class Bytes {
+public:
+    std::string data;
+
+    void u8(uint8_t value) { data += (char)value; }
+    void u16(uint16_t value) { u8(value); u8(value >> 8); }
+    void u32(uint32_t value) { u16(value); u16(value >> 16); }
+    void text(const char* value) {
+        u16(strlen(value));
+        data += value;
+    }
+    void raw(const std::string& bytes) { data += bytes; }
+
+    // Запись или секция: длина перед содержимым
+    void record16(const Bytes& body) { u16(body.data.size()); raw(body.data); }
+    void section(uint8_t tag, const Bytes& body) { u8(tag); u32(body.data.size()); raw(body.data); }
+};
+
+uint32_t crc32(const std::string& data) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (char c : data) {
+        crc ^= (uint8_t)c;
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+Bytes relayRecord(int32_t id, uint8_t pin, const char* description, bool isFull) {
+    Bytes relay;
+    relay.u32(id);
+    relay.u8(pin);
+    if (!isFull) return relay;   // запись старой прошивки: дальше полей нет
+    relay.u8(0x04);              // isOutput
+    relay.text(description);
+    relay.u32(5000);
+    relay.u8(10);
+    relay.u16(300);
+    return relay;
+}
+
+void testUnknownTagsAndFields() {
+    HostHardware::reset(1709510400);
+
+    Bytes head;
+    head.text("Гость");
+    head.u8(1);
+    head.u16(ADC_MIN_RATE_HZ + 5);
+    head.u8(0x05);               // таймеры и расписания включены
+    head.u32(0xDEADBEEF);        // поле новой прошивки
+
+    Bytes relays;
+    relays.u16(3);
+    Bytes first = relayRecord(1, 16, "Насос", true);
+    first.raw("\x01\x02\x03");   // поля новой прошивки в конце записи
+    relays.record16(first);
+    relays.record16(relayRecord(2, 17, "", false));
+    relays.record16(relayRecord(3, 18, "Клапан", true));
+
+    Bytes unknown;
+    unknown.raw(std::string("\x00\x01\x02\x03\x04\x05\x06", 7));
+
+    Bytes file;
+    file.raw("ESPD");
+    file.u16(DEVICE_CONFIG_VERSION);
+    file.u8(1);
+    file.section(1, head);
+    file.section(200, unknown);  // секция с незнакомым тегом
+    file.section(3, relays);
+    file.u8(0);
+    file.u32(crc32(file.data));
+    HostHardware::writeFile(PATH, file.data);
+
+    std::vector<Device> devices;
+    CHECK(DeviceConfigFile::read(devices, PATH));
+    CHECK_EQ(devices.size(), 1);
+    if (devices.size() != 1) return;
+
+    const Device& device = devices[0];
+    const Device defaults = Device();
+    CHECK_STR(device.nameDevice, "Гость");
+    CHECK(device.isSelected);
+    CHECK_EQ(device.adcRateHz, ADC_MIN_RATE_HZ + 5);
+    CHECK(device.isTimersEnabled);
+    CHECK(!device.isEncyclateTimers);
+    CHECK(device.isScheduleEnabled);
+    CHECK(!device.isActionEnabled);
+
+    CHECK_EQ(device.relays.size(), 3);
+    if (device.relays.size() == 3) {
+        CHECK_EQ(device.relays[0].id, 1);
+        CHECK_EQ(device.relays[0].pin, 16);
+        CHECK(device.relays[0].isOutput);
+        CHECK_STR(device.relays[0].description, "Насос");
+        CHECK_EQ(device.relays[0].pwmFrequency, 5000);
+        CHECK_EQ(device.relays[0].pwmRampMs, 300);
+
+        // Короткая запись: недостающие поля нулевые, соседи не сдвинуты
+        CHECK_EQ(device.relays[1].id, 2);
+        CHECK_EQ(device.relays[1].pin, 17);
+        CHECK_STR(device.relays[1].description, "");
+        CHECK_EQ(device.relays[1].pwmFrequency, 0);
+
+        CHECK_EQ(device.relays[2].id, 3);
+        CHECK_EQ(device.relays[2].pin, 18);
+        CHECK_STR(device.relays[2].description, "Клапан");
+        CHECK_EQ(device.relays[2].pwmRampMs, 300);
+    }
+
+    // Секций нет в файле - списки по умолчанию
+    CHECK_EQ(device.sensors.size(), defaults.sensors.size());
+    CHECK_EQ(device.timers.size(), defaults.timers.size());
+    CHECK_EQ(device.temperatures.size(), defaults.temperatures.size());
+
+    // Неизвестная версия формата не читается
+    std::string future = file.data;
+    future[4] = DEVICE_CONFIG_VERSION + 1;
+    HostHardware::writeFile(PATH, future);
+    devices = marker();
+    CHECK(!DeviceConfigFile::read(devices, PATH));
+    CHECK_STR(devices[0].nameDevice, "прежнее");
+}
+
+}
+
+int main() {
+    testRoundTrip();
+    testCorruptByte();
+    testTruncated();
+    testPowerCut();
+    testUnknownTagsAndFields();
+    return testResult("DeviceConfigFileTest");
+}
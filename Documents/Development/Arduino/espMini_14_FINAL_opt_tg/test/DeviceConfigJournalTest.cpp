@@ -0,0 +1,328 @@
+#include <memory>
+#include <string>
+#include "DeviceConfigFile.h"
+#include "DeviceJsonWriter.h"
+#include "HostHardware.h"
+#include "SPIFFS.h"
+#include "TestCheck.h"
+
+// Журнал правок devices.cfg.jnl на SPIFFS в памяти: оборванный хвост
+// отбрасывается и журнал сворачивается, журнал от другого файла
+// пропускается, на 4 КБ запись правки отказывает и идёт полная запись,
+// переполнение очереди правок в DeviceManager - тоже полная запись; снимок
+// конфигурации копируется заново только после правки её полей.
+
+namespace {
+
+const char* const PATH = "/devices.cfg";
+const char* const JOURNAL_PATH = "/devices.cfg.jnl";
+
+class StringPrint : public Print {
+public:
+    std::string text;
+    size_t write(uint8_t c) override { text += (char)c; return 1; }
+};
+
+std::string devicesJson(const std::vector<Device>& devices) {
+    std::string text;
+    for (const Device& device : devices) {
+        StringPrint out;
+        DeviceJsonWriter writer(std::make_shared<const Device>(device));
+        writer.writeTo(out);
+        text += out.text + "\n";
+    }
+    return text;
+}
+
+std::string fileContent(const char* path) {
+    std::string content;
+    HostHardware::readFile(path, content);
+    return content;
+}
+
+std::vector<Device> sampleDevices() {
+    AppState appState;
+    DeviceManager deviceManager(appState);
+    deviceManager.initializeDevice("Теплица", true, true);
+    deviceManager.initializeDevice("Котельная", false, true);
+    return deviceManager.myDevices;
+}
+
+// Правка в памяти и в журнал, как после PATCH /device
+bool patchRelay(std::vector<Device>& devices, size_t deviceIndex, size_t relayIndex, int number) {
+    Relay& relay = devices[deviceIndex].relays[relayIndex];
+    snprintf(relay.description, MAX_DESCRIPTION_LENGTH, "Правка %d", number);
+    relay.pwmRampMs = number;
+    return DeviceConfigFile::writeItem(devices[deviceIndex], deviceIndex, PATCH_RELAY, relayIndex, PATH);
+}
+
+bool patchSchedule(std::vector<Device>& devices, size_t deviceIndex, size_t index, const char* start) {
+    ScheduleScenario& scenario = devices[deviceIndex].scheduleScenarios[index];
+    strcpy(scenario.startEndTimes[0].startTime, start);
+    return DeviceConfigFile::writeItem(devices[deviceIndex], deviceIndex, PATCH_SCHEDULE, index, PATH);
+}
+
+void testReplay() {
+    HostHardware::reset(1709510400);
+    std::vector<Device> devices = sampleDevices();
+    CHECK(DeviceConfigFile::write(devices, PATH));
+    const std::string base = fileContent(PATH);
+
+    CHECK(patchRelay(devices, 0, 0, 100));
+    CHECK(patchRelay(devices, 1, 1, 200));
+    CHECK(patchSchedule(devices, 0, 0, "06:15"));
+    CHECK(patchRelay(devices, 0, 0, 300));   // повтор той же записи: действует последняя
+    CHECK(SPIFFS.exists(JOURNAL_PATH));
+    CHECK(fileContent(PATH) == base);        // файл конфигурации не переписывается
+
+    std::vector<Device> loaded;
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) == devicesJson(devices));
+    CHECK(SPIFFS.exists(JOURNAL_PATH));
+
+    // Полная запись включает правки и удаляет журнал
+    CHECK(DeviceConfigFile::write(devices, PATH));
+    CHECK(!SPIFFS.exists(JOURNAL_PATH));
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) == devicesJson(devices));
+
+    // Без файла конфигурации журналу не к чему привязаться
+    SPIFFS.remove(PATH);
+    CHECK(!patchRelay(devices, 0, 0, 400));
+    CHECK(!SPIFFS.exists(JOURNAL_PATH));
+}
+
+// Сбой питания посреди дописывания: последняя запись оборвана на любом
+// байте или испорчена - применяются предыдущие, журнал сворачивается
+void testTornTail() {
+    HostHardware::reset(1709510400);
+    std::vector<Device> devices = sampleDevices();
+    CHECK(DeviceConfigFile::write(devices, PATH));
+    const std::string base = fileContent(PATH);
+
+    CHECK(patchRelay(devices, 0, 0, 11));
+    CHECK(patchRelay(devices, 0, 1, 12));
+    const std::string beforeLast = fileContent(JOURNAL_PATH);
+    const std::string expected = devicesJson(devices);
+    CHECK(patchRelay(devices, 0, 2, 13));
+    const std::string journal = fileContent(JOURNAL_PATH);
+    CHECK(journal.size() > beforeLast.size());
+
+    for (size_t length = beforeLast.size(); length < journal.size(); length++) {
+        HostHardware::writeFile(PATH, base);
+        HostHardware::writeFile(JOURNAL_PATH, journal.substr(0, length));
+        std::vector<Device> loaded;
+        CHECK(DeviceConfigFile::read(loaded, PATH));
+        if (devicesJson(loaded) != expected) {
+            printf("torn journal of %u bytes\n", (unsigned)length);
+            CHECK(false);
+            break;
+        }
+        // Целый хвост (length == beforeLast) не оборван: журнал остаётся
+        if (length > beforeLast.size()) {
+            CHECK(!SPIFFS.exists(JOURNAL_PATH));
+            std::vector<Device> reloaded;
+            CHECK(DeviceConfigFile::read(reloaded, PATH));
+            CHECK(devicesJson(reloaded) == expected);
+        }
+    }
+
+    for (size_t i = beforeLast.size(); i < journal.size(); i++) {
+        std::string corrupt = journal;
+        corrupt[i] ^= 0x01;
+        HostHardware::writeFile(PATH, base);
+        HostHardware::writeFile(JOURNAL_PATH, corrupt);
+        std::vector<Device> loaded;
+        CHECK(DeviceConfigFile::read(loaded, PATH));
+        if (devicesJson(loaded) != expected) {
+            printf("corrupt journal byte %u applied\n", (unsigned)i);
+            CHECK(false);
+            break;
+        }
+    }
+}
+
+// Файл конфигурации заменён (загрузка через /uploadFile, сбой при подмене):
+// журнал от прежнего файла не накладывается и начинается заново
+void testStaleBase() {
+    HostHardware::reset(1709510400);
+    std::vector<Device> devices = sampleDevices();
+    CHECK(DeviceConfigFile::write(devices, PATH));
+    CHECK(patchRelay(devices, 0, 0, 21));
+    CHECK(patchRelay(devices, 0, 1, 22));
+
+    std::vector<Device> uploaded = sampleDevices();
+    strcpy(uploaded[0].nameDevice, "Загруженная");
+    CHECK(DeviceConfigFile::write(uploaded, "/upload.cfg"));
+    HostHardware::writeFile(PATH, fileContent("/upload.cfg"));
+    CHECK(SPIFFS.exists(JOURNAL_PATH));
+
+    std::vector<Device> loaded;
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) == devicesJson(uploaded));
+
+    const size_t staleSize = fileContent(JOURNAL_PATH).size();
+    CHECK(patchRelay(uploaded, 0, 3, 23));
+    CHECK(fileContent(JOURNAL_PATH).size() < staleSize);
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) == devicesJson(uploaded));
+}
+
+// Журнал не растёт дальше DEVICE_CONFIG_JOURNAL_MAX: writeItem отказывает,
+// вызывающий пишет конфигурацию целиком
+void testCompaction() {
+    HostHardware::reset(1709510400);
+    std::vector<Device> devices = sampleDevices();
+    CHECK(DeviceConfigFile::write(devices, PATH));
+
+    int accepted = 0;
+    while (patchRelay(devices, 0, accepted % devices[0].relays.size(), 1000 + accepted)) {
+        accepted++;
+        if (accepted > 1000) break;
+    }
+    size_t journalSize = fileContent(JOURNAL_PATH).size();
+    CHECK(accepted > 50);
+    CHECK(journalSize >= DEVICE_CONFIG_JOURNAL_MAX);
+    CHECK(journalSize < DEVICE_CONFIG_JOURNAL_MAX + 128);   // не больше одной записи сверх предела
+
+    // Отказанная правка в журнал не попала, но есть в памяти
+    std::vector<Device> loaded;
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) != devicesJson(devices));
+
+    CHECK(DeviceConfigFile::write(devices, PATH));
+    CHECK(!SPIFFS.exists(JOURNAL_PATH));
+    CHECK(DeviceConfigFile::read(loaded, PATH));
+    CHECK(devicesJson(loaded) == devicesJson(devices));
+    CHECK(patchRelay(devices, 0, 0, 1));
+}
+
+// Через DeviceManager: CMD_PATCH_ITEM, снимок, savePatchedItems
+struct Station {
+    AppState appState;
+    DeviceManager deviceManager{appState};
+
+    Station() {
+        deviceManager.initializeDevice("Теплица", true, true);
+        deviceManager.initializeDevice("Котельная", false, true);
+        deviceManager.currentDeviceIndex = 0;
+        deviceManager.writeDevicesToFile(deviceManager.myDevices, PATH);
+        deviceManager.markConfigChanged();
+        deviceManager.publishConfig();
+    }
+
+    void patch(size_t index, int number) {
+        Device& device = deviceManager.myDevices[deviceManager.currentDeviceIndex];
+        Relay* relay = static_cast<Relay*>(DeviceManager::copyItem(device, PATCH_RELAY, index));
+        snprintf(relay->description, MAX_DESCRIPTION_LENGTH, "Пульт %d", number);
+        ControlCommand command;
+        command.type = CMD_PATCH_ITEM;
+        command.field = PATCH_RELAY;
+        command.id = index;
+        command.number = relay->id;
+        command.payload = relay;
+        deviceManager.applyCommand(command);
+    }
+
+    // Такт задачи управления: снимок после команд, затем saveControl
+    void save() {
+        deviceManager.publishConfig();
+        deviceManager.savePatchedItems();
+    }
+
+    bool fileMatches() {
+        std::vector<Device> loaded;
+        return DeviceConfigFile::read(loaded, PATH) && devicesJson(loaded) == devicesJson(deviceManager.myDevices);
+    }
+};
+
+void testPatchQueue() {
+    HostHardware::reset(1709510400);
+    Station station;
+    const std::string base = fileContent(PATH);
+
+    // Очередь вмещает все правки такта: только журнал
+    for (int i = 0; i < PATCHED_QUEUE_SIZE; i++) station.patch(i % 4, i);
+    station.save();
+    CHECK(SPIFFS.exists(JOURNAL_PATH));
+    CHECK(fileContent(PATH) == base);
+    CHECK(station.fileMatches());
+
+    // Правка сверх очереди потеряна для журнала: полная запись, журнал удалён
+    for (int i = 0; i <= PATCHED_QUEUE_SIZE; i++) station.patch(i % 4, 100 + i);
+    CHECK(station.deviceManager.bridge.isPatchedLost);
+    station.save();
+    CHECK(!station.deviceManager.bridge.isPatchedLost);
+    CHECK(!SPIFFS.exists(JOURNAL_PATH));
+    CHECK(fileContent(PATH) != base);
+    CHECK(station.fileMatches());
+
+    // Дальше - снова журнал
+    station.patch(2, 500);
+    station.save();
+    CHECK(SPIFFS.exists(JOURNAL_PATH));
+    CHECK(station.fileMatches());
+}
+
+// Журнал на пределе: savePatchedItems сам переходит на полную запись
+void testPatchCompaction() {
+    HostHardware::reset(1709510400);
+    Station station;
+
+    bool wasCompacted = false;
+    size_t largest = 0;
+    for (int i = 0; i < 400 && !wasCompacted; i++) {
+        station.patch(i % 4, i);
+        station.save();
+        size_t size = fileContent(JOURNAL_PATH).size();
+        wasCompacted = largest > 0 && size < largest;
+        if (size > largest) largest = size;
+        CHECK(station.fileMatches());
+    }
+    CHECK(wasCompacted);
+    CHECK(largest >= DEVICE_CONFIG_JOURNAL_MAX);
+}
+
+// Снимок публикуется заново только после правки конфигурации: команды реле
+// и промахи по индексу его не копируют
+void testSnapshotRepublish() {
+    HostHardware::reset(1709510400);
+    Station station;
+    DeviceManager& deviceManager = station.deviceManager;
+    auto apply = [&deviceManager](ControlCommandType type, uint8_t field, uint8_t id, bool value) {
+        ControlCommand command;
+        command.type = type;
+        command.field = field;
+        command.id = id;
+        command.value = value;
+        deviceManager.applyCommand(command);
+        std::shared_ptr<const DeviceConfigSnapshot> before = deviceManager.configSnapshot();
+        deviceManager.publishConfig();
+        return deviceManager.configSnapshot() != before;
+    };
+
+    const uint8_t relayId = deviceManager.myDevices[0].relays[0].id;
+    CHECK(!apply(CMD_RELAY_ON, 0, relayId, false));
+    CHECK(!apply(CMD_RELAY_OFF, 0, relayId, false));
+    CHECK(!apply(CMD_RELAY_RESET_ALL, 0, 0, false));
+    CHECK(!apply(CMD_SET_ITEM, ITEM_RELAY_STATE, 0, true));
+    CHECK(!apply(CMD_SET_ITEM, ITEM_ACTION_USE, 200, true));
+    CHECK(!apply(CMD_SET_PID_KP, 0, 200, false));
+
+    CHECK(apply(CMD_SET_ITEM, ITEM_ACTION_USE, 0, false));
+    CHECK(!deviceManager.configSnapshot()->device.actions[0].isUseSetting);
+    CHECK(apply(CMD_SET_FLAG, FLAG_TIMERS, 0, true));
+}
+
+}
+
+int main() {
+    testReplay();
+    testTornTail();
+    testStaleBase();
+    testCompaction();
+    testPatchQueue();
+    testPatchCompaction();
+    testSnapshotRepublish();
+    return testResult("DeviceConfigJournalTest");
+}
@@ -0,0 +1,79 @@
+#include "Control.h"
+#include "HostHardware.h"
+#include "TestCheck.h"
+
+// Состояние исполнения устройств при изменении списка: добавленное
+// устройство не сбрасывает идущий шаг таймера у прежних, у убранного
+// взведённый шаг снимается и не приходит.
+
+namespace {
+
+struct Station {
+    AppState appState;
+    DeviceManager deviceManager{appState};
+    Logger logger;
+    Control control{deviceManager, logger, appState};
+
+    Station() {
+        deviceManager.initializeDevice("Теплица", true, true);
+        deviceManager.myDevices[0].isTimersEnabled = true;   // один шаг 00:00:05
+        deviceManager.myDevices[0].isEncyclateTimers = false;
+        deviceManager.currentDeviceIndex = 0;
+        control.setClock(HostHardware::nowMs, HostHardware::nowTime);
+        control.setupControl();
+    }
+
+    void tick(uint32_t ms) {
+        HostHardware::advance(ms);
+        control.processCommands(true);
+        control.setTimersExecute();
+    }
+
+    TimerInfo& progress(size_t device) { return deviceManager.myDevices[device].timers[0].progress; }
+};
+
+void testDeviceAdded() {
+    HostHardware::reset(1709510400);
+    Station station;
+    station.tick(0);
+    CHECK(station.progress(0).isRunning);
+    const unsigned long startedAt = station.progress(0).startedAt;
+
+    station.tick(2000);
+    station.deviceManager.initializeDevice("Котельная", false, true);
+    station.tick(100);
+    CHECK(station.progress(0).isRunning);
+    CHECK_EQ(station.progress(0).startedAt, startedAt);
+
+    // Шаг заканчивается в срок, а не через 5 с после добавления
+    station.tick(2950);
+    CHECK(!station.progress(0).isRunning);
+    CHECK(station.progress(0).isStopped);
+}
+
+void testDeviceRemoved() {
+    HostHardware::reset(1709510400);
+    Station station;
+    station.deviceManager.initializeDevice("Котельная", false, true);
+    station.deviceManager.myDevices[1].isTimersEnabled = true;
+    station.deviceManager.liveDevices.push_back(1);
+    station.tick(0);
+    CHECK(station.progress(1).isRunning);
+
+    // Последнее устройство убрано посреди шага: его срок в очередь не попадает
+    station.deviceManager.myDevices.pop_back();
+    station.deviceManager.liveDevices.pop_back();
+    station.tick(100);
+    station.tick(6000);
+    CHECK(station.progress(0).isStopped);
+    ControlCommand command;
+    CHECK(!station.deviceManager.bridge.commands.pop(command));
+}
+
+}
+
+int main() {
+    testDeviceAdded();
+    testDeviceRemoved();
+    return testResult("DeviceRuntimeTest");
+}
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include "Control.h"
+#include "HostHardware.h"
+#include "BenchCommon.h"
+
+// Режим нескольких устройств: 1, 2, 4 и 8 одинаковых устройств на
+// непересекающихся пинах работают одновременно. Время такта должно расти
+// линейно, время на устройство - оставаться тем же:
+//   {"bench":"DeviceScalingBench","case":"devices","devices":4,"live":4,"ns_per_tick":1000,"ns_per_device":250}
+// Последняя строка - отношение времени на устройство при 8 и при 1.
+
+namespace {
+
+const int RELAYS_PER_DEVICE = 8;
+
+// Устройство на пинах base..base+7: 4 выхода, 4 входа; аналоговый сенсор,
+// виртуальный и две кнопки; действия, расписания, таймеры и контур температуры
+void addDevice(DeviceManager& deviceManager, int index) {
+    char name[MAX_DESCRIPTION_LENGTH];
+    snprintf(name, sizeof(name), "Устройство %d", index + 1);
+    deviceManager.initializeDevice(name, index == 0, true);
+    Device& device = deviceManager.myDevices.back();
+
+    int base = index * RELAYS_PER_DEVICE;
+    int outputs = RELAYS_PER_DEVICE / 2;
+    device.pins.clear();
+    for (int pin = 0; pin < OUTPUT_MAX_PINS; pin++) device.pins.push_back(pin);
+
+    Relay relayProto = device.relays[0];
+    device.relays.clear();
+    for (int i = 0; i < RELAYS_PER_DEVICE; i++) {
+        Relay relay = relayProto;
+        relay.id = i;
+        relay.pin = base + i;
+        relay.isOutput = i < outputs;
+        relay.manualMode = false;
+        relay.statePin = false;
+        snprintf(relay.description, MAX_DESCRIPTION_LENGTH, "Выход %d", i + 1);
+        device.relays.push_back(relay);
+    }
+
+    Sensor sensorProto = device.sensors[1];
+    device.sensors.clear();
+    for (int i = 0; i < RELAYS_PER_DEVICE - outputs; i++) {
+        Sensor sensor = sensorProto;
+        sensor.isUseSetting = true;
+        sensor.sensorId = 100 + i;
+        sensor.relayId = outputs + i;
+        sensor.typeSensor.clear();
+        if (i == 0) {
+            sensor.typeSensor.set(4, true);
+        } else if (i == 1) {
+            sensor.typeSensor.set(5, true);
+            sensor.expression = "s100 * 2";
+        } else {
+            sensor.typeSensor.set(3, true);
+        }
+        snprintf(sensor.description, MAX_DESCRIPTION_LENGTH, "Сенсор %d", i + 1);
+        device.sensors.push_back(sensor);
+    }
+
+    Action actionProto = device.actions[0];
+    device.actions.clear();
+    for (int i = 0; i < 4; i++) {
+        Action action = actionProto;
+        action.isUseSetting = true;
+        action.targetSensorId = 100 + i % 2;
+        action.triggerValueMax = 80 + i * 20;
+        action.triggerValueMin = action.triggerValueMax - 10;
+        action.outputs[0].relayId = i % outputs;
+        action.targetRelayId = -1;
+        action.relayMustBeOn = false;
+        if (i == 3) action.condition = "s100 > 90 && r1";
+        action.sendMsg = "";
+        snprintf(action.description, MAX_DESCRIPTION_LENGTH, "Действие %d", i + 1);
+        device.actions.push_back(action);
+    }
+
+    ScheduleScenario scheduleProto = device.scheduleScenarios[0];
+    device.scheduleScenarios.clear();
+    for (int i = 0; i < 4; i++) {
+        ScheduleScenario scenario = scheduleProto;
+        scenario.isUseSetting = true;
+        scenario.startEndTimes.clear();
+        startEndTime interval;
+        snprintf(interval.startTime, sizeof interval.startTime, "%02d:%02d", i * 6, 0);
+        snprintf(interval.endTime, sizeof interval.endTime, "%02d:%02d", i * 6 + 2, 30);
+        scenario.startEndTimes.push_back(interval);
+        scenario.initialStateRelay.relayId = i % outputs;
+        scenario.endStateRelay.relayId = i % outputs;
+        scenario.endStateRelay.isUseSetting = true;
+        snprintf(scenario.description, MAX_DESCRIPTION_LENGTH, "Расписание %d", i + 1);
+        device.scheduleScenarios.push_back(scenario);
+    }
+
+    for (Timer& timer : device.timers) timer.isUseSetting = true;
+
+    device.temperature().isUseSetting = true;
+    device.temperature().sensorId = 100;
+    device.temperature().relayId = 0;
+
+    device.isTimersEnabled = true;
+    device.isScheduleEnabled = true;
+    device.isActionEnabled = true;
+
+    deviceManager.compileDevice(device);
+}
+
+// Время такта (стадии скетча подряд) на n устройствах; 0 - запустились не все
+double runDevices(int count, uint32_t ticks) {
+    HostHardware::reset(1709510400);   // 2024-03-04 00:00 UTC
+
+    AppState appState;
+    DeviceManager deviceManager(appState);
+    Logger logger;
+    for (int i = 0; i < count; i++) addDevice(deviceManager, i);
+    deviceManager.currentDeviceIndex = 0;
+    deviceManager.isMultiDevice = true;
+    Control control(deviceManager, logger, appState);
+    control.setClock(HostHardware::nowMs, HostHardware::nowTime);
+    control.setupControl();
+
+    size_t live = deviceManager.liveDevices.size();
+    uint64_t elapsedNs = 0;
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        for (int i = 0; i < count; i++) {
+            HostHardware::setAnalogMv(i * RELAYS_PER_DEVICE + RELAYS_PER_DEVICE / 2, 900 + (tick * 7 + i * 131) % 700);
+        }
+        HostHardware::advance(50);
+        control.updateAdc();
+
+        uint64_t start = benchNowNs();
+        control.readSensors();
+        control.setSensorActions();
+        control.setTemperature();
+        control.setTimersExecute();
+        control.setSchedules();
+        control.updatePins();
+        elapsedNs += benchNowNs() - start;
+    }
+
+    double nsPerTick = (double)elapsedNs / ticks;
+    benchReport("DeviceScalingBench", "devices", {
+        {"devices", (double)count}, {"live", (double)live},
+        {"ns_per_tick", nsPerTick}, {"ns_per_device", nsPerTick / count}});
+    return live == (size_t)count ? nsPerTick / count : 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    benchInit(argc, argv);
+    uint32_t ticks = benchIterations(20000);
+
+    double firstPerDevice = 0;
+    double lastPerDevice = 0;
+    for (int count : {1, 2, 4, 8}) {
+        double perDevice = runDevices(count, ticks);
+        if (perDevice == 0) {
+            printf("FAIL: %d devices on disjoint pins did not all start\n", count);
+            return 1;
+        }
+        if (firstPerDevice == 0) firstPerDevice = perDevice;
+        lastPerDevice = perDevice;
+    }
+
+    benchReport("DeviceScalingBench", "scaling", {{"per_device_ratio_8_to_1", lastPerDevice / firstPerDevice}});
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "DhtFrame.h"
+#include "TestCheck.h"
+#include <stdint.h>
+#include <vector>
+
+// Разбор кадра DHT по длительностям уровней. Кадры синтетические: времена из
+// документации на DHT11/DHT22 (ответ 80/80 мкс, бит - низкий ~50 мкс, высокий
+// 26-28 мкс для 0 и ~70 мкс для 1) с детерминированным разбросом, в том виде,
+// в каком их отдаёт захват: хвост стартового импульса, затем уровни по порядку.
+
+struct Jitter {
+    uint32_t state = 12345;
+    // Равномерно в [-spread, spread]
+    int next(int spread) {
+        state = state * 1103515245u + 12345u;
+        return (int)((state >> 16) % (2 * spread + 1)) - spread;
+    }
+};
+
+struct FrameTiming {
+    int bitLowUs = 50;
+    int zeroHighUs = 27;
+    int oneHighUs = 70;
+    int spreadUs = 0;
+    bool hasHostRelease = true;   // линия отпущена хостом, до ответа датчика
+    bool hasIdleHigh = false;     // записан и высокий после кадра; RMT обрывает кадр на тишине без него
+};
+
+static std::vector<DhtEdge> makeFrame(const uint8_t data[5], const FrameTiming& timing, Jitter& jitter) {
+    std::vector<DhtEdge> edges;
+    auto add = [&](uint8_t level, int us) {
+        int duration = us + (timing.spreadUs ? jitter.next(timing.spreadUs) : 0);
+        edges.push_back({ level, (uint16_t)duration });
+    };
+
+    if (timing.hasHostRelease) add(1, 30);
+    add(0, 80);
+    add(1, 80);
+    for (int bit = 0; bit < DHT_FRAME_BITS; bit++) {
+        bool isOne = data[bit / 8] & (0x80 >> (bit % 8));
+        add(0, timing.bitLowUs);
+        add(1, isOne ? timing.oneHighUs : timing.zeroHighUs);
+    }
+    add(0, 50);   // датчик отпускает линию после последнего бита
+    if (timing.hasIdleHigh) add(1, 200);
+    return edges;
+}
+
+static void withChecksum(uint8_t data[5]) {
+    data[4] = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+}
+
+static void testDht22() {
+    Jitter jitter;
+    FrameTiming timing;
+    DhtReading reading;
+
+    // 65.2 %, 23.4 °C
+    uint8_t data[5] = { 0x02, 0x8C, 0x00, 0xEA, 0 };
+    withChecksum(data);
+    std::vector<DhtEdge> edges = makeFrame(data, timing, jitter);
+    CHECK_EQ(DhtFrameDecoder::decode(edges.data(), edges.size(), false, reading), DHT_OK);
+    CHECK_NEAR(reading.humidity, 65.2, 0.01);
+    CHECK_NEAR(reading.temperature, 23.4, 0.01);
+
+    // Отрицательная температура: старший бит - знак. -10.1 °C
+    uint8_t negative[5] = { 0x01, 0xF4, 0x80, 0x65, 0 };
+    withChecksum(negative);
+    edges = makeFrame(negative, timing, jitter);
+    CHECK_EQ(DhtFrameDecoder::decode(edges.data(), edges.size(), false, reading), DHT_OK);
+    CHECK_NEAR(reading.humidity, 50.0, 0.01);
+    CHECK_NEAR(reading.temperature, -10.1, 0.01);
+}
+
+static void testDht11() {
+    Jitter jitter;
+    FrameTiming timing;
+    DhtReading reading;
+
+    uint8_t data[5] = { 45, 0, 22, 3, 0 };
+    withChecksum(data);
+    std::vector<DhtEdge> edges = makeFrame(data, timing, jitter);
+    CHECK_EQ(DhtFrameDecoder::decode(edges.data(), edges.size(), true, reading), DHT_OK);
+    CHECK_NEAR(reading.humidity, 45.0, 0.01);
+    CHECK_NEAR(reading.temperature, 22.3, 0.01);
+
+    // Бит 0x80 дробной части - ниже нуля: -1 - 5 + 0.3
+    uint8_t negative[5] = { 80, 0, 5, 0x83, 0 };
+    withChecksum(negative);
+    edges = makeFrame(negative, timing, jitter);
+    CHECK_EQ(DhtFrameDecoder::decode(edges.data(), edges.size(), true, reading), DHT_OK);
+    CHECK_NEAR(reading.temperature, -5.7, 0.01);
+}
+
+// Разброс времён в пределах допусков датчика и захвата: кадр разбирается всегда
+static void testJitter() {
+    Jitter jitter;
+    FrameTiming timing;
+    timing.spreadUs = 8;
+    int decoded = 0;
+    const int FRAMES = 2000;
+
+    for (int n = 0; n < FRAMES; n++) {
+        uint8_t data[5] = { (uint8_t)(n >> 3), (uint8_t)n, (uint8_t)(n * 7), (uint8_t)(n * 13), 0 };
+        withChecksum(data);
+        timing.hasHostRelease = n % 2;
+        timing.hasIdleHigh = n % 3 == 0;
+
+        std::vector<DhtEdge> edges = makeFrame(data, timing, jitter);
+        uint8_t bytes[5];
+        if (DhtFrameDecoder::decodeBits(edges.data(), edges.size(), bytes) == DHT_OK &&
+            memcmp(bytes, data, 5) == 0) {
+            decoded++;
+        }
+    }
+    CHECK_EQ(decoded, FRAMES);
+}
+
+static void testBrokenFrames() {
+    Jitter jitter;
+    FrameTiming timing;
+    DhtReading reading;
+    uint8_t data[5] = { 0x02, 0x8C, 0x00, 0xEA, 0 };
+    withChecksum(data);
+    std::vector<DhtEdge> edges = makeFrame(data, timing, jitter);
+
+    // Датчик не ответил: только отпущенная линия
+    DhtEdge idle[] = { { 1, 200 } };
+    CHECK_EQ(DhtFrameDecoder::decode(idle, 1, false, reading), DHT_NO_RESPONSE);
+    CHECK_EQ(DhtFrameDecoder::decode(edges.data(), 0, false, reading), DHT_NO_RESPONSE);
+
+    // Буфер захвата закончился посреди кадра
+    CHECK_EQ(DhtFrameDecoder::decode(edges.data(), edges.size() - 12, false, reading), DHT_TRUNCATED);
+
+    // Помеха: короткий высокий уровень внутри бита
+    std::vector<DhtEdge> glitch = edges;
+    glitch[10].durationUs = 4;
+    CHECK_EQ(DhtFrameDecoder::decode(glitch.data(), glitch.size(), false, reading), DHT_BAD_TIMING);
+
+    // Один бит прочитан неверно - контрольная сумма
+    std::vector<DhtEdge> flipped = edges;
+    size_t bitHigh = 1 + 2 + 2 * 5 + 1;   // высокий уровень шестого бита
+    flipped[bitHigh].durationUs = flipped[bitHigh].durationUs > DHT_BIT_ONE_THRESHOLD_US ? 27 : 70;
+    CHECK_EQ(DhtFrameDecoder::decode(flipped.data(), flipped.size(), false, reading), DHT_BAD_CHECKSUM);
+}
+
+int main() {
+    testDht22();
+    testDht11();
+    testJitter();
+    testBrokenFrames();
+    return testResult("DhtFrameTest");
+}
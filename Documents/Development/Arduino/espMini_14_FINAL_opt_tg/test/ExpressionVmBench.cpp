@@ -0,0 +1,130 @@
+#include "ExpressionVm.h"
+#include "BenchCommon.h"
+#include <stdio.h>
+#include <vector>
+
+// Стоимость 100 правил: компиляция при загрузке конфигурации и вычисление
+// всех условий за проход readSensors. Для сравнения - те же условия,
+// написанные на C++ напрямую (нижняя граница, к которой стремится VM).
+
+static const int SENSORS = 16;
+static const int RELAYS = 8;
+static const int RULES = 100;
+
+struct BenchResolver : ExpressionResolver {
+    int16_t sensorIndex(int id) const override { return id < SENSORS ? id : -1; }
+    int16_t relayIndex(int id) const override { return id < RELAYS ? id : -1; }
+};
+
+struct BenchEnv : ExpressionEnv {
+    float sensors[SENSORS];
+    float humidity[SENSORS];
+    bool relays[RELAYS];
+    int minute;
+
+    float sensorValue(uint16_t index) const override { return sensors[index]; }
+    float humidityValue(uint16_t index) const override { return humidity[index]; }
+    bool relayState(uint16_t index) const override { return relays[index]; }
+    int minuteOfDay() const override { return minute; }
+};
+
+// Правила трёх видов, как в конфигурациях: порог с влажностью, реле и окном
+// времени; разность двух датчиков; точка росы
+static void ruleText(int i, char* buffer, size_t size) {
+    int a = i % SENSORS;
+    int b = (i + 5) % SENSORS;
+    switch (i % 3) {
+        case 0:
+            snprintf(buffer, size, "s%d > %d and h%d < 40 and r%d and between(08:00, 20:00)",
+                     a, 20 + i % 15, b, i % RELAYS);
+            break;
+        case 1:
+            snprintf(buffer, size, "abs(s%d - s%d) > %d.5 or not r%d", a, b, i % 4, i % RELAYS);
+            break;
+        default:
+            snprintf(buffer, size, "dew(s%d, h%d) > s%d - 3", a, a, b);
+            break;
+    }
+}
+
+static bool direct(int i, const BenchEnv& env) {
+    int a = i % SENSORS;
+    int b = (i + 5) % SENSORS;
+    switch (i % 3) {
+        case 0:
+            return env.sensors[a] > 20 + i % 15 && env.humidity[b] < 40 && env.relays[i % RELAYS] &&
+                   env.minute >= 8 * 60 && env.minute < 20 * 60;
+        case 1:
+            return fabsf(env.sensors[a] - env.sensors[b]) > (i % 4) + 0.5f || !env.relays[i % RELAYS];
+        default: {
+            float gamma = logf(env.humidity[a] / 100.0f) + 17.62f * env.sensors[a] / (243.12f + env.sensors[a]);
+            return 243.12f * gamma / (17.62f - gamma) > env.sensors[b] - 3;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    benchInit(argc, argv);
+    BenchResolver resolver;
+    ExpressionCompiler compiler;
+    std::vector<ExpressionProgram> rules(RULES);
+    char text[128];
+
+    const uint32_t compiles = benchIterations(200);
+    uint64_t start = benchNowNs();
+    for (uint32_t n = 0; n < compiles; n++) {
+        for (int i = 0; i < RULES; i++) {
+            ruleText(i, text, sizeof(text));
+            if (!compiler.compile(text, resolver, rules[i])) {
+                printf("правило %d: %s\n", i, compiler.error());
+                return 1;
+            }
+        }
+    }
+    double compileNs = (double)(benchNowNs() - start) / ((double)compiles * RULES);
+
+    size_t ops = 0;
+    for (const ExpressionProgram& rule : rules) ops += rule.size();
+    benchReport("ExpressionVmBench", "compile", {
+        { "rules", (double)RULES }, { "ops_per_rule", (double)ops / RULES }, { "ns_per_rule", compileNs } });
+
+    BenchEnv env;
+    for (int i = 0; i < SENSORS; i++) {
+        env.sensors[i] = 18 + i;
+        env.humidity[i] = 30 + i * 3;
+    }
+    for (int i = 0; i < RELAYS; i++) env.relays[i] = i & 1;
+    env.minute = 9 * 60;
+
+    // Результаты VM и прямого кода должны совпадать
+    for (int i = 0; i < RULES; i++) {
+        if (ExpressionProgram::isTrue(rules[i].evaluate(env)) != direct(i, env)) {
+            printf("правило %d: VM и прямой код расходятся\n", i);
+            return 1;
+        }
+    }
+
+    // Между проходами меняются датчики, как при каждом readSensors
+    const uint32_t passes = benchIterations(50000);
+    int fired = 0;
+    start = benchNowNs();
+    for (uint32_t n = 0; n < passes; n++) {
+        env.sensors[n % SENSORS] += (n & 1) ? 0.5f : -0.5f;
+        for (const ExpressionProgram& rule : rules) fired += ExpressionProgram::isTrue(rule.evaluate(env));
+    }
+    double vmNs = (double)(benchNowNs() - start) / passes;
+    benchKeep(fired);
+
+    start = benchNowNs();
+    for (uint32_t n = 0; n < passes; n++) {
+        env.sensors[n % SENSORS] += (n & 1) ? 0.5f : -0.5f;
+        for (int i = 0; i < RULES; i++) fired += direct(i, env);
+    }
+    double directNs = (double)(benchNowNs() - start) / passes;
+    benchKeep(fired);
+
+    benchReport("ExpressionVmBench", "evaluate", {
+        { "rules", (double)RULES }, { "ns_per_pass", vmNs }, { "ns_per_rule", vmNs / RULES },
+        { "direct_ns_per_pass", directNs } });
+    return 0;
+}
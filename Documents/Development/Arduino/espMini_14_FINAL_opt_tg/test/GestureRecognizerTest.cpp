@@ -0,0 +1,218 @@
+#include "GestureRecognizer.h"
+#include "TestCheck.h"
+#include <string>
+#include <vector>
+
+// Жесты на синтетических последовательностях фронтов: нажатия с дребезгом,
+// опрос каждые 10 мс (задача inputs) и вся пачка фронтов сразу с опозданием -
+// результат должен совпадать.
+
+struct Edge {
+    uint32_t time;
+    bool isPressed;
+};
+
+static const char* gestureName(GestureType gesture) {
+    switch (gesture) {
+        case GESTURE_SHORT: return "S";
+        case GESTURE_LONG: return "L";
+        case GESTURE_DOUBLE: return "D";
+        case GESTURE_HOLD_REPEAT: return "R";
+        default: return "?";
+    }
+}
+
+static void drain(GestureRecognizer& recognizer, std::string& out) {
+    GestureType gesture;
+    while (recognizer.nextGesture(gesture)) out += gestureName(gesture);
+}
+
+static std::string runPolled(const std::vector<Edge>& edges, uint32_t end,
+                             const GestureTiming& timing = GestureRecognizer::defaultTiming()) {
+    GestureRecognizer recognizer(timing);
+    recognizer.reset(false, 0);
+    std::string out;
+    size_t next = 0;
+    for (uint32_t now = 0; now <= end; now += 10) {
+        while (next < edges.size() && edges[next].time <= now) {
+            recognizer.edge(edges[next].time, edges[next].isPressed);
+            next++;
+        }
+        recognizer.update(now);
+        drain(recognizer, out);
+    }
+    return out;
+}
+
+// Все фронты одной пачкой, обработка в конце
+static std::string runBatched(const std::vector<Edge>& edges, uint32_t end) {
+    GestureRecognizer recognizer;
+    recognizer.reset(false, 0);
+    for (const Edge& edge : edges) recognizer.edge(edge.time, edge.isPressed);
+    recognizer.update(end);
+    std::string out;
+    drain(recognizer, out);
+    return out;
+}
+
+// Переход с дребезгом: три фронта за 4 мс, уровень принимается по последнему
+static void bouncy(std::vector<Edge>& edges, uint32_t time, bool isPressed) {
+    edges.push_back({ time, isPressed });
+    edges.push_back({ time + 2, !isPressed });
+    edges.push_back({ time + 4, isPressed });
+}
+
+static void press(std::vector<Edge>& edges, uint32_t down, uint32_t up) {
+    bouncy(edges, down, true);
+    bouncy(edges, up, false);
+}
+
+static void checkGestures(const std::vector<Edge>& edges, uint32_t end, const char* expected) {
+    CHECK_STR(runPolled(edges, end).c_str(), expected);
+    CHECK_STR(runBatched(edges, end).c_str(), expected);
+}
+
+static void testBasicGestures() {
+    std::vector<Edge> edges;
+    press(edges, 100, 250);
+    checkGestures(edges, 1000, "S");
+
+    edges.clear();
+    press(edges, 100, 200);
+    press(edges, 350, 450);
+    checkGestures(edges, 1500, "D");
+
+    // Пауза дольше doubleMs - два коротких
+    edges.clear();
+    press(edges, 100, 200);
+    press(edges, 700, 800);
+    checkGestures(edges, 1500, "SS");
+
+    // Удержание 1450 мс: длинное на 800 мс, повторы на 1000, 1200, 1400
+    edges.clear();
+    press(edges, 100, 1550);
+    checkGestures(edges, 2000, "LRRR");
+
+    // Длинное не ждёт отпускания
+    edges.clear();
+    bouncy(edges, 100, true);
+    CHECK_STR(runPolled(edges, 1000).c_str(), "L");
+}
+
+static void testNoise() {
+    // Помеха короче debounceMs - ничего
+    std::vector<Edge> edges = { { 100, true }, { 105, false } };
+    checkGestures(edges, 1000, "");
+
+    // Длинный дребезг: фронты через 5 мс в течение 60 мс - одно нажатие
+    edges.clear();
+    for (uint32_t t = 100; t < 160; t += 5) edges.push_back({ t, (t / 5) % 2 == 0 });
+    edges.push_back({ 160, true });
+    bouncy(edges, 300, false);
+    checkGestures(edges, 1000, "S");
+}
+
+static void testTimingVariants() {
+    // Без повтора: только длинное
+    GestureTiming timing = GestureRecognizer::defaultTiming();
+    timing.repeatMs = 0;
+    std::vector<Edge> edges;
+    press(edges, 100, 2000);
+    CHECK_STR(runPolled(edges, 2500, timing).c_str(), "L");
+
+    // Кнопка зажата при старте: ни длинного, ни повторов, отпускание - не клик
+    GestureRecognizer recognizer;
+    recognizer.reset(true, 0);
+    recognizer.update(2000);
+    recognizer.edge(2100, false);
+    recognizer.update(3000);
+    std::string out;
+    drain(recognizer, out);
+    CHECK_STR(out.c_str(), "");
+    CHECK(!recognizer.isPressed());
+}
+
+static void testQueueOverflow() {
+    // Шесть коротких без опроса: в очереди остаются последние GESTURE_QUEUE
+    GestureRecognizer recognizer;
+    recognizer.reset(false, 0);
+    GestureTiming timing = GestureRecognizer::defaultTiming();
+    GestureType last = GESTURE_NONE;
+    for (uint32_t i = 0; i < 6; i++) {
+        uint32_t down = 100 + i * 1000;
+        recognizer.edge(down, true);
+        recognizer.edge(down + 100, false);
+        // Последний - двойной, чтобы было видно, что выпали старые
+        if (i == 5) {
+            recognizer.edge(down + 200, true);
+            recognizer.edge(down + 300, false);
+        }
+    }
+    recognizer.update(10000 + timing.doubleMs);
+    int count = 0;
+    GestureType gesture;
+    while (recognizer.nextGesture(gesture)) {
+        last = gesture;
+        count++;
+    }
+    CHECK_EQ(count, GESTURE_QUEUE);
+    CHECK_EQ(last, GESTURE_DOUBLE);
+}
+
+// Случайные нажатия с дребезгом дают те же жесты, что и чистый сигнал
+static void testRandomStreams() {
+    uint32_t random = 99;
+    auto next = [&random](uint32_t limit) {
+        random = random * 1664525u + 1013904223u;
+        return (random >> 8) % limit;
+    };
+
+    int mismatches = 0;
+    for (int stream = 0; stream < 500; stream++) {
+        std::vector<Edge> clean;
+        std::vector<Edge> noisy;
+        uint32_t time = 100;
+        int presses = 1 + next(4);
+        for (int i = 0; i < presses; i++) {
+            uint32_t hold = 100 + next(1500);
+            uint32_t gap = 40 + next(700);
+            clean.push_back({ time, true });
+            clean.push_back({ time + hold, false });
+
+            // Дребезг до 4 фронтов с интервалом меньше debounceMs, уровень - по последнему
+            for (int phase = 0; phase < 2; phase++) {
+                uint32_t start = phase == 0 ? time : time + hold;
+                bool level = phase == 0;
+                int bounces = next(3) * 2;
+                uint32_t t = start;
+                for (int b = 0; b < bounces; b++) {
+                    noisy.push_back({ t, b % 2 == 0 ? level : !level });
+                    t += 1 + next(GESTURE_DEBOUNCE_MS - 2);
+                }
+                noisy.push_back({ t, level });
+                if (phase == 0) {
+                    // Сдвиг чистого сигнала на время принятия уровня
+                    clean[clean.size() - 2].time = t;
+                } else {
+                    clean.back().time = t;
+                }
+            }
+            time += hold + gap + GESTURE_DEBOUNCE_MS * 2;
+        }
+
+        uint32_t end = time + 1000;
+        // Пачкой очередь может переполниться - сравнение с чистым сигналом той же пачкой
+        if (runPolled(noisy, end) != runPolled(clean, end)) mismatches++;
+        if (runBatched(noisy, end) != runBatched(clean, end)) mismatches++;
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+int main() {
+    testBasicGestures();
+    testNoise();
+    testTimingVariants();
+    testQueueOverflow();
+    testRandomStreams();
+    return testResult("GestureRecognizerTest");
+}
@@ -0,0 +1,438 @@
+#include <string>
+#include <vector>
+#include "HistoryArchive.h"
+#include "HostHardware.h"
+#include "SPIFFS.h"
+#include "TestCheck.h"
+
+// Сжатие Gorilla и архив истории на SPIFFS в памяти: кодирование без потерь
+// до бита, размер каждого диапазона разности разностей и окна XOR, удаление
+// самых старых сегментов в пределах бюджета, индекс после перезапуска и
+// чтение интервала кусками любого размера.
+
+namespace {
+
+const uint32_t START = 1709510400;   // 2024-03-04 00:00 UTC
+
+struct Point {
+    uint32_t time;
+    float values[GORILLA_MAX_COLUMNS];
+};
+
+// Весь ряд блоками, как SensorHistory::archiveMinute; false - блок не декодировался
+bool roundTrip(const std::vector<Point>& points, uint8_t columns, size_t* blocks = nullptr) {
+    GorillaEncoder encoder;
+    size_t next = 0;
+    size_t blockCount = 0;
+    while (next < points.size()) {
+        encoder.begin(columns);
+        size_t first = next;
+        while (next < points.size() && encoder.append(points[next].time, points[next].values)) next++;
+        if (next == first) return false;
+        blockCount++;
+
+        // isValid() не годится: время в ряду может идти назад
+        GorillaBlockHeader header = encoder.header(7, 1);
+        if (header.magic != GORILLA_BLOCK_MAGIC || header.bytes > GORILLA_BLOCK_BYTES || header.count != next - first ||
+            header.firstTime != points[first].time || header.lastTime != points[next - 1].time) {
+            return false;
+        }
+
+        GorillaDecoder decoder(header, encoder.data());
+        uint32_t time;
+        float values[GORILLA_MAX_COLUMNS];
+        for (size_t i = first; i < next; i++) {
+            if (!decoder.next(time, values) || time != points[i].time) return false;
+            for (uint8_t c = 0; c < columns; c++) {
+                if (GorillaCodec::floatBits(values[c]) != GorillaCodec::floatBits(points[i].values[c])) return false;
+            }
+        }
+        if (decoder.next(time, values)) return false;
+    }
+    if (blocks) *blocks = blockCount;
+    return true;
+}
+
+// Байт сжатых данных у блока из одного ряда
+uint16_t encodedBytes(const std::vector<Point>& points, uint8_t columns) {
+    GorillaEncoder encoder;
+    encoder.begin(columns);
+    for (const Point& point : points) {
+        if (!encoder.append(point.time, point.values)) return 0;
+    }
+    return encoder.header(7, 1).bytes;
+}
+
+Point point(uint32_t time, float value) {
+    Point result = { time, { value, value, value } };
+    return result;
+}
+
+Point pointBits(uint32_t time, uint32_t bits) {
+    return point(time, GorillaCodec::bitsFloat(bits));
+}
+
+// Время с постоянной разностью разностей dod: первая запись 32 + 32 бита,
+// дальше на запись код времени и '0' неизменного значения
+void testDeltaOfDeltaBands() {
+    struct Band {
+        int32_t dod;
+        uint8_t bits;   // код времени целиком
+    };
+    const Band bands[] = {
+        { 0, 1 },
+        { 1, 9 }, { -1, 9 }, { 63, 9 }, { -64, 9 },
+        { 64, 12 }, { -65, 12 }, { 255, 12 }, { -256, 12 },
+        { 256, 16 }, { -257, 16 }, { 2047, 16 }, { -2048, 16 },
+        { 2048, 36 }, { -2049, 36 }, { 100000, 36 }, { -100000, 36 },
+    };
+    const int records = 8;
+
+    for (const Band& band : bands) {
+        std::vector<Point> points;
+        uint32_t time = START;
+        int32_t delta = 0;
+        points.push_back(point(time, 21.5f));
+        for (int i = 0; i < records; i++) {
+            delta += band.dod;
+            time += delta;
+            points.push_back(point(time, 21.5f));
+        }
+        CHECK(roundTrip(points, 1));
+        size_t bits = 64 + records * (band.bits + 1);
+        if (encodedBytes(points, 1) != (bits + 7) / 8) {
+            printf("dod %d: %u bytes\n", (int)band.dod, (unsigned)encodedBytes(points, 1));
+            CHECK(false);
+        }
+    }
+
+    // Смена знака и разрывы подряд, время назад (часы переставили)
+    const int32_t jumps[] = { 60, 60, 61, 59, 60, 3600, 60, -7200, 60, 0, 0, 60, 2147483, 60 };
+    std::vector<Point> points;
+    uint32_t time = START;
+    points.push_back(point(time, 1.0f));
+    for (int32_t jump : jumps) {
+        time += jump;
+        points.push_back(point(time, 1.0f));
+    }
+    CHECK(roundTrip(points, 1));
+}
+
+// Окно XOR: новое ('11' + 5 + 5 + значащие) или прежнее ('10' + значащие)
+void testXorWindows() {
+    std::vector<Point> points = {
+        pointBits(START, 0x41A80000),         // 21.0: 32 бита
+        pointBits(START, 0xC1A80000),         // знак: окно с 0 ведущих, 1 значащий бит - 1 + 12 + 1
+        pointBits(START, 0x41A80000),         // тот же бит в окне - 1 + 2 + 1
+        pointBits(START, 0xC1A80001),         // все 32 бита: новое окно длины 32 - 1 + 12 + 32
+        pointBits(START, 0xC1A90000),         // в окне 32 бит - 1 + 2 + 32
+        pointBits(START, 0xC1A90000),         // без изменений - 1 + 1
+    };
+    CHECK(roundTrip(points, 1));
+    size_t bits = 64 + 14 + 4 + 45 + 35 + 2;
+    CHECK_EQ(encodedBytes(points, 1), (bits + 7) / 8);
+
+    // Окно сужается и расширяется: каждый раз значение точное до бита
+    const uint32_t patterns[] = {
+        0x00000000, 0x80000000, 0x7F800000, 0xFF800000, 0x7FC00000, 0x7FC00001, 0xFFFFFFFF,
+        0x00000001, 0x00800000, 0x3F800000, 0x3F800001, 0x3F800003, 0x3F800002, 0xBF7FFFFF,
+        0x00000001, 0x80000001, 0x40490FDB, 0x40490FDA, 0x40490FDB, 0x00000000,
+    };
+    points.clear();
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        points.push_back(pointBits(START + i * 60, patterns[i]));
+    }
+    for (uint8_t columns = 1; columns <= GORILLA_MAX_COLUMNS; columns++) CHECK(roundTrip(points, columns));
+}
+
+// Случайные блуждания и случайные биты по всем столбцам, ряды на много блоков
+void testRandomSeries() {
+    uint32_t seed = 12345;
+    auto random = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    };
+
+    for (uint8_t columns = 1; columns <= GORILLA_MAX_COLUMNS; columns++) {
+        std::vector<Point> points;
+        uint32_t time = START;
+        float level = 20;
+        for (int i = 0; i < 3000; i++) {
+            time += 60 + (random() % 7 == 0 ? (int)(random() % 300) - 150 : 0);
+            level += ((int)(random() % 201) - 100) / 100.0f;
+            Point item = { time, { level - 0.5f, level, level + 0.25f } };
+            if (i % 97 == 0) item.values[columns - 1] = GorillaCodec::bitsFloat(random() ^ (random() << 24));
+            points.push_back(item);
+        }
+        size_t blocks = 0;
+        CHECK(roundTrip(points, columns, &blocks));
+        CHECK(blocks > 1);
+    }
+}
+
+// Повреждённый блок: декодер останавливается, а не читает за данными
+void testTruncatedBlock() {
+    std::vector<Point> points;
+    for (int i = 0; i < 20; i++) points.push_back(point(START + i * 61, 20.0f + i * 0.37f));
+    GorillaEncoder encoder;
+    encoder.begin(GORILLA_MAX_COLUMNS);
+    for (const Point& item : points) encoder.append(item.time, item.values);
+    GorillaBlockHeader header = encoder.header(7, 1);
+
+    for (uint16_t bytes = 1; bytes < header.bytes; bytes++) {
+        GorillaBlockHeader cut = header;
+        cut.bytes = bytes;
+        GorillaDecoder decoder(cut, encoder.data());
+        uint32_t time;
+        float values[GORILLA_MAX_COLUMNS];
+        int decoded = 0;
+        while (decoder.next(time, values)) decoded++;
+        CHECK(decoded < header.count);
+    }
+}
+
+// Блоки рядов (датчик, поле) по минутам; points - всё записанное по порядку
+struct Recorder {
+    HistoryArchive& archive;
+    std::vector<std::pair<GorillaBlockHeader, std::vector<uint8_t>>> blocks;
+    uint32_t seed = 777;
+
+    explicit Recorder(HistoryArchive& target) : archive(target) {}
+
+    // count минутных точек ряда от time; в блоке до perBlock точек
+    void series(int32_t sensorId, uint8_t field, uint32_t time, int count, int perBlock, std::vector<Point>& points) {
+        GorillaEncoder encoder;
+        encoder.begin(GORILLA_MAX_COLUMNS);
+        for (int i = 0; i < count; i++, time += 60) {
+            seed = seed * 1103515245 + 12345;
+            float average = sensorId + field * 10 + (float)(seed >> 20) / 256.0f;
+            Point item = { time, { average - 1, average, average + 1 } };
+            if (encoder.size() == perBlock || !encoder.append(time, item.values)) {
+                flush(encoder, sensorId, field);
+                encoder.append(time, item.values);
+            }
+            points.push_back(item);
+        }
+        flush(encoder, sensorId, field);
+    }
+
+    void flush(GorillaEncoder& encoder, int32_t sensorId, uint8_t field) {
+        if (encoder.size() == 0) return;
+        GorillaBlockHeader header = encoder.header(sensorId, field);
+        CHECK(archive.append(header, encoder.data()));
+        blocks.emplace_back(header, std::vector<uint8_t>(encoder.data(), encoder.data() + header.bytes));
+        encoder.begin(GORILLA_MAX_COLUMNS);
+    }
+};
+
+size_t segmentFileBytes() {
+    size_t total = 0;
+    for (uint32_t seq = 1; seq < 10000; seq++) {
+        std::string content;
+        std::string path = "/hist" + std::to_string(seq) + ".seg";
+        if (HostHardware::readFile(path.c_str(), content)) total += content.size();
+    }
+    return total;
+}
+
+// Сегменты нумеруются подряд; после удаления старых первый - не /hist1.seg
+std::string lastSegmentPath() {
+    std::string last;
+    for (uint32_t seq = 1; seq < 10000; seq++) {
+        std::string path = "/hist" + std::to_string(seq) + ".seg";
+        if (SPIFFS.exists(path.c_str())) last = path;
+    }
+    return last;
+}
+
+std::vector<uint32_t> blockTimes(HistoryArchive& archive) {
+    std::vector<uint32_t> times;
+    archive.forEachBlock([&](const GorillaBlockHeader& header, const uint8_t*) { times.push_back(header.firstTime); });
+    return times;
+}
+
+// Бюджет historyKb: сегментов не больше HISTORY_ARCHIVE_SEGMENTS, удаляются
+// самые старые, файлы на флеше не выходят за бюджет
+void testRotation() {
+    HostHardware::reset(START);
+    const uint32_t budget = 16 * 1024;
+    HistoryArchive archive;
+    archive.begin(budget);
+    Recorder recorder(archive);
+
+    std::vector<Point> points;
+    uint32_t time = START;
+    size_t peakSegments = 0;
+    for (int round = 0; round < 60; round++) {
+        recorder.series(5, 0, time, 40, 20, points);
+        time += 40 * 60;
+        CHECK(archive.bytes() <= budget);
+        CHECK_EQ(segmentFileBytes(), archive.bytes());
+        if (archive.segmentCount() > peakSegments) peakSegments = archive.segmentCount();
+    }
+    CHECK(recorder.blocks.size() * (sizeof(GorillaBlockHeader) + GORILLA_BLOCK_BYTES / 2) > budget);
+    CHECK(peakSegments <= HISTORY_ARCHIVE_SEGMENTS + 1);
+    CHECK(archive.bytes() > budget / 2);
+
+    // Остался хвост записанного: последние блоки по порядку, без пропусков
+    std::vector<uint32_t> times = blockTimes(archive);
+    CHECK(!times.empty());
+    CHECK(times.size() < recorder.blocks.size());
+    size_t skipped = recorder.blocks.size() - times.size();
+    for (size_t i = 0; i < times.size(); i++) CHECK_EQ(times[i], recorder.blocks[skipped + i].first.firstTime);
+
+    // Самый старый сегмент удалён с флеша, не только из индекса
+    CHECK(!SPIFFS.exists("/hist1.seg"));
+
+    // Бюджет меньше минимального поднимается до HISTORY_ARCHIVE_MIN_KB
+    HostHardware::reset(START);
+    HistoryArchive small;
+    small.begin(1024);
+    Recorder smallRecorder(small);
+    points.clear();
+    smallRecorder.series(5, 0, START, 2000, 20, points);
+    CHECK(small.bytes() <= HISTORY_ARCHIVE_MIN_KB * 1024);
+    CHECK(small.bytes() > 1024);
+}
+
+// Перезапуск: индекс по заголовкам блоков, запись продолжается в новый сегмент
+void testRestart() {
+    HostHardware::reset(START);
+    const uint32_t budget = 16 * 1024;
+    std::vector<Point> points;
+    std::vector<uint32_t> before;
+    uint32_t time = START;
+    std::string earlyIndex;
+    {
+        HistoryArchive archive;
+        archive.begin(budget);
+        Recorder recorder(archive);
+        recorder.series(3, 0, time, 1500, 20, points);
+        HostHardware::readFile(HISTORY_ARCHIVE_INDEX, earlyIndex);
+        recorder.series(3, 0, time + 1500 * 60, 1500, 20, points);
+        before = blockTimes(archive);
+        time += 3000 * 60;
+    }
+
+    HistoryArchive restarted;
+    restarted.begin(budget);
+    CHECK(blockTimes(restarted) == before);
+    size_t segments = restarted.segmentCount();
+    uint32_t bytes = restarted.bytes();
+
+    // Первая запись после старта - в новый сегмент
+    Recorder recorder(restarted);
+    recorder.series(3, 0, time, 5, 20, points);
+    CHECK_EQ(restarted.segmentCount(), segments + 1);
+    CHECK(restarted.bytes() > bytes);
+    before = blockTimes(restarted);
+
+    // Индекс отстал (сбой до его записи): сегменты за ним находятся по файлам
+    HostHardware::writeFile(HISTORY_ARCHIVE_INDEX, earlyIndex);
+    HistoryArchive stale;
+    stale.begin(budget);
+    CHECK(blockTimes(stale) == before);
+
+    // Оборванный хвост последнего сегмента: целые блоки остаются, обрывок - нет
+    std::string path = lastSegmentPath();
+    std::string content;
+    CHECK(HostHardware::readFile(path.c_str(), content));
+    size_t lastBlock = sizeof(GorillaBlockHeader) + recorder.blocks.back().first.bytes;
+    HostHardware::writeFile(path.c_str(), content.substr(0, content.size() - 3));
+    HistoryArchive torn;
+    torn.begin(budget);
+    std::vector<uint32_t> tornTimes = blockTimes(torn);
+    CHECK_EQ(tornTimes.size(), before.size() - 1);
+    CHECK_EQ(torn.bytes(), stale.bytes() - lastBlock);
+
+    // Бюджет уменьшили в настройках: лишнее удаляется при старте
+    HistoryArchive smaller;
+    smaller.begin(HISTORY_ARCHIVE_MIN_KB * 1024);
+    CHECK(smaller.bytes() <= HISTORY_ARCHIVE_MIN_KB * 1024);
+    CHECK(smaller.segmentCount() < segments);
+}
+
+std::vector<HistoryAggregate> readAll(HistoryArchive& archive, int32_t sensorId, uint8_t field,
+                                      uint32_t from, uint32_t to, size_t chunk) {
+    std::vector<HistoryAggregate> result;
+    std::vector<HistoryAggregate> buffer(chunk);
+    ArchiveCursor cursor;
+    for (int guard = 0; guard < 100000; guard++) {
+        size_t count = archive.read(cursor, sensorId, field, from, to, buffer.data(), chunk);
+        if (count == 0) break;
+        result.insert(result.end(), buffer.begin(), buffer.begin() + count);
+    }
+    return result;
+}
+
+bool sameAggregates(const std::vector<HistoryAggregate>& actual, const std::vector<Point>& expected) {
+    if (actual.size() != expected.size()) return false;
+    for (size_t i = 0; i < actual.size(); i++) {
+        if (actual[i].time != expected[i].time ||
+            GorillaCodec::floatBits(actual[i].min) != GorillaCodec::floatBits(expected[i].values[0]) ||
+            GorillaCodec::floatBits(actual[i].avg) != GorillaCodec::floatBits(expected[i].values[1]) ||
+            GorillaCodec::floatBits(actual[i].max) != GorillaCodec::floatBits(expected[i].values[2])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Окно [from, to] кусками 1..N: то же, что за один вызов, и ровно записанное
+void testChunkedRead() {
+    HostHardware::reset(START);
+    HistoryArchive archive;
+    archive.begin(HISTORY_ARCHIVE_MIN_KB * 1024);
+    Recorder recorder(archive);
+
+    // Ряды вперемешку по блокам, на несколько сегментов
+    std::vector<Point> wanted;
+    std::vector<Point> other;
+    std::vector<Point> otherField;
+    uint32_t time = START;
+    for (int round = 0; round < 6; round++) {
+        recorder.series(10, 0, time, 45, 15, wanted);
+        recorder.series(11, 0, time, 30, 15, other);
+        recorder.series(10, 1, time, 30, 15, otherField);
+        time += 45 * 60;
+    }
+    CHECK(archive.segmentCount() > 1);
+    CHECK(SPIFFS.exists("/hist1.seg"));   // без удаления: все точки на месте
+
+    const uint32_t from = wanted[20].time;
+    const uint32_t to = wanted[wanted.size() - 33].time;
+    std::vector<Point> expected;
+    for (const Point& item : wanted) {
+        if (item.time >= from && item.time <= to) expected.push_back(item);
+    }
+
+    std::vector<HistoryAggregate> whole = readAll(archive, 10, 0, from, to, expected.size() + 10);
+    CHECK(sameAggregates(whole, expected));
+
+    for (size_t chunk = 1; chunk <= expected.size() + 1; chunk++) {
+        if (!sameAggregates(readAll(archive, 10, 0, from, to, chunk), expected)) {
+            printf("chunk %u\n", (unsigned)chunk);
+            CHECK(false);
+            break;
+        }
+    }
+
+    // Другие ряды и всё окно
+    CHECK(sameAggregates(readAll(archive, 11, 0, 0, UINT32_MAX, 7), other));
+    CHECK(sameAggregates(readAll(archive, 10, 1, 0, UINT32_MAX, 13), otherField));
+    CHECK(readAll(archive, 12, 0, 0, UINT32_MAX, 5).empty());
+    CHECK(readAll(archive, 10, 0, time + 60, UINT32_MAX, 5).empty());
+}
+
+}
+
+int main() {
+    testDeltaOfDeltaBands();
+    testXorWindows();
+    testRandomSeries();
+    testTruncatedBlock();
+    testRotation();
+    testRestart();
+    testChunkedRead();
+    return testResult("HistoryArchiveTest");
+}
@@ -0,0 +1,303 @@
+#include <memory>
+#include <string>
+#include "DeviceJsonReader.h"
+#include "DeviceJsonWriter.h"
+#include "HostHardware.h"
+#include "TestCheck.h"
+
+// Потоковый разбор JSON: результат не зависит от того, как вход порезан на
+// куски (1..N байт), пределы глубины, длины токена и ключа, числа записей
+// в списке и обрыв входа отклоняются - в веб-сервере это ответ 400.
+// Число - строго по грамматике JSON.
+
+namespace {
+
+// События разбора одной строкой: по ней сравниваются прогоны
+class TraceHandler : public JsonStreamHandler {
+public:
+    std::string trace;
+
+    bool beginContainer(const char* key, bool isArray) override {
+        keyPrefix(key);
+        trace += isArray ? '[' : '{';
+        return true;
+    }
+    bool endContainer(bool isArray) override {
+        trace += isArray ? ']' : '}';
+        return true;
+    }
+    bool value(const char* key, const JsonStreamValue& value) override {
+        keyPrefix(key);
+        char number[32];
+        switch (value.type) {
+            case JSON_VALUE_STRING: trace += "s:" + std::string(value.text, value.length); break;
+            case JSON_VALUE_NUMBER:
+                snprintf(number, sizeof(number), "n:%.17g", value.number);
+                trace += number;
+                break;
+            case JSON_VALUE_BOOL: trace += value.boolean ? "true" : "false"; break;
+            case JSON_VALUE_NULL: trace += "null"; break;
+        }
+        trace += ';';
+        return true;
+    }
+
+private:
+    void keyPrefix(const char* key) {
+        if (key) trace += std::string(key) + "=";
+    }
+};
+
+struct Outcome {
+    bool ok;
+    JsonStreamError error;
+    size_t offset;
+    std::string trace;
+};
+
+Outcome parseChunked(const std::string& text, size_t chunk) {
+    TraceHandler handler;
+    JsonStreamParser parser(handler);
+    bool ok = true;
+    for (size_t i = 0; ok && i < text.size(); i += chunk) {
+        ok = parser.feed(text.data() + i, std::min(chunk, text.size() - i));
+    }
+    if (ok) ok = parser.finish();
+    return { ok, parser.error(), parser.errorOffset(), handler.trace };
+}
+
+Outcome parse(const std::string& text) { return parseChunked(text, text.size() ? text.size() : 1); }
+
+// Один и тот же исход при любой нарезке
+void checkAllChunkSizes(const std::string& text) {
+    Outcome whole = parse(text);
+    for (size_t chunk = 1; chunk <= text.size(); chunk++) {
+        Outcome split = parseChunked(text, chunk);
+        if (split.ok != whole.ok || split.error != whole.error ||
+            split.offset != whole.offset || split.trace != whole.trace) {
+            printf("chunk %u: \"%s\"\n", (unsigned)chunk, text.c_str());
+            CHECK(false);
+            return;
+        }
+    }
+}
+
+class StringPrint : public Print {
+public:
+    std::string text;
+    size_t write(uint8_t c) override { text += (char)c; return 1; }
+};
+
+std::string writeDevice(const Device& device) {
+    StringPrint out;
+    DeviceJsonWriter writer(std::make_shared<const Device>(device));
+    writer.writeTo(out);
+    return out.text;
+}
+
+Device sampleDevice(DeviceManager& deviceManager) {
+    deviceManager.initializeDevice("Теплица \"Север\"\\1", true);
+    Device device = deviceManager.myDevices.back();
+    device.sensors[0].expression = "s100 * 2.5e-1";
+    device.actions[0].condition = "s100 > -0.5 && r1";
+    device.temperature().setTemperature = -12.75f;
+    return device;
+}
+
+void testTraceChunks() {
+    const char* documents[] = {
+        R"({"a":[1,-0,0.5,-12.25e-3,1E+2,true,false,null],"b":{"c":"x\"\\\/\b\f\n\r\t"}})",
+        R"({"u":"Aé€😀\udc00x","k":"Привет"})",
+        R"(  [ [ ], { }, "", 0 ]  )",
+        R"({"n":123456789012345678901234567890})",
+        "[1,2",
+        "{\"a\":1,}",
+        "[1.e5]",
+        "{\"a\" 1}",
+        "[\"a\x01\"]",
+        "[1] x",
+    };
+    for (const char* document : documents) checkAllChunkSizes(document);
+
+    Outcome outcome = parse(documents[1]);
+    CHECK(outcome.ok);
+    CHECK_STR(outcome.trace.c_str(), "{u=s:A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xEF\xBF\xBDx;k=s:Привет;}");
+}
+
+// Весь документ устройства через DeviceJsonReader при любой нарезке
+// даёт то же устройство
+void testDeviceChunks() {
+    HostHardware::reset(1709510400);
+    AppState appState;
+    DeviceManager deviceManager(appState);
+    std::string document = writeDevice(sampleDevice(deviceManager));
+    CHECK(document.size() > 1000);
+
+    for (size_t chunk = 1; chunk <= document.size(); chunk++) {
+        Device device;
+        DeviceJsonReader reader(device);
+        bool ok = true;
+        for (size_t i = 0; ok && i < document.size(); i += chunk) {
+            ok = reader.feed(document.data() + i, std::min(chunk, document.size() - i));
+        }
+        if (ok) ok = reader.finish();
+        if (!ok || writeDevice(device) != document) {
+            printf("chunk %u: %s at %u\n", (unsigned)chunk,
+                   JsonStreamParser::errorText(reader.error()), (unsigned)reader.errorOffset());
+            CHECK(false);
+            return;
+        }
+    }
+}
+
+// Любой обрывок полного документа - "unexpected end", не успех
+void testTruncation() {
+    const std::string document = R"({"a":[1,2.5,"x"],"b":{"c":true,"d":null},"e":-3})";
+    CHECK(parse(document).ok);
+    for (size_t length = 0; length < document.size(); length++) {
+        Outcome outcome = parse(document.substr(0, length));
+        CHECK(!outcome.ok);
+        CHECK_EQ(outcome.error, JSON_STREAM_INCOMPLETE);
+    }
+}
+
+void testDepth() {
+    std::string deepest = std::string(JSON_STREAM_MAX_DEPTH, '[') + std::string(JSON_STREAM_MAX_DEPTH, ']');
+    CHECK(parse(deepest).ok);
+    checkAllChunkSizes(deepest);
+
+    std::string tooDeep = std::string(JSON_STREAM_MAX_DEPTH + 1, '[') + std::string(JSON_STREAM_MAX_DEPTH + 1, ']');
+    Outcome outcome = parse(tooDeep);
+    CHECK(!outcome.ok);
+    CHECK_EQ(outcome.error, JSON_STREAM_TOO_DEEP);
+    CHECK_EQ(outcome.offset, JSON_STREAM_MAX_DEPTH);
+    checkAllChunkSizes(tooDeep);
+
+    std::string mixed;
+    for (int i = 0; i <= JSON_STREAM_MAX_DEPTH; i++) mixed += i % 2 ? "[" : "{\"k\":";
+    CHECK_EQ(parse(mixed).error, JSON_STREAM_TOO_DEEP);
+}
+
+void testTokenLength() {
+    std::string longest = "[\"" + std::string(JSON_STREAM_MAX_TOKEN, 'x') + "\"]";
+    Outcome outcome = parse(longest);
+    CHECK(outcome.ok);
+    CHECK_EQ(outcome.trace.size(), JSON_STREAM_MAX_TOKEN + 5);
+
+    std::string tooLong = "[\"" + std::string(JSON_STREAM_MAX_TOKEN + 1, 'x') + "\"]";
+    outcome = parse(tooLong);
+    CHECK_EQ(outcome.error, JSON_STREAM_TOO_LONG);
+    CHECK_EQ(outcome.offset, JSON_STREAM_MAX_TOKEN + 2);
+    checkAllChunkSizes(tooLong);
+
+    // Предел - байты после раскрытия \u: 171 "€" по три байта = 513
+    std::string escaped = "[\"";
+    for (int i = 0; i < 171; i++) escaped += "\\u20ac";
+    escaped += "\"]";
+    CHECK_EQ(parse(escaped).error, JSON_STREAM_TOO_LONG);
+
+    std::string longNumber = "[" + std::string(JSON_STREAM_MAX_TOKEN + 1, '1') + "]";
+    CHECK_EQ(parse(longNumber).error, JSON_STREAM_TOO_LONG);
+}
+
+void testKeyLength() {
+    std::string longest = "{\"" + std::string(JSON_STREAM_MAX_KEY, 'k') + "\":1}";
+    CHECK(parse(longest).ok);
+
+    std::string tooLong = "{\"" + std::string(JSON_STREAM_MAX_KEY + 1, 'k') + "\":1}";
+    Outcome outcome = parse(tooLong);
+    CHECK_EQ(outcome.error, JSON_STREAM_TOO_LONG);
+    CHECK_EQ(outcome.offset, JSON_STREAM_MAX_KEY + 3);   // закрывающая кавычка
+    checkAllChunkSizes(tooLong);
+
+    // Длинная строка-значение ключом не считается
+    CHECK(parse("{\"k\":\"" + std::string(JSON_STREAM_MAX_KEY + 1, 'v') + "\"}").ok);
+}
+
+void testNumbers() {
+    const char* valid[] = { "0", "-0", "7", "-12", "10", "0.5", "-0.25", "1e5", "1E+2", "-2.5e-3", "0e0" };
+    const double values[] = { 0, -0.0, 7, -12, 10, 0.5, -0.25, 1e5, 100, -2.5e-3, 0 };
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+        Outcome outcome = parse(std::string("[") + valid[i] + "]");
+        CHECK(outcome.ok);
+        char expected[40];
+        snprintf(expected, sizeof(expected), "[n:%.17g;]", values[i]);
+        CHECK_STR(outcome.trace.c_str(), expected);
+
+        // Число на верхнем уровне заканчивается только с концом входа
+        CHECK(parse(valid[i]).ok);
+    }
+
+    const char* invalid[] = {
+        "-.5", "1.e5", ".5", "1.", "-", "--1", "-+1", "01", "-01", "00",
+        "1e", "1e+", "1E-", "1e5.5", "1.5.5", "1ee5", "2-1", "1+", "0.e1"
+    };
+    for (const char* text : invalid) {
+        Outcome outcome = parse(std::string("[") + text + "]");
+        if (outcome.ok || outcome.error != JSON_STREAM_SYNTAX) printf("accepted: %s\n", text);
+        CHECK(!outcome.ok);
+        CHECK_EQ(outcome.error, JSON_STREAM_SYNTAX);
+        CHECK_EQ(parse(text).error, JSON_STREAM_SYNTAX);
+    }
+
+    // Этих нет даже среди символов числа: ошибка на первом байте
+    for (const char* text : { "+1", "inf", "NaN", "0x10" }) {
+        CHECK(!parse(std::string("[") + text + "]").ok);
+    }
+}
+
+std::string relayList(size_t count) {
+    std::string document = "{\"rel\":[";
+    for (size_t i = 0; i < count; i++) {
+        if (i) document += ',';
+        document += "{\"id\":" + std::to_string(i) + ",\"pin\":" + std::to_string(i % 40) + "}";
+    }
+    return document + "]}";
+}
+
+bool readDevice(Device& device, const std::string& document, JsonStreamError& error) {
+    DeviceJsonReader reader(device);
+    bool ok = reader.feed(document.data(), document.size()) && reader.finish();
+    error = reader.error();
+    return ok;
+}
+
+// Записей в списке не больше DEVICE_JSON_MAX_ITEMS
+void testListItems() {
+    HostHardware::reset(1709510400);
+    JsonStreamError error;
+
+    Device device;
+    CHECK(readDevice(device, relayList(DEVICE_JSON_MAX_ITEMS), error));
+    CHECK_EQ(device.relays.size(), DEVICE_JSON_MAX_ITEMS);
+
+    Device overflow;
+    CHECK(!readDevice(overflow, relayList(DEVICE_JSON_MAX_ITEMS + 1), error));
+    CHECK_EQ(error, JSON_STREAM_REJECTED);
+
+    std::string pins = "{\"pinL\":[";
+    for (int i = 0; i <= DEVICE_JSON_MAX_ITEMS; i++) pins += (i ? ",1" : "1");
+    pins += "]}";
+    Device pinOverflow;
+    CHECK(!readDevice(pinOverflow, pins, error));
+    CHECK_EQ(error, JSON_STREAM_REJECTED);
+
+    // Документ устройства - объект
+    Device array;
+    CHECK(!readDevice(array, "[]", error));
+    CHECK_EQ(error, JSON_STREAM_REJECTED);
+}
+
+}
+
+int main() {
+    testTraceChunks();
+    testDeviceChunks();
+    testTruncation();
+    testDepth();
+    testTokenLength();
+    testKeyLength();
+    testNumbers();
+    testListItems();
+    return testResult("JsonStreamTest");
+}
@@ -0,0 +1,76 @@
+#include "NtcModel.h"
+#include "TestCheck.h"
+#include <math.h>
+
+// Таблица NTC против точной формулы (Beta и Стейнхарт-Харт) по всей шкале АЦП
+// с шагом 1/4 мВ. Допуск - по рабочему диапазону: узлы через 16 мВ, на краях
+// шкалы кривая круче и ошибка интерполяции растёт.
+
+static const uint16_t FULL_SCALE_MV = 3300;
+
+struct Band {
+    double minC;
+    double maxC;
+    double toleranceC;
+};
+
+static double maxError(const NtcParams& params, const LinearTable& table, const Band& band) {
+    double worst = 0;
+    for (double mv = 0.25; mv < FULL_SCALE_MV; mv += 0.25) {
+        double exact = NtcModel::exactCelsius(params, mv / FULL_SCALE_MV);
+        if (exact < band.minC || exact > band.maxC) continue;
+        double error = fabs(NtcModel::lookupCentiCelsius(table, mv) / 100.0 - exact);
+        if (error > worst) worst = error;
+    }
+    return worst;
+}
+
+static void checkModel(const char* name, const NtcParams& params) {
+    LinearTable table;
+    NtcModel::buildTable(params, FULL_SCALE_MV, table);
+    CHECK(!table.empty());
+
+    const Band bands[] = {
+        { -20, 100, 0.05 },
+        { -40, 125, 0.15 },
+    };
+    for (const Band& band : bands) {
+        double error = maxError(params, table, band);
+        printf("%s %g..%g °C: макс. ошибка %.4f °C\n", name, band.minC, band.maxC, error);
+        CHECK(error <= band.toleranceC);
+    }
+}
+
+static void testBeta() {
+    NtcParams params = { 10000, 10000, 3950, 0, 0, 0, 0 };
+    checkModel("beta 3950", params);
+
+    // Середина делителя при равных R - ровно 25 °C
+    CHECK_NEAR(NtcModel::exactCelsius(params, 0.5), 25.0, 1e-9);
+}
+
+static void testSteinhartHart() {
+    NtcParams params = { 10000, 10000, 0, 1.009249522e-03f, 2.378405444e-04f, 2.019202697e-07f, 0 };
+    CHECK(NtcModel::usesSteinhartHart(params));
+    checkModel("steinhart-hart", params);
+}
+
+static void testOffsetAndInvalid() {
+    NtcParams params = { 10000, 10000, 3950, 0, 0, 0, -1.5f };
+    LinearTable table;
+    NtcModel::buildTable(params, FULL_SCALE_MV, table);
+    CHECK_NEAR(NtcModel::lookupCentiCelsius(table, FULL_SCALE_MV / 2) / 100.0, 23.5, 0.02);
+
+    // Без Beta и коэффициентов модели нет: пустая таблица
+    NtcParams invalid = { 10000, 10000, 0, 0, 0, 0, 0 };
+    CHECK(!NtcModel::isValid(invalid));
+    NtcModel::buildTable(invalid, FULL_SCALE_MV, table);
+    CHECK(table.empty());
+}
+
+int main() {
+    testBeta();
+    testSteinhartHart();
+    testOffsetAndInvalid();
+    return testResult("NtcModelTest");
+}
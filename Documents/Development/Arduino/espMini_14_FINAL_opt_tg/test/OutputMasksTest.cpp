@@ -0,0 +1,123 @@
+#include "OutputMasks.h"
+#include "TestCheck.h"
+#include <stdint.h>
+
+// Маски set/clear против простой модели: уровень и "известность" каждого пина,
+// запланированные записи. Случайные последовательности stage/forget/take/reset.
+
+struct MaskModel {
+    bool known[OUTPUT_MAX_PINS] = {};
+    bool level[OUTPUT_MAX_PINS] = {};
+    int8_t pending[OUTPUT_MAX_PINS];   // -1 - записи нет, иначе уровень
+
+    MaskModel() { reset(); }
+
+    void reset() {
+        for (int pin = 0; pin < OUTPUT_MAX_PINS; pin++) {
+            known[pin] = false;
+            level[pin] = false;
+            pending[pin] = -1;
+        }
+    }
+
+    bool stage(uint8_t pin, bool value, bool force) {
+        if (known[pin] && level[pin] == value && !force) return false;
+        pending[pin] = value;
+        return true;
+    }
+
+    OutputMasks take() {
+        OutputMasks masks = {};
+        for (int pin = 0; pin < OUTPUT_MAX_PINS; pin++) {
+            if (pending[pin] < 0) continue;
+            uint32_t bit = 1UL << (pin % 32);
+            if (pending[pin]) masks.set[pin / 32] |= bit;
+            else masks.clear[pin / 32] |= bit;
+            known[pin] = true;
+            level[pin] = pending[pin];
+            pending[pin] = -1;
+        }
+        return masks;
+    }
+};
+
+static bool sameMasks(const OutputMasks& a, const OutputMasks& b) {
+    for (int i = 0; i < OUTPUT_BANKS; i++) {
+        if (a.set[i] != b.set[i] || a.clear[i] != b.clear[i]) return false;
+    }
+    return true;
+}
+
+static void testBasics() {
+    OutputMaskBuilder builder;
+
+    // Неизвестное состояние: записывается любой уровень, в том числе LOW
+    CHECK(builder.stage(5, false));
+    CHECK(builder.stage(40, true));
+    OutputMasks masks = builder.take();
+    CHECK_EQ(masks.clear[0], 1UL << 5);
+    CHECK_EQ(masks.set[1], 1UL << (40 - 32));
+    CHECK_EQ(masks.count(), 2);
+
+    // Тот же уровень - записи нет, force - есть
+    CHECK(!builder.stage(5, false));
+    CHECK(builder.take().empty());
+    CHECK(builder.stage(5, false, true));
+    CHECK_EQ(builder.take().clear[0], 1UL << 5);
+
+    // Несколько смен за цикл - в маске последний уровень
+    builder.stage(7, true);
+    builder.stage(7, false);
+    builder.stage(7, true);
+    masks = builder.take();
+    CHECK_EQ(masks.set[0], 1UL << 7);
+    CHECK_EQ(masks.clear[0], 0);
+    CHECK(builder.level(7));
+
+    // Пин из ШИМ: состояние забыто, тот же уровень пишется снова
+    builder.forget(7);
+    CHECK(builder.stage(7, true));
+    builder.take();
+
+    CHECK(!builder.stage(OUTPUT_MAX_PINS, true));
+    CHECK(builder.take().empty());
+}
+
+static void testAgainstModel() {
+    OutputMaskBuilder builder;
+    MaskModel model;
+    uint32_t random = 1;
+    auto next = [&random](uint32_t limit) {
+        random = random * 1664525u + 1013904223u;
+        return (random >> 8) % limit;
+    };
+
+    int mismatches = 0;
+    for (int step = 0; step < 200000; step++) {
+        uint32_t op = next(100);
+        uint8_t pin = next(OUTPUT_MAX_PINS);
+        if (op < 80) {
+            bool value = next(2);
+            bool force = next(10) == 0;
+            if (builder.stage(pin, value, force) != model.stage(pin, value, force)) mismatches++;
+        } else if (op < 85) {
+            builder.forget(pin);
+            model.known[pin] = false;
+        } else if (op < 99) {
+            if (!sameMasks(builder.take(), model.take())) mismatches++;
+        } else if (next(20) == 0) {
+            builder.reset();
+            model.reset();
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    for (int pin = 0; pin < OUTPUT_MAX_PINS; pin++) {
+        if (model.known[pin]) CHECK_EQ(builder.level(pin), model.level[pin]);
+    }
+}
+
+int main() {
+    testBasics();
+    testAgainstModel();
+    return testResult("OutputMasksTest");
+}
@@ -0,0 +1,171 @@
+#include "PidAutotune.h"
+#include "TestCheck.h"
+#include <math.h>
+#include <vector>
+
+// Автонастройка на модели нагревателя: объект первого порядка с запаздыванием
+// (печь: усиление 100 °C на полную мощность, постоянная 300 с, запаздывание
+// 60 с). Ku и Tu сравниваются с точными для этой модели, затем найденные
+// коэффициенты проверяются в замкнутом контуре.
+
+static const double WINDOW_MS = 10000;    // pidWindowSize: размах выхода
+static const uint32_t SAMPLE_MS = 1000;   // замер раз в секунду, как setTemperature
+
+struct Plant {
+    double gain;        // °C на полную мощность
+    double tau;         // с
+    double deadTime;    // с
+    double ambient;
+    double temperature;
+    std::vector<double> delayed;    // мощность за последние deadTime, шагами по 0.1 с
+    size_t position = 0;
+
+    Plant(double newGain, double newTau, double newDeadTime, double newAmbient)
+        : gain(newGain), tau(newTau), deadTime(newDeadTime), ambient(newAmbient), temperature(newAmbient),
+          delayed((size_t)(newDeadTime * 10) + 1, 0.0) {}
+
+    // power - доля 0..1 на весь интервал
+    void step(double seconds, double power) {
+        for (int i = 0; i < (int)(seconds * 10); i++) {
+            delayed[position] = power;
+            position = (position + 1) % delayed.size();
+            double applied = delayed[position];
+            temperature += 0.1 * (ambient + gain * applied - temperature) / tau;
+        }
+    }
+};
+
+// Точка, где фаза объекта -180°: atan(w*tau) + w*L = pi
+static void ultimate(const Plant& plant, double& ku, double& tu) {
+    double low = 1e-6;
+    double high = M_PI / plant.deadTime;
+    for (int i = 0; i < 100; i++) {
+        double w = (low + high) / 2;
+        if (atan(w * plant.tau) + w * plant.deadTime < M_PI) low = w;
+        else high = w;
+    }
+    double w = (low + high) / 2;
+    tu = 2 * M_PI / w;
+    // В единицах выхода регулятора: усиление объекта - gain / WINDOW_MS
+    ku = sqrt(1 + w * w * plant.tau * plant.tau) / (plant.gain / WINDOW_MS);
+}
+
+static AutotuneState runAutotune(Plant& plant, PidAutotune& autotune, float setpoint, bool isDirect,
+                                 uint32_t limitMs) {
+    autotune.start(setpoint, AUTOTUNE_DEFAULT_HYSTERESIS, WINDOW_MS, isDirect, 0);
+    for (uint32_t now = 0; now < limitMs && autotune.state() == AUTOTUNE_RUNNING; now += SAMPLE_MS) {
+        bool isOn = autotune.update(now, (float)plant.temperature);
+        plant.step(SAMPLE_MS / 1000.0, isOn ? 1.0 : 0.0);
+    }
+    return autotune.state();
+}
+
+// Замкнутый контур с коэффициентами автонастройки: ПИД с ограничением
+// интеграла, выход - доля окна, как pidOutputMs. Интеграл стартует с текущего
+// выхода - безударное включение, как SetMode(AUTOMATIC) в PID_v1.
+struct LoopStats {
+    double overshoot;
+    double finalError;
+};
+
+static LoopStats runClosedLoop(Plant& plant, const AutotuneResult& result, double power, double setpoint,
+                               uint32_t durationS) {
+    double integral = power * WINDOW_MS;
+    double lastInput = plant.temperature;
+    LoopStats stats = { 0, 0 };
+    for (uint32_t t = 0; t < durationS; t++) {
+        double input = plant.temperature;
+        double error = setpoint - input;
+        integral += result.ki * error;
+        if (integral > WINDOW_MS) integral = WINDOW_MS;
+        if (integral < 0) integral = 0;
+        double output = result.kp * error + integral - result.kd * (input - lastInput);
+        lastInput = input;
+        if (output > WINDOW_MS) output = WINDOW_MS;
+        if (output < 0) output = 0;
+        plant.step(1.0, output / WINDOW_MS);
+
+        if (plant.temperature - setpoint > stats.overshoot) stats.overshoot = plant.temperature - setpoint;
+        // Ошибка - по последним 10 минутам
+        if (t + 600 >= durationS) {
+            double finalError = fabs(plant.temperature - setpoint);
+            if (finalError > stats.finalError) stats.finalError = finalError;
+        }
+    }
+    return stats;
+}
+
+static void testHeater() {
+    Plant plant(100, 300, 60, 20);
+    PidAutotune autotune;
+    CHECK_EQ(runAutotune(plant, autotune, 60, true, AUTOTUNE_TIMEOUT_MS), AUTOTUNE_DONE);
+    CHECK_EQ(autotune.cycles(), AUTOTUNE_CYCLES);
+
+    double ku;
+    double tu;
+    ultimate(plant, ku, tu);
+    const AutotuneResult& result = autotune.getResult();
+    printf("нагреватель: Ku %.3f (точно %.3f), Tu %.1f с (точно %.1f), Kp %.3f Ki %.5f Kd %.1f\n",
+           result.ku, ku, result.tuSeconds, tu, result.kp, result.ki, result.kd);
+
+    // Релейный метод - приближение описывающей функции: на объекте с
+    // запаздыванием колебания не синусоида, Ku занижается на 15-25%
+    CHECK_NEAR(result.tuSeconds / tu, 1.0, 0.1);
+    CHECK(result.ku > 0.7 * ku && result.ku <= ku);
+    CHECK_NEAR(result.kp, 0.2 * result.ku, 1e-9);
+
+    // Регулятор с найденными коэффициентами: из установившихся 50 °C на
+    // уставку 60. Правило "без перерегулирования" номинальное - на модели
+    // выходит около четверти шага; главное - контур устойчив и сходится.
+    Plant warm(100, 300, 60, 20);
+    warm.step(3600, 0.3);
+    LoopStats stats = runClosedLoop(warm, result, 0.3, 60, 3600);
+    printf("замкнутый контур: перерегулирование %.2f °C, ошибка в конце %.3f °C\n",
+           stats.overshoot, stats.finalError);
+    CHECK(stats.overshoot < 3.0);
+    CHECK(stats.finalError < 0.1);
+}
+
+static void testCooler() {
+    // Охлаждение: выход уменьшает вход, "мощность" - отрицательное усиление
+    Plant plant(-30, 120, 30, 25);
+    PidAutotune autotune;
+    CHECK_EQ(runAutotune(plant, autotune, 10, false, AUTOTUNE_TIMEOUT_MS), AUTOTUNE_DONE);
+
+    double ku;
+    double tu;
+    Plant magnitude(30, 120, 30, 25);
+    ultimate(magnitude, ku, tu);
+    const AutotuneResult& result = autotune.getResult();
+    printf("охладитель: Ku %.3f (точно %.3f), Tu %.1f с (точно %.1f)\n", result.ku, ku, result.tuSeconds, tu);
+    CHECK(result.kp > 0);
+    CHECK_NEAR(result.tuSeconds / tu, 1.0, 0.1);
+    CHECK(result.ku > 0.7 * ku && result.ku <= ku);
+}
+
+static void testFailedRuns() {
+    // Нагреватель не достаёт до уставки: колебаний нет, выход по таймауту
+    Plant weak(20, 300, 30, 20);
+    PidAutotune autotune;
+    CHECK_EQ(runAutotune(weak, autotune, 60, true, AUTOTUNE_TIMEOUT_MS + 2 * SAMPLE_MS), AUTOTUNE_FAILED);
+    CHECK(!autotune.update(AUTOTUNE_TIMEOUT_MS + 3 * SAMPLE_MS, 30));
+
+    // Обрыв датчика
+    autotune.start(60, AUTOTUNE_DEFAULT_HYSTERESIS, WINDOW_MS, true, 0);
+    CHECK(autotune.update(0, 20));
+    CHECK(!autotune.update(SAMPLE_MS, NAN));
+    CHECK_EQ(autotune.state(), AUTOTUNE_FAILED);
+
+    // Отмена не даёт результата
+    autotune.start(60, AUTOTUNE_DEFAULT_HYSTERESIS, WINDOW_MS, true, 0);
+    autotune.cancel();
+    CHECK_EQ(autotune.state(), AUTOTUNE_IDLE);
+    CHECK(!autotune.update(SAMPLE_MS, 20));
+}
+
+int main() {
+    testHeater();
+    testCooler();
+    testFailedRuns();
+    return testResult("PidAutotuneTest");
+}
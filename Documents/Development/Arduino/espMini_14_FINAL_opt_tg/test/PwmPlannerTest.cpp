@@ -0,0 +1,105 @@
+#include "PwmPlanner.h"
+#include "TestCheck.h"
+
+// Раздача каналов и таймеров LEDC и расчёт плавных переходов.
+// Пределы - как у ESP32: два режима скорости по 4 таймера и 8 каналов, APB 80 МГц.
+
+static const PwmHardwareLimits ESP32_LIMITS = { 2, 4, 8, 80000000 };
+
+static void testSharedFrequency() {
+    PwmChannelAllocator allocator(ESP32_LIMITS);
+
+    // Одна частота: на режим один таймер, каналы до исчерпания
+    int newTimers = 0;
+    for (int i = 0; i < 16; i++) {
+        PwmSlot slot = allocator.allocate(1000, 8);
+        CHECK(slot.valid());
+        CHECK(!slot.shared);
+        CHECK_EQ(slot.mode, i / 8);
+        CHECK_EQ(slot.channel, i % 8);
+        CHECK_EQ(slot.timer, 0);
+        if (slot.newTimer) newTimers++;
+    }
+    CHECK_EQ(newTimers, 2);
+    CHECK(!allocator.allocate(1000, 8).valid());
+
+    // После reset всё свободно снова
+    allocator.reset();
+    PwmSlot slot = allocator.allocate(1000, 8);
+    CHECK(slot.valid() && slot.newTimer);
+    CHECK_EQ(slot.channel, 0);
+}
+
+static void testTimerExhaustion() {
+    PwmChannelAllocator allocator(ESP32_LIMITS);
+
+    // 8 разных частот занимают все таймеры обоих режимов
+    for (uint32_t i = 0; i < 8; i++) {
+        PwmSlot slot = allocator.allocate(1000 + i * 100, 8);
+        CHECK(slot.valid() && slot.newTimer && !slot.shared);
+        CHECK_EQ(slot.frequency, 1000 + i * 100);
+    }
+
+    // Девятая частота: канал есть, таймер чужой - частота и разрядность его
+    PwmSlot shared = allocator.allocate(5000, 8);
+    CHECK(shared.valid() && shared.shared && !shared.newTimer);
+    CHECK_EQ(shared.timer, 0);
+    CHECK_EQ(shared.frequency, 1000);
+
+    // Уже настроенная частота берёт свой таймер без подмены
+    PwmSlot reused = allocator.allocate(1300, 8);
+    CHECK(reused.valid() && !reused.shared && !reused.newTimer);
+    CHECK_EQ(reused.frequency, 1300);
+}
+
+static void testResolution() {
+    // freq * 2^res не больше тактовой частоты
+    CHECK_EQ(PwmChannelAllocator::fitResolution(1000, 14, 80000000), 14);
+    CHECK_EQ(PwmChannelAllocator::fitResolution(40000, 14, 80000000), 10);
+    CHECK_EQ(PwmChannelAllocator::fitResolution(1000, 20, 80000000), PWM_MAX_RESOLUTION);
+    CHECK_EQ(PwmChannelAllocator::fitResolution(1000, 0, 80000000), 1);
+
+    // Частота 0 - по умолчанию; разная разрядность - разные таймеры
+    PwmChannelAllocator allocator(ESP32_LIMITS);
+    PwmSlot a = allocator.allocate(0, 8);
+    PwmSlot b = allocator.allocate(PWM_DEFAULT_FREQUENCY, 10);
+    CHECK_EQ(a.frequency, PWM_DEFAULT_FREQUENCY);
+    CHECK(b.newTimer);
+    CHECK(a.timer != b.timer || a.mode != b.mode);
+}
+
+static void testFades() {
+    // 8 бит -> 10 бит: максимум входа - полное включение
+    CHECK_EQ(PwmFadePlanner::scaleDuty(255, 8, 10), 1024);
+    CHECK_EQ(PwmFadePlanner::scaleDuty(0, 8, 10), 0);
+    CHECK_EQ(PwmFadePlanner::scaleDuty(128, 8, 10), 514);
+    CHECK_EQ(PwmFadePlanner::scaleDuty(65535, 16, 8), 256);
+
+    // Полный ход - полное время, половина - половина, мелкий шаг - сразу
+    CHECK_EQ(PwmFadePlanner::plan(0, 1024, 10, 1000).durationMs, 1000);
+    CHECK_EQ(PwmFadePlanner::plan(1024, 512, 10, 1000).durationMs, 500);
+    CHECK_EQ(PwmFadePlanner::plan(500, 510, 10, 1000).durationMs, 0);
+    CHECK_EQ(PwmFadePlanner::plan(0, 1024, 10, 0).durationMs, 0);
+
+    // Программный переход: от начала к цели монотонно
+    PwmFade fade = PwmFadePlanner::plan(1000, 200, 10, 1000);
+    CHECK_EQ(PwmFadePlanner::dutyAt(fade, 0), 1000);
+    CHECK_EQ(PwmFadePlanner::dutyAt(fade, fade.durationMs), 200);
+    CHECK_EQ(PwmFadePlanner::dutyAt(fade, fade.durationMs * 2), 200);
+    uint32_t previous = 1000;
+    bool isMonotonic = true;
+    for (uint32_t ms = 0; ms <= fade.durationMs; ms += 7) {
+        uint32_t duty = PwmFadePlanner::dutyAt(fade, ms);
+        if (duty > previous) isMonotonic = false;
+        previous = duty;
+    }
+    CHECK(isMonotonic);
+}
+
+int main() {
+    testSharedFrequency();
+    testTimerExhaustion();
+    testResolution();
+    testFades();
+    return testResult("PwmPlannerTest");
+}
@@ -0,0 +1,142 @@
+#include "LockFreeQueue.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Очереди между ядрами под настоящими потоками: ничего не теряется и не
+// дублируется, порядок от каждого писателя сохраняется, снимки не рвутся.
+// Имеет смысл гонять и с -DHOST_SANITIZER=thread.
+
+static const uint32_t ITEMS = 200000;
+
+static void testSpsc() {
+    SpscQueue<uint32_t, 64> queue;
+    std::atomic<bool> isOrderBroken{false};
+
+    std::thread consumer([&] {
+        uint32_t expected = 0;
+        uint32_t value;
+        while (expected < ITEMS) {
+            if (!queue.pop(value)) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (value != expected) isOrderBroken = true;
+            expected++;
+        }
+    });
+
+    uint32_t fullCount = 0;
+    for (uint32_t i = 0; i < ITEMS; i++) {
+        while (!queue.push(i)) {
+            fullCount++;
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+
+    CHECK(!isOrderBroken);
+    CHECK(queue.empty());
+    printf("spsc: %u элементов, очередь полна %u раз\n", ITEMS, fullCount);
+}
+
+struct Tagged {
+    uint8_t producer;
+    uint32_t sequence;
+};
+
+static void testMpsc() {
+    const int PRODUCERS = 4;
+    const uint32_t PER_PRODUCER = ITEMS / PRODUCERS;
+    MpscQueue<Tagged, 128> queue;
+    std::atomic<uint32_t> rejected{0};
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&, p] {
+            for (uint32_t i = 0; i < PER_PRODUCER; i++) {
+                while (!queue.push({(uint8_t)p, i})) {
+                    rejected.fetch_add(1, std::memory_order_relaxed);
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    uint32_t next[PRODUCERS] = {};
+    uint32_t received = 0;
+    bool isOrderBroken = false;
+    Tagged item;
+    while (received < PER_PRODUCER * PRODUCERS) {
+        if (!queue.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.producer >= PRODUCERS || item.sequence != next[item.producer]) {
+            isOrderBroken = true;
+        } else {
+            next[item.producer]++;
+        }
+        received++;
+    }
+    for (std::thread& producer : producers) producer.join();
+
+    CHECK(!isOrderBroken);
+    CHECK(!queue.pop(item));
+    for (int p = 0; p < PRODUCERS; p++) CHECK_EQ(next[p], PER_PRODUCER);
+    CHECK_EQ(queue.dropped(), rejected.load());
+    printf("mpsc: %d писателя, отклонено push %u\n", PRODUCERS, rejected.load());
+}
+
+struct Snapshot {
+    uint32_t sequence;
+    uint32_t payload[31];
+};
+
+static void testSnapshot() {
+    SnapshotBuffer<Snapshot> buffer;
+    std::atomic<bool> isDone{false};
+
+    std::thread writer([&] {
+        for (uint32_t i = 1; i <= ITEMS; i++) {
+            Snapshot& snapshot = buffer.beginWrite();
+            snapshot.sequence = i;
+            for (uint32_t& word : snapshot.payload) word = i;
+            buffer.publish();
+        }
+        isDone = true;
+    });
+
+    uint32_t last = 0;
+    uint32_t updates = 0;
+    bool isTorn = false;
+    bool isBackwards = false;
+    while (true) {
+        bool wasDone = isDone.load();
+        if (buffer.update()) {
+            const Snapshot& snapshot = buffer.read();
+            for (uint32_t word : snapshot.payload) {
+                if (word != snapshot.sequence) isTorn = true;
+            }
+            if (snapshot.sequence <= last) isBackwards = true;
+            last = snapshot.sequence;
+            updates++;
+        } else if (wasDone) {
+            break;
+        }
+    }
+    writer.join();
+
+    CHECK(!isTorn);
+    CHECK(!isBackwards);
+    CHECK_EQ(last, ITEMS);
+    printf("snapshot: прочитано %u снимков из %u\n", updates, ITEMS);
+}
+
+int main() {
+    testSpsc();
+    testMpsc();
+    testSnapshot();
+    return testResult("QueueStressTest");
+}
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <time.h>
+#include "ScheduleIndex.h"
+#include "TestCheck.h"
+
+// Скомпилированное расписание в зоне с переходом на летнее время (CET/CEST):
+// граница считается по местному времени, в сутки перехода не сдвигается на
+// час; пересчёт только на границах даёт то же состояние, что пересчёт
+// каждую минуту.
+
+namespace {
+
+CompiledSchedule everyDay() {
+    CompiledSchedule schedule;
+    schedule.weekMask = 0x7F;
+    schedule.monthMask = 0xFFF;
+    return schedule;
+}
+
+time_t transitionFrom(CompiledSchedule schedule, time_t now) {
+    struct tm local;
+    localtime_r(&now, &local);
+    schedule.evaluate(now, local);
+    return schedule.nextTransition;
+}
+
+void testEdgeOnDstDay() {
+    CompiledSchedule schedule = everyDay();
+    schedule.addInterval("08:00", "18:00");
+
+    // 31.03.2024 00:30 CET: 08:00 уже по CEST - 06:00 UTC, а не 07:00
+    CHECK_EQ(transitionFrom(schedule, 1711841400), 1711864800);
+    // 27.10.2024 00:30 CEST: 08:00 по CET - 07:00 UTC
+    CHECK_EQ(transitionFrom(schedule, 1729981800), 1730012400);
+    // 31.03.2024 19:00 CEST: смена суток - полночь по CEST
+    CHECK_EQ(transitionFrom(schedule, 1711904400), 1711922400);
+}
+
+// Граница в пропущенном и в повторённом часе
+void testEdgeInShiftedHour() {
+    CompiledSchedule schedule = everyDay();
+    schedule.addInterval("02:30", "03:30");
+
+    // 31.03 01:30 CET: 02:30 не существует, граница не раньше 03:00 CEST
+    time_t now = 1711841400 + 3600;
+    time_t edge = transitionFrom(schedule, now);
+    CHECK(edge > now);
+    CHECK(edge <= now + 3600);
+
+    // 27.10 02:45 CET (второй раз): граница 03:30 CET - через 45 минут
+    now = 1729981800 + 3 * 3600 + 15 * 60;
+    CHECK_EQ(transitionFrom(schedule, now), now + 45 * 60);
+}
+
+// Трое суток вокруг перехода, шаг минута: состояние по кэшу совпадает
+// с пересчётом с нуля
+void walk(time_t from) {
+    CompiledSchedule cached = everyDay();
+    cached.addInterval("01:00", "02:30");
+    cached.addInterval("02:30", "03:30");
+    cached.addInterval("08:00", "18:00");
+    cached.addInterval("22:00", "06:00");
+
+    bool state = false;
+    int evaluations = 0;
+    for (time_t now = from; now < from + 3 * (time_t)SECONDS_PER_DAY; now += 60) {
+        struct tm local;
+        localtime_r(&now, &local);
+        if (cached.isDue(now)) {
+            state = cached.evaluate(now, local);
+            evaluations++;
+        }
+        CompiledSchedule fresh = cached;
+        fresh.invalidate();
+        if (fresh.evaluate(now, local) != state) {
+            printf("state differs at %lld\n", (long long)now);
+            CHECK(false);
+            return;
+        }
+        CHECK(cached.nextTransition > now);
+    }
+    CHECK(evaluations < 3 * 12);
+}
+
+void testWalkAcrossDst() {
+    walk(1711753200);   // 30.03.2024 00:00 CET
+    walk(1729893600);   // 26.10.2024 00:00 CEST
+}
+
+void testHorizon() {
+    ScheduleHorizon horizon;
+    CHECK(horizon.isDue(1000));
+    horizon.evaluatedAt = 1000;
+    horizon.nextTransition = 2000;
+    CHECK(!horizon.isDue(1999));
+    CHECK(horizon.isDue(2000));
+    CHECK(horizon.isDue(999));   // часы переведены назад
+    horizon.invalidate();
+    CHECK(horizon.isDue(1500));
+}
+
+}
+
+int main() {
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+    testEdgeOnDstDay();
+    testEdgeInShiftedHour();
+    testWalkAcrossDst();
+    testHorizon();
+    return testResult("ScheduleIndexTest");
+}
@@ -0,0 +1,242 @@
+#include "Scheduler.h"
+#include "TestCheck.h"
+#include <string>
+#include <vector>
+
+// Планировщик на виртуальных часах: сон и длительность задач только двигают
+// время. Проверяются дедлайны без дрейфа, фаза, порядок в runDue(),
+// пропуск периодов с учётом просрочек и ожидание, которое возвращает runDue().
+
+static uint32_t clockMs = 0;
+
+static uint32_t fakeClock() { return clockMs; }
+static void fakeSleep(uint32_t ms) { clockMs += ms; }
+
+// Запуски задачи: момент старта; задача "работает" busyMs
+struct Runs {
+    std::vector<uint32_t> starts;
+    uint32_t busyMs = 0;
+
+    Scheduler::TaskFn fn() {
+        return [this]() {
+            starts.push_back(clockMs);
+            clockMs += busyMs;
+        };
+    }
+};
+
+static void runFor(Scheduler& scheduler, uint32_t durationMs) {
+    uint32_t end = clockMs + durationMs;
+    while ((int32_t)(clockMs - end) < 0) scheduler.loop();
+}
+
+// Задача работает 7 мс из 100: старты ровно на кратных периоду
+static void testNoDrift() {
+    clockMs = 5000;
+    Scheduler scheduler(fakeClock, fakeSleep);
+    Runs runs;
+    runs.busyMs = 7;
+    scheduler.addTask("fast", 100, 0, 1, runs.fn());
+
+    runFor(scheduler, 10000);
+
+    CHECK_EQ(runs.starts.size(), 100);
+    for (size_t i = 0; i < runs.starts.size(); i++) {
+        CHECK_EQ(runs.starts[i], 5000 + i * 100);
+    }
+    const Scheduler::Task* task = scheduler.getTask(0);
+    CHECK_EQ(task->runs, 100);
+    CHECK_EQ(task->overruns, 0);
+    CHECK_EQ(task->maxLateMs, 0);
+}
+
+// Сон короче периода (maxSleepMs) и неровный: опоздание есть, дрейфа нет
+static void testNoDriftWithCoarseWakeups() {
+    clockMs = 0;
+    Scheduler scheduler(fakeClock, fakeSleep, 30);
+    Runs runs;
+    scheduler.addTask("coarse", 250, 0, 1, runs.fn());
+
+    // Просыпаемся с шагом 30 мс вместо точного дедлайна
+    for (int i = 0; i < 400; i++) {
+        scheduler.runDue();
+        clockMs += 30;
+    }
+
+    CHECK(runs.starts.size() >= 47);
+    for (size_t i = 0; i < runs.starts.size(); i++) {
+        uint32_t deadline = i * 250;
+        CHECK(runs.starts[i] >= deadline);
+        CHECK(runs.starts[i] - deadline < 30);
+    }
+    CHECK(scheduler.getTask(0)->maxLateMs < 30);
+    CHECK_EQ(scheduler.getTask(0)->overruns, 0);
+}
+
+static void testPhase() {
+    clockMs = 1000;
+    Scheduler scheduler(fakeClock, fakeSleep);
+    Runs first;
+    Runs second;
+    scheduler.addTask("first", 200, 0, 1, first.fn());
+    scheduler.addTask("second", 200, 50, 1, second.fn());
+
+    runFor(scheduler, 1000);
+
+    CHECK_EQ(first.starts.size(), 5);
+    CHECK_EQ(second.starts.size(), 5);
+    for (size_t i = 0; i < second.starts.size(); i++) {
+        CHECK_EQ(first.starts[i], 1000 + i * 200);
+        CHECK_EQ(second.starts[i], 1050 + i * 200);
+    }
+}
+
+// Все должны: сначала старший приоритет, при равном - ранний дедлайн,
+// каждая задача - один раз за вызов
+static void testOrdering() {
+    clockMs = 0;
+    Scheduler scheduler(fakeClock, fakeSleep);
+    std::string order;
+    scheduler.addTask("lowEarly", 1000, 10, 1, [&]() { order += "a"; });
+    scheduler.addTask("highLate", 1000, 40, 5, [&]() { order += "b"; });
+    scheduler.addTask("midLate", 1000, 30, 3, [&]() { order += "c"; });
+    scheduler.addTask("midEarly", 1000, 20, 3, [&]() { order += "d"; });
+    scheduler.addTask("notDue", 1000, 90, 9, [&]() { order += "e"; });
+
+    clockMs = 50;
+    scheduler.runDue();
+    CHECK_STR(order.c_str(), "bdca");
+
+    // Задачи, ставшие должными за время прохода, выполняются в нём же;
+    // пропущенная на прошлом проходе e старше по дедлайну, чем новая s
+    order.clear();
+    clockMs = 1000;
+    scheduler.addTask("slow", 1000, 0, 9, [&]() { order += "s"; clockMs += 60; });
+    scheduler.runDue();
+    CHECK_STR(order.c_str(), "esbdca");
+}
+
+// Задача 350 мс при периоде 100: три периода пропускаются, не догоняются
+static void testSkippedPeriods() {
+    clockMs = 0;
+    Scheduler scheduler(fakeClock, fakeSleep);
+    std::vector<uint32_t> lateReports;
+    scheduler.setOverrunCallback([&](const char*, uint32_t lateMs) { lateReports.push_back(lateMs); });
+
+    Runs runs;
+    int id = scheduler.addTask("slow", 100, 0, 1, [&]() {
+        runs.starts.push_back(clockMs);
+        clockMs += runs.starts.size() == 1 ? 350 : 10;
+    });
+
+    runFor(scheduler, 700);
+
+    // 0 (до 350), затем 400, 500, 600
+    CHECK_EQ(runs.starts.size(), 4);
+    CHECK_EQ(runs.starts[0], 0);
+    CHECK_EQ(runs.starts[1], 400);
+    CHECK_EQ(runs.starts[2], 500);
+    CHECK_EQ(runs.starts[3], 600);
+
+    const Scheduler::Task* task = scheduler.getTask(id);
+    CHECK_EQ(task->overruns, 1);
+    CHECK_EQ(task->runs, 4);
+    CHECK_EQ(lateReports.size(), 1);
+    CHECK_EQ(lateReports[0], 250);   // закончила в 350, дедлайн был 100
+
+    // Опоздание старта: главный цикл проспал 60 мс после дедлайна
+    clockMs = 760;
+    scheduler.runDue();
+    CHECK_EQ(runs.starts.size(), 5);
+    CHECK_EQ(task->maxLateMs, 60);
+    CHECK_EQ(task->overruns, 1);
+    CHECK_EQ(task->nextRun, 800);   // от дедлайна 700, а не от старта в 760
+}
+
+static void testWait() {
+    clockMs = 0;
+    Scheduler scheduler(fakeClock, fakeSleep, 100);
+
+    // Пустая таблица - максимальный сон
+    CHECK_EQ(scheduler.runDue(), 100);
+
+    Runs a;
+    Runs b;
+    int idA = scheduler.addTask("a", 40, 0, 1, a.fn());
+    int idB = scheduler.addTask("b", 1000, 25, 1, b.fn());
+
+    CHECK_EQ(scheduler.runDue(), 25);    // a выполнена, до b 25 мс
+    clockMs = 25;
+    CHECK_EQ(scheduler.runDue(), 15);    // b выполнена, до a 15 мс
+    clockMs = 30;
+    CHECK_EQ(scheduler.runDue(), 10);    // ничего не должно
+    CHECK_EQ(a.starts.size(), 1);
+    CHECK_EQ(b.starts.size(), 1);
+
+    // Дедлайн дальше maxSleepMs - ограничение сном
+    scheduler.setEnabled(idA, false);
+    CHECK_EQ(scheduler.runDue(), 100);
+
+    // Включённая снова задача запускается сразу
+    scheduler.setEnabled(idA, true);
+    CHECK_EQ(scheduler.timeToNext(), 0);
+    CHECK_EQ(scheduler.runDue(), 40);
+    CHECK_EQ(a.starts.size(), 2);
+    CHECK_EQ(a.starts[1], 30);
+
+    // trigger() - внеочередной запуск, период дальше от него
+    clockMs = 50;
+    scheduler.trigger(idB);
+    scheduler.runDue();
+    CHECK_EQ(b.starts.size(), 2);
+    CHECK_EQ(scheduler.getTask(idB)->nextRun, 1050);
+
+    // a уже выполнилась в проходе, и её новый дедлайн прошёл, пока работала c:
+    // второй раз за вызов она не идёт, ожидание 0
+    clockMs = 70;
+    int idC = scheduler.addTask("c", 500, 0, 0, [&]() { clockMs += 50; });
+    CHECK_EQ(scheduler.runDue(), 0);
+    CHECK_EQ(scheduler.getTask(idC)->runs, 1);
+    CHECK_EQ(a.starts.size(), 3);
+    CHECK_EQ(a.starts[2], 70);
+}
+
+static void testRejectsBadTasks() {
+    clockMs = 0;
+    Scheduler scheduler(fakeClock, fakeSleep);
+    CHECK_EQ(scheduler.addTask("zero", 0, 0, 1, []() {}), -1);
+    CHECK_EQ(scheduler.addTask("empty", 10, 0, 1, Scheduler::TaskFn()), -1);
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        CHECK_EQ(scheduler.addTask("task", 10, 0, 1, []() {}), i);
+    }
+    CHECK_EQ(scheduler.addTask("overflow", 10, 0, 1, []() {}), -1);
+    CHECK_EQ(scheduler.getTaskCount(), SCHEDULER_MAX_TASKS);
+}
+
+// Переполнение uint32 millis(): дедлайны сравниваются по разности
+static void testClockWrap() {
+    clockMs = 0xFFFFFF00u;
+    Scheduler scheduler(fakeClock, fakeSleep);
+    Runs runs;
+    scheduler.addTask("wrap", 100, 0, 1, runs.fn());
+
+    runFor(scheduler, 1000);
+
+    CHECK_EQ(runs.starts.size(), 10);
+    for (size_t i = 0; i < runs.starts.size(); i++) {
+        CHECK_EQ(runs.starts[i], (uint32_t)(0xFFFFFF00u + i * 100));
+    }
+    CHECK_EQ(scheduler.getTask(0)->overruns, 0);
+}
+
+int main() {
+    testNoDrift();
+    testNoDriftWithCoarseWakeups();
+    testPhase();
+    testOrdering();
+    testSkippedPeriods();
+    testWait();
+    testRejectsBadTasks();
+    testClockWrap();
+    return testResult("SchedulerTest");
+}
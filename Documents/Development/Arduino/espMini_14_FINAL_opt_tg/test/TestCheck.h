@@ -0,0 +1,58 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+// Проверки хостовых тестов без фреймворка: провал печатается и считается,
+// тест продолжается; testResult() - код возврата main().
+
+inline int testFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        long long a_ = (long long)(actual), e_ = (long long)(expected); \
+        if (a_ != e_) { \
+            printf("%s:%d: %s = %lld, ожидалось %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, eps) \
+    do { \
+        double a_ = (double)(actual), e_ = (double)(expected); \
+        if (!(fabs(a_ - e_) <= (eps))) { \
+            printf("%s:%d: %s = %.6g, ожидалось %.6g +- %g\n", __FILE__, __LINE__, #actual, a_, e_, (double)(eps)); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_STR(actual, expected) \
+    do { \
+        const char* a_ = (actual); \
+        const char* e_ = (expected); \
+        if (strcmp(a_, e_) != 0) { \
+            printf("%s:%d: %s = \"%s\", ожидалось \"%s\"\n", __FILE__, __LINE__, #actual, a_, e_); \
+            testFailures++; \
+        } \
+    } while (0)
+
+inline int testResult(const char* name) {
+    if (testFailures) {
+        printf("%s: провалов %d\n", name, testFailures);
+        return 1;
+    }
+    printf("%s: OK\n", name);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "TimeSeriesStore.h"
+#include "BenchCommon.h"
+#include <vector>
+
+// Вставка и чтение истории на раскладках SensorHistory (HISTORY_SRAM_* и
+// HISTORY_PSRAM_* для ESP32). Кольца заполнены до отказа, время идёт шагом
+// HISTORY_SAMPLE_MS, все ряды пишутся на каждом шаге - как recordHistory.
+
+static const uint32_t SAMPLE_S = 5;
+
+struct LayoutCase {
+    const char* name;
+    HistoryLayout layout;
+};
+
+static bool benchLayout(const LayoutCase& layoutCase) {
+    const HistoryLayout& layout = layoutCase.layout;
+    std::vector<uint8_t> memory(TimeSeriesStore::bytesFor(layout));
+    TimeSeriesStore store;
+    if (!store.begin(layout, memory.data(), memory.size())) return false;
+
+    for (uint8_t i = 0; i < layout.series; i++) store.findOrAdd(100 + i, 0);
+
+    // Прогрев: часовое кольцо заполнено целиком, дальше - замер
+    uint32_t time = 1700000000UL;
+    uint32_t warmSteps = (uint32_t)layout.hourCapacity * HISTORY_HOUR_S / SAMPLE_S + layout.rawCapacity;
+    if (benchQuick) warmSteps = layout.rawCapacity * 2;
+    for (uint32_t step = 0; step < warmSteps; step++, time += SAMPLE_S) {
+        for (uint8_t i = 0; i < layout.series; i++) store.insert(i, time, (float)(step % 100) + i);
+    }
+
+    const uint32_t steps = benchIterations(200000);
+    uint64_t start = benchNowNs();
+    for (uint32_t step = 0; step < steps; step++, time += SAMPLE_S) {
+        for (uint8_t i = 0; i < layout.series; i++) store.insert(i, time, (float)(step % 100) + i);
+    }
+    double insertNs = (double)(benchNowNs() - start) / ((double)steps * layout.series);
+    benchReport("TimeSeriesStoreBench", "insert", {
+        { "series", (double)layout.series }, { "raw", (double)layout.rawCapacity }, { "ns_per_op", insertNs } });
+
+    // Поиск ряда по id сенсора: на каждый замер в recordHistory
+    const uint32_t lookups = benchIterations(1000000);
+    start = benchNowNs();
+    for (uint32_t n = 0; n < lookups; n++) benchKeep(store.find(100 + n % layout.series, 0));
+    benchReport("TimeSeriesStoreBench", "find", {
+        { "series", (double)layout.series }, { "ns_per_op", (double)(benchNowNs() - start) / lookups } });
+
+    // Чтение кусками по 64, как /history: весь ряд и последние 10 минут
+    HistoryPoint points[64];
+    HistoryAggregate aggregates[64];
+    struct { const char* name; HistoryTier tier; uint32_t windowS; } queries[] = {
+        { "read_raw_all", HISTORY_RAW, 0 },
+        { "read_raw_10min", HISTORY_RAW, 600 },
+        { "read_minute_all", HISTORY_MINUTE, 0 },
+        { "read_hour_all", HISTORY_HOUR, 0 },
+    };
+    const uint32_t reads = benchIterations(20000);
+    for (const auto& query : queries) {
+        uint32_t from = query.windowS ? time - query.windowS : 0;
+        size_t returned = 0;
+        start = benchNowNs();
+        for (uint32_t n = 0; n < reads; n++) {
+            int16_t series = n % layout.series;
+            uint32_t cursor = 0;
+            size_t count;
+            do {
+                count = query.tier == HISTORY_RAW
+                    ? store.readRaw(series, cursor, from, time, points, 64)
+                    : store.readAggregate(series, query.tier, cursor, from, time, aggregates, 64);
+                returned += count;
+            } while (count > 0);
+        }
+        benchReport("TimeSeriesStoreBench", query.name, {
+            { "series", (double)layout.series },
+            { "points_per_query", (double)returned / reads },
+            { "ns_per_query", (double)(benchNowNs() - start) / reads } });
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    benchInit(argc, argv);
+    const LayoutCase layouts[] = {
+        { "sram", { 8, 60, 120, 96 } },
+        { "psram", { 16, 720, 1440, 720 } },
+    };
+    for (const LayoutCase& layout : layouts) {
+        if (!benchLayout(layout)) {
+            printf("%s: не удалось разметить хранилище\n", layout.name);
+            return 1;
+        }
+    }
+    return 0;
+}
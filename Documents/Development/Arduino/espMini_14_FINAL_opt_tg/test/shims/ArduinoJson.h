@@ -0,0 +1,72 @@
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+
+#include <Arduino.h>
+
+// Заглушка ArduinoJson для хостовых сборок: только типы и методы, которые
+// встречаются в модулях управления. Документ ничего не хранит, чтение даёт
+// null - веб-пути (handleRelayCommand, serialize*) на хосте не выполняются,
+// команды идут прямо через ControlBridge.
+
+class JsonArray;
+class JsonObject;
+
+class JsonVariant {
+public:
+    JsonVariant operator[](const char*) const { return JsonVariant(); }
+    JsonVariant operator[](size_t) const { return JsonVariant(); }
+
+    template<typename T>
+    JsonVariant& operator=(const T&) { return *this; }
+
+    bool isNull() const { return true; }
+    template<typename T>
+    T as() const { return T(); }
+    template<typename T>
+    bool is() const { return false; }
+
+    operator const char*() const { return nullptr; }
+};
+
+class JsonObject : public JsonVariant {
+public:
+    using JsonVariant::operator=;
+    JsonArray createNestedArray(const char* key);
+    JsonObject createNestedObject(const char* key) { return JsonObject(); }
+};
+
+class JsonArray : public JsonVariant {
+public:
+    using JsonVariant::operator=;
+    JsonObject createNestedObject() { return JsonObject(); }
+    JsonArray createNestedArray() { return JsonArray(); }
+    template<typename T>
+    bool add(const T&) { return false; }
+    size_t size() const { return 0; }
+};
+
+inline JsonArray JsonObject::createNestedArray(const char*) { return JsonArray(); }
+
+template<size_t capacity>
+class StaticJsonDocument : public JsonObject {
+public:
+    template<typename T>
+    T to() { return T(); }
+    void clear() {}
+};
+
+class DynamicJsonDocument : public JsonObject {
+public:
+    explicit DynamicJsonDocument(size_t) {}
+    template<typename T>
+    T to() { return T(); }
+    void clear() {}
+};
+
+template<typename Output>
+size_t serializeJson(const JsonVariant&, Output& output) {
+    output = "null";
+    return 4;
+}
+
+#endif
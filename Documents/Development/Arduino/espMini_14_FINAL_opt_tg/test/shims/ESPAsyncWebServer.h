@@ -0,0 +1,18 @@
+#ifndef HOST_ESPASYNCWEBSERVER_H
+#define HOST_ESPASYNCWEBSERVER_H
+
+#include <Arduino.h>
+
+// Веб-сервер на хосте не поднимается: типы нужны только для объявлений
+// DeviceManager и DeviceJsonWriter. Поток ответа копит текст в памяти.
+
+class AsyncWebServerRequest;
+
+class AsyncResponseStream : public Print {
+public:
+    size_t write(uint8_t c) override { text += (char)c; return 1; }
+    using Print::write;
+    String text;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <Arduino.h>
+#include <memory>
+#include <string>
+
+// Файловая система в памяти с интерфейсом fs::FS. Файл - общий буфер:
+// открытый дескриптор видит запись через другой дескриптор.
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+public:
+    File() {}
+    File(std::shared_ptr<std::string> newData, const char* newPath, bool isAppend)
+        : data(std::move(newData)), path(newPath), offset(isAppend ? data->size() : 0) {}
+
+    explicit operator bool() const { return data != nullptr; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (!data) return 0;
+        if (offset > data->size()) offset = data->size();
+        data->replace(offset, std::min(size, data->size() - offset), (const char*)buffer, size);
+        offset += size;
+        return size;
+    }
+    using Print::write;
+
+    int available() override { return data && offset < data->size() ? (int)(data->size() - offset) : 0; }
+    int read() override { return available() ? (uint8_t)(*data)[offset++] : -1; }
+    int peek() override { return available() ? (uint8_t)(*data)[offset] : -1; }
+    size_t read(uint8_t* buffer, size_t size) {
+        size_t count = std::min(size, (size_t)available());
+        if (count) memcpy(buffer, data->data() + offset, count);
+        offset += count;
+        return count;
+    }
+    using Stream::read;
+
+    bool seek(uint32_t position, SeekMode mode = SeekSet) {
+        if (!data) return false;
+        size_t base = mode == SeekSet ? 0 : (mode == SeekCur ? offset : data->size());
+        if (base + position > data->size()) return false;
+        offset = base + position;
+        return true;
+    }
+    size_t position() const { return offset; }
+    size_t size() const { return data ? data->size() : 0; }
+    const char* name() const { return path.c_str(); }
+    void close() { data.reset(); }
+
+private:
+    std::shared_ptr<std::string> data;
+    std::string path;
+    size_t offset = 0;
+};
+
+class FSClass {
+public:
+    bool begin(bool formatOnFail = false) { return true; }
+    void end() {}
+    bool format();
+
+    File open(const char* path, const char* mode = "r");
+    File open(const String& path, const char* mode = "r") { return open(path.c_str(), mode); }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to);
+    bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+
+    size_t totalBytes() { return 1024 * 1024; }
+    size_t usedBytes();
+};
+
+typedef FSClass FS;
+
+#endif
@@ -0,0 +1,449 @@
+#include "HostHardware.h"
+
+#include <map>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <Ticker.h>
+#include <driver/ledc.h>
+#include <driver/rmt.h>
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+
+// Кадр DHT занимает ~5 мс после отпускания линии
+#define DHT_FRAME_MS 5
+// Стартовый импульс не короче этого - опрашивают DHT11
+#define DHT11_START_MIN_MS 18
+
+HardwareSerial Serial;
+FSClass SPIFFS;
+
+namespace {
+
+struct PinModel {
+    uint8_t mode = INPUT;
+    bool output = false;
+    bool input = true;          // входы подтянуты к питанию
+    uint32_t writes = 0;
+    uint32_t analogMv = 0;
+    void (*handler)(void*) = nullptr;
+    void* handlerArg = nullptr;
+    int interruptMode = 0;
+    uint32_t lowSinceMs = 0;    // линия DHT прижата к нулю с этого момента
+};
+
+struct DhtModel {
+    float temperature = 0;
+    float humidity = 0;
+    bool isPresent = false;
+};
+
+struct LedcTimer {
+    uint32_t resolution = 0;
+};
+
+struct LedcChannel {
+    int pin = -1;
+    int timer = 0;
+    bool isStopped = true;
+    uint32_t duty = 0;
+    uint32_t fadeFrom = 0;
+    uint32_t fadeTo = 0;
+    uint32_t fadeStartMs = 0;
+    uint32_t fadeMs = 0;
+};
+
+struct RmtChannel {
+    int pin = -1;
+    bool isInstalled = false;
+    bool hasFrame = false;
+    uint32_t readyMs = 0;
+    std::vector<rmt_item32_t> items;
+};
+
+uint32_t clockMs = 0;
+time_t clockEpoch = 0;
+bool isSerialEcho = false;
+
+PinModel pins[256];
+std::map<uint8_t, DhtModel> dhtSensors;
+LedcTimer ledcTimers[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+LedcChannel ledcChannels[LEDC_SPEED_MODE_MAX][LEDC_CHANNEL_MAX];
+RmtChannel rmtChannels[RMT_CHANNEL_MAX];
+std::map<std::string, std::shared_ptr<std::string>> files;
+std::vector<Ticker*> tickers;
+
+void setOutput(uint8_t pin, bool level) {
+    pins[pin].output = level;
+    pins[pin].writes++;
+}
+
+void fireInterrupt(uint8_t pin, bool level) {
+    PinModel& model = pins[pin];
+    if (!model.handler) return;
+    bool isRising = level;
+    if (model.interruptMode == CHANGE || (model.interruptMode == RISING && isRising) ||
+        (model.interruptMode == FALLING && !isRising)) {
+        model.handler(model.handlerArg);
+    }
+}
+
+uint32_t ledcDuty(const LedcChannel& channel, uint32_t now) {
+    if (channel.fadeMs == 0 || now - channel.fadeStartMs >= channel.fadeMs) return channel.duty;
+    double progress = (double)(now - channel.fadeStartMs) / channel.fadeMs;
+    return (uint32_t)(channel.fadeFrom + ((double)channel.fadeTo - channel.fadeFrom) * progress);
+}
+
+// Кадр датчика в символах RMT: ответ 80/80 мкс, 40 бит (50 мкс ноль, затем
+// 27 или 70 мкс единица), хвост 50 мкс. Пустой символ - конец приёма.
+void buildDhtFrame(RmtChannel& channel, const DhtModel& dht, bool isDht11) {
+    uint8_t data[5] = {};
+    if (isDht11) {
+        float temperature = fabsf(dht.temperature);
+        data[0] = (uint8_t)dht.humidity;
+        data[2] = (uint8_t)temperature;
+        data[3] = (uint8_t)lroundf((temperature - data[2]) * 10);
+        if (dht.temperature < 0) data[3] |= 0x80;
+    } else {
+        uint16_t humidity = (uint16_t)lroundf(dht.humidity * 10);
+        uint16_t temperature = (uint16_t)lroundf(fabsf(dht.temperature) * 10);
+        if (dht.temperature < 0) temperature |= 0x8000;
+        data[0] = humidity >> 8;
+        data[1] = humidity & 0xFF;
+        data[2] = temperature >> 8;
+        data[3] = temperature & 0xFF;
+    }
+    data[4] = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+
+    std::vector<std::pair<uint8_t, uint16_t>> levels;
+    levels.push_back({ 1, 30 });
+    levels.push_back({ 0, 80 });
+    levels.push_back({ 1, 80 });
+    for (int bit = 0; bit < 40; bit++) {
+        bool isOne = data[bit / 8] & (0x80 >> (bit % 8));
+        levels.push_back({ 0, 50 });
+        levels.push_back({ 1, (uint16_t)(isOne ? 70 : 27) });
+    }
+    levels.push_back({ 0, 50 });
+    levels.push_back({ 1, 0 });
+
+    channel.items.clear();
+    for (size_t i = 0; i + 1 < levels.size(); i += 2) {
+        rmt_item32_t item = {};
+        item.level0 = levels[i].first;
+        item.duration0 = levels[i].second;
+        item.level1 = levels[i + 1].first;
+        item.duration1 = levels[i + 1].second;
+        channel.items.push_back(item);
+    }
+    channel.items.push_back(rmt_item32_t{});
+}
+
+Ticker* nextDue(uint32_t until) {
+    Ticker* next = nullptr;
+    for (Ticker* ticker : tickers) {
+        if (!ticker->isArmed || (int32_t)(until - ticker->dueMs) < 0) continue;
+        if (!next || (int32_t)(ticker->dueMs - next->dueMs) < 0) next = ticker;
+    }
+    return next;
+}
+
+}
+
+namespace HostHardware {
+
+void reset(time_t epoch) {
+    clockMs = 0;
+    clockEpoch = epoch;
+    for (PinModel& pin : pins) pin = PinModel();
+    dhtSensors.clear();
+    for (auto& mode : ledcTimers) for (LedcTimer& timer : mode) timer = LedcTimer();
+    for (auto& mode : ledcChannels) for (LedcChannel& channel : mode) channel = LedcChannel();
+    for (RmtChannel& channel : rmtChannels) channel = RmtChannel();
+    files.clear();
+}
+
+uint32_t nowMs() { return clockMs; }
+
+time_t nowTime() { return clockEpoch + clockMs / 1000; }
+
+void advance(uint32_t ms) {
+    uint32_t until = clockMs + ms;
+    while (Ticker* ticker = nextDue(until)) {
+        clockMs = ticker->dueMs;
+        if (ticker->isRepeating) {
+            ticker->dueMs += ticker->periodMs;
+        } else {
+            ticker->isArmed = false;
+        }
+        ticker->callback(ticker->arg);
+    }
+    clockMs = until;
+}
+
+void setInput(uint8_t pin, bool level) {
+    if (pins[pin].input == level) return;
+    pins[pin].input = level;
+    fireInterrupt(pin, level);
+}
+
+bool outputLevel(uint8_t pin) { return pins[pin].output; }
+
+uint32_t outputWrites(uint8_t pin) { return pins[pin].writes; }
+
+void setAnalogMv(uint8_t pin, uint32_t mv) { pins[pin].analogMv = mv; }
+
+float pwmDuty(uint8_t pin) {
+    for (int mode = 0; mode < LEDC_SPEED_MODE_MAX; mode++) {
+        for (const LedcChannel& channel : ledcChannels[mode]) {
+            if (channel.pin != pin) continue;
+            if (channel.isStopped) return 0;
+            uint32_t resolution = ledcTimers[mode][channel.timer].resolution;
+            return resolution ? (float)ledcDuty(channel, clockMs) / (1UL << resolution) : 0;
+        }
+    }
+    return -1;
+}
+
+void setDht(uint8_t pin, float temperature, float humidity, bool isPresent) {
+    dhtSensors[pin] = { temperature, humidity, isPresent };
+}
+
+void writeFile(const char* path, const std::string& content) {
+    files[path] = std::make_shared<std::string>(content);
+}
+
+bool readFile(const char* path, std::string& content) {
+    auto found = files.find(path);
+    if (found == files.end()) return false;
+    content = *found->second;
+    return true;
+}
+
+void setSerialEcho(bool isEnabled) { isSerialEcho = isEnabled; }
+
+}
+
+// --- Ядро Arduino ---
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t* data, size_t size) {
+    if (isSerialEcho) fwrite(data, 1, size, stdout);
+    return size;
+}
+
+unsigned long millis() { return clockMs; }
+unsigned long micros() { return clockMs * 1000UL; }
+void delay(unsigned long ms) { HostHardware::advance(ms); }
+void delayMicroseconds(unsigned int) {}
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) { pins[pin].mode = mode; }
+
+void digitalWrite(uint8_t pin, uint8_t level) { setOutput(pin, level != LOW); }
+
+int digitalRead(uint8_t pin) {
+    return (pins[pin].mode & OUTPUT) == OUTPUT ? pins[pin].output : pins[pin].input;
+}
+
+uint32_t analogReadMilliVolts(uint8_t pin) { return pins[pin].analogMv; }
+int analogRead(uint8_t pin) { return (int)(pins[pin].analogMv * 4095UL / 3300); }
+void analogReadResolution(uint8_t) {}
+void analogSetAttenuation(int) {}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+    pins[pin].handler = handler;
+    pins[pin].handlerArg = arg;
+    pins[pin].interruptMode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+    pins[pin].handler = nullptr;
+    pins[pin].handlerArg = nullptr;
+}
+
+bool psramFound() { return false; }
+void* ps_malloc(size_t size) { return malloc(size); }
+
+// --- Ticker ---
+
+void Ticker::arm(uint32_t ms, bool repeat, Callback newCallback, void* newArg) {
+    if (std::find(tickers.begin(), tickers.end(), this) == tickers.end()) tickers.push_back(this);
+    isArmed = true;
+    isRepeating = repeat;
+    periodMs = ms;
+    dueMs = clockMs + ms;
+    callback = newCallback;
+    arg = newArg;
+}
+
+void Ticker::detach() {
+    isArmed = false;
+    tickers.erase(std::remove(tickers.begin(), tickers.end(), this), tickers.end());
+}
+
+// --- Регистры GPIO ---
+
+void hostRegisterWrite(uint32_t address, uint32_t value) {
+    int base = (address == GPIO_OUT1_W1TS_REG || address == GPIO_OUT1_W1TC_REG) ? 32 : 0;
+    bool level = address == GPIO_OUT_W1TS_REG || address == GPIO_OUT1_W1TS_REG;
+    for (int bit = 0; bit < 32; bit++) {
+        if (value & (1UL << bit)) setOutput(base + bit, level);
+    }
+}
+
+esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t) { return ESP_OK; }
+esp_err_t gpio_set_pull_mode(gpio_num_t, gpio_pull_mode_t) { return ESP_OK; }
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level) {
+    if (!level) pins[pin].lowSinceMs = clockMs;
+    setOutput(pin, level != 0);
+    return ESP_OK;
+}
+
+// --- LEDC ---
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* config) {
+    if (config->speed_mode >= LEDC_SPEED_MODE_MAX || config->timer_num >= LEDC_TIMER_MAX) return ESP_FAIL;
+    ledcTimers[config->speed_mode][config->timer_num].resolution = config->duty_resolution;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* config) {
+    if (config->speed_mode >= LEDC_SPEED_MODE_MAX || config->channel >= LEDC_CHANNEL_MAX) return ESP_FAIL;
+    LedcChannel& channel = ledcChannels[config->speed_mode][config->channel];
+    channel = LedcChannel();
+    channel.pin = config->gpio_num;
+    channel.timer = config->timer_sel;
+    channel.duty = config->duty;
+    channel.isStopped = false;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_func_install(int) { return ESP_OK; }
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t mode, ledc_channel_t index, uint32_t duty, int ms) {
+    LedcChannel& channel = ledcChannels[mode][index];
+    channel.fadeFrom = ledcDuty(channel, clockMs);
+    channel.fadeTo = duty;
+    channel.fadeMs = ms > 0 ? ms : 0;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t mode, ledc_channel_t index, ledc_fade_mode_t) {
+    LedcChannel& channel = ledcChannels[mode][index];
+    channel.fadeStartMs = clockMs;
+    channel.duty = channel.fadeTo;
+    channel.isStopped = false;
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t index, uint32_t duty) {
+    LedcChannel& channel = ledcChannels[mode][index];
+    channel.duty = duty;
+    channel.fadeMs = 0;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t index) {
+    ledcChannels[mode][index].isStopped = false;
+    return ESP_OK;
+}
+
+esp_err_t ledc_stop(ledc_mode_t mode, ledc_channel_t index, uint32_t idleLevel) {
+    LedcChannel& channel = ledcChannels[mode][index];
+    channel.isStopped = true;
+    channel.fadeMs = 0;
+    if (channel.pin >= 0) setOutput(channel.pin, idleLevel != 0);
+    return ESP_OK;
+}
+
+// --- RMT: приём кадров DHT ---
+
+esp_err_t rmt_config(const rmt_config_t* config) {
+    if (config->channel >= RMT_CHANNEL_MAX) return ESP_FAIL;
+    rmtChannels[config->channel].pin = config->gpio_num;
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t, int) {
+    if (channel >= RMT_CHANNEL_MAX || rmtChannels[channel].isInstalled) return ESP_FAIL;
+    rmtChannels[channel].isInstalled = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel) {
+    rmtChannels[channel] = RmtChannel();
+    return ESP_OK;
+}
+
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t* handle) {
+    *handle = &rmtChannels[channel];
+    return ESP_OK;
+}
+
+// Датчик отвечает на стартовый импульс; его длина говорит, DHT11 это или DHT22
+esp_err_t rmt_rx_start(rmt_channel_t index, bool) {
+    RmtChannel& channel = rmtChannels[index];
+    channel.hasFrame = false;
+    auto dht = dhtSensors.find((uint8_t)channel.pin);
+    if (dht == dhtSensors.end() || !dht->second.isPresent) return ESP_OK;
+
+    bool isDht11 = clockMs - pins[channel.pin].lowSinceMs >= DHT11_START_MIN_MS;
+    buildDhtFrame(channel, dht->second, isDht11);
+    channel.hasFrame = true;
+    channel.readyMs = clockMs + DHT_FRAME_MS;
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_stop(rmt_channel_t index) {
+    rmtChannels[index].hasFrame = false;
+    return ESP_OK;
+}
+
+void* xRingbufferReceive(RingbufHandle_t handle, size_t* size, TickType_t) {
+    RmtChannel* channel = static_cast<RmtChannel*>(handle);
+    if (!channel || !channel->hasFrame || (int32_t)(clockMs - channel->readyMs) < 0) return nullptr;
+    channel->hasFrame = false;
+    *size = channel->items.size() * sizeof(rmt_item32_t);
+    return channel->items.data();
+}
+
+void vRingbufferReturnItem(RingbufHandle_t, void*) {}
+
+// --- SPIFFS ---
+
+File FSClass::open(const char* path, const char* mode) {
+    auto found = files.find(path);
+    if (mode[0] == 'r') {
+        return found == files.end() ? File() : File(found->second, path, false);
+    }
+    if (mode[0] == 'w' || found == files.end()) {
+        found = files.insert_or_assign(path, std::make_shared<std::string>()).first;
+    }
+    return File(found->second, path, mode[0] == 'a');
+}
+
+bool FSClass::exists(const char* path) { return files.count(path) > 0; }
+
+bool FSClass::remove(const char* path) { return files.erase(path) > 0; }
+
+bool FSClass::rename(const char* from, const char* to) {
+    auto found = files.find(from);
+    if (found == files.end()) return false;
+    std::shared_ptr<std::string> data = found->second;
+    files.erase(found);
+    files[to] = data;
+    return true;
+}
+
+bool FSClass::format() {
+    files.clear();
+    return true;
+}
+
+size_t FSClass::usedBytes() {
+    size_t used = 0;
+    for (const auto& file : files) used += file.second->size();
+    return used;
+}
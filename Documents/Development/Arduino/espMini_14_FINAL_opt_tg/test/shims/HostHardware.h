@@ -0,0 +1,43 @@
+#ifndef HOST_HARDWARE_H
+#define HOST_HARDWARE_H
+
+#include <Arduino.h>
+#include <string>
+
+// Модель платы для хостовых сборок: виртуальные часы, уровни пинов, АЦП,
+// LEDC, датчики DHT на RMT и SPIFFS в памяти. Всё однопоточное: время идёт
+// только через advance(), тогда же срабатывают Ticker и прерывания.
+
+namespace HostHardware {
+
+void reset(time_t epoch);
+
+// Виртуальные часы: millis() и time(). advance() выполняет истёкшие Ticker по порядку.
+uint32_t nowMs();
+time_t nowTime();
+void advance(uint32_t ms);
+
+// Уровень на входе; при изменении вызывается обработчик attachInterruptArg
+void setInput(uint8_t pin, bool level);
+// Уровень, который прошивка выставила на выходе (digitalWrite или регистры W1TS/W1TC)
+bool outputLevel(uint8_t pin);
+uint32_t outputWrites(uint8_t pin);
+
+void setAnalogMv(uint8_t pin, uint32_t mv);
+
+// Скважность LEDC на пине, 0..1; -1 - пин не привязан к каналу
+float pwmDuty(uint8_t pin);
+
+// DHT22 на пине: следующий захват RMT получит кадр с этими значениями.
+// isPresent = false - датчик не отвечает.
+void setDht(uint8_t pin, float temperature, float humidity, bool isPresent = true);
+
+// SPIFFS в памяти
+void writeFile(const char* path, const std::string& content);
+bool readFile(const char* path, std::string& content);
+
+void setSerialEcho(bool isEnabled);
+
+}
+
+#endif
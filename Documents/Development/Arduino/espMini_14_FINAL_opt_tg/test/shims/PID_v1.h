@@ -0,0 +1,127 @@
+#ifndef HOST_PID_V1_H
+#define HOST_PID_V1_H
+
+#include <Arduino.h>
+
+// Алгоритм библиотеки PID_v1 (Brett Beauregard, 1.2.x) для хоста: пропорция
+// по ошибке, интеграл с ограничением выходом, производная по входу, расчёт
+// не чаще SampleTime по millis().
+
+#define AUTOMATIC 1
+#define MANUAL 0
+#define DIRECT 0
+#define REVERSE 1
+#define P_ON_M 0
+#define P_ON_E 1
+
+class PID {
+public:
+    PID(double* input, double* output, double* setpoint, double kp, double ki, double kd, int direction)
+        : myInput(input), myOutput(output), mySetpoint(setpoint) {
+        SetOutputLimits(0, 255);
+        SetControllerDirection(direction);
+        SetTunings(kp, ki, kd);
+        lastTime = millis() - sampleTime;
+    }
+
+    bool Compute() {
+        if (!inAuto) return false;
+        unsigned long now = millis();
+        if (now - lastTime < sampleTime) return false;
+
+        double input = *myInput;
+        double error = *mySetpoint - input;
+        outputSum += ki * error;
+        outputSum = clamp(outputSum);
+
+        double output = kp * error + outputSum - kd * (input - lastInput);
+        *myOutput = clamp(output);
+
+        lastInput = input;
+        lastTime = now;
+        return true;
+    }
+
+    void SetMode(int mode) {
+        bool isAuto = mode == AUTOMATIC;
+        if (isAuto && !inAuto) {
+            outputSum = clamp(*myOutput);
+            lastInput = *myInput;
+        }
+        inAuto = isAuto;
+    }
+
+    void SetOutputLimits(double min, double max) {
+        if (min >= max) return;
+        outMin = min;
+        outMax = max;
+        if (inAuto) {
+            *myOutput = clamp(*myOutput);
+            outputSum = clamp(outputSum);
+        }
+    }
+
+    void SetTunings(double newKp, double newKi, double newKd) {
+        if (newKp < 0 || newKi < 0 || newKd < 0) return;
+        dispKp = newKp;
+        dispKi = newKi;
+        dispKd = newKd;
+        double sampleSeconds = sampleTime / 1000.0;
+        kp = newKp;
+        ki = newKi * sampleSeconds;
+        kd = newKd / sampleSeconds;
+        if (direction == REVERSE) {
+            kp = -kp;
+            ki = -ki;
+            kd = -kd;
+        }
+    }
+
+    void SetSampleTime(int newSampleTime) {
+        if (newSampleTime <= 0) return;
+        double ratio = (double)newSampleTime / sampleTime;
+        ki *= ratio;
+        kd /= ratio;
+        sampleTime = newSampleTime;
+    }
+
+    void SetControllerDirection(int newDirection) {
+        if (inAuto && newDirection != direction) {
+            kp = -kp;
+            ki = -ki;
+            kd = -kd;
+        }
+        direction = newDirection;
+    }
+
+    double GetKp() { return dispKp; }
+    double GetKi() { return dispKi; }
+    double GetKd() { return dispKd; }
+    int GetMode() { return inAuto ? AUTOMATIC : MANUAL; }
+    int GetDirection() { return direction; }
+
+private:
+    double* myInput;
+    double* myOutput;
+    double* mySetpoint;
+
+    double dispKp = 0;
+    double dispKi = 0;
+    double dispKd = 0;
+    double kp = 0;
+    double ki = 0;
+    double kd = 0;
+    int direction = DIRECT;
+
+    unsigned long lastTime = 0;
+    unsigned long sampleTime = 100;
+    double outputSum = 0;
+    double lastInput = 0;
+    double outMin = 0;
+    double outMax = 255;
+    bool inAuto = false;
+
+    double clamp(double value) const { return value > outMax ? outMax : (value < outMin ? outMin : value); }
+};
+
+#endif
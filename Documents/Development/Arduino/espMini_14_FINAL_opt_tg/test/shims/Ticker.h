@@ -0,0 +1,43 @@
+#ifndef HOST_TICKER_H
+#define HOST_TICKER_H
+
+#include <stdint.h>
+
+// Ticker на виртуальных часах HostHardware: колбэк вызывается из advance(),
+// когда время дошло до срока. Одноразовый снимается перед вызовом.
+
+class Ticker {
+public:
+    Ticker() {}
+    ~Ticker() { detach(); }
+    Ticker(const Ticker&) = delete;
+    Ticker& operator=(const Ticker&) = delete;
+
+    typedef void (*Callback)(void*);
+
+    template<typename T>
+    void once_ms(uint32_t ms, void (*callback)(T), T arg) {
+        arm(ms, false, reinterpret_cast<Callback>(callback), (void*)arg);
+    }
+
+    template<typename T>
+    void attach_ms(uint32_t ms, void (*callback)(T), T arg) {
+        arm(ms, true, reinterpret_cast<Callback>(callback), (void*)arg);
+    }
+
+    void detach();
+    bool active() const { return isArmed; }
+
+    // Для HostHardware::advance
+    bool isArmed = false;
+    bool isRepeating = false;
+    uint32_t periodMs = 0;
+    uint32_t dueMs = 0;
+    Callback callback = nullptr;
+    void* arg = nullptr;
+
+private:
+    void arm(uint32_t ms, bool repeat, Callback newCallback, void* newArg);
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+
+// String ядра Arduino поверх std::string: те же методы и то же поведение
+// на границах (substring за концом - пустая строка, indexOf - -1).
+
+class String {
+public:
+    String() {}
+    String(const char* text) : value(text ? text : "") {}
+    String(const String& other) = default;
+    String(String&& other) = default;
+    explicit String(char c) : value(1, c) {}
+    String(int number, unsigned char base = 10) : value(fromInteger((long long)number, base)) {}
+    String(unsigned number, unsigned char base = 10) : value(fromInteger((unsigned long long)number, base)) {}
+    String(long number, unsigned char base = 10) : value(fromInteger((long long)number, base)) {}
+    String(unsigned long number, unsigned char base = 10) : value(fromInteger((unsigned long long)number, base)) {}
+    String(long long number, unsigned char base = 10) : value(fromInteger(number, base)) {}
+    String(unsigned long long number, unsigned char base = 10) : value(fromInteger(number, base)) {}
+    String(float number, unsigned char decimals = 2) : value(fromDouble(number, decimals)) {}
+    String(double number, unsigned char decimals = 2) : value(fromDouble(number, decimals)) {}
+
+    String& operator=(const String& other) = default;
+    String& operator=(String&& other) = default;
+    String& operator=(const char* text) { value = text ? text : ""; return *this; }
+
+    const char* c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.size(); }
+    bool isEmpty() const { return value.empty(); }
+    bool reserve(unsigned int size) { value.reserve(size); return true; }
+
+    char charAt(unsigned int index) const { return index < value.size() ? value[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return value[index]; }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(value.find(c, from)); }
+    int indexOf(const String& text, unsigned int from = 0) const { return position(value.find(text.value, from)); }
+    int lastIndexOf(char c) const { return position(value.rfind(c)); }
+    int lastIndexOf(const String& text) const { return position(value.rfind(text.value)); }
+
+    String substring(unsigned int from) const { return from < value.size() ? String(value.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        return from < value.size() ? String(value.substr(from, to - from)) : String();
+    }
+
+    bool startsWith(const String& prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+    bool endsWith(const String& suffix) const {
+        return value.size() >= suffix.value.size() &&
+               value.compare(value.size() - suffix.value.size(), suffix.value.size(), suffix.value) == 0;
+    }
+    bool equals(const String& other) const { return value == other.value; }
+    bool equalsIgnoreCase(const String& other) const { return strcasecmp(c_str(), other.c_str()) == 0; }
+    int compareTo(const String& other) const { return value.compare(other.value); }
+
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return (float)atof(c_str()); }
+    double toDouble() const { return atof(c_str()); }
+
+    void trim() {
+        size_t begin = 0;
+        while (begin < value.size() && isspace((unsigned char)value[begin])) begin++;
+        size_t end = value.size();
+        while (end > begin && isspace((unsigned char)value[end - 1])) end--;
+        value = value.substr(begin, end - begin);
+    }
+    void toLowerCase() { for (char& c : value) c = (char)tolower((unsigned char)c); }
+    void toUpperCase() { for (char& c : value) c = (char)toupper((unsigned char)c); }
+    void remove(unsigned int index) { if (index < value.size()) value.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < value.size()) value.erase(index, count); }
+    void replace(const String& find, const String& with) {
+        if (find.value.empty()) return;
+        for (size_t at = value.find(find.value); at != std::string::npos; at = value.find(find.value, at + with.value.size())) {
+            value.replace(at, find.value.size(), with.value);
+        }
+    }
+
+    String& operator+=(const String& other) { value += other.value; return *this; }
+    String& operator+=(const char* text) { if (text) value += text; return *this; }
+    String& operator+=(char c) { value += c; return *this; }
+    template<typename T>
+    String& operator+=(T number) { return *this += String(number); }
+    bool concat(const String& other) { value += other.value; return true; }
+
+    bool operator==(const String& other) const { return value == other.value; }
+    bool operator==(const char* text) const { return value == (text ? text : ""); }
+    bool operator!=(const String& other) const { return value != other.value; }
+    bool operator!=(const char* text) const { return !(*this == text); }
+    bool operator<(const String& other) const { return value < other.value; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.value + b.value); }
+    friend String operator+(const String& a, const char* b) { return String(a.value + (b ? b : "")); }
+    friend String operator+(const char* a, const String& b) { return String(std::string(a ? a : "") + b.value); }
+    friend String operator+(const String& a, char b) { return String(a.value + b); }
+
+private:
+    std::string value;
+
+    explicit String(std::string&& text) : value(std::move(text)) {}
+    explicit String(const std::string& text) : value(text) {}
+
+    static int position(size_t at) { return at == std::string::npos ? -1 : (int)at; }
+
+    template<typename T>
+    static std::string fromInteger(T number, unsigned char base) {
+        if (base == 10) return std::to_string(number);
+        char buffer[72];
+        char* end = buffer + sizeof(buffer) - 1;
+        char* cursor = end;
+        *cursor = '\0';
+        bool isNegative = number < 0;
+        unsigned long long magnitude = isNegative ? 0ULL - (unsigned long long)number : (unsigned long long)number;
+        do {
+            unsigned digit = magnitude % base;
+            *--cursor = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+            magnitude /= base;
+        } while (magnitude > 0);
+        if (isNegative) *--cursor = '-';
+        return std::string(cursor);
+    }
+
+    static std::string fromDouble(double number, unsigned char decimals) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+        return std::string(buffer);
+    }
+};
+
+#endif
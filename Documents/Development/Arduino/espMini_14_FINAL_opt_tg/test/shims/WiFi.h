@@ -0,0 +1,8 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+// Модули управления сеть не используют; заголовок нужен CommonTypes.h
+
+#include <Arduino.h>
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef HOST_RMT_H
+#define HOST_RMT_H
+
+#include <Arduino.h>
+
+// Старый драйвер RMT (IDF 4): приём в кольцевой буфер. Захват на пине с
+// моделью DHT (HostHardware::setDht) кладёт в буфер кадр датчика.
+
+typedef enum { RMT_CHANNEL_0 = 0, RMT_CHANNEL_MAX = 8 } rmt_channel_t;
+typedef enum { RMT_MODE_TX = 0, RMT_MODE_RX } rmt_mode_t;
+typedef enum { GPIO_NUM_0 = 0 } gpio_num_t;
+typedef enum { GPIO_MODE_INPUT = 1, GPIO_MODE_OUTPUT = 2, GPIO_MODE_INPUT_OUTPUT_OD = 7 } gpio_mode_t;
+typedef enum { GPIO_PULLUP_ONLY = 0, GPIO_FLOATING = 3 } gpio_pull_mode_t;
+
+typedef struct {
+    uint32_t duration0 : 15;
+    uint32_t level0 : 1;
+    uint32_t duration1 : 15;
+    uint32_t level1 : 1;
+} rmt_item32_t;
+
+typedef void* RingbufHandle_t;
+typedef uint32_t TickType_t;
+
+typedef struct {
+    bool filter_en;
+    uint8_t filter_ticks_thresh;
+    uint16_t idle_threshold;
+} rmt_rx_config_t;
+
+typedef struct {
+    rmt_mode_t rmt_mode;
+    rmt_channel_t channel;
+    gpio_num_t gpio_num;
+    uint8_t clk_div;
+    uint8_t mem_block_num;
+    rmt_rx_config_t rx_config;
+} rmt_config_t;
+
+esp_err_t rmt_config(const rmt_config_t* config);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t ringBufferSize, int flags);
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel);
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t* handle);
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool resetMemory);
+esp_err_t rmt_rx_stop(rmt_channel_t channel);
+
+void* xRingbufferReceive(RingbufHandle_t handle, size_t* size, TickType_t wait);
+void vRingbufferReturnItem(RingbufHandle_t handle, void* item);
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode);
+esp_err_t gpio_set_pull_mode(gpio_num_t pin, gpio_pull_mode_t pull);
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level);
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_ESP_IDF_VERSION_H
+#define HOST_ESP_IDF_VERSION_H
+
+// Arduino-ESP32 2.x: DHT читается старым драйвером RMT через кольцевой буфер
+#define ESP_IDF_VERSION_MAJOR 4
+
+#endif
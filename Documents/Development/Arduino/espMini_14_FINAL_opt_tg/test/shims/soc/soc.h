@@ -0,0 +1,11 @@
+#ifndef HOST_SOC_H
+#define HOST_SOC_H
+
+#include <stdint.h>
+
+// Запись в регистр GPIO попадает в модель пинов HostHardware
+void hostRegisterWrite(uint32_t address, uint32_t value);
+
+#define REG_WRITE(address, value) hostRegisterWrite((uint32_t)(address), (uint32_t)(value))
+
+#endif